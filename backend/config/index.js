@@ -8,6 +8,18 @@ try {
   console.warn('[Config] Could not log .env path', e);
 }
 
+// DEVICE_UPLOAD_KEYS: {"<deviceId>": {"key": "...", "email": "...", "moduleId": "..."}}
+const parseDeviceKeys = (raw) => {
+  if (!raw) return {};
+  try {
+    const keys = JSON.parse(raw);
+    return keys && typeof keys === 'object' ? keys : {};
+  } catch (e) {
+    console.warn('[Config] DEVICE_UPLOAD_KEYS is not valid JSON, device uploads disabled');
+    return {};
+  }
+};
+
 module.exports = {
   database: {
     host: process.env.DB_HOST || 'localhost',
@@ -26,4 +38,8 @@ module.exports = {
     origin: process.env.CORS_ORIGIN || '*',
     credentials: true,
   },
+  deviceUpload: {
+    devices: parseDeviceKeys(process.env.DEVICE_UPLOAD_KEYS),
+    maxBatchBytes: process.env.DEVICE_UPLOAD_MAX_BATCH || '1mb',
+  },
 };
@@ -0,0 +1,11 @@
+-- Upload offset of each device's log (Wi-Fi bulk upload, routes/deviceLogRoutes.js):
+-- the seq the next batch continues from. Records below it are already stored.
+CREATE TABLE IF NOT EXISTS device_log_offsets (
+  "deviceId" TEXT PRIMARY KEY,
+  "batteryId" UUID NOT NULL REFERENCES batteries("id") ON DELETE CASCADE,
+  "nextSeq" BIGINT NOT NULL DEFAULT 0,
+  "createdAt" TIMESTAMPTZ NOT NULL DEFAULT now(),
+  "updatedAt" TIMESTAMPTZ NOT NULL DEFAULT now()
+);
+
+CREATE INDEX IF NOT EXISTS idx_device_log_offsets_batteryId ON device_log_offsets ("batteryId");
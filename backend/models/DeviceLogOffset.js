@@ -0,0 +1,39 @@
+const { DataTypes } = require('sequelize');
+const sequelize = require('../config/database');
+
+const DeviceLogOffset = sequelize.define(
+  'DeviceLogOffset',
+  {
+    // device id the firmware uploads under (NVS "offload"/"dev")
+    deviceId: {
+      type: DataTypes.STRING,
+      primaryKey: true,
+    },
+    batteryId: {
+      type: DataTypes.UUID,
+      allowNull: false,
+      references: {
+        model: 'batteries',
+        key: 'id',
+      },
+    },
+    // seq the next batch continues from; records below it are stored
+    nextSeq: {
+      type: DataTypes.BIGINT,
+      allowNull: false,
+      defaultValue: 0,
+      get() {
+        return Number(this.getDataValue('nextSeq'));
+      },
+    },
+  },
+  {
+    tableName: 'device_log_offsets',
+    timestamps: true,
+    indexes: [
+      { fields: ['batteryId'] },
+    ],
+  }
+);
+
+module.exports = DeviceLogOffset;
@@ -2,6 +2,7 @@ const User = require('./User');
 const Battery = require('./Battery');
 const BatteryReading = require('./BatteryReading');
 const Firmware = require('./Firmware');
+const DeviceLogOffset = require('./DeviceLogOffset');
 
 // Define associations
 User.hasMany(Battery, {
@@ -24,9 +25,21 @@ BatteryReading.belongsTo(Battery, {
   targetKey: 'id',
 });
 
+Battery.hasMany(DeviceLogOffset, {
+  foreignKey: 'batteryId',
+  sourceKey: 'id',
+  onDelete: 'CASCADE',
+});
+
+DeviceLogOffset.belongsTo(Battery, {
+  foreignKey: 'batteryId',
+  targetKey: 'id',
+});
+
 module.exports = {
   User,
   Battery,
   BatteryReading,
   Firmware,
+  DeviceLogOffset,
 };
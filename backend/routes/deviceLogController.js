@@ -0,0 +1,199 @@
+const { User, Battery, BatteryReading, DeviceLogOffset } = require('../models');
+const sequelize = require('../config/database');
+const config = require('../config');
+const { decodeBatch } = require('../utils/logBatch');
+
+/* Helpers --------------------------------------------------------------- */
+
+const isDbConnectionError = (err) => {
+  const msg = (err && err.message ? err.message : String(err)).toLowerCase();
+  return msg.includes('econnrefused') || msg.includes('connect') || msg.includes('connection');
+};
+
+// Device id -> { key, email, moduleId } from DEVICE_UPLOAD_KEYS; null unless
+// the request carries that device's key.
+const authenticateDevice = (req) => {
+  const device = config.deviceUpload.devices[req.params.deviceId];
+  const auth = req.headers?.authorization || '';
+  if (!device || typeof device.key !== 'string' || !device.key) return null;
+  if (!auth.startsWith('Bearer ') || auth.slice(7).trim() !== device.key) return null;
+  return device;
+};
+
+const resolveDeviceBattery = async (device, deviceId, transaction) => {
+  const email = (typeof device.email === 'string' && device.email.includes('@'))
+    ? device.email
+    : 'guest@featherstill.local';
+  const moduleId = (typeof device.moduleId === 'string' && device.moduleId.trim())
+    ? device.moduleId.trim()
+    : deviceId;
+
+  const [user] = await User.findOrCreate({
+    where: { email },
+    defaults: { email, isGuest: email.startsWith('guest@') },
+    transaction,
+  });
+  const [battery] = await Battery.findOrCreate({
+    where: { userId: user.id, moduleId },
+    defaults: { userId: user.id, moduleId },
+    transaction,
+  });
+  return battery;
+};
+
+// Same mapping as the phone app's formatBmsPayload() (frontend/utils/commonUtils.js).
+const buildReadingFromRecord = (rec, batteryId, deviceId) => {
+  const cellVoltages = rec.cell_mv.map((v) => v / 1000);
+  const currentAmps = rec.current_ma / 1000;
+
+  return {
+    batteryId,
+    timestamp: new Date(rec.timestamp_s * 1000),
+    minCellVoltage: cellVoltages.length ? Math.min(...cellVoltages) : 0,
+    maxCellVoltage: cellVoltages.length ? Math.max(...cellVoltages) : 0,
+    totalBatteryVoltage: rec.pack_total_mv / 1000,
+    cellTemperature: rec.temp_ts1_c_x100 / 100,
+    currentAmps,
+    outputVoltage: rec.pack_ld_mv / 1000,
+    stateOfCharge: rec.soc,
+    chargingStatus: currentAmps > 0 ? 'CHARGING' : 'INACTIVE',
+    cellVoltages,
+    rawPayload: { source: 'wifi', deviceId, ...rec },
+  };
+};
+
+// Newest record seq the phone relay stored for this battery (its readings
+// carry the record's seq in rawPayload), -1 if none.
+const relayWatermark = async (batteryId, transaction) => {
+  const [row] = await sequelize.query(
+    `SELECT MAX(("rawPayload"->>'seq')::bigint) AS "seq" FROM battery_readings
+     WHERE "batteryId" = :batteryId
+       AND jsonb_typeof("rawPayload"->'seq') = 'number'
+       AND ("rawPayload"->>'source') IS DISTINCT FROM 'wifi'`,
+    { replacements: { batteryId }, type: sequelize.QueryTypes.SELECT, transaction },
+  );
+  return row && row.seq !== null ? Number(row.seq) : -1;
+};
+
+/* Controllers ----------------------------------------------------------- */
+
+/**
+ * GET /api/device-logs/:deviceId/offset
+ * Seq the device's next batch continues from (0 before its first upload)
+ */
+const getUploadOffset = async (req, res, next) => {
+  try {
+    if (!authenticateDevice(req)) {
+      return res.status(401).json({ success: false, error: 'Bad device key' });
+    }
+
+    const row = await DeviceLogOffset.findByPk(req.params.deviceId);
+    return res.json({ success: true, data: { nextSeq: row ? row.nextSeq : 0 } });
+  } catch (err) {
+    if (isDbConnectionError(err)) {
+      return res.status(503).json({ success: false, error: 'Database unavailable. Try again.' });
+    }
+    return next(err);
+  }
+};
+
+/**
+ * POST /api/device-logs/:deviceId/batches
+ * Store one log batch (application/octet-stream, main/log_pack.h)
+ *
+ * The batch must continue from the stored offset (from_seq <= nextSeq) unless
+ * it is flagged REBASE; records below the offset were stored before and are
+ * skipped, so a batch resent after a lost reply stores nothing twice.
+ *
+ * A REBASE moves the offset to from_seq only when that can be checked:
+ * backward only to 0 (the device's log was reset), forward only when the
+ * phone relay already stored the record before from_seq. Otherwise 409.
+ */
+const postLogBatch = async (req, res, next) => {
+  const { deviceId } = req.params;
+  try {
+    const device = authenticateDevice(req);
+    if (!device) {
+      return res.status(401).json({ success: false, error: 'Bad device key' });
+    }
+    if (!Buffer.isBuffer(req.body) || !req.body.length) {
+      return res.status(400).json({ success: false, error: 'Expected an application/octet-stream batch' });
+    }
+
+    let batch;
+    try {
+      batch = decodeBatch(req.body);
+    } catch (err) {
+      return res.status(err.statusCode || 400).json({ success: false, error: err.message });
+    }
+    const { header, records } = batch;
+
+    const result = await sequelize.transaction(async (transaction) => {
+      const battery = await resolveDeviceBattery(device, deviceId, transaction);
+      await DeviceLogOffset.findOrCreate({
+        where: { deviceId },
+        defaults: { deviceId, batteryId: battery.id, nextSeq: 0 },
+        transaction,
+      });
+      // Row lock: concurrent batches of one device are applied one at a time.
+      const offset = await DeviceLogOffset.findByPk(deviceId, {
+        transaction,
+        lock: transaction.LOCK.UPDATE,
+      });
+
+      let expected = offset.nextSeq;
+      if (header.rebase && header.fromSeq !== expected) {
+        const allowed = header.fromSeq < expected
+          ? header.fromSeq === 0
+          : (await relayWatermark(battery.id, transaction)) >= header.fromSeq - 1;
+        if (!allowed) {
+          return { conflict: true, nextSeq: expected };
+        }
+        expected = header.fromSeq;
+      } else if (header.fromSeq > expected) {
+        return { conflict: true, nextSeq: expected };
+      }
+
+      const rows = [];
+      for (const rec of records) {
+        if (rec.seq < expected) continue;
+        rows.push(buildReadingFromRecord(rec, battery.id, deviceId));
+        expected = rec.seq + 1;
+      }
+      if (rows.length) {
+        await BatteryReading.bulkCreate(rows, { transaction });
+      }
+      await offset.update({ nextSeq: expected, batteryId: battery.id }, { transaction });
+      return { conflict: false, nextSeq: expected, inserted: rows.length };
+    });
+
+    console.log('[DeviceLogAPI] Batch:', {
+      requestId: req.id,
+      deviceId,
+      codec: header.codec,
+      count: header.count,
+      fromSeq: header.fromSeq,
+      rebase: header.rebase,
+      ...result,
+    });
+
+    if (result.conflict) {
+      return res.status(409).json({
+        success: false,
+        error: 'Batch does not continue from the upload offset',
+        data: { nextSeq: result.nextSeq },
+      });
+    }
+    return res.json({ success: true, data: { nextSeq: result.nextSeq, inserted: result.inserted } });
+  } catch (err) {
+    if (isDbConnectionError(err)) {
+      return res.status(503).json({ success: false, error: 'Database unavailable. Try again.' });
+    }
+    return next(err);
+  }
+};
+
+module.exports = {
+  getUploadOffset,
+  postLogBatch,
+};
@@ -0,0 +1,39 @@
+const express = require('express');
+const router = express.Router();
+const config = require('../config');
+const {
+  getUploadOffset,
+  postLogBatch,
+} = require('./deviceLogController');
+
+/**
+ * GET /api/device-logs/:deviceId/offset
+ * Upload offset of a device's log (device key in Authorization: Bearer)
+ *
+ * Response:
+ * - 200: { success, data: { nextSeq } }
+ * - 401: Unknown device or bad key
+ */
+router.get('/:deviceId/offset', getUploadOffset);
+
+/**
+ * POST /api/device-logs/:deviceId/batches
+ * Upload one log batch from the device over Wi-Fi
+ *
+ * Request:
+ * - application/octet-stream: log_pack batch (hardware/BLE_Step1/main/log_pack.h)
+ *
+ * Response:
+ * - 200: { success, data: { nextSeq, inserted } }
+ * - 400: Malformed batch or other record version
+ * - 401: Unknown device or bad key
+ * - 409: Batch does not continue from the offset, or a REBASE that cannot be
+ *        checked (see postLogBatch); data.nextSeq is the offset
+ */
+router.post(
+  '/:deviceId/batches',
+  express.raw({ type: 'application/octet-stream', limit: config.deviceUpload.maxBatchBytes }),
+  postLogBatch
+);
+
+module.exports = router;
@@ -2,6 +2,7 @@ const express = require('express');
 const batteryRoutes = require('./batteryRoutes');
 const healthRoutes = require('./healthRoutes');
 const firmwareRoutes = require('./firmwareRoutes');
+const deviceLogRoutes = require('./deviceLogRoutes');
 
 const router = express.Router();
 
@@ -20,6 +21,11 @@ router.use('/health', healthRoutes);
  */
 router.use('/firmware', firmwareRoutes);
 
+/**
+ * Device log upload endpoints (Wi-Fi bulk upload from the device)
+ */
+router.use('/device-logs', deviceLogRoutes);
+
 /**
  * Root API endpoint
  */
@@ -40,6 +46,10 @@ router.get('/', (req, res) => {
         latest: 'GET /api/firmware/latest',
         download: 'GET /api/firmware/:version/download',
       },
+      deviceLogs: {
+        offset: 'GET /api/device-logs/:deviceId/offset (device key)',
+        batches: 'POST /api/device-logs/:deviceId/batches (device key)',
+      },
     },
   });
 });
@@ -0,0 +1,165 @@
+// POST /api/device-logs/:deviceId/batches offset and REBASE rules, against
+// in-memory stand-ins for the models and the database (no Postgres needed).
+// Run with `npm test`.
+
+const test = require('node:test');
+const assert = require('node:assert');
+const path = require('path');
+
+const { HEADER_LEN, CODEC_RAW, FLAG_REBASE } = require('../utils/logBatch');
+const { RECORD_VERSION, RECORD_SIZE } = require('../utils/batteryRecord');
+
+const DEVICE_ID = 'esp32-test';
+const DEVICE_KEY = 'test-key';
+
+/* Stand-ins ------------------------------------------------------------- */
+
+const db = { nextSeq: null, readings: [], relaySeq: -1 };
+
+const stub = (rel, exports) => {
+  const file = require.resolve(path.join(__dirname, rel));
+  require.cache[file] = { id: file, filename: file, loaded: true, exports };
+};
+
+stub('../config', {
+  deviceUpload: { devices: { [DEVICE_ID]: { key: DEVICE_KEY, email: 'owner@example.com', moduleId: 'ESP32' } } },
+});
+
+stub('../config/database', {
+  QueryTypes: { SELECT: 'SELECT' },
+  transaction: async (fn) => fn({ LOCK: { UPDATE: 'UPDATE' } }),
+  // Only the relay watermark query goes through here.
+  query: async () => [{ seq: db.relaySeq < 0 ? null : String(db.relaySeq) }],
+});
+
+const offsetRow = () => ({
+  nextSeq: db.nextSeq,
+  update: async (fields) => { db.nextSeq = fields.nextSeq; },
+});
+
+stub('../models', {
+  User: { findOrCreate: async () => [{ id: 'user-1' }] },
+  Battery: { findOrCreate: async () => [{ id: 'battery-1' }] },
+  BatteryReading: { bulkCreate: async (rows) => { db.readings.push(...rows); } },
+  DeviceLogOffset: {
+    findOrCreate: async ({ defaults }) => {
+      if (db.nextSeq === null) db.nextSeq = defaults.nextSeq;
+      return [offsetRow()];
+    },
+    findByPk: async () => (db.nextSeq === null ? null : offsetRow()),
+  },
+});
+
+const { postLogBatch } = require('../routes/deviceLogController');
+
+/* Helpers --------------------------------------------------------------- */
+
+// RAW batch of records seq from..from+count-1, all other fields zero.
+const batch = (from, count, flags = 0) => {
+  const buf = Buffer.alloc(HEADER_LEN + count * RECORD_SIZE);
+  buf.writeUInt32LE(0x424c5346, 0);
+  buf[4] = 1;
+  buf[5] = CODEC_RAW;
+  buf[6] = RECORD_VERSION;
+  buf[7] = flags;
+  buf.writeUInt16LE(RECORD_SIZE, 8);
+  buf.writeUInt16LE(count, 10);
+  buf.writeUInt32LE(from, 12);
+  buf.writeUInt32LE(from + count - 1, 16);
+  buf.writeUInt32LE(count * RECORD_SIZE, 20);
+  for (let i = 0; i < count; i++) buf.writeUInt32LE(from + i, HEADER_LEN + i * RECORD_SIZE);
+  return buf;
+};
+
+const post = async (body) => {
+  const res = {
+    statusCode: 200,
+    status(code) { this.statusCode = code; return this; },
+    json(payload) { this.body = payload; return this; },
+  };
+  const req = {
+    params: { deviceId: DEVICE_ID },
+    headers: { authorization: `Bearer ${DEVICE_KEY}` },
+    body,
+  };
+  let error = null;
+  const log = console.log;
+  console.log = () => {};
+  try {
+    await postLogBatch(req, res, (err) => { error = err; });
+  } finally {
+    console.log = log;
+  }
+  if (error) throw error;
+  return res;
+};
+
+// Upload offset at `nextSeq`, the relay holding up to `relaySeq` (-1: none).
+const reset = (nextSeq, relaySeq = -1) => {
+  db.nextSeq = nextSeq;
+  db.readings = [];
+  db.relaySeq = relaySeq;
+};
+
+/* Tests ----------------------------------------------------------------- */
+
+test('a batch continuing from the offset is stored', async () => {
+  reset(100);
+  const res = await post(batch(100, 5));
+  assert.strictEqual(res.statusCode, 200);
+  assert.deepStrictEqual(res.body.data, { nextSeq: 105, inserted: 5 });
+});
+
+test('a batch past the offset without REBASE gets 409', async () => {
+  reset(100);
+  const res = await post(batch(110, 5));
+  assert.strictEqual(res.statusCode, 409);
+  assert.strictEqual(res.body.data.nextSeq, 100);
+  assert.strictEqual(db.readings.length, 0);
+});
+
+test('backward REBASE to 0 (log reset) moves the offset back', async () => {
+  reset(100);
+  const res = await post(batch(0, 3, FLAG_REBASE));
+  assert.strictEqual(res.statusCode, 200);
+  assert.deepStrictEqual(res.body.data, { nextSeq: 3, inserted: 3 });
+  assert.strictEqual(db.nextSeq, 3);
+});
+
+test('backward REBASE to a non-zero seq gets 409 and stores nothing', async () => {
+  reset(100);
+  const res = await post(batch(40, 5, FLAG_REBASE));
+  assert.strictEqual(res.statusCode, 409);
+  assert.strictEqual(res.body.data.nextSeq, 100);
+  assert.strictEqual(db.nextSeq, 100);
+  assert.strictEqual(db.readings.length, 0);
+});
+
+test('forward REBASE past what the phone relay stored is accepted', async () => {
+  reset(100, 149);
+  const res = await post(batch(150, 5, FLAG_REBASE));
+  assert.strictEqual(res.statusCode, 200);
+  assert.deepStrictEqual(res.body.data, { nextSeq: 155, inserted: 5 });
+});
+
+test('forward REBASE beyond the relay watermark gets 409', async () => {
+  reset(100, 120);
+  const res = await post(batch(150, 5, FLAG_REBASE));
+  assert.strictEqual(res.statusCode, 409);
+  assert.strictEqual(res.body.data.nextSeq, 100);
+  assert.strictEqual(db.readings.length, 0);
+});
+
+test('forward REBASE with nothing relayed gets 409', async () => {
+  reset(100);
+  const res = await post(batch(150, 5, FLAG_REBASE));
+  assert.strictEqual(res.statusCode, 409);
+  assert.strictEqual(db.nextSeq, 100);
+});
+
+test('REBASE to the current offset is an ordinary batch', async () => {
+  reset(100);
+  const res = await post(batch(100, 2, FLAG_REBASE));
+  assert.strictEqual(res.statusCode, 200);
+  assert.deepStrictEqual(res.body.data, { nextSeq: 102, inserted: 2 });
+});
@@ -0,0 +1,27 @@
+// Generated by hardware/BLE_Step1/host/tools/log_schema_gen from
+// main/log_schema.h. Do not edit.
+//
+// This build's battery_log_t layout; utils/logBatch.js decodes the
+// device's log_pack upload batches with it.
+
+const RECORD_VERSION = 4;
+const RECORD_SIZE = 56;
+
+// { name, code, count, offset, exp10, unit }: code is LOG_TCODE_* (low
+// nibble = bytes, 0x80 = signed); value in unit = raw * 10 ** exp10
+const FIELDS = [
+  { name: 'seq', code: 0x04, count: 1, offset: 0, exp10: 0, unit: '' },
+  { name: 'timestamp_s', code: 0x04, count: 1, offset: 4, exp10: 0, unit: 's' },
+  { name: 'cell_mv', code: 0x02, count: 16, offset: 8, exp10: -3, unit: 'V' },
+  { name: 'pack_total_mv', code: 0x02, count: 1, offset: 40, exp10: -3, unit: 'V' },
+  { name: 'pack_ld_mv', code: 0x02, count: 1, offset: 42, exp10: -3, unit: 'V' },
+  { name: 'pack_sum_active_mv', code: 0x02, count: 1, offset: 44, exp10: -3, unit: 'V' },
+  { name: 'current_ma', code: 0x82, count: 1, offset: 46, exp10: -3, unit: 'A' },
+  { name: 'temp_ts1_c_x100', code: 0x82, count: 1, offset: 48, exp10: -2, unit: 'C' },
+  { name: 'temp_int_c_x100', code: 0x82, count: 1, offset: 50, exp10: -2, unit: 'C' },
+  { name: 'soc', code: 0x01, count: 1, offset: 52, exp10: 0, unit: '%' },
+  { name: 'interval_s', code: 0x02, count: 1, offset: 53, exp10: 0, unit: 's' },
+  { name: 'rate', code: 0x01, count: 1, offset: 55, exp10: 0, unit: '' },
+];
+
+module.exports = { RECORD_VERSION, RECORD_SIZE, FIELDS };
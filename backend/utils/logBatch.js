@@ -0,0 +1,191 @@
+// Decoder for the device's log upload batches (hardware/BLE_Step1/main/log_pack.h).
+//
+// A batch is a 24-byte little-endian header and `count` records, either back
+// to back in their wire form (RAW) or column by column (DELTA): one column of
+// zigzag varints per record value, the first value as is and then the change
+// from the previous record; a zero change is followed by a varint of how many
+// more zeros follow.
+
+const { RECORD_VERSION, RECORD_SIZE, FIELDS } = require('./batteryRecord');
+
+const MAGIC = 0x424c5346; // "FSLB"
+const FORMAT = 1;
+const HEADER_LEN = 24;
+const CODEC_RAW = 0;
+const CODEC_DELTA = 1;
+const FLAG_REBASE = 0x01;
+
+const READERS = {
+  0x01: 'readUInt8', 0x81: 'readInt8',
+  0x02: 'readUInt16LE', 0x82: 'readInt16LE',
+  0x04: 'readUInt32LE', 0x84: 'readInt32LE',
+};
+
+// One entry per value, array elements expanded, in record order (the DELTA
+// column order).
+const VALUES = FIELDS.flatMap((f) =>
+  Array.from({ length: f.count }, (_, i) => ({
+    field: f,
+    index: i,
+    offset: f.offset + i * (f.code & 0x0f),
+  })));
+
+const badBatch = (message) => {
+  const err = new Error(message);
+  err.statusCode = 400;
+  return err;
+};
+
+// Wraps to the value's width and sign, like the firmware's decoder.
+const toWidth = (code, v) => {
+  const bits = (code & 0x0f) * 8;
+  const mod = 2 ** bits;
+  let x = ((v % mod) + mod) % mod;
+  if (code & 0x80 && x >= mod / 2) x -= mod;
+  return x;
+};
+
+const parseHeader = (buf) => {
+  if (!Buffer.isBuffer(buf) || buf.length < HEADER_LEN) {
+    throw badBatch('Batch too short');
+  }
+  if (buf.readUInt32LE(0) !== MAGIC || buf[4] !== FORMAT) {
+    throw badBatch('Not a log batch');
+  }
+
+  const hdr = {
+    codec: buf[5],
+    recordVersion: buf[6],
+    flags: buf[7],
+    recordSize: buf.readUInt16LE(8),
+    count: buf.readUInt16LE(10),
+    fromSeq: buf.readUInt32LE(12),
+    lastSeq: buf.readUInt32LE(16),
+    payloadLength: buf.readUInt32LE(20),
+  };
+  hdr.rebase = (hdr.flags & FLAG_REBASE) !== 0;
+
+  if (hdr.recordVersion !== RECORD_VERSION || hdr.recordSize !== RECORD_SIZE) {
+    throw badBatch(`Record version ${hdr.recordVersion} (${hdr.recordSize} bytes) not supported`);
+  }
+  if (hdr.count === 0 || hdr.codec > CODEC_DELTA) {
+    throw badBatch('Malformed batch header');
+  }
+  if (hdr.payloadLength !== buf.length - HEADER_LEN) {
+    throw badBatch('Batch length does not match its header');
+  }
+  return hdr;
+};
+
+const newRecord = () => {
+  const rec = {};
+  for (const f of FIELDS) {
+    rec[f.name] = f.count === 1 ? 0 : new Array(f.count).fill(0);
+  }
+  return rec;
+};
+
+const setValue = (rec, v, x) => {
+  if (v.field.count === 1) {
+    rec[v.field.name] = x;
+  } else {
+    rec[v.field.name][v.index] = x;
+  }
+};
+
+const decodeRaw = (payload, count) => {
+  if (payload.length !== count * RECORD_SIZE) {
+    throw badBatch('RAW payload length does not match its count');
+  }
+  const recs = [];
+  for (let i = 0; i < count; i++) {
+    const rec = newRecord();
+    for (const v of VALUES) {
+      setValue(rec, v, payload[READERS[v.field.code]](i * RECORD_SIZE + v.offset));
+    }
+    recs.push(rec);
+  }
+  return recs;
+};
+
+const decodeDelta = (payload, count) => {
+  let pos = 0;
+  const varint = () => {
+    let x = 0;
+    for (let scale = 1; scale < 2 ** 63; scale *= 128) {
+      if (pos >= payload.length) {
+        throw badBatch('DELTA payload truncated');
+      }
+      const b = payload[pos++];
+      x += (b & 0x7f) * scale;
+      if (!(b & 0x80)) {
+        return x;
+      }
+    }
+    throw badBatch('DELTA varint too long');
+  };
+  // zigzag: even = positive, odd = negative
+  const signed = () => {
+    const z = varint();
+    return z % 2 === 0 ? z / 2 : -(z + 1) / 2;
+  };
+
+  const recs = Array.from({ length: count }, newRecord);
+  for (const v of VALUES) {
+    let prev = signed();
+    setValue(recs[0], v, toWidth(v.field.code, prev));
+
+    for (let i = 1; i < count;) {
+      const d = signed();
+      if (d !== 0) {
+        prev += d;
+        setValue(recs[i++], v, toWidth(v.field.code, prev));
+        continue;
+      }
+      const run = 1 + varint();
+      if (i + run > count) {
+        throw badBatch('DELTA run past the end of the batch');
+      }
+      for (let k = 0; k < run; k++) {
+        setValue(recs[i++], v, toWidth(v.field.code, prev));
+      }
+    }
+  }
+  if (pos !== payload.length) {
+    throw badBatch('DELTA payload has trailing bytes');
+  }
+  return recs;
+};
+
+/**
+ * Decode a whole batch. Throws an error with statusCode 400 if it is not a
+ * batch of this record version or is malformed.
+ * @returns {{ header: object, records: object[] }} records keyed by the
+ *          log_schema.h field names, raw integer values
+ */
+const decodeBatch = (buf) => {
+  const header = parseHeader(buf);
+  const payload = buf.subarray(HEADER_LEN);
+  const records = header.codec === CODEC_RAW
+    ? decodeRaw(payload, header.count)
+    : decodeDelta(payload, header.count);
+
+  for (let i = 0; i < records.length; i++) {
+    if (i > 0 && records[i].seq <= records[i - 1].seq) {
+      throw badBatch('Batch records out of order');
+    }
+  }
+  if (records[0].seq < header.fromSeq || records[records.length - 1].seq !== header.lastSeq) {
+    throw badBatch('Batch seqs do not match its header');
+  }
+  return { header, records };
+};
+
+module.exports = {
+  HEADER_LEN,
+  CODEC_RAW,
+  CODEC_DELTA,
+  FLAG_REBASE,
+  parseHeader,
+  decodeBatch,
+};
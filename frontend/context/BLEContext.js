@@ -5,6 +5,7 @@ import { insertTelemetry } from "../services/database"
 import AsyncStorage from '@react-native-async-storage/async-storage';
 import {useAuth} from './AuthContext'
 import { formatBmsPayload } from '../utils/commonUtils';
+import { decodeWithSchema, parseSchemaTable, RECORD_SCHEMA_UUID } from '../utils/batteryRecord';
 
 export const BLEContext = createContext();
 
@@ -13,46 +14,6 @@ const OTA_CONTROL_UUID = 'f0debc9a-7856-3412-7856-341278563413';
 const OTA_DATA_UUID = 'f0debc9a-7856-3412-7856-341278563414';
 const OTA_STATUS_UUID = 'f0debc9a-7856-3412-7856-341278563415';
 
-const parseTelemetryData = (buffer) => {
-  if (buffer.length < 49) {
-    return null;
-  }
-
-  const data = {};
-  let offset = 0;
-
-  data.timestamp_s = buffer.readUInt32LE(offset);
-  offset += 4;
-
-  data.cell_mv = [];
-  for (let i = 0; i < 16; i++) {
-    data.cell_mv.push(buffer.readUInt16LE(offset));
-    offset += 2;
-  }
-
-  data.pack_total_mv = buffer.readUInt16LE(offset);
-  offset += 2;
-
-  data.pack_ld_mv = buffer.readUInt16LE(offset);
-  offset += 2;
-
-  data.pack_sum_active_mv = buffer.readUInt16LE(offset);
-  offset += 2;
-
-  data.current_ma = buffer.readInt16LE(offset);
-  offset += 2;
-
-  data.temp_ts1_c_x100 = buffer.readInt16LE(offset);
-  offset += 2;
-
-  data.temp_int_c_x100 = buffer.readInt16LE(offset);
-  offset += 2;
-
-  data.soc = buffer.readUInt8(offset);
-
-  return data;
-};
-
 export const BLEProvider = ({ children }) => {
   const [manager] = useState(new BleManager());
   const [devices, setDevices] = useState([]);
@@ -63,7 +24,7 @@ export const BLEProvider = ({ children }) => {
   const [isOtaSupported, setIsOtaSupported] = useState(false);
   const [otaStatus, setOtaStatus] = useState('idle');
   const [otaProgress, setOtaProgress] = useState(0);
-  const dataBuffer = useRef(Buffer.alloc(0));
+  const recordSchema = useRef(null); // layout advertised by the device, if any
   const otaCharacteristics = useRef({});
   const otaRebootExpected = useRef(false);
   const otaResumeInfo = useRef(null); // To store { chunk_count, bytes_received }
@@ -84,7 +45,7 @@ export const BLEProvider = ({ children }) => {
     }
     setConnectedDevice(null);
     setTelemetryData(null);
-    dataBuffer.current = Buffer.alloc(0);
+    recordSchema.current = null;
     setIsOtaSupported(false);
     setOtaProgress(0);
     otaCharacteristics.current = {};
@@ -198,6 +159,16 @@ export const BLEProvider = ({ children }) => {
           }
         }
 
+        const schemaChar = characteristics.find((c) => c.uuid === RECORD_SCHEMA_UUID);
+        if (schemaChar) {
+          try {
+            const table = await schemaChar.read();
+            recordSchema.current = parseSchemaTable(Buffer.from(table.value, 'base64'));
+          } catch (e) {
+            console.log('[BLE] Record schema read failed, using built-in layout:', e.message);
+          }
+        }
+
         for (const characteristic of characteristics) {
           if (characteristic.isNotifiable && service.uuid !== OTA_SERVICE_UUID) {
             console.log(`Subscribing to telemetry characteristic ${characteristic.uuid}`);
@@ -206,26 +177,25 @@ export const BLEProvider = ({ children }) => {
                 return;
               }
               if (char && char.value) {
-                const newChunk = Buffer.from(char.value, 'base64');
-                dataBuffer.current = Buffer.concat([dataBuffer.current, newChunk]);
-
-                while (dataBuffer.current.length >= 49) {
-                  const packet = dataBuffer.current.slice(0, 49);
-                  const parsedData = parseTelemetryData(packet);
-
-                  if (parsedData) {
-                    setTelemetryData(parsedData);
-                    const dbPayload = {
-                      moduleId: "ESP32",
-                      payload: formatBmsPayload(parsedData),
-                      ts: parsedData.timestamp_s * 1000
-                    };
-
-                    insertTelemetry(dbPayload);
-                  } else {
-                    console.log('Received raw data (incomplete packet):', packet.toString('hex'));
-                  }
-                  dataBuffer.current = dataBuffer.current.slice(49);
+                // One record per notification, possibly followed by more
+                // (live cell analytics); decode the record at the start.
+                const packet = Buffer.from(char.value, 'base64');
+                const parsedData = decodeWithSchema(packet, recordSchema.current);
+
+                if (parsedData) {
+                  setTelemetryData(parsedData);
+                  const dbPayload = {
+                    moduleId: "ESP32",
+                    // Lets the backend check the device's Wi-Fi upload
+                    // skipping records this phone relays.
+                    seq: parsedData.seq,
+                    payload: formatBmsPayload(parsedData),
+                    ts: parsedData.timestamp_s * 1000
+                  };
+
+                  insertTelemetry(dbPayload);
+                } else {
+                  console.log('Received raw data (incomplete packet):', packet.toString('hex'));
                 }
               }
             });
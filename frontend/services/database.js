@@ -104,6 +104,7 @@ export const syncTelemetryToAWS = async () => {
         localId: row.id,
         moduleId: parsed?.moduleId || 'ESP32',
         ts: parsed?.ts || row.ts,
+        seq: parsed?.seq,
         payload: parsed?.payload || {},
       };
     });
@@ -0,0 +1,100 @@
+// Generated by hardware/BLE_Step1/host/tools/log_schema_gen from
+// main/log_schema.h. Do not edit.
+//
+// decodeRecord() reads this build's battery_log_t layout from a Buffer;
+// parseSchemaTable() / decodeWithSchema() decode any layout the device
+// advertises on its Record Schema characteristic.
+
+export const RECORD_VERSION = 4;
+export const RECORD_SIZE = 56;
+export const RECORD_SCHEMA_UUID = 'aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee5';
+
+// { name, count, exp10, unit }: value in unit = raw * 10 ** exp10
+export const FIELDS = [
+  { name: 'seq', count: 1, exp10: 0, unit: '' },
+  { name: 'timestamp_s', count: 1, exp10: 0, unit: 's' },
+  { name: 'cell_mv', count: 16, exp10: -3, unit: 'V' },
+  { name: 'pack_total_mv', count: 1, exp10: -3, unit: 'V' },
+  { name: 'pack_ld_mv', count: 1, exp10: -3, unit: 'V' },
+  { name: 'pack_sum_active_mv', count: 1, exp10: -3, unit: 'V' },
+  { name: 'current_ma', count: 1, exp10: -3, unit: 'A' },
+  { name: 'temp_ts1_c_x100', count: 1, exp10: -2, unit: 'C' },
+  { name: 'temp_int_c_x100', count: 1, exp10: -2, unit: 'C' },
+  { name: 'soc', count: 1, exp10: 0, unit: '%' },
+  { name: 'interval_s', count: 1, exp10: 0, unit: 's' },
+  { name: 'rate', count: 1, exp10: 0, unit: '' },
+];
+
+export const decodeRecord = (buf) => {
+  if (buf.length < RECORD_SIZE) {
+    return null;
+  }
+  return {
+    seq: buf.readUInt32LE(0),
+    timestamp_s: buf.readUInt32LE(4),
+    cell_mv: [
+      buf.readUInt16LE(8), buf.readUInt16LE(10), buf.readUInt16LE(12), buf.readUInt16LE(14),
+      buf.readUInt16LE(16), buf.readUInt16LE(18), buf.readUInt16LE(20), buf.readUInt16LE(22),
+      buf.readUInt16LE(24), buf.readUInt16LE(26), buf.readUInt16LE(28), buf.readUInt16LE(30),
+      buf.readUInt16LE(32), buf.readUInt16LE(34), buf.readUInt16LE(36), buf.readUInt16LE(38),
+    ],
+    pack_total_mv: buf.readUInt16LE(40),
+    pack_ld_mv: buf.readUInt16LE(42),
+    pack_sum_active_mv: buf.readUInt16LE(44),
+    current_ma: buf.readInt16LE(46),
+    temp_ts1_c_x100: buf.readInt16LE(48),
+    temp_int_c_x100: buf.readInt16LE(50),
+    soc: buf.readUInt8(52),
+    interval_s: buf.readUInt16LE(53),
+    rate: buf.readUInt8(55),
+  };
+};
+
+const READERS = {
+  0x01: 'readUInt8', 0x81: 'readInt8',
+  0x02: 'readUInt16LE', 0x82: 'readInt16LE',
+  0x04: 'readUInt32LE', 0x84: 'readInt32LE',
+};
+
+export const parseSchemaTable = (buf) => {
+  if (buf.length < 5 || buf[0] !== 1) {
+    return null;
+  }
+  const schema = { version: buf[1], size: buf.readUInt16LE(2), fields: [] };
+  let pos = 5;
+  const str = () => {
+    const end = buf.indexOf(0, pos);
+    const s = buf.toString('utf8', pos, end);
+    pos = end + 1;
+    return s;
+  };
+  for (let i = 0; i < buf[4]; i++) {
+    const code = buf[pos];
+    const count = buf[pos + 1];
+    const offset = buf[pos + 2];
+    const exp10 = buf.readInt8(pos + 3);
+    pos += 4;
+    const name = str();
+    const unit = str();
+    if (!READERS[code]) {
+      return null;
+    }
+    schema.fields.push({ name, code, count, offset, exp10, unit, size: code & 0x0f });
+  }
+  return schema;
+};
+
+export const decodeWithSchema = (buf, schema) => {
+  if (!schema || schema.version === RECORD_VERSION) {
+    return decodeRecord(buf);
+  }
+  if (buf.length < schema.size) {
+    return null;
+  }
+  const rec = {};
+  for (const f of schema.fields) {
+    const read = (i) => buf[READERS[f.code]](f.offset + i * f.size);
+    rec[f.name] = f.count === 1 ? read(0) : Array.from({ length: f.count }, (_, i) => read(i));
+  }
+  return rec;
+};
@@ -0,0 +1,144 @@
+/*
+ * A backlog read from the partition ring while the ring wraps under it.
+ *
+ * The firmware's backlog sender, GATT service and scheduler (the fleet_fw
+ * library, one device) on a small "blog" partition that is full before the
+ * backlog starts, so every sector the sampler fills meanwhile drops the
+ * oldest one and moves every record index down. A FULL backlog is then
+ * pumped at the scheduler's budget while samples keep being stored.
+ *
+ * Checked on the received stream: seqs strictly increasing, any gap made
+ * only of records the ring had already dropped when the next frame went
+ * out, and nothing missing at the end: the stream reaches at least the
+ * record that was newest when the backlog was requested. Exits 1 otherwise,
+ * or if nothing was evicted during the backlog.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "ble_batt_mock.h"
+#include "esp_partition.h"
+#include "fleet_dev.h"
+#include "host/ble_hs.h"
+#include "log_store.h"
+
+#define RING_SECTORS    8
+#define PUMP_US         20000       // mock_sender's poll while a backlog runs
+#define SAMPLE_EVERY    2           // pumps per stored sample
+#define BUDGET_BPS      3000        // about one record per pump
+#define MAX_PUMPS       100000
+
+static const uint16_t k_conn = 1;
+static fleet_dev_chrs_t s_h;
+
+static uint32_t s_rx;
+static int64_t s_last;              // last backlog seq received
+static uint32_t s_order_err;
+static uint32_t s_skipped;          // missing seqs still in the log when skipped
+static uint32_t s_lost;             // missing seqs the ring had dropped
+
+static void wake(void) {}
+
+static int sink(uint16_t conn, uint16_t attr, const uint8_t *data, uint16_t len, void *arg)
+{
+    (void)conn; (void)arg;
+    if (attr != s_h.backlog || len < sizeof(battery_log_t)) return 0;
+
+    battery_log_t rec;
+    memcpy(&rec, data, sizeof(rec));
+    battery_log_summary_t sum;
+    battery_log_get_summary(&sum);
+
+    if ((int64_t)rec.seq <= s_last) {
+        s_order_err++;
+    } else {
+        for (int64_t q = s_last + 1; q < rec.seq; q++) {
+            if (q < sum.first_seq) s_lost++; else s_skipped++;
+        }
+    }
+    s_last = rec.seq;
+    s_rx++;
+    return 0;
+}
+
+int main(void)
+{
+    bench_enter_scratch_dir("bench_backlog_wrap");
+    battery_log_lock_init();
+
+    esp_partition_shim_add(LOG_PART_LABEL, RING_SECTORS * 4096);
+    battery_log_use_store(&log_store_partition);
+    log_store_partition.wipe();
+    if (fleet_dev_boot(1, wake) != ESP_OK || !fleet_dev_get_chrs(&s_h)) {
+        fprintf(stderr, "boot failed\n");
+        return 1;
+    }
+    ble_hs_shim_set_sink(sink, NULL);
+    notify_sched_set_budget(BUDGET_BPS, NOTIFY_SCHED_BURST_BYTES);
+
+    // Fill the ring past one wrap: nothing subscribed, every sample is stored.
+    int64_t now = 0;
+    while (battery_log_evicted() == 0) {
+        now += 5000000;
+        fleet_dev_set_time(now);
+        fleet_dev_sample();
+    }
+
+    battery_log_summary_t at_start;
+    battery_log_get_summary(&at_start);
+    uint32_t ev0 = battery_log_evicted();
+    s_last = (int64_t)at_start.first_seq - 1;     // a gap at the front counts too
+
+    // Backlog only: the sink checks the backlog stream.
+    fleet_dev_connect(k_conn);
+    ble_batt_mock_on_subscribe(s_h.backlog, true);
+    const uint8_t full = 0x01;
+    ble_gatts_shim_write(k_conn, s_h.cmd, &full, 1);
+
+    uint32_t stored = 0;
+    int pumps = 0;
+    bool active = true;
+    int64_t wait = 0;
+    while ((active || wait >= 0) && pumps < MAX_PUMPS) {
+        now += PUMP_US;
+        fleet_dev_set_time(now);
+        if (++pumps % SAMPLE_EVERY == 0) {
+            fleet_dev_sample();
+            stored++;
+        }
+        active = fleet_dev_serve();
+        wait = fleet_dev_dispatch();
+    }
+
+    uint32_t evicted = battery_log_evicted() - ev0;
+    printf("ring %d sectors, %u records at start (seq %u..%u)\n", RING_SECTORS,
+           (unsigned)at_start.count, (unsigned)at_start.first_seq, (unsigned)at_start.last_seq);
+    printf("backlog: %u frames in %d pumps, %u stored meanwhile, %u evicted meanwhile\n",
+           (unsigned)s_rx, pumps, (unsigned)stored, (unsigned)evicted);
+    printf("gaps: %u record(s) dropped by the ring before they were sent, %u skipped\n",
+           (unsigned)s_lost, (unsigned)s_skipped);
+
+    int fail = 0;
+    if (pumps >= MAX_PUMPS) {
+        fprintf(stderr, "FAIL: backlog did not finish\n");
+        fail = 1;
+    }
+    if (evicted == 0) {
+        fprintf(stderr, "FAIL: the ring did not wrap during the backlog\n");
+        fail = 1;
+    }
+    if (s_order_err || s_skipped) {
+        fprintf(stderr, "FAIL: %u out of order, %u still-stored record(s) skipped\n",
+                (unsigned)s_order_err, (unsigned)s_skipped);
+        fail = 1;
+    }
+    if (s_last < (int64_t)at_start.last_seq) {
+        fprintf(stderr, "FAIL: backlog ended at seq %lld, not %u\n",
+                (long long)s_last, (unsigned)at_start.last_seq);
+        fail = 1;
+    }
+    return fail;
+}
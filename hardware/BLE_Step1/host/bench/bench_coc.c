@@ -0,0 +1,530 @@
+/*
+ * Bulk channel (ble_coc, L2CAP CoC) vs. the GATT paths, for the backlog
+ * and for OTA.
+ *
+ * CPU: the backlog built as notifications (notify pool, 1 record per
+ * plaintext frame, FRAME_CRYPT_BACKLOG_RECS per sealed one) vs. page-sized
+ * SDUs through ble_coc_send_backlog_at(), read from the log either way.
+ *
+ * Link (virtual clock, modelled): 1M PHY with data length extension, one
+ * connection event per 15 ms interval filled with LL PDUs (more data set),
+ * each PDU acknowledged by an empty one. GATT notifications are one LL PDU
+ * each; the channel sends 247-byte K-frames under the peer's credits,
+ * returned as the peer receives them. The real sender runs against the
+ * shim channel (shim/host/ble_hs.h) and every SDU is checked on arrival:
+ * records in order, sealed frames opened with the device key. A second
+ * run with too few credits exercises the stall / TX_UNSTALLED path, and a
+ * peer MTU below one sealed record must be refused.
+ *
+ * OTA: stop-and-wait 244-byte writes (as the app does) vs. 4 KB SDUs, with
+ * a modelled flash erase / program time; image bytes are pushed through
+ * the channel's receive path and counted.
+ *
+ * Exits 1 if a record or image byte goes missing or arrives out of order.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "battery_log.h"
+#include "ble_batt_mock.h"
+#include "ble_coc.h"
+#include "ble_stats.h"
+#include "frame_crypt.h"
+#include "host/ble_hs.h"
+#include "notify_pool.h"
+#include "notify_sched.h"
+#include "bench_common.h"
+
+#define RECORDS         20000
+#define CPU_ROUNDS      5
+
+#define CONN_ITVL_US    15000
+#define LL_OVERHEAD_B   10          // preamble, access address, header, CRC
+#define T_IFS_US        150
+#define EMPTY_PDU_US    80
+#define ATT_NOTIFY_HDR  3
+#define L2CAP_HDR       4
+#define PEER_MPS        247         // K-frame payload: one 251-byte LL PDU
+#define PEER_MTU        (BLE_COC_SDU_MAX + 4)
+#define PEER_CREDITS    40
+#define PAGE_KFRAMES    ((BLE_COC_SDU_MAX + 2 + PEER_MPS - 1) / PEER_MPS)
+
+#define OTA_IMAGE       (1024 * 1024)
+#define OTA_GATT_CHUNK  244
+#define FLASH_ERASE_US  30000       // 4 KB sector
+#define FLASH_PROG_US   700         // 256-byte page
+
+static const uint8_t k_key[FRAME_CRYPT_KEY_LEN] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+
+// --- firmware the channel calls into ---
+
+static bool s_kicked;
+static uint32_t s_ota_bytes;
+static uint32_t s_ota_sdus;
+
+int ble_backlog_submit(backlog_cmd_type_t type, backlog_mode_t mode, uint32_t start_seq,
+                       backlog_via_t via)
+{
+    (void)type; (void)mode; (void)start_seq; (void)via;
+    return 0;
+}
+
+void ble_backlog_kick(void)
+{
+    s_kicked = true;
+}
+
+int ble_sync_ack(uint32_t seq)
+{
+    (void)seq;
+    return 0;
+}
+
+void ble_link_note_tx(size_t bytes) { (void)bytes; }
+void ble_link_note_rx(size_t bytes) { (void)bytes; }
+
+int ble_ota_coc_control(const uint8_t *data, uint16_t len)
+{
+    (void)data; (void)len;
+    return 0;
+}
+
+int ble_ota_coc_data(const uint8_t *data, uint16_t len)
+{
+    char msg[48];
+    s_ota_bytes += len;
+    s_ota_sdus++;
+    snprintf(msg, sizeof(msg), "ACK:%u:%u", (unsigned)s_ota_sdus, (unsigned)s_ota_bytes);
+    return ble_coc_send_status(msg);
+}
+
+// --- link model ---
+
+static double ll_pdu_us(unsigned payload)
+{
+    return (LL_OVERHEAD_B + payload) * 8.0 + T_IFS_US + EMPTY_PDU_US + T_IFS_US;
+}
+
+// LL PDUs per connection event, all of one size.
+static unsigned pdus_per_event(unsigned payload)
+{
+    return (unsigned)(CONN_ITVL_US / ll_pdu_us(payload));
+}
+
+// Controller queue: airtime of each queued K-frame.
+#define LL_QUEUE_MAX 4096
+static float s_ll_q[LL_QUEUE_MAX];
+static unsigned s_ll_head, s_ll_count;
+static double s_ll_queued_us, s_ll_queued_max_us;
+
+static void ll_push(double us)
+{
+    if (s_ll_count == LL_QUEUE_MAX) {
+        fprintf(stderr, "LL queue overflow\n");
+        exit(1);
+    }
+    s_ll_q[(s_ll_head + s_ll_count++) % LL_QUEUE_MAX] = (float)us;
+    s_ll_queued_us += us;
+    if (s_ll_queued_us > s_ll_queued_max_us) s_ll_queued_max_us = s_ll_queued_us;
+}
+
+// One connection event; returns the K-frames that went out.
+static unsigned ll_event(void)
+{
+    double left = CONN_ITVL_US;
+    unsigned sent = 0;
+    while (s_ll_count && s_ll_q[s_ll_head] <= left) {
+        left -= s_ll_q[s_ll_head];
+        s_ll_queued_us -= s_ll_q[s_ll_head];
+        s_ll_head = (s_ll_head + 1) % LL_QUEUE_MAX;
+        s_ll_count--;
+        sent++;
+    }
+    return sent;
+}
+
+// --- client side of the channel ---
+
+static bool s_model_link;
+static bool s_verify;
+static uint32_t s_next_seq;
+static uint32_t s_records;
+static uint32_t s_sdus;
+static uint64_t s_sdu_bytes;
+static uint64_t s_bad;
+static uint32_t s_status_sdus;
+
+static void check_record(const uint8_t *p)
+{
+    battery_log_t r;
+    memcpy(&r, p, sizeof(r));
+    if (r.seq != s_next_seq++) s_bad++;
+    s_records++;
+}
+
+static void sdu_sink(const uint8_t *sdu, uint16_t len, uint16_t kframes, void *arg)
+{
+    (void)arg;
+    s_sdus++;
+    s_sdu_bytes += len;
+
+    if (s_model_link) {
+        unsigned left = len + 2u;   // SDU length field in the first K-frame
+        for (unsigned k = 0; k < kframes; k++) {
+            unsigned p = left < PEER_MPS ? left : PEER_MPS;
+            ll_push(ll_pdu_us(L2CAP_HDR + p));
+            left -= p;
+        }
+    }
+
+    if (!s_verify) return;
+    if (len >= 1 && sdu[0] == BLE_COC_OP_OTA_STATUS) {
+        s_status_sdus++;
+        return;
+    }
+    if (len < BLE_COC_HDR_LEN || sdu[0] != BLE_COC_OP_BACKLOG_DATA) {
+        s_bad++;
+        return;
+    }
+    unsigned count = sdu[2] | (sdu[3] << 8);
+    const uint8_t *p = sdu + BLE_COC_HDR_LEN, *end = sdu + len;
+    unsigned got = 0;
+
+    if (!(sdu[1] & BLE_COC_F_SEALED)) {
+        for (; p + sizeof(battery_log_t) <= end; p += sizeof(battery_log_t), got++) check_record(p);
+    } else {
+        while (p < end) {
+            uint8_t frame[FRAME_CRYPT_MAX_FRAME];
+            frame_crypt_hdr_t h;
+            memcpy(&h, p, sizeof(h));
+            size_t flen = h.count * sizeof(battery_log_t) + FRAME_CRYPT_OVERHEAD;
+            if (flen > sizeof(frame) || p + flen > end) {
+                s_bad++;
+                return;
+            }
+            memcpy(frame, p, flen);
+            int n = frame_crypt_open(k_key, frame, flen, &h);
+            if (n < 0 || h.type != FRAME_TYPE_BACKLOG) {
+                s_bad++;
+                return;
+            }
+            for (int i = 0; i < h.count; i++) check_record(frame + FRAME_CRYPT_HDR_LEN + i * sizeof(battery_log_t));
+            got += h.count;
+            p += flen;
+        }
+    }
+    if (got != count) s_bad++;
+}
+
+static void reset_client(void)
+{
+    s_next_seq = 0;
+    s_records = 0;
+    s_sdus = 0;
+    s_sdu_bytes = 0;
+    s_bad = 0;
+    s_ll_head = s_ll_count = 0;
+    s_ll_queued_us = s_ll_queued_max_us = 0;
+}
+
+// --- backlog ---
+
+typedef struct {
+    double cpu_ns;          // per record
+    double bytes;           // link payload per record
+} cpu_t;
+
+static int gatt_sink_frames;
+static uint64_t gatt_sink_bytes;
+
+static int gatt_sink(uint16_t conn, uint16_t attr, const uint8_t *data, uint16_t len, void *arg)
+{
+    (void)conn; (void)attr; (void)data; (void)arg;
+    gatt_sink_frames++;
+    gatt_sink_bytes += len;
+    return 0;
+}
+
+// As ble_batt_mock_notify_backlog_at(): the record(s) read into a pool mbuf.
+static cpu_t cpu_gatt(const char *label, int per_frame, bool sealed)
+{
+    gatt_sink_frames = 0;
+    gatt_sink_bytes = 0;
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (int r = 0; r < CPU_ROUNDS; r++) {
+        for (int i = 0; i < RECORDS; i += per_frame) {
+            int n = RECORDS - i < per_frame ? RECORDS - i : per_frame;
+            struct os_mbuf *om = notify_pool_get();
+            uint8_t *frame = sealed ? notify_pool_reserve(om, FRAME_CRYPT_HDR_LEN) : NULL;
+            battery_log_t *dst = notify_pool_reserve(om, n * sizeof(battery_log_t));
+            for (int k = 0; k < n; k++) battery_log_read(i + k, &dst[k]);
+            if (sealed) {
+                notify_pool_reserve(om, FRAME_CRYPT_TAG_LEN);
+                frame_crypt_seal(frame, n * sizeof(battery_log_t), FRAME_TYPE_BACKLOG, (uint8_t)n);
+            }
+            ble_gatts_notify_custom(0, 1, om);
+        }
+    }
+    uint64_t ops = (uint64_t)CPU_ROUNDS * RECORDS;
+    uint64_t cpu = bench_cpu_ns() - c0;
+    bench_report(label, ops, bench_now_ns() - w0, cpu);
+    cpu_t res = {
+        .cpu_ns = (double)cpu / ops,
+        .bytes = (double)(gatt_sink_bytes + (uint64_t)gatt_sink_frames * (ATT_NOTIFY_HDR + L2CAP_HDR)) / ops,
+    };
+    return res;
+}
+
+static cpu_t cpu_coc(const char *label)
+{
+    struct ble_l2cap_chan *chan = ble_l2cap_shim_connect(1, PEER_MTU, PEER_MPS, 0);
+    reset_client();
+    s_model_link = false;
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (int r = 0; r < CPU_ROUNDS; r++) {
+        s_next_seq = 0;
+        for (int i = 0; i < RECORDS;) {
+            ble_l2cap_shim_credits(chan, PAGE_KFRAMES);
+            int rc = ble_coc_send_backlog_at(i, RECORDS - i, NULL);
+            if (rc <= 0) {
+                fprintf(stderr, "send rc=%d at %d\n", rc, i);
+                exit(1);
+            }
+            i += rc;
+        }
+    }
+    uint64_t ops = (uint64_t)CPU_ROUNDS * RECORDS;
+    uint64_t cpu = bench_cpu_ns() - c0;
+    bench_report(label, ops, bench_now_ns() - w0, cpu);
+    ble_l2cap_shim_disconnect(chan);
+    cpu_t res = {
+        .cpu_ns = (double)cpu / ops,
+        .bytes = (double)(s_sdu_bytes + (uint64_t)s_sdus * (2 + L2CAP_HDR)) / ops,
+    };
+    return res;
+}
+
+typedef struct {
+    double rec_s;
+    uint32_t events;
+    double max_queue_ms;    // airtime queued ahead of a live notification
+    bool ok;
+} link_t;
+
+// The app's backlog pump against the modelled link, one connection event
+// at a time; the peer returns a credit per K-frame received.
+static link_t link_coc(void)
+{
+    struct ble_l2cap_chan *chan = ble_l2cap_shim_connect(1, PEER_MTU, PEER_MPS, PEER_CREDITS);
+    reset_client();
+    s_model_link = true;
+    s_verify = true;
+    uint32_t events = 0;
+    int next = 0;
+
+    while (s_records < RECORDS) {
+        s_kicked = false;
+        while (next < RECORDS) {
+            int rc = ble_coc_send_backlog_at(next, RECORDS - next, NULL);
+            if (rc == -2) break;
+            if (rc <= 0) {
+                fprintf(stderr, "send rc=%d at %d\n", rc, next);
+                return (link_t){ 0 };
+            }
+            next += rc;
+        }
+        unsigned sent = ll_event();
+        events++;
+        ble_l2cap_shim_credits(chan, (uint16_t)sent);
+        if (events > 1000000) break;
+    }
+    s_model_link = false;
+    s_verify = false;
+    ble_l2cap_shim_disconnect(chan);
+    link_t res = {
+        .rec_s = RECORDS / (events * (CONN_ITVL_US / 1e6)),
+        .events = events,
+        .max_queue_ms = s_ll_queued_max_us / 1000.0,
+        .ok = s_bad == 0 && s_records == RECORDS,
+    };
+    return res;
+}
+
+static double gatt_link_rec_s(double payload_per_frame, int recs_per_frame)
+{
+    unsigned pdu = (unsigned)payload_per_frame + ATT_NOTIFY_HDR + L2CAP_HDR;
+    return pdus_per_event(pdu) * recs_per_frame / (CONN_ITVL_US / 1e6);
+}
+
+static bool backlog(const char *label, bool sealed)
+{
+    char l1[64], l2[64];
+    int per_frame = sealed ? (int)FRAME_CRYPT_BACKLOG_RECS : 1;
+    snprintf(l1, sizeof(l1), "%s gatt, %d/notify", label, per_frame);
+    snprintf(l2, sizeof(l2), "%s coc, page/SDU", label);
+
+    cpu_t g = cpu_gatt(l1, per_frame, sealed);
+    cpu_t c = cpu_coc(l2);
+    link_t lc = link_coc();
+    bool ok = lc.ok;
+
+    double frame_payload = per_frame * sizeof(battery_log_t) + (sealed ? FRAME_CRYPT_OVERHEAD : 0);
+    double g_link = gatt_link_rec_s(frame_payload, per_frame);
+    double g_budget = NOTIFY_SCHED_BUDGET_BPS / (frame_payload / per_frame);
+
+    printf("  cpu/rec %.0f -> %.0f ns (%+.1f %%)  L2CAP bytes/rec %.1f -> %.1f\n",
+           g.cpu_ns, c.cpu_ns, (c.cpu_ns / g.cpu_ns - 1.0) * 100.0, g.bytes, c.bytes);
+    printf("  rec/s: gatt at %d B/s bulk budget %.0f, gatt link-bound %.0f, coc %.0f (%u events)"
+           "  queued ahead of live <= %.1f ms  %s\n\n",
+           NOTIFY_SCHED_BUDGET_BPS, g_budget, g_link, lc.rec_s, (unsigned)lc.events,
+           lc.max_queue_ms, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// Too few credits for a page: the send stalls, the next one is refused
+// until TX_UNSTALLED, which kicks the sender.
+static bool stall_check(void)
+{
+    reset_client();
+    s_verify = true;            // and for the OTA status SDUs after this
+    struct ble_l2cap_chan *chan = ble_l2cap_shim_connect(1, PEER_MTU, PEER_MPS, 4);
+    if (!chan) return false;
+
+    int rc1 = ble_coc_send_backlog_at(0, RECORDS, NULL);
+    int rc2 = ble_coc_send_backlog_at(rc1 > 0 ? rc1 : 0, RECORDS, NULL);
+    bool held = rc1 > 0 && rc2 == -2 && s_sdus == 0;
+    s_kicked = false;
+    ble_l2cap_shim_credits(chan, 64);
+    bool done = s_kicked && s_sdus == 1 && s_records == (uint32_t)rc1;
+    int rc3 = ble_coc_send_backlog_at(rc1, RECORDS, NULL);
+
+    ble_coc_stats_t st;
+    ble_coc_get_stats(&st);
+    ble_l2cap_shim_disconnect(chan);
+    bool ok = held && done && rc3 > 0 && s_bad == 0 && st.stalls >= 1 && !ble_coc_is_open();
+    printf("stall: first SDU %d records held for credits, second %d, kick on unstall %d  %s\n\n",
+           rc1, rc2, (int)s_kicked, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// A peer MTU that cannot hold the header and one sealed record is refused;
+// one that just can gets a record per SDU.
+static bool small_mtu_check(void)
+{
+    const uint16_t min_mtu = BLE_COC_HDR_LEN + FRAME_CRYPT_OVERHEAD + sizeof(battery_log_t);
+    reset_client();
+    struct ble_l2cap_chan *small = ble_l2cap_shim_connect(1, min_mtu - 1, PEER_MPS, 64);
+    ble_coc_stats_t st;
+    ble_coc_get_stats(&st);
+    bool refused = !small && !ble_coc_is_open() && st.small_mtu == 1;
+
+    struct ble_l2cap_chan *chan = ble_l2cap_shim_connect(1, min_mtu, PEER_MPS, 64);
+    int rc = chan ? ble_coc_send_backlog_at(0, RECORDS, NULL) : -1;
+    if (chan) ble_l2cap_shim_disconnect(chan);
+    bool ok = refused && rc == 1 && s_sdus == 1 && s_records == 1 && s_bad == 0;
+    printf("small mtu: %u refused %d, %u sends %d record(s)  %s\n\n", (unsigned)(min_mtu - 1),
+           (int)refused, (unsigned)min_mtu, rc, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// --- OTA ---
+
+static double ota_gatt_s(void)
+{
+    // Write in one event, ACK notification in the next: two intervals per
+    // chunk; a sector erase holds the host task for whole intervals.
+    double chunks = ceil((double)OTA_IMAGE / OTA_GATT_CHUNK);
+    double sectors = ceil((double)OTA_IMAGE / 4096);
+    double erase_itvl = ceil((double)FLASH_ERASE_US / CONN_ITVL_US);
+    return (chunks * 2 + sectors * erase_itvl) * CONN_ITVL_US / 1e6;
+}
+
+static double ota_coc_s(void)
+{
+    // K-frames of a page over the events they need, the page erased and
+    // programmed, then the ACK status in the next event.
+    unsigned kf = (BLE_COC_PAGE + 1 + 2 + PEER_MPS - 1) / PEER_MPS;
+    double air = kf * ll_pdu_us(L2CAP_HDR + PEER_MPS);
+    double per_sdu = ceil(air / CONN_ITVL_US) + ceil((FLASH_ERASE_US + 16.0 * FLASH_PROG_US) / CONN_ITVL_US) + 1;
+    return ceil((double)OTA_IMAGE / BLE_COC_PAGE) * per_sdu * CONN_ITVL_US / 1e6;
+}
+
+static bool ota(void)
+{
+    struct ble_l2cap_chan *chan = ble_l2cap_shim_connect(1, PEER_MTU, PEER_MPS, 64);
+    static uint8_t sdu[1 + BLE_COC_PAGE];
+    s_ota_bytes = 0;
+    s_ota_sdus = 0;
+    s_status_sdus = 0;
+    bool ok = chan != NULL;
+
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (uint32_t off = 0; ok && off < OTA_IMAGE; off += BLE_COC_PAGE) {
+        sdu[0] = BLE_COC_OP_OTA_DATA;
+        memset(sdu + 1, (int)(off >> 12), BLE_COC_PAGE);
+        ok = ble_l2cap_shim_deliver(chan, sdu, sizeof(sdu)) == 0;
+        ble_l2cap_shim_credits(chan, 8);
+    }
+    uint64_t wall = bench_now_ns() - w0, cpu = bench_cpu_ns() - c0;
+    ble_coc_stats_t st;
+    ble_coc_get_stats(&st);
+    if (chan) ble_l2cap_shim_disconnect(chan);
+
+    ok = ok && s_ota_bytes == OTA_IMAGE && s_status_sdus == s_ota_sdus && st.bad_sdu == 0;
+    double g = ota_gatt_s(), c = ota_coc_s();
+    printf("ota: %u KB image in %u SDUs, channel rx path %.0f ns/KB cpu (%.0f wall), %u status SDUs\n",
+           OTA_IMAGE / 1024, (unsigned)s_ota_sdus, (double)cpu / (OTA_IMAGE / 1024),
+           (double)wall / (OTA_IMAGE / 1024), (unsigned)s_status_sdus);
+    printf("  modelled: gatt %d B stop-and-wait %.1f s (%.1f KB/s), coc 4 KB SDUs %.1f s (%.1f KB/s), %.1fx  %s\n",
+           OTA_GATT_CHUNK, g, OTA_IMAGE / 1024.0 / g, c, OTA_IMAGE / 1024.0 / c, g / c,
+           ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+int main(void)
+{
+    bench_enter_scratch_dir("bench_coc");
+    battery_log_lock_init();
+    ble_hs_shim_set_sink(gatt_sink, NULL);
+    ble_l2cap_shim_set_sink(sdu_sink, NULL);
+    notify_pool_init();
+    if (ble_coc_init() != 0 || !ble_coc_available()) {
+        fprintf(stderr, "ble_coc_init failed\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < RECORDS; i++) {
+        battery_log_t r;
+        memset(&r, 0, sizeof(r));
+        r.seq = i;
+        r.timestamp_s = 1700000000u + i * 5u;
+        for (int c = 0; c < 16; c++) r.cell_mv[c] = (uint16_t)(3600 + (i + c) % 50);
+        r.current_ma = (int16_t)(i % 2000) - 1000;
+        r.soc = (uint8_t)(i % 101);
+        battery_log_append(&r);
+    }
+    printf("records=%d record=%u B page=%u B SDU max=%u B, link: %d ms interval, %u x 251 B PDUs/event\n\n",
+           battery_log_count(), (unsigned)sizeof(battery_log_t), BLE_COC_PAGE, (unsigned)BLE_COC_SDU_MAX,
+           CONN_ITVL_US / 1000, pdus_per_event(251));
+
+    bool ok = backlog("plain:", false);
+
+    if (frame_crypt_provision(k_key, 1) != ESP_OK || !frame_crypt_active()) {
+        fprintf(stderr, "provisioning failed\n");
+        return 1;
+    }
+    ok &= backlog("sealed:", true);
+
+    ok &= stall_check();
+    ok &= ota();
+    ok &= small_mtu_check();
+
+    printf("\n");
+    ble_stats_log_all();
+    printf("  %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
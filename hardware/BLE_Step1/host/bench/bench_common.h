@@ -0,0 +1,45 @@
+#pragma once
+/* Shared helpers for the host benchmarks. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t bench_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Creates a scratch directory under $TMPDIR and makes it the cwd, so firmware
+ * code built with LOG_BASE_PATH="." writes its files there. */
+static inline const char *bench_enter_scratch_dir(const char *name)
+{
+    static char path[256];
+    const char *tmp = getenv("TMPDIR");
+    snprintf(path, sizeof(path), "%s/%s.XXXXXX", tmp ? tmp : "/tmp", name);
+    if (!mkdtemp(path) || chdir(path) != 0) {
+        perror("scratch dir");
+        exit(1);
+    }
+    return path;
+}
+
+static inline void bench_report(const char *label, uint64_t ops, uint64_t wall_ns, uint64_t cpu_ns)
+{
+    printf("%-34s %10llu ops  %9.1f ns/op cpu  %9.1f ns/op wall  %11.0f ops/s\n",
+           label, (unsigned long long)ops,
+           ops ? (double)cpu_ns / (double)ops : 0.0,
+           ops ? (double)wall_ns / (double)ops : 0.0,
+           wall_ns ? (double)ops * 1e9 / (double)wall_ns : 0.0);
+}
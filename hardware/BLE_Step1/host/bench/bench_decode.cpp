@@ -0,0 +1,101 @@
+// Decode throughput for field-dump sized inputs: mmap + columnar transpose,
+// validation and CSV export, against a per-record struct loop baseline.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "batlog.hpp"
+#include "bench_common.h"
+
+namespace {
+
+constexpr size_t kRecords = 2 * 1000 * 1000;   // 112 MB
+
+void report_mb(const char *label, size_t bytes, uint64_t wall_ns)
+{
+    std::printf("%-28s %8.1f ms  %8.0f MB/s\n", label, wall_ns / 1e6,
+                wall_ns ? (double)bytes * 1e3 / (double)wall_ns : 0.0);
+}
+
+} // namespace
+
+int main()
+{
+    std::printf("scratch: %s\n", bench_enter_scratch_dir("bench_decode"));
+
+    {
+        std::vector<battery_log_t> recs(kRecords);
+        for (size_t i = 0; i < kRecords; i++) {
+            battery_log_t &r = recs[i];
+            std::memset(&r, 0, sizeof(r));
+            r.seq = (uint32_t)i + 1;
+            r.timestamp_s = (uint32_t)i * 5;
+            for (int c = 0; c < 16; c++) r.cell_mv[c] = (uint16_t)(3700 + ((i + c) % 97));
+            r.pack_total_mv = r.pack_sum_active_mv = 59200;
+            r.pack_ld_mv = 59100;
+            r.current_ma = (int16_t)((int)(i % 4000) - 2000);
+            r.temp_ts1_c_x100 = 2500;
+            r.temp_int_c_x100 = 3000;
+            r.soc = 80;
+            r.interval_s = i ? 5 : 0;
+            r.rate = 2;
+        }
+        std::FILE *f = std::fopen("battery.bin", "wb");
+        std::fwrite(recs.data(), sizeof(battery_log_t), recs.size(), f);
+        std::fclose(f);
+    }
+    const size_t bytes = kRecords * LOG_RECORD_SIZE_BYTES;
+
+    fw::MappedFile file;
+    std::string err;
+    if (!file.open("battery.bin", &err)) {
+        std::fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+
+    // Baseline: what a straightforward decoder does, one struct at a time.
+    uint64_t t0 = bench_now_ns();
+    std::vector<battery_log_t> aos(kRecords);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < kRecords; i++) {
+        std::memcpy(&aos[i], file.data() + i * LOG_RECORD_SIZE_BYTES, sizeof(battery_log_t));
+        for (int c = 0; c < 16; c++) sum += aos[i].cell_mv[c];
+    }
+    report_mb("per-record copy + cell sum", bytes, bench_now_ns() - t0);
+
+    t0 = bench_now_ns();
+    fw::Columns cols;
+    fw::decode_columns(file.data(), kRecords, cols);
+    uint64_t t_dec = bench_now_ns() - t0;
+    uint64_t sum2 = 0;
+    t0 = bench_now_ns();
+    for (int c = 0; c < 16; c++) {
+        for (uint16_t v : cols.cell_mv[c]) sum2 += v;
+    }
+    uint64_t t_sum = bench_now_ns() - t0;
+    report_mb("columnar decode", bytes, t_dec);
+    report_mb("columnar decode + cell sum", bytes, t_dec + t_sum);
+    if (sum != sum2) {
+        std::fprintf(stderr, "checksum mismatch\n");
+        return 1;
+    }
+
+    t0 = bench_now_ns();
+    fw::ValidationReport rep = fw::validate(cols);
+    report_mb("validate", bytes, bench_now_ns() - t0);
+    if (rep.seq_gaps || rep.seq_dups || rep.interval_mismatch) {
+        std::fprintf(stderr, "unexpected validation issues\n");
+        return 1;
+    }
+
+    std::FILE *devnull = std::fopen("/dev/null", "w");
+    t0 = bench_now_ns();
+    fw::write_csv(cols, devnull);
+    report_mb("csv export", bytes, bench_now_ns() - t0);
+    std::fclose(devnull);
+
+    std::remove("battery.bin");
+    return 0;
+}
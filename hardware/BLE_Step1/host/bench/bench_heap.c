@@ -0,0 +1,169 @@
+/*
+ * Heap allocations on the log's steady-state paths.
+ *
+ * malloc/calloc/realloc/free are interposed (glibc forwards to __libc_*),
+ * so allocations made inside libc on behalf of the log (stdio buffers,
+ * FILE objects) are counted too. Each store is filled and warmed up first,
+ * then appends (write-through and staged) and backlog reads are counted.
+ * Exits 1 if the row or partition store allocates in steady state.
+ *
+ * The columnar store still opens a stream per block read: glibc allocates
+ * a FILE object for each, where newlib reuses closed ones.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "log_store.h"
+#include "file_pool.h"
+#include "esp_partition.h"
+
+#define N_FILL      2000
+#define N_STEADY    2000
+#define PART_SIZE   0x80000         // no ring eviction during the run
+
+// ---------------------------------------------------------------- counters
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+static int s_counting;
+static uint64_t s_allocs;
+static uint64_t s_frees;
+
+void *malloc(size_t n)
+{
+    if (s_counting) s_allocs++;
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t sz)
+{
+    if (s_counting) s_allocs++;
+    return __libc_calloc(n, sz);
+}
+
+void *realloc(void *p, size_t n)
+{
+    if (s_counting) s_allocs++;
+    return __libc_realloc(p, n);
+}
+
+void free(void *p)
+{
+    if (s_counting && p) s_frees++;
+    __libc_free(p);
+}
+
+static void count_start(void)
+{
+    s_allocs = 0;
+    s_frees = 0;
+    s_counting = 1;
+}
+
+static void count_stop(void)
+{
+    s_counting = 0;
+}
+
+// ---------------------------------------------------------------- run
+
+static void make_rec(battery_log_t *r, uint32_t seq)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq = seq;
+    r->timestamp_s = 1700000000u + seq * 5;
+    for (int c = 0; c < 16; c++) r->cell_mv[c] = (uint16_t)(3300 + (seq * 7 + (uint32_t)c) % 600);
+    r->interval_s = 5;
+}
+
+static void report(const char *store, const char *what, int ops)
+{
+    printf("%-10s %-26s %6d ops  %6.2f allocs/op  %6.2f frees/op\n", store, what, ops,
+           (double)s_allocs / ops, (double)s_frees / ops);
+}
+
+// Returns the steady-state allocation count.
+static uint64_t run(const log_store_t *store)
+{
+    battery_log_t r;
+    uint32_t seq = 0;
+    uint64_t total = 0;
+
+    store->wipe();
+    battery_log_use_store(store);
+    battery_log_set_flush_batch(1);
+    battery_log_init();
+
+    for (int i = 0; i < N_FILL; i++) {
+        make_rec(&r, seq++);
+        battery_log_append(&r);
+    }
+    for (int i = 0; i < 64; i++) battery_log_read(i, &r);     // warm-up
+
+    // Sampling: write-through appends, as with a client connected.
+    count_start();
+    for (int i = 0; i < N_STEADY; i++) {
+        make_rec(&r, seq++);
+        if (battery_log_append(&r) != 0) exit(1);
+    }
+    count_stop();
+    report(store->name, "append (write-through)", N_STEADY);
+    total += s_allocs;
+
+    battery_log_set_flush_batch(8);
+    count_start();
+    for (int i = 0; i < N_STEADY; i++) {
+        make_rec(&r, seq++);
+        if (battery_log_append(&r) != 0) exit(1);
+    }
+    count_stop();
+    battery_log_flush();
+    battery_log_set_flush_batch(1);
+    report(store->name, "append (staged, batch 8)", N_STEADY);
+    total += s_allocs;
+
+    // Backlog: find the start, then read in order with a sample appended
+    // every 50 records, as mock_sender interleaves them.
+    int count = battery_log_count();
+    count_start();
+    int start = battery_log_find_start_index_by_seq(seq / 2);
+    for (int i = start; i < count; i++) {
+        if (!battery_log_read(i, &r)) exit(1);
+        if (i % 50 == 0) {
+            make_rec(&r, seq++);
+            battery_log_append(&r);
+        }
+    }
+    count_stop();
+    report(store->name, "backlog read", count - start);
+    total += s_allocs;
+    return total;
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_heap"));
+    battery_log_lock_init();
+    esp_partition_shim_add(LOG_PART_LABEL, PART_SIZE);
+
+    uint64_t row = run(&log_store_row);
+    uint64_t col = run(&log_store_columnar);
+    uint64_t part = run(&log_store_partition);
+
+    file_pool_stats_t fp;
+    file_pool_get_stats(&fp);
+    printf("\nfile_pool: %u opens, peak %u/%d buffers, %u fallbacks\n",
+           (unsigned)fp.opens, fp.peak, FILE_POOL_BUFS, (unsigned)fp.fallback);
+    printf("steady-state allocations: row %llu, columnar %llu (FILE objects), partition %llu\n",
+           (unsigned long long)row, (unsigned long long)col, (unsigned long long)part);
+
+    bool ok = row == 0 && part == 0;
+    printf("  %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/*
+ * Row vs. columnar on-flash layout.
+ *
+ * Fills each store with the same mock-sensor history, then scans it three
+ * ways: battery_log_read() per record (what the backlog sender does), and
+ * battery_log_read_field() projections of one cell and of a temperature
+ * (what on-device analytics would do). Also reports how well each file
+ * deflates, when zlib is available.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "log_store.h"
+#include "sensor_backend.h"
+#include "esp_random.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define N_RECORDS   51200   // whole blocks, so both files hold the same records
+#define SCAN_CHUNK  256
+
+static battery_log_t s_hist[N_RECORDS];
+
+static void make_history(void)
+{
+    esp_random_shim_seed(7);
+    sensor_init(&sensor_backend_mock);
+    for (int i = 0; i < N_RECORDS; i++) {
+        sensor_read(&s_hist[i]);
+        s_hist[i].seq = (uint32_t)i;
+        s_hist[i].timestamp_s = (uint32_t)i * 5;
+        s_hist[i].interval_s = i ? 5 : 0;
+        s_hist[i].rate = 2;
+    }
+}
+
+static void fill(const log_store_t *store)
+{
+    store->wipe();
+    battery_log_use_store(store);
+    battery_log_set_flush_batch(32);
+    for (int i = 0; i < N_RECORDS; i++) {
+        battery_log_append(&s_hist[i]);
+    }
+    battery_log_flush();
+    battery_log_init();   // recovery path: count from the files
+    if (battery_log_count() != N_RECORDS) {
+        fprintf(stderr, "%s: count %d != %d\n", store->name, battery_log_count(), N_RECORDS);
+        exit(1);
+    }
+}
+
+static long deflated_size(const char *path)
+{
+#ifdef HAVE_ZLIB
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *in = malloc((size_t)n);
+    uLongf out_len = compressBound((uLong)n);
+    unsigned char *out = malloc(out_len);
+    if (fread(in, 1, (size_t)n, f) != (size_t)n) n = 0;
+    fclose(f);
+    compress2(out, &out_len, in, (uLong)n, 6);
+    free(in);
+    free(out);
+    return (long)out_len;
+#else
+    (void)path;
+    return 0;
+#endif
+}
+
+static void run(const log_store_t *store, const char *file)
+{
+    char label[64];
+    fill(store);
+
+    // Row reads, checked against the source history.
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    uint32_t max_c7 = 0;
+    for (int i = 0; i < N_RECORDS; i++) {
+        battery_log_t r;
+        if (!battery_log_read(i, &r) || memcmp(&r, &s_hist[i], sizeof(r)) != 0) {
+            fprintf(stderr, "%s: record %d mismatch\n", store->name, i);
+            exit(1);
+        }
+        if (r.cell_mv[6] > max_c7) max_c7 = r.cell_mv[6];
+    }
+    snprintf(label, sizeof(label), "%s: read() cell7 max", store->name);
+    bench_report(label, N_RECORDS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    // Projection of cell 7.
+    uint16_t v16[SCAN_CHUNK];
+    uint32_t max_p = 0;
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < N_RECORDS; i += SCAN_CHUNK) {
+        int got = battery_log_read_field(LOG_FIELD_CELL(6), i, SCAN_CHUNK, v16);
+        for (int k = 0; k < got; k++) {
+            if (v16[k] != s_hist[i + k].cell_mv[6]) {
+                fprintf(stderr, "%s: projected cell7 mismatch at %d\n", store->name, i + k);
+                exit(1);
+            }
+            if (v16[k] > max_p) max_p = v16[k];
+        }
+    }
+    snprintf(label, sizeof(label), "%s: read_field() cell7 max", store->name);
+    bench_report(label, N_RECORDS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+    if (max_p != max_c7) {
+        fprintf(stderr, "%s: max mismatch\n", store->name);
+        exit(1);
+    }
+
+    // Projection of a signed field.
+    int16_t t16[SCAN_CHUNK];
+    int max_t = -32768;
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < N_RECORDS; i += SCAN_CHUNK) {
+        int got = battery_log_read_field(LOG_FIELD_TEMP_TS1, i, SCAN_CHUNK, t16);
+        for (int k = 0; k < got; k++) {
+            if (t16[k] > max_t) max_t = t16[k];
+        }
+    }
+    snprintf(label, sizeof(label), "%s: read_field() ts1 max", store->name);
+    bench_report(label, N_RECORDS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    // The host page cache hides most of the I/O; on flash the cost follows
+    // the bytes a projected scan has to read.
+    printf("%-34s %zu bytes read per projected value\n", store->name,
+           store == &log_store_columnar ? battery_log_field_size(LOG_FIELD_TEMP_TS1)
+                                        : sizeof(battery_log_t));
+
+    // Seq lookup (backlog FROM_SEQ).
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < 1000; i++) {
+        uint32_t want = (uint32_t)((i * 7919) % N_RECORDS);
+        if (battery_log_find_start_index_by_seq(want) != (int)want) {
+            fprintf(stderr, "%s: find_seq(%u) wrong\n", store->name, (unsigned)want);
+            exit(1);
+        }
+    }
+    snprintf(label, sizeof(label), "%s: find_start_index_by_seq", store->name);
+    bench_report(label, 1000, bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    long z = deflated_size(file);
+    if (z) {
+        long raw = (long)N_RECORDS * (long)sizeof(battery_log_t);
+        printf("%-34s %ld -> %ld bytes deflated (%.2fx)\n", store->name, raw, z, (double)raw / (double)z);
+    }
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_log_layout"));
+    battery_log_lock_init();
+    make_history();
+
+    run(&log_store_row, "battery.bin");
+    run(&log_store_columnar, "battery.col");
+    return 0;
+}
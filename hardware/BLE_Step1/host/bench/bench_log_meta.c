@@ -0,0 +1,191 @@
+/*
+ * Filesystem calls per backlog record.
+ *
+ * The backlog sender calls battery_log_count() once and battery_log_read()
+ * per record; the read used to ask the store for its size every time (a
+ * stat() of battery.bin on the row layout). This links the log with the
+ * libc file calls wrapped (-Wl,--wrap) and counts them over a backlog of
+ * every store, then checks the RAM summary against the records it
+ * describes: after appends, staged appends, remount and ring eviction.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "log_store.h"
+#include "esp_partition.h"
+
+#define N_RECORDS   3000            // fits the partition ring without wrapping
+#define PART_SIZE   0x40000
+
+// ---------------------------------------------------------------- fs counters
+
+enum { FS_STAT, FS_OPEN, FS_SEEK, FS_READ, FS_WRITE, FS_CLOSE, FS_OTHER, FS_KINDS };
+static const char *const s_kind_name[FS_KINDS] = {
+    "stat", "open", "seek", "read", "write", "close", "other",
+};
+static uint64_t s_calls[FS_KINDS];
+
+#define WRAP(ret, name, kind, params, args)          \
+    ret __real_##name params;                        \
+    ret __wrap_##name params                         \
+    {                                                \
+        s_calls[kind]++;                             \
+        return __real_##name args;                   \
+    }
+
+WRAP(int, stat, FS_STAT, (const char *p, struct stat *st), (p, st))
+WRAP(FILE *, fopen, FS_OPEN, (const char *p, const char *m), (p, m))
+WRAP(int, fseeko, FS_SEEK, (FILE *f, off_t o, int w), (f, o, w))
+WRAP(int, fseek, FS_SEEK, (FILE *f, long o, int w), (f, o, w))
+WRAP(size_t, fread, FS_READ, (void *b, size_t s, size_t n, FILE *f), (b, s, n, f))
+WRAP(size_t, fwrite, FS_WRITE, (const void *b, size_t s, size_t n, FILE *f), (b, s, n, f))
+WRAP(int, fclose, FS_CLOSE, (FILE *f), (f))
+WRAP(int, fflush, FS_OTHER, (FILE *f), (f))
+WRAP(ssize_t, read, FS_READ, (int fd, void *b, size_t n), (fd, b, n))
+WRAP(ssize_t, write, FS_WRITE, (int fd, const void *b, size_t n), (fd, b, n))
+WRAP(int, close, FS_CLOSE, (int fd), (fd))
+WRAP(int, unlink, FS_OTHER, (const char *p), (p))
+WRAP(int, rename, FS_OTHER, (const char *a, const char *b), (a, b))
+WRAP(int, fsync, FS_OTHER, (int fd), (fd))
+
+static uint64_t fs_total(void)
+{
+    uint64_t t = 0;
+    for (int k = 0; k < FS_KINDS; k++) t += s_calls[k];
+    return t;
+}
+
+// ---------------------------------------------------------------- helpers
+
+static void make_rec(battery_log_t *r, uint32_t seq)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq = seq;
+    r->timestamp_s = 1700000000u + seq * 5;
+    for (int c = 0; c < 16; c++) r->cell_mv[c] = (uint16_t)(3300 + (seq * 7 + (uint32_t)c) % 600);
+    r->interval_s = 5;
+    r->rate = 2;
+}
+
+static void check_summary(const char *what)
+{
+    battery_log_summary_t s;
+    bool ok = battery_log_get_summary(&s);
+    int n = battery_log_count();
+    battery_log_t first, last;
+
+    ok = ok && s.count == (uint32_t)n && s.bytes == (uint32_t)n * sizeof(battery_log_t);
+    if (ok && n > 0) {
+        ok = battery_log_read(0, &first) && battery_log_read(n - 1, &last) &&
+             s.first_seq == first.seq && s.first_ts == first.timestamp_s &&
+             s.last_seq == last.seq && s.last_ts == last.timestamp_s;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: summary count=%u first=%u last=%u does not match the log (count=%d)\n",
+                what, (unsigned)s.count, (unsigned)s.first_seq, (unsigned)s.last_seq, n);
+        exit(1);
+    }
+}
+
+// What mock_sender does for a full backlog, minus the notification itself.
+static void backlog(const log_store_t *store)
+{
+    char label[64];
+    battery_log_t r;
+
+    memset(s_calls, 0, sizeof(s_calls));
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    int count = battery_log_count();
+    for (int i = 0; i < count; i++) {
+        if (!battery_log_read(i, &r) || r.seq != (uint32_t)i) {
+            fprintf(stderr, "%s: backlog read %d failed\n", store->name, i);
+            exit(1);
+        }
+    }
+    uint64_t wall = bench_now_ns() - w0, cpu = bench_cpu_ns() - c0;
+
+    snprintf(label, sizeof(label), "%s: backlog read", store->name);
+    bench_report(label, (uint64_t)count, wall, cpu);
+    printf("%-34s %.2f fs calls/record (", "", (double)fs_total() / count);
+    for (int k = 0, first = 1; k < FS_KINDS; k++) {
+        if (!s_calls[k]) continue;
+        printf("%s%s %.2f", first ? "" : ", ", s_kind_name[k], (double)s_calls[k] / count);
+        first = 0;
+    }
+    printf(")\n");
+}
+
+static void run(const log_store_t *store)
+{
+    battery_log_t r;
+
+    store->wipe();
+    battery_log_use_store(store);
+    battery_log_set_flush_batch(1);
+    battery_log_init();
+    check_summary("empty");
+
+    for (int i = 0; i < N_RECORDS / 2; i++) {
+        make_rec(&r, (uint32_t)i);
+        if (battery_log_append(&r) != 0) exit(1);
+    }
+    check_summary("write-through");
+
+    battery_log_set_flush_batch(8);
+    for (int i = N_RECORDS / 2; i < N_RECORDS; i++) {
+        make_rec(&r, (uint32_t)i);
+        if (battery_log_append(&r) != 0) exit(1);
+        if (i % 5 == 0) check_summary("staged");
+    }
+    battery_log_flush();
+    battery_log_set_flush_batch(1);
+
+    battery_log_init();   // remount: loaded from the store
+    check_summary("remount");
+
+    backlog(store);
+}
+
+static void check_eviction(void)
+{
+    battery_log_t r;
+
+    log_store_partition.wipe();
+    battery_log_use_store(&log_store_partition);
+    battery_log_init();
+
+    uint32_t total = 3 * (PART_SIZE / 4096) * 63 + 20;
+    for (uint32_t s = 0; s < total; s++) {
+        make_rec(&r, s);
+        if (battery_log_append(&r) != 0) exit(1);
+        if (s % 97 == 0) check_summary("ring");
+    }
+    check_summary("ring");
+
+    battery_log_summary_t sum;
+    if (!battery_log_get_summary(&sum) || sum.first_seq == 0) {
+        fprintf(stderr, "ring: nothing evicted\n");
+        exit(1);
+    }
+    printf("ring: %u appends, summary follows eviction (first_seq=%u, %u kept)\n",
+           (unsigned)total, (unsigned)sum.first_seq, (unsigned)sum.count);
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_log_meta"));
+    battery_log_lock_init();
+    esp_partition_shim_add(LOG_PART_LABEL, PART_SIZE);
+
+    run(&log_store_row);
+    run(&log_store_columnar);
+    run(&log_store_partition);
+    check_eviction();
+    return 0;
+}
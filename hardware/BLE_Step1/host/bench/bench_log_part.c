@@ -0,0 +1,198 @@
+/*
+ * Raw-partition circular log vs. the battery.bin row store.
+ *
+ * The partition store runs on the NOR flash emulator in shim/ (512 KB, the
+ * "blog" partition of partitions_rawlog.csv); the row store runs on the host
+ * filesystem, since LittleFS itself is not built here. Besides host time,
+ * the emulator reports the flash operations per record and the estimated
+ * device time they cost.
+ *
+ * Then the ring is checked: wrap-around several times, remount, and a torn
+ * write at the head.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "log_store.h"
+#include "esp_partition.h"
+
+#define PART_SIZE   0x80000
+#define N_RECORDS   7000            // fits the ring without wrapping
+#define SCAN_CHUNK  256
+
+static void make_rec(battery_log_t *r, uint32_t seq)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq = seq;
+    r->timestamp_s = 1700000000u + seq * 5;
+    for (int c = 0; c < 16; c++) r->cell_mv[c] = (uint16_t)(3300 + (seq * 7 + (uint32_t)c) % 600);
+    r->current_ma = (int16_t)(seq % 2000) - 1000;
+    r->interval_s = 5;
+    r->rate = 2;
+}
+
+static void check_rec(const char *what, int index, const battery_log_t *r, uint32_t seq)
+{
+    battery_log_t want;
+    make_rec(&want, seq);
+    if (memcmp(r, &want, sizeof(want)) != 0) {
+        fprintf(stderr, "%s: record %d is not seq %u (got %u)\n", what, index,
+                (unsigned)seq, (unsigned)r->seq);
+        exit(1);
+    }
+}
+
+static void run(const log_store_t *store)
+{
+    char label[64];
+    esp_partition_shim_stats_t fs;
+
+    store->wipe();
+    battery_log_use_store(store);
+    battery_log_init();
+    esp_partition_shim_reset_stats();
+
+    // Appends, write-through as in normal mode. The sampler calls idle() before
+    // it sleeps, so the partition store's sector erases happen there.
+    uint64_t w_app = 0, c_app = 0;
+    for (int i = 0; i < N_RECORDS; i++) {
+        battery_log_t r;
+        make_rec(&r, (uint32_t)i);
+        uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+        if (battery_log_append(&r) != 0) {
+            fprintf(stderr, "%s: append %d failed\n", store->name, i);
+            exit(1);
+        }
+        w_app += bench_now_ns() - w0;
+        c_app += bench_cpu_ns() - c0;
+        battery_log_idle();
+    }
+    snprintf(label, sizeof(label), "%s: append", store->name);
+    bench_report(label, N_RECORDS, w_app, c_app);
+
+    if (store == &log_store_partition) {
+        esp_partition_shim_get_stats(&fs);
+        printf("%-34s %.2f writes, %.1f bytes programmed, %.4f erases per record\n",
+               "  flash ops", (double)fs.writes / N_RECORDS,
+               (double)fs.write_bytes / N_RECORDS, (double)fs.erases / N_RECORDS);
+        printf("%-34s %.0f us/record on device (writes %.0f us, erases amortised %.0f us, off the append path)\n",
+               "  device time (model)", (double)fs.device_ns / N_RECORDS / 1000.0,
+               (double)(fs.device_ns - fs.erases * 45000000ull) / N_RECORDS / 1000.0,
+               (double)fs.erases * 45000.0 / N_RECORDS);
+    }
+
+    // Sequential reads, as the backlog sender does them.
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (int i = 0; i < N_RECORDS; i++) {
+        battery_log_t r;
+        if (!battery_log_read(i, &r)) exit(1);
+        check_rec(store->name, i, &r, (uint32_t)i);
+    }
+    uint64_t wall = bench_now_ns() - w0;
+    snprintf(label, sizeof(label), "%s: read()", store->name);
+    bench_report(label, N_RECORDS, wall, bench_cpu_ns() - c0);
+    printf("%-34s %.1f MB/s\n", "", (double)N_RECORDS * sizeof(battery_log_t) / 1e6 / ((double)wall / 1e9));
+
+    // Field projection.
+    uint16_t v[SCAN_CHUNK];
+    uint32_t sum = 0;
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < N_RECORDS; i += SCAN_CHUNK) {
+        int got = battery_log_read_field(LOG_FIELD_CELL(3), i, SCAN_CHUNK, v);
+        for (int k = 0; k < got; k++) sum += v[k];
+    }
+    snprintf(label, sizeof(label), "%s: read_field() cell4", store->name);
+    bench_report(label, N_RECORDS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < 1000; i++) {
+        uint32_t want = (uint32_t)((i * 7919) % N_RECORDS);
+        if (battery_log_find_start_index_by_seq(want) != (int)want) {
+            fprintf(stderr, "%s: find_seq(%u) wrong\n", store->name, (unsigned)want);
+            exit(1);
+        }
+    }
+    snprintf(label, sizeof(label), "%s: find_start_index_by_seq", store->name);
+    bench_report(label, 1000, bench_now_ns() - w0, bench_cpu_ns() - c0);
+    (void)sum;
+}
+
+static void check_ring(void)
+{
+    const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                        ESP_PARTITION_SUBTYPE_ANY, LOG_PART_LABEL);
+    log_store_partition.wipe();
+    battery_log_use_store(&log_store_partition);
+    battery_log_init();
+
+    // Three times round the ring, without idle(): every erase is inline.
+    const uint32_t total = 3 * (PART_SIZE / 4096) * 63 + 20;
+    for (uint32_t s = 0; s < total; s++) {
+        battery_log_t r;
+        make_rec(&r, s);
+        if (battery_log_append(&r) != 0) exit(1);
+    }
+
+    int n = battery_log_count();
+    battery_log_t r;
+    for (int i = 0; i < n; i++) {
+        if (!battery_log_read(i, &r)) exit(1);
+        check_rec("wrap", i, &r, total - (uint32_t)n + (uint32_t)i);
+    }
+
+    // Remount: same ring.
+    battery_log_init();
+    if (battery_log_count() != n) {
+        fprintf(stderr, "remount: count %d != %d\n", battery_log_count(), n);
+        exit(1);
+    }
+    if (battery_log_find_start_index_by_seq(total - 10) != n - 10) {
+        fprintf(stderr, "remount: find_seq wrong\n");
+        exit(1);
+    }
+
+    // Torn write: half a record programmed after the newest one, then power loss.
+    const uint8_t *map = NULL;
+    esp_partition_mmap_handle_t mh;
+    esp_partition_mmap(p, 0, p->size, ESP_PARTITION_MMAP_DATA, (const void **)&map, &mh);
+    battery_log_t last;
+    make_rec(&last, total - 1);
+    size_t torn_off = 0;
+    for (size_t off = 64; off < p->size; off += 64) {
+        if (memcmp(map + off, &last, sizeof(last)) == 0) torn_off = off + 64;
+    }
+    if (torn_off == 0 || torn_off % 4096 == 0) {
+        fprintf(stderr, "torn: newest record not found mid-sector\n");
+        exit(1);
+    }
+    battery_log_t torn;
+    make_rec(&torn, total);
+    esp_partition_write(p, torn_off, &torn, 24);
+
+    battery_log_init();
+    if (battery_log_count() != n) {
+        fprintf(stderr, "torn: count %d != %d\n", battery_log_count(), n);
+        exit(1);
+    }
+    make_rec(&r, total);
+    if (battery_log_append(&r) != 0 || !battery_log_read(battery_log_count() - 1, &r)) exit(1);
+    check_rec("after torn", battery_log_count() - 1, &r, total);
+
+    printf("ring: %u appends over %d sectors, %d kept, remount + torn write ok\n",
+           (unsigned)total, (int)(PART_SIZE / 4096), n);
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_log_part"));
+    battery_log_lock_init();
+    esp_partition_shim_add(LOG_PART_LABEL, PART_SIZE);
+
+    run(&log_store_row);
+    run(&log_store_partition);
+    check_ring();
+    return 0;
+}
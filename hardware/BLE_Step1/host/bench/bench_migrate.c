@@ -0,0 +1,186 @@
+/*
+ * Online log migration (log_migrate.c) on a full partition.
+ *
+ * Writes a v3 battery.bin as large as the littlefs partition can hold, boots
+ * the v4 firmware code against it, and converts it batch by batch while new
+ * records keep arriving. Halfway through, the log is re-initialised from
+ * NVS as after a reset. At the end every record is checked, old and new.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "log_store.h"
+#include "file_pool.h"
+#include "log_migrate.h"
+#include "nvs.h"
+
+#define PARTITION_BYTES  0xE0000                        // littlefs in partitions.csv
+#define N_OLD            (PARTITION_BYTES / 56)         // v3 records filling it
+#define NEW_EVERY        8                              // one new record per N batches
+
+// v3 record: v4 with three pad bytes where interval_s and rate are now.
+typedef struct __attribute__((packed)) {
+    uint8_t  head[offsetof(battery_log_t, interval_s)];
+    uint8_t  pad[3];
+} rec_v3_t;
+
+static void expect_v3(int i, const battery_log_t *r)
+{
+    if (r->seq != (uint32_t)i || r->timestamp_s != 1700000000u + (uint32_t)i * 5 ||
+        r->cell_mv[15] != (uint16_t)(3300 + i % 500) || r->soc != (uint8_t)(i % 101) ||
+        r->interval_s != 0 || r->rate != 0) {
+        fprintf(stderr, "old record %d wrong (seq=%u)\n", i, (unsigned)r->seq);
+        exit(1);
+    }
+}
+
+static void write_v3_log(void)
+{
+    FILE *f = fopen("battery.bin", "wb");
+    for (int i = 0; i < N_OLD; i++) {
+        battery_log_t r;
+        memset(&r, 0, sizeof(r));
+        r.seq = (uint32_t)i;
+        r.timestamp_s = 1700000000u + (uint32_t)i * 5;
+        for (int c = 0; c < 16; c++) r.cell_mv[c] = (uint16_t)(3300 + (i + c) % 500);
+        r.cell_mv[15] = (uint16_t)(3300 + i % 500);
+        r.soc = (uint8_t)(i % 101);
+
+        rec_v3_t v3;
+        memcpy(v3.head, &r, sizeof(v3.head));
+        memset(v3.pad, 0, sizeof(v3.pad));
+        fwrite(&v3, sizeof(v3), 1, f);
+    }
+    fclose(f);
+
+    nvs_handle_t h;
+    nvs_open(LOG_NVS_NS, NVS_READWRITE, &h);
+    nvs_set_u32(h, "log_ver", 3);
+    nvs_set_u32(h, "log_sz", sizeof(rec_v3_t));
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static void append_new(uint32_t *seq)
+{
+    battery_log_t r;
+    memset(&r, 0, sizeof(r));
+    r.seq = (*seq)++;
+    r.timestamp_s = 1800000000u + r.seq;
+    r.interval_s = 5;
+    r.rate = 2;
+    if (battery_log_append(&r) != 0) {
+        fprintf(stderr, "append failed during migration\n");
+        exit(1);
+    }
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_migrate"));
+    battery_log_lock_init();
+    write_v3_log();
+
+    // Boot: format check sets up the migration, init serves the old records.
+    log_maybe_wipe_on_format_change();
+    battery_log_init();
+    if (battery_log_count() != N_OLD) {
+        fprintf(stderr, "count %d != %d before migration\n", battery_log_count(), N_OLD);
+        return 1;
+    }
+
+    uint32_t seq = N_OLD;
+    int batches = 0, left;
+    uint64_t wall = 0, cpu = 0;
+    bool rebooted = false;
+    uint32_t appends = 0, append_opens = 0;
+
+    for (;;) {
+        uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+        left = log_migrate_run_batch();
+        wall += bench_now_ns() - w0;
+        cpu += bench_cpu_ns() - c0;
+
+        if (left < 0) {
+            fprintf(stderr, "batch failed\n");
+            return 1;
+        }
+        if (left == 0) break;
+        batches++;
+
+        // The sampler keeps appending in the new format meanwhile, on the
+        // row store's open handle (no reopen per append).
+        if (batches % NEW_EVERY == 0) {
+            file_pool_stats_t a, b;
+            file_pool_get_stats(&a);
+            append_new(&seq);
+            file_pool_get_stats(&b);
+            appends++;
+            append_opens += b.opens - a.opens;
+        }
+
+        if (!rebooted && left < N_OLD / 2) {
+            rebooted = true;
+            battery_log_init();
+            battery_log_t r;
+            if (!battery_log_read(N_OLD - 1, &r)) return 1;
+            expect_v3(N_OLD - 1, &r);
+            if (battery_log_find_start_index_by_seq(N_OLD) != N_OLD ||
+                battery_log_find_start_index_by_seq(100) != 100) {
+                fprintf(stderr, "find_seq wrong during migration\n");
+                return 1;
+            }
+            printf("reset with %d left: resumed, %d old + %d new record(s) visible\n",
+                   left, log_migrate_count(), battery_log_count() - log_migrate_count());
+        }
+    }
+    // One open for the first append, one after the reboot's init().
+    printf("%u append(s) during conversion opened the log %u time(s)\n",
+           (unsigned)appends, (unsigned)append_opens);
+    if (append_opens > 2) {
+        fprintf(stderr, "appends during conversion reopen the log\n");
+        return 1;
+    }
+    bench_report("convert (per record)", N_OLD, wall, cpu);
+    printf("%-34s %.2f MB/s read+write, %d batch(es) of %d\n", "convert",
+           (double)N_OLD * 56 * 2 / 1e6 / ((double)wall / 1e9), batches + 1, LOG_MIGRATE_BATCH);
+
+    // Swap on the next append: merge what was written meanwhile, rename.
+    int n_new = (int)(seq - N_OLD);
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    append_new(&seq);
+    n_new++;
+    bench_report("swap (per new record merged)", (uint64_t)n_new, bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    if (log_migrate_count() != 0 || access("battery.old", F_OK) == 0 || access("battery.mig", F_OK) == 0) {
+        fprintf(stderr, "migration not finished\n");
+        return 1;
+    }
+    if (battery_log_count() != N_OLD + n_new) {
+        fprintf(stderr, "count %d != %d after migration\n", battery_log_count(), N_OLD + n_new);
+        return 1;
+    }
+
+    for (int i = 0; i < N_OLD + n_new; i++) {
+        battery_log_t r;
+        if (!battery_log_read(i, &r)) return 1;
+        if (i < N_OLD) {
+            expect_v3(i, &r);
+        } else if (r.seq != (uint32_t)i || r.interval_s != 5 || r.rate != 2) {
+            fprintf(stderr, "new record %d wrong\n", i);
+            return 1;
+        }
+    }
+    if (battery_log_find_start_index_by_seq(N_OLD + 3) != N_OLD + 3) {
+        fprintf(stderr, "find_seq wrong after swap\n");
+        return 1;
+    }
+
+    printf("migrated %d v3 record(s) (%d bytes) + %d new, all verified\n",
+           N_OLD, N_OLD * 56, n_new);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * CPU cost per notification: legacy msys path (battery_log_read into a stack
+ * record, ble_hs_mbuf_from_flat copy) vs. the dedicated notify pool with the
+ * record read straight into the mbuf.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "battery_log.h"
+#include "host/ble_hs.h"
+#include "notify_pool.h"
+#include "bench_common.h"
+
+#define RECORDS 4000
+#define RAM_ROUNDS 200
+
+static uint64_t s_sink_bytes;
+
+static int sink(uint16_t conn, uint16_t attr, const uint8_t *data, uint16_t len, void *arg)
+{
+    (void)conn; (void)attr; (void)data; (void)arg;
+    s_sink_bytes += len;
+    return 0;
+}
+
+static void fill_record(battery_log_t *r, uint32_t i)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq = i;
+    r->timestamp_s = 1700000000u + i * 5u;
+    for (int c = 0; c < 16; c++) r->cell_mv[c] = (uint16_t)(3600 + (i + c) % 50);
+    r->current_ma = (int16_t)(i % 2000) - 1000;
+    r->soc = (uint8_t)(i % 101);
+}
+
+int main(void)
+{
+    bench_enter_scratch_dir("bench_notify");
+    battery_log_lock_init();
+    ble_hs_shim_set_sink(sink, NULL);
+    os_msys_shim_init(24, 320);
+    notify_pool_init();
+
+    static battery_log_t recs[RECORDS];
+    for (uint32_t i = 0; i < RECORDS; i++) {
+        fill_record(&recs[i], i);
+        battery_log_append(&recs[i]);
+    }
+    printf("records=%d record_size=%u pool_block=%u\n\n",
+           battery_log_count(), (unsigned)sizeof(battery_log_t),
+           (unsigned)NOTIFY_POOL_BLOCK_SIZE);
+
+    uint64_t w0, c0;
+
+    /* --- frame construction only (records already in RAM) --- */
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int r = 0; r < RAM_ROUNDS; r++) {
+        for (int i = 0; i < RECORDS; i++) {
+            battery_log_t rec = recs[i];
+            struct os_mbuf *om = ble_hs_mbuf_from_flat(&rec, sizeof(rec));
+            ble_gatts_notify_custom(0, 1, om);
+        }
+    }
+    bench_report("ram: stack copy + msys from_flat", (uint64_t)RAM_ROUNDS * RECORDS,
+                 bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int r = 0; r < RAM_ROUNDS; r++) {
+        for (int i = 0; i < RECORDS; i++) {
+            struct os_mbuf *om = notify_pool_get();
+            battery_log_t *dst = notify_pool_reserve(om, sizeof(battery_log_t));
+            memcpy(dst, &recs[i], sizeof(*dst));
+            ble_gatts_notify_custom(0, 1, om);
+        }
+    }
+    bench_report("ram: notify pool, in-place", (uint64_t)RAM_ROUNDS * RECORDS,
+                 bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    /* --- full backlog path including the log read --- */
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < RECORDS; i++) {
+        battery_log_t rec;
+        battery_log_read(i, &rec);
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(&rec, sizeof(rec));
+        ble_gatts_notify_custom(0, 1, om);
+    }
+    bench_report("log: read to stack + msys", RECORDS,
+                 bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    w0 = bench_now_ns(); c0 = bench_cpu_ns();
+    for (int i = 0; i < RECORDS; i++) {
+        struct os_mbuf *om = notify_pool_get();
+        battery_log_t *dst = notify_pool_reserve(om, sizeof(battery_log_t));
+        battery_log_read(i, dst);
+        ble_gatts_notify_custom(0, 1, om);
+    }
+    bench_report("log: read into pool mbuf", RECORDS,
+                 bench_now_ns() - w0, bench_cpu_ns() - c0);
+
+    notify_pool_stats_t st;
+    notify_pool_get_stats(&st);
+    printf("\npool: blocks=%u free=%u min_free=%u allocs=%u exhausted=%u sink_bytes=%llu\n",
+           st.blocks, st.free_now, st.min_free, (unsigned)st.allocs,
+           (unsigned)st.exhausted, (unsigned long long)s_sink_bytes);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Live latency during a long backlog.
+ *
+ * Virtual-time simulation of mock_sender and the notification dispatcher
+ * over a link that drains at LINK_BPS through a few controller buffers.
+ * Compares the old sender (live sampling paused while a backlog streams,
+ * 20 ms between records) with the scheduler at an unlimited bulk budget
+ * (backlog and live share the controller queue first come, first served)
+ * and at the default budget. Live latency is sample -> on air.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "battery_log.h"
+#include "host/ble_hs.h"
+#include "notify_sched.h"
+#include "lat_hist.h"
+#include "bench_common.h"
+
+#define LINK_BPS        16000       // notification payload the link carries, B/s
+#define CTRL_BUFS       12          // frames the controller holds before ENOMEM
+#define BACKLOG_RECS    20000       // ~28 h of 5 s samples, 1.1 MB
+#define LIVE_PERIOD_US  1000000     // fast sampler rate
+#define POLL_US         20000       // mock_sender backlog poll (mbuf_retry_delay)
+#define STEP_US         1000
+#define TAIL_US         5000000     // keep sampling after the backlog ends
+
+enum { ATTR_LIVE = 1, ATTR_BACKLOG = 2 };
+
+// ble_link is not linked in: only its byte counter is used.
+void ble_link_note_tx(size_t bytes) { (void)bytes; }
+
+static int64_t s_now;
+static int64_t now_us(void) { return s_now; }
+
+// ---------------------------------------------------------------- link model
+
+static int64_t s_depart[CTRL_BUFS];     // on-air times of frames still buffered
+static int s_inflight;
+static int64_t s_link_free;             // when the link finishes its last frame
+static int64_t s_live_t0[4096];         // live sample time by seq
+static lat_hist_t s_live_lat;
+static uint32_t s_link_reject;
+static uint32_t s_backlog_rx;
+static int64_t s_backlog_done_us;      // last backlog frame on air
+
+static void link_drain(void)
+{
+    int keep = 0;
+    for (int i = 0; i < s_inflight; i++) {
+        if (s_depart[i] > s_now) s_depart[keep++] = s_depart[i];
+    }
+    s_inflight = keep;
+}
+
+static int sink(uint16_t conn, uint16_t attr, const uint8_t *data, uint16_t len, void *arg)
+{
+    (void)conn; (void)arg;
+    link_drain();
+    if (s_inflight == CTRL_BUFS) {
+        s_link_reject++;
+        return BLE_HS_ENOMEM;
+    }
+    int64_t start = s_link_free > s_now ? s_link_free : s_now;
+    s_link_free = start + (int64_t)len * 1000000 / LINK_BPS;
+    s_depart[s_inflight++] = s_link_free;
+
+    battery_log_t rec;
+    memcpy(&rec, data, sizeof(rec));
+    if (attr == ATTR_LIVE) {
+        lat_hist_add(&s_live_lat, (uint32_t)(s_link_free - s_live_t0[rec.seq % 4096]));
+    } else {
+        s_backlog_rx++;
+        s_backlog_done_us = s_link_free;
+    }
+    return 0;
+}
+
+static void reset_link(void)
+{
+    s_now = 0;
+    s_inflight = 0;
+    s_link_free = 0;
+    s_link_reject = 0;
+    s_backlog_rx = 0;
+    s_backlog_done_us = 0;
+    memset(&s_live_lat, 0, sizeof(s_live_lat));
+}
+
+static struct os_mbuf *frame(uint32_t seq)
+{
+    battery_log_t r;
+    memset(&r, 0, sizeof(r));
+    r.seq = seq;
+    return ble_hs_mbuf_from_flat(&r, sizeof(r));
+}
+
+static void report(const char *name, uint32_t live_due, uint64_t cpu_ns, uint32_t steps)
+{
+    char buf[200];
+    lat_hist_format(&s_live_lat, buf, sizeof(buf));
+    printf("%s\n", name);
+    printf("  backlog %u records on air after %.1f s, link rejects %u\n",
+           (unsigned)s_backlog_rx, s_backlog_done_us / 1e6, (unsigned)s_link_reject);
+    printf("  live %u of %u samples sent: %s\n",
+           (unsigned)s_live_lat.n, (unsigned)live_due, buf);
+    if (steps) {
+        bench_report("  dispatcher step", steps, cpu_ns, cpu_ns);
+    }
+}
+
+// ---------------------------------------------------------------- old sender
+
+static void run_serial(void)
+{
+    reset_link();
+    uint32_t live_due = 0;
+
+    // Backlog first, one record per 20 ms (retrying while the controller is
+    // full); samples due meanwhile are never taken.
+    for (uint32_t i = 0; i < BACKLOG_RECS;) {
+        if (ble_gatts_notify_custom(0, ATTR_BACKLOG, frame(i)) == 0) i++;
+        s_now += POLL_US;
+    }
+    live_due = (uint32_t)(s_now / LIVE_PERIOD_US);
+    int64_t end = s_now + TAIL_US;
+    for (int64_t t = s_now; t < end; t += LIVE_PERIOD_US) {
+        s_now = t;
+        live_due++;
+        s_live_t0[live_due % 4096] = t;
+        ble_gatts_notify_custom(0, ATTR_LIVE, frame(live_due));
+    }
+    report("serial sender (before): live paused for the backlog, 20 ms gap", live_due, 0, 0);
+}
+
+// ---------------------------------------------------------------- scheduler
+
+static void run_sched(const char *name, uint32_t budget_bps, uint32_t burst)
+{
+    reset_link();
+    notify_sched_set_clock(now_us);
+    notify_sched_set_budget(budget_bps, burst);
+    notify_sched_init(NULL);
+
+    uint32_t next_rec = 0, live_seq = 0, steps = 0;
+    int64_t next_live = 0, next_poll = 0, wake = 0;
+    int64_t end = -1;
+    uint64_t cpu = 0;
+
+    for (;; s_now += STEP_US) {
+        bool submitted = false;
+        if (s_now >= next_live) {
+            live_seq++;
+            s_live_t0[live_seq % 4096] = s_now;
+            notify_sched_submit(NS_CLASS_LIVE, 0, ATTR_LIVE, frame(live_seq), sizeof(battery_log_t));
+            next_live += LIVE_PERIOD_US;
+            submitted = true;
+        }
+        if (s_now >= next_poll) {
+            while (next_rec < BACKLOG_RECS && notify_sched_has_room(NS_CLASS_BACKLOG)) {
+                notify_sched_submit(NS_CLASS_BACKLOG, 0, ATTR_BACKLOG, frame(next_rec++),
+                                    sizeof(battery_log_t));
+                submitted = true;
+            }
+            next_poll += POLL_US;
+        }
+
+        // The dispatcher runs on a submit or when its budget wait expires.
+        // A notify the controller rejects is dropped, like on the device.
+        if (submitted || (wake >= 0 && s_now >= wake)) {
+            uint64_t c0 = bench_cpu_ns();
+            int64_t w = notify_sched_run();
+            cpu += bench_cpu_ns() - c0;
+            steps++;
+            wake = w < 0 ? -1 : s_now + (w < STEP_US ? STEP_US : w);
+        }
+
+        if (end < 0 && next_rec == BACKLOG_RECS && wake < 0) end = s_now + TAIL_US;
+        if (end >= 0 && s_now >= end) break;
+    }
+
+    report(name, live_seq, cpu, steps);
+    const char *cls_name[NS_CLASS_COUNT] = { "alert", "live", "backlog", "ota" };
+    for (int c = 0; c < NS_CLASS_COUNT; c++) {
+        ns_class_stats_t st;
+        notify_sched_get_stats(c, &st);
+        if (!st.sent && !st.full && !st.failed) continue;
+        printf("  queue %-7s sent=%u full=%u failed=%u delay avg=%.1f ms max=%.1f ms\n",
+               cls_name[c], (unsigned)st.sent, (unsigned)st.full, (unsigned)st.failed,
+               st.sent ? (double)st.sum_delay_us / st.sent / 1000.0 : 0.0,
+               st.max_delay_us / 1000.0);
+    }
+}
+
+int main(void)
+{
+    os_msys_shim_init(64, 320);
+    ble_hs_shim_set_sink(sink, NULL);
+    printf("link %d B/s, %d controller buffers, backlog %d x %u B, live every %d ms\n\n",
+           LINK_BPS, CTRL_BUFS, BACKLOG_RECS, (unsigned)sizeof(battery_log_t),
+           LIVE_PERIOD_US / 1000);
+
+    run_serial();
+    printf("\n");
+    run_sched("scheduler, unlimited budget (shared FIFO)", 100000000u, 1000000u);
+    printf("\n");
+    run_sched("scheduler, default budget", NOTIFY_SCHED_BUDGET_BPS, NOTIFY_SCHED_BURST_BYTES);
+    return 0;
+}
@@ -0,0 +1,534 @@
+/*
+ * Wi-Fi upload (wifi_offload) against a stand-in backend.
+ *
+ * The firmware module runs on the shims: the Wi-Fi driver joins at once
+ * (or is refused), and esp_http_client talks real HTTP over loopback to a
+ * server thread here that follows the backend's device-log protocol
+ * (backend/routes/deviceLogController.js): GET .../offset, POST .../batches
+ * with a log_pack batch, offset check, REBASE (backward to seq 0 only,
+ * forward only up to what the phone relay stored), 409 with the offset it has.
+ *
+ * Scenarios: a clean upload; a reply lost after the server stored a batch
+ * (the next session resumes from the server's offset, nothing twice); a
+ * request cut off before it was stored; a stale offset answered with 409;
+ * the network refusing the join; a phone holding records ahead of the
+ * backend, not yet relayed (rebase refused, the upload sends them) and
+ * relayed (upload rebases past them); the writer appending while an upload
+ * runs on another thread. The server's copy is compared with the log
+ * record by record.
+ *
+ * Also reports the batch codec against RAW and, when zlib is available,
+ * deflate of the same batches.
+ *
+ * Exits 1 if a record is missing, duplicated, altered or out of order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "ble_sync.h"
+#include "esp_random.h"
+#include "esp_wifi.h"
+#include "log_pack.h"
+#include "nvs.h"
+#include "sensor_backend.h"
+#include "wifi_offload.h"
+#include "freertos/task.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define RECORDS         6000
+#define MORE_RECORDS    1500
+#define DEV_ID          "bench-dev"
+#define DEV_KEY         "bench-key"
+#define LIVE_RECORDS    8000        // appended while an upload runs, at most
+#define MAX_STORED      (4 * (RECORDS + MORE_RECORDS) + LIVE_RECORDS)
+
+#define REQ_OFFSET      "GET /api/device-logs/" DEV_ID "/offset "
+#define REQ_BATCHES     "POST /api/device-logs/" DEV_ID "/batches "
+
+// mem_plan.c needs the IDF heap API; the upload task is not watched here.
+void mem_plan_watch_task(TaskHandle_t task, uint32_t stack_bytes)
+{
+    (void)task;
+    (void)stack_bytes;
+}
+
+// --- stand-in backend ---
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_DROP_REPLY,       // store the batch, close without answering
+    FAULT_DROP_REQUEST,     // close before storing
+    FAULT_STALE_OFFSET,     // GET answers an offset ahead of the real one
+} fault_t;
+
+static struct {
+    pthread_mutex_t lock;
+    int listen_fd;
+    uint16_t port;
+    bool has_offset;
+    uint32_t next_seq;
+    battery_log_t *stored;
+    int stored_count;
+    int posts;
+    bool has_relay;
+    uint32_t relay_seq;     // newest seq the phone relay stored
+    int rebases;
+    int conflicts;
+    int skipped;            // records at or behind the offset (sent twice)
+    fault_t fault;
+    int fault_at_post;      // 1-based POST that the fault hits
+} s_srv = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static battery_log_t s_unpacked[LOG_PACK_MAX_RECORDS];
+
+static void reply(int fd, int status, const char *json)
+{
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+                     "HTTP/1.1 %d X\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n%s",
+                     status, strlen(json), json);
+    if (send(fd, buf, (size_t)n, MSG_NOSIGNAL) != n) perror("reply");
+}
+
+static void reply_offset(int fd, int status, uint32_t next, int inserted)
+{
+    char json[128];
+    snprintf(json, sizeof(json), "{\"success\":%s,\"data\":{\"nextSeq\":%u,\"inserted\":%d}}",
+             status == 200 ? "true" : "false", (unsigned)next, inserted);
+    reply(fd, status, json);
+}
+
+// Whole request: headers, then Content-Length bytes of body.
+static int read_request(int fd, char *hdr, size_t hdr_cap, uint8_t **body, size_t *body_len)
+{
+    size_t got = 0;
+    char *end = NULL;
+    while (!end) {
+        if (got == hdr_cap - 1) return -1;
+        ssize_t n = recv(fd, hdr + got, hdr_cap - 1 - got, 0);
+        if (n <= 0) return -1;
+        got += (size_t)n;
+        hdr[got] = '\0';
+        end = strstr(hdr, "\r\n\r\n");
+    }
+    const char *cl = strstr(hdr, "Content-Length:");
+    size_t len = cl ? strtoul(cl + 15, NULL, 10) : 0;
+    size_t have = got - (size_t)(end + 4 - hdr);
+
+    *body = malloc(len ? len : 1);
+    memcpy(*body, end + 4, have < len ? have : len);
+    while (have < len) {
+        ssize_t n = recv(fd, *body + have, len - have, 0);
+        if (n <= 0) {
+            free(*body);
+            return -1;
+        }
+        have += (size_t)n;
+    }
+    *body_len = len;
+    return 0;
+}
+
+static void handle_batch(int fd, const uint8_t *body, size_t len)
+{
+    log_pack_hdr_t h;
+    int n = log_pack_unpack(body, len, &h, s_unpacked, LOG_PACK_MAX_RECORDS);
+    if (n < 0) {
+        reply(fd, 400, "{\"success\":false,\"error\":\"Bad batch\"}");
+        return;
+    }
+
+    pthread_mutex_lock(&s_srv.lock);
+    int post = ++s_srv.posts;
+    if (s_srv.fault == FAULT_DROP_REQUEST && post == s_srv.fault_at_post) {
+        pthread_mutex_unlock(&s_srv.lock);
+        return;
+    }
+    uint32_t expected = s_srv.has_offset ? s_srv.next_seq : 0;
+    bool conflict = h.from_seq > expected;
+    if ((h.flags & LOG_PACK_F_REBASE) && h.from_seq != expected) {
+        // Backward only to a reset log, forward only past what the relay stored.
+        conflict = h.from_seq < expected ? h.from_seq != 0
+                                         : !s_srv.has_relay || s_srv.relay_seq + 1 < h.from_seq;
+        if (!conflict) {
+            expected = h.from_seq;
+            s_srv.rebases++;
+        }
+    }
+    if (conflict) {
+        s_srv.conflicts++;
+        pthread_mutex_unlock(&s_srv.lock);
+        reply_offset(fd, 409, expected, 0);
+        return;
+    }
+
+    int inserted = 0;
+    for (int i = 0; i < n; i++) {
+        if (s_unpacked[i].seq < expected) {
+            s_srv.skipped++;
+            continue;
+        }
+        if (s_srv.stored_count < MAX_STORED) s_srv.stored[s_srv.stored_count++] = s_unpacked[i];
+        expected = s_unpacked[i].seq + 1;
+        inserted++;
+    }
+    s_srv.next_seq = expected;
+    s_srv.has_offset = true;
+    bool drop = s_srv.fault == FAULT_DROP_REPLY && post == s_srv.fault_at_post;
+    pthread_mutex_unlock(&s_srv.lock);
+
+    if (!drop) reply_offset(fd, 200, expected, inserted);
+}
+
+static void handle(int fd)
+{
+    char hdr[2048];
+    uint8_t *body = NULL;
+    size_t body_len = 0;
+    if (read_request(fd, hdr, sizeof(hdr), &body, &body_len) != 0) return;
+
+    if (!strstr(hdr, "Authorization: Bearer " DEV_KEY "\r\n")) {
+        reply(fd, 401, "{\"success\":false,\"error\":\"Bad device key\"}");
+    } else if (!strncmp(hdr, REQ_OFFSET, sizeof(REQ_OFFSET) - 1)) {
+        pthread_mutex_lock(&s_srv.lock);
+        uint32_t next = s_srv.has_offset ? s_srv.next_seq : 0;
+        if (s_srv.fault == FAULT_STALE_OFFSET) next += 100;
+        pthread_mutex_unlock(&s_srv.lock);
+        reply_offset(fd, 200, next, 0);
+    } else if (!strncmp(hdr, REQ_BATCHES, sizeof(REQ_BATCHES) - 1)) {
+        handle_batch(fd, body, body_len);
+    } else {
+        reply(fd, 404, "{\"success\":false}");
+    }
+    free(body);
+}
+
+static void *server_main(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        int fd = accept(s_srv.listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        handle(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static void server_start(void)
+{
+    s_srv.stored = calloc(MAX_STORED, sizeof(battery_log_t));
+    s_srv.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t alen = sizeof(a);
+    if (s_srv.listen_fd < 0 || bind(s_srv.listen_fd, (struct sockaddr *)&a, sizeof(a)) != 0 ||
+        listen(s_srv.listen_fd, 8) != 0 ||
+        getsockname(s_srv.listen_fd, (struct sockaddr *)&a, &alen) != 0) {
+        perror("stand-in server");
+        exit(1);
+    }
+    s_srv.port = ntohs(a.sin_port);
+    pthread_t t;
+    pthread_create(&t, NULL, server_main, NULL);
+    pthread_detach(t);
+}
+
+static void server_fault(fault_t f, int at_post)
+{
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.fault = f;
+    s_srv.fault_at_post = s_srv.posts + at_post;
+    pthread_mutex_unlock(&s_srv.lock);
+}
+
+// --- device side ---
+
+static uint32_t s_ts = 1700000000u;
+
+static void make_record(battery_log_t *r)
+{
+    sensor_read(r);
+    r->timestamp_s = s_ts;
+    r->interval_s = 5;
+    r->soc = 80;
+    s_ts += 5;
+    r->seq = battery_log_next_seq();
+}
+
+static void append_records(int n)
+{
+    for (int i = 0; i < n; i++) {
+        battery_log_t r;
+        make_record(&r);
+        battery_log_append(&r);
+    }
+}
+
+static void configure(void)
+{
+    char url[96];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/api/device-logs/", (unsigned)s_srv.port);
+    nvs_handle_t h;
+    nvs_open("offload", NVS_READWRITE, &h);
+    nvs_set_str(h, "ssid", "bench");
+    nvs_set_str(h, "url", url);
+    nvs_set_str(h, "dev", DEV_ID);
+    nvs_set_str(h, "key", DEV_KEY);
+    nvs_close(h);
+}
+
+// From its `at`-th record on, the server holds log records [from, to) (by
+// seq) once each, unaltered and in order, and nothing else.
+static int check_server(int at, uint32_t from, uint32_t to, const char *what)
+{
+    int idx = battery_log_find_start_index_by_seq(from);
+    int want = (int)(to - from);
+    if (s_srv.stored_count - at != want) {
+        fprintf(stderr, "%s: server has %d records, want %d\n", what, s_srv.stored_count - at, want);
+        return 1;
+    }
+    for (int i = 0; i < want; i++) {
+        battery_log_t r;
+        if (!battery_log_read(idx + i, &r) || memcmp(&r, &s_srv.stored[at + i], sizeof(r)) != 0) {
+            fprintf(stderr, "%s: record %d (seq %u) differs\n", what, i, (unsigned)r.seq);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int session(const char *label, int want)
+{
+    wifi_offload_stats_t a, b;
+    wifi_offload_get_stats(&a);
+    uint64_t t0 = bench_now_ns();
+    int got = wifi_offload_run_session();
+    uint64_t t1 = bench_now_ns();
+    wifi_offload_get_stats(&b);
+    uint32_t wm = 0;
+    bool has_wm = wifi_offload_get_watermark(&wm);
+
+    printf("%-28s %6d records %4u batches %8u -> %7u bytes  %6.1f ms  offset %u  wm %lld\n",
+           label, got, (unsigned)(b.batches - a.batches), (unsigned)(b.bytes_raw - a.bytes_raw),
+           (unsigned)(b.bytes_sent - a.bytes_sent), (double)(t1 - t0) / 1e6,
+           (unsigned)s_srv.next_seq, has_wm ? (long long)wm : -1LL);
+    if (got != want) {
+        fprintf(stderr, "%s: %d records accepted, want %d\n", label, got, want);
+        return 1;
+    }
+    return 0;
+}
+
+static atomic_int s_up_done;
+static int s_up_got;
+
+static void *upload_thread(void *arg)
+{
+    (void)arg;
+    s_up_got = wifi_offload_run_session();
+    atomic_store(&s_up_done, 1);
+    return NULL;
+}
+
+// The writer keeps appending while the upload task reads the log (both take
+// the log lock). Seqs are assigned up front: the NVS shim is not shared
+// between threads here.
+static int appends_during_upload(void)
+{
+    static battery_log_t recs[LIVE_RECORDS];
+    for (int i = 0; i < LIVE_RECORDS; i++) make_record(&recs[i]);
+
+    int at = s_srv.stored_count;
+    uint32_t from = s_srv.next_seq;
+    for (int i = 0; i < 2 * WIFI_OFFLOAD_BATCH; i++) battery_log_append(&recs[i]);
+
+    int n = 2 * WIFI_OFFLOAD_BATCH, during = 0;
+    pthread_t t;
+    atomic_store(&s_up_done, 0);
+    pthread_create(&t, NULL, upload_thread, NULL);
+    while (n < LIVE_RECORDS && !atomic_load(&s_up_done)) {
+        battery_log_append(&recs[n++]);
+        during++;
+    }
+    pthread_join(t, NULL);
+    printf("%-28s %6d records while %d were appended\n", "appends during upload", s_up_got, during);
+
+    while (n < LIVE_RECORDS) battery_log_append(&recs[n++]);
+    int fail = 0;
+    int left = (int)(battery_log_peek_next_seq() - s_srv.next_seq);
+    int cap = WIFI_OFFLOAD_MAX_BATCHES * WIFI_OFFLOAD_BATCH;
+    while (left > 0) {
+        fail |= session("resume after appends", left < cap ? left : cap);
+        left -= cap;
+    }
+    if (during == 0) {
+        fprintf(stderr, "appends during upload: the upload ended before any append\n");
+        fail = 1;
+    }
+    return fail | check_server(at, from, battery_log_peek_next_seq(), "appends during upload");
+}
+
+// --- codec ---
+
+static void codec_report(void)
+{
+    static battery_log_t recs[WIFI_OFFLOAD_BATCH];
+    static uint8_t out[LOG_PACK_BUF_SIZE(WIFI_OFFLOAD_BATCH)];
+    int count = battery_log_count();
+    long raw = 0, packed = 0, deflated = 0;
+    uint64_t cpu = 0;
+    int batches = 0;
+
+    for (int i = 0; i + WIFI_OFFLOAD_BATCH <= count; i += WIFI_OFFLOAD_BATCH, batches++) {
+        for (int k = 0; k < WIFI_OFFLOAD_BATCH; k++) battery_log_read(i + k, &recs[k]);
+        uint64_t c0 = bench_cpu_ns();
+        int len = log_pack_batch(recs, WIFI_OFFLOAD_BATCH, recs[0].seq, 0, out, sizeof(out));
+        cpu += bench_cpu_ns() - c0;
+        raw += (long)LOG_PACK_BUF_SIZE(WIFI_OFFLOAD_BATCH);
+        packed += len;
+#ifdef HAVE_ZLIB
+        uint8_t wire[WIFI_OFFLOAD_BATCH * LOG_RECORD_SIZE_BYTES];
+        for (int k = 0; k < WIFI_OFFLOAD_BATCH; k++) {
+            log_record_encode(&recs[k], wire + k * LOG_RECORD_SIZE_BYTES);
+        }
+        static uint8_t z[2 * sizeof(wire)];
+        uLongf zlen = sizeof(z);
+        compress2(z, &zlen, wire, sizeof(wire), 6);
+        deflated += (long)(zlen + LOG_PACK_HDR_LEN);
+#endif
+    }
+    printf("\nbatch of %d records, %d batches:\n", WIFI_OFFLOAD_BATCH, batches);
+    printf("  raw        %8ld bytes\n", raw);
+    printf("  log_pack   %8ld bytes  %.2fx  %.0f ns/record cpu\n", packed, (double)raw / packed,
+           (double)cpu / ((double)batches * WIFI_OFFLOAD_BATCH));
+#ifdef HAVE_ZLIB
+    printf("  deflate-6  %8ld bytes  %.2fx  (zlib defaults: 256 KB of state)\n",
+           deflated, (double)raw / deflated);
+#endif
+}
+
+int main(void)
+{
+    int fail = 0;
+    bench_enter_scratch_dir("bench_offload");
+    battery_log_lock_init();
+    esp_random_shim_seed(11);
+    sensor_init(&sensor_backend_mock);
+    server_start();
+    configure();
+
+    battery_log_init();
+    battery_log_seq_init();
+    ble_sync_init();
+    wifi_offload_init();
+
+    append_records(RECORDS);
+    printf("log: %d records, stand-in backend on 127.0.0.1:%u\n\n", battery_log_count(),
+           (unsigned)s_srv.port);
+
+    // Reply lost after batch 3 was stored, then a request cut off.
+    server_fault(FAULT_DROP_REPLY, 3);
+    fail |= session("reply lost at batch 3", 2 * WIFI_OFFLOAD_BATCH);
+    server_fault(FAULT_DROP_REQUEST, 2);
+    fail |= session("request lost at batch 2", WIFI_OFFLOAD_BATCH);
+    server_fault(FAULT_NONE, 0);
+    int left = RECORDS - 4 * WIFI_OFFLOAD_BATCH;
+    int cap = WIFI_OFFLOAD_MAX_BATCHES * WIFI_OFFLOAD_BATCH;
+    while (left > 0) {
+        fail |= session("resume", left < cap ? left : cap);
+        left -= cap;
+    }
+    fail |= session("caught up", 0);
+    fail |= check_server(0, 0, RECORDS, "after resume");
+
+    // Stale offset: the first POST gets 409 and the upload continues from the real one.
+    append_records(MORE_RECORDS / 3);
+    server_fault(FAULT_STALE_OFFSET, 0);
+    fail |= session("stale offset (409)", MORE_RECORDS / 3);
+    server_fault(FAULT_NONE, 0);
+    fail |= check_server(0, 0, RECORDS + MORE_RECORDS / 3, "after 409");
+
+    // No network: the join fails and the driver is released.
+    append_records(MORE_RECORDS / 3);
+    esp_wifi_shim_set_reachable(false);
+    fail |= session("join refused", -1);
+    esp_wifi_shim_set_reachable(true);
+
+    // A phone holds records past the backend's offset. Not relayed yet: the
+    // rebase is refused and the upload sends them. Relayed: it skips them.
+    uint8_t phone_id[] = "phone";
+    ble_sync_set_client_id(phone_id, sizeof(phone_id) - 1);
+    ble_sync_ack(battery_log_peek_next_seq() - 1 - 50);
+    ble_sync_on_disconnect();
+    uint32_t before = s_srv.next_seq;
+    int stored_before = s_srv.stored_count;
+    int conflicts = s_srv.conflicts;
+    fail |= session("phone ahead, not relayed", (int)(battery_log_peek_next_seq() - before));
+    if (s_srv.rebases != 0 || s_srv.conflicts - conflicts != 1) {
+        fprintf(stderr, "not relayed: %d rebases, %d conflicts\n", s_srv.rebases,
+                s_srv.conflicts - conflicts);
+        fail = 1;
+    }
+    fail |= check_server(stored_before, before, battery_log_peek_next_seq(), "after refused rebase");
+
+    append_records(MORE_RECORDS - 2 * (MORE_RECORDS / 3));
+    uint32_t phone_wm = battery_log_peek_next_seq() - 1 - 50;
+    ble_sync_set_client_id(phone_id, sizeof(phone_id) - 1);
+    ble_sync_ack(phone_wm);
+    ble_sync_on_disconnect();
+    pthread_mutex_lock(&s_srv.lock);
+    s_srv.has_relay = true;
+    s_srv.relay_seq = phone_wm;
+    pthread_mutex_unlock(&s_srv.lock);
+    before = s_srv.next_seq;
+    stored_before = s_srv.stored_count;
+    uint32_t end = battery_log_peek_next_seq();
+    fail |= session("phone relayed (rebase)", (int)(end - (phone_wm + 1)));
+    if (s_srv.rebases != 1) {
+        fprintf(stderr, "rebase: %d rebases from offset %u\n", s_srv.rebases, (unsigned)before);
+        fail = 1;
+    }
+    fail |= check_server(stored_before, phone_wm + 1, end, "after rebase");
+
+    uint32_t wm = 0, reclaim = 0;
+    if (!wifi_offload_get_watermark(&wm) || wm != end - 1 || !ble_sync_reclaimable_seq(&reclaim) ||
+        reclaim != phone_wm) {
+        fprintf(stderr, "watermarks: upload %u (want %u), reclaim %u (want %u)\n", (unsigned)wm,
+                (unsigned)(end - 1), (unsigned)reclaim, (unsigned)phone_wm);
+        fail = 1;
+    }
+
+    fail |= appends_during_upload();
+
+    uint32_t inits, deinits;
+    esp_wifi_shim_counts(&inits, &deinits);
+    wifi_offload_stats_t st;
+    wifi_offload_get_stats(&st);
+    printf("\nsessions %u, join failed %u, batches %u, conflicts %u, rebased %u, http errors %u\n",
+           (unsigned)st.sessions, (unsigned)st.join_failed, (unsigned)st.batches,
+           (unsigned)st.conflicts, (unsigned)st.rebased, (unsigned)st.http_errors);
+    printf("server: %d POSTs, %d records stored, %d resent and skipped\n", s_srv.posts,
+           s_srv.stored_count, s_srv.skipped);
+    if (inits != deinits || st.join_failed != 1 || s_srv.skipped != 0) {
+        fprintf(stderr, "driver inits %u / deinits %u, join failed %u, skipped %d\n",
+                (unsigned)inits, (unsigned)deinits, (unsigned)st.join_failed, s_srv.skipped);
+        fail = 1;
+    }
+
+    codec_report();
+    printf("\n%s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
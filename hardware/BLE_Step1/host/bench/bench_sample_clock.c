@@ -0,0 +1,215 @@
+/*
+ * Sample timing: the old relative schedule vs. the sampling clock.
+ *
+ * Virtual time, modelled costs. The old sender took a sample when its
+ * command-queue wait ran out, at a 10 ms tick, and scheduled the next one a
+ * period after that wake-up; the wait was computed before the idle work
+ * (log pre-erase, sync / SOC checkpoints), so that work made the sample late,
+ * and every late sample pushed all the following ones back. A backlog pump
+ * in progress delayed it the same way.
+ *
+ * The sampling clock (main/sample_clock.c, the real code) schedules on a
+ * grid and is woken by an esp_timer; the acquisition task preempts the
+ * sender, so only the dispatch and a flash operation in flight (the cache is
+ * off on both cores) delay it.
+ *
+ * Phases: 24 h at 5 s; 1 h at 1 s with a backlog pump running; then a
+ * 3.5 s stall at 1 s and a switch to 60 s. Exits 1 if the clock leaves its
+ * grid, loses or invents a sample, or miscounts the missed slots.
+ */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lat_hist.h"
+#include "sample_clock.h"
+#include "sampler.h"
+
+#define TICK_US             10000       // CONFIG_FREERTOS_HZ=100
+#define STORE_US            3000        // notify + append
+#define SYNC_PERSIST_US     12000       // NVS, every SYNC_EVERY samples
+#define SYNC_EVERY          6
+#define SOC_PERSIST_US      20000
+#define SOC_EVERY           60
+#define PRE_ERASE_US        45000       // 4 KB sector, every ERASE_EVERY samples
+#define ERASE_EVERY         73          // 4096 / 56-byte records
+#define PUMP_CHUNK_US       8000        // backlog pump per 20 ms poll
+#define PUMP_POLL_US        20000
+#define FLASH_READ_US       1000        // a pump read, cache off
+#define DISPATCH_MIN_US     30          // esp_timer ISR -> timer task -> notify
+#define DISPATCH_MAX_US     90
+
+#define DAY_US              (24LL * 3600 * 1000000)
+#define HOUR_US             (3600LL * 1000000)
+
+static uint32_t s_rng = 0x12345678u;
+
+static uint32_t rnd(uint32_t n)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (s_rng >> 8) % n;
+}
+
+// Idle work the sender did before waiting for sample k.
+static int64_t idle_work_us(uint32_t k)
+{
+    int64_t us = 0;
+    if (k % SYNC_EVERY == 0) us += SYNC_PERSIST_US;
+    if (k % SOC_EVERY == 0) us += SOC_PERSIST_US;
+    if (k % ERASE_EVERY == 0) us += PRE_ERASE_US;
+    return us;
+}
+
+static int64_t tick_ceil(int64_t us)
+{
+    return (us + TICK_US - 1) / TICK_US * TICK_US;
+}
+
+typedef struct {
+    uint32_t samples;
+    int64_t last_us;
+    lat_hist_t late;
+} run_t;
+
+// Old sender: next = wake-up tick + period; idle work or a pump chunk in
+// progress when the wait ran out made the wake-up late.
+static void old_schedule(run_t *r, int64_t start_us, int64_t span_us, uint32_t period_ms,
+                         bool pumping)
+{
+    const int64_t period_us = (int64_t)period_ms * 1000;
+    int64_t due = start_us;
+    memset(r, 0, sizeof(*r));
+
+    while (due < start_us + span_us) {
+        int64_t wake = due;
+        if (pumping) {
+            int64_t phase = rnd(PUMP_POLL_US);
+            if (phase < PUMP_CHUNK_US) wake += PUMP_CHUNK_US - phase;
+        }
+        wake = tick_ceil(wake + idle_work_us(r->samples));
+        lat_hist_add(&r->late, (uint32_t)(wake - due));
+        r->samples++;
+        r->last_us = wake;
+        due = wake + period_us;
+    }
+}
+
+// Sampling clock: wake-ups from the timer, lateness from the dispatch and
+// from a pump read in flight. Returns false if a slot was off the grid.
+static bool clock_schedule(run_t *r, int64_t *now_us, int64_t span_us, bool pumping)
+{
+    const int64_t end = *now_us + span_us;
+    sample_clock_stats_t before, after;
+    sample_clock_get_stats(&before);
+    uint32_t period_ms = before.period_ms;
+    int64_t anchor = -1;
+    bool ok = true;
+    memset(r, 0, sizeof(*r));
+
+    for (;;) {
+        int64_t due = sample_clock_next_due(*now_us);
+        if (due >= end) break;
+        int64_t wake = due + DISPATCH_MIN_US + rnd(DISPATCH_MAX_US - DISPATCH_MIN_US);
+        if (pumping && rnd(PUMP_POLL_US) < PUMP_CHUNK_US) wake += rnd(FLASH_READ_US);
+
+        int64_t slot = sample_clock_take(wake);
+        sample_clock_set_period(period_ms);
+        if (anchor < 0) anchor = slot;
+        if ((slot - anchor) % ((int64_t)period_ms * 1000) != 0) ok = false;
+
+        lat_hist_add(&r->late, (uint32_t)(wake - slot));
+        r->samples++;
+        r->last_us = wake;
+        *now_us = wake + STORE_US + idle_work_us(r->samples);
+    }
+    sample_clock_get_stats(&after);
+    if (after.samples - before.samples != r->samples || after.missed != before.missed) ok = false;
+    *now_us = end;
+    return ok;
+}
+
+static void report(const char *label, const run_t *r, int64_t span_us, uint32_t period_ms)
+{
+    const double expect = (double)span_us / (period_ms * 1000.0);
+    const double drift_s = (expect - r->samples) * period_ms / 1000.0;
+    printf("%-24s %7" PRIu32 " samples (grid %7.0f)  behind %7.1f s  avg late %6.0f us  max %6" PRIu32
+           " us\n",
+           label, r->samples, expect, drift_s,
+           r->late.n ? (double)r->late.sum_us / r->late.n : 0.0, r->late.max_us);
+}
+
+static void report_hist(const run_t *r)
+{
+    char line[256];
+    lat_hist_format(&r->late, line, sizeof(line));
+    printf("    %s\n", line);
+}
+
+int main(void)
+{
+    int fail = 0;
+    run_t old, clk;
+    int64_t now = 1000000;
+
+    sample_clock_init();
+
+    printf("24 h at %d ms, idle work before the wait (modelled)\n", SAMPLER_PERIOD_NORMAL_MS);
+    old_schedule(&old, now, DAY_US, SAMPLER_PERIOD_NORMAL_MS, false);
+    report("  relative schedule", &old, DAY_US, SAMPLER_PERIOD_NORMAL_MS);
+    report_hist(&old);
+    sample_clock_set_period(SAMPLER_PERIOD_NORMAL_MS);
+    if (!clock_schedule(&clk, &now, DAY_US, false)) {
+        printf("FAIL: clock off its grid at %d ms\n", SAMPLER_PERIOD_NORMAL_MS);
+        fail = 1;
+    }
+    report("  sampling clock", &clk, DAY_US, SAMPLER_PERIOD_NORMAL_MS);
+    report_hist(&clk);
+    if (clk.samples != DAY_US / (SAMPLER_PERIOD_NORMAL_MS * 1000)) {
+        printf("FAIL: %" PRIu32 " samples in 24 h\n", clk.samples);
+        fail = 1;
+    }
+
+    printf("\n1 h at %d ms with a backlog pump running (modelled)\n", SAMPLER_PERIOD_FAST_MS);
+    old_schedule(&old, now, HOUR_US, SAMPLER_PERIOD_FAST_MS, true);
+    report("  relative schedule", &old, HOUR_US, SAMPLER_PERIOD_FAST_MS);
+    report_hist(&old);
+    // The first FAST slot is a FAST period after the last NORMAL one.
+    sample_clock_set_period(SAMPLER_PERIOD_FAST_MS);
+    now = sample_clock_next_due(now);
+    if (!clock_schedule(&clk, &now, HOUR_US, true)) {
+        printf("FAIL: clock off its grid at %d ms\n", SAMPLER_PERIOD_FAST_MS);
+        fail = 1;
+    }
+    report("  sampling clock", &clk, HOUR_US, SAMPLER_PERIOD_FAST_MS);
+    report_hist(&clk);
+
+    // A 3.5 s stall at 1 s: three slots missed, the fourth taken 0.5 s late,
+    // and the grid kept. Then REST: the next slot is 60 s after that one.
+    sample_clock_stats_t st0, st1;
+    sample_clock_get_stats(&st0);
+    int64_t due = sample_clock_next_due(now);
+    int64_t slot = sample_clock_take(due + 3500000);
+    sample_clock_get_stats(&st1);
+    bool stall_ok = st1.missed - st0.missed == 3 && slot == due + 3000000 &&
+                    sample_clock_next_due(0) == slot + SAMPLER_PERIOD_FAST_MS * 1000;
+    sample_clock_set_period(SAMPLER_PERIOD_REST_MS);
+    stall_ok = stall_ok && sample_clock_next_due(0) == slot + SAMPLER_PERIOD_REST_MS * 1000LL;
+    int64_t rest_slot = sample_clock_take(slot + SAMPLER_PERIOD_REST_MS * 1000LL + 40);
+    stall_ok = stall_ok && rest_slot == slot + SAMPLER_PERIOD_REST_MS * 1000LL;
+
+    sample_clock_stats_t st;
+    sample_clock_get_stats(&st);
+    printf("\nstall 3.5 s at %d ms, then %d ms: missed %" PRIu32 ", late %" PRIu32 " us, next slot %s\n",
+           SAMPLER_PERIOD_FAST_MS, SAMPLER_PERIOD_REST_MS, st1.missed - st0.missed,
+           st1.late.max_us, stall_ok ? "on the grid" : "OFF THE GRID");
+    if (!stall_ok) fail = 1;
+
+    char line[256];
+    lat_hist_format(&st.late, line, sizeof(line));
+    printf("\nclock stats: period_ms=%" PRIu32 ",samples=%" PRIu32 ",missed=%" PRIu32 ",%s\n",
+           st.period_ms, st.samples, st.missed, line);
+
+    printf("\n%s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
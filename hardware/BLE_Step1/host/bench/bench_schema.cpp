@@ -0,0 +1,190 @@
+// Record schema (main/log_schema.h) checks and costs.
+//
+// Round-trips records through log_record_encode / log_record_decode, reads
+// them through the zero-copy RecordView against plain struct copies, and
+// parses the advertised field table: this build's, and a table for a
+// layout with the fields in reverse order, whose records are then decoded
+// by Schema::decode_column and compared with the originals. That is what a
+// client does with records of a version it was not built for. Exits 1 on
+// any mismatch.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "record_view.hpp"
+
+namespace {
+
+constexpr size_t kRecords = 1000 * 1000;
+
+void report_mb(const char *label, size_t bytes, uint64_t wall_ns)
+{
+    std::printf("%-28s %8.1f ms  %8.0f MB/s\n", label, wall_ns / 1e6,
+                wall_ns ? (double)bytes * 1e3 / (double)wall_ns : 0.0);
+}
+
+bool check(bool ok, const char *what)
+{
+    std::printf("  %-40s %s\n", what, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+void make_rec(battery_log_t &r, size_t i)
+{
+    uint32_t x = (uint32_t)(i * 2654435761u);
+    std::memset(&r, 0, sizeof(r));
+    r.seq = (uint32_t)i + 1;
+    r.timestamp_s = 1700000000u + (uint32_t)i * 5;
+    for (int c = 0; c < 16; c++) r.cell_mv[c] = (uint16_t)(3300 + (x >> c) % 900);
+    r.pack_total_mv = (uint16_t)(52000 + x % 7000);
+    r.pack_ld_mv = (uint16_t)(r.pack_total_mv - 40);
+    r.pack_sum_active_mv = r.pack_total_mv;
+    r.current_ma = (int16_t)((int)(x % 40000) - 20000);
+    r.temp_ts1_c_x100 = (int16_t)((int)(x % 6000) - 1000);
+    r.temp_int_c_x100 = (int16_t)(2500 + x % 1000);
+    r.soc = (uint8_t)(x % 101);
+    r.interval_s = i ? 5 : 0;
+    r.rate = (uint8_t)(x % 3);
+}
+
+// The fields of `s` packed in reverse order, as another firmware might.
+fw::Schema reversed(const fw::Schema &s)
+{
+    fw::Schema out = s;
+    out.record_version = s.record_version + 1;
+    uint8_t off = 0;
+    for (size_t k = s.fields.size(); k-- > 0;) {
+        fw::SchemaField &f = out.fields[k];
+        f.offset = off;
+        off = (uint8_t)(off + f.size() * f.count);
+    }
+    return out;
+}
+
+std::vector<uint8_t> table_bytes(const fw::Schema &s)
+{
+    std::vector<uint8_t> t = { LOG_SCHEMA_TABLE_VERSION, (uint8_t)s.record_version,
+                               (uint8_t)s.record_size, (uint8_t)(s.record_size >> 8),
+                               (uint8_t)s.fields.size() };
+    for (const fw::SchemaField &f : s.fields) {
+        t.insert(t.end(), { f.code, f.count, f.offset, (uint8_t)f.exp10 });
+        t.insert(t.end(), f.name.begin(), f.name.end());
+        t.push_back(0);
+        t.insert(t.end(), f.unit.begin(), f.unit.end());
+        t.push_back(0);
+    }
+    return t;
+}
+
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    const size_t bytes = kRecords * LOG_RECORD_SIZE_BYTES;
+
+    std::vector<battery_log_t> recs(kRecords);
+    for (size_t i = 0; i < kRecords; i++) make_rec(recs[i], i);
+
+    // Encode / decode.
+    std::vector<uint8_t> wire(bytes);
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < kRecords; i++) log_record_encode(&recs[i], &wire[i * LOG_RECORD_SIZE_BYTES]);
+    report_mb("log_record_encode", bytes, bench_now_ns() - t0);
+
+    std::vector<battery_log_t> back(kRecords);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < kRecords; i++) log_record_decode(&wire[i * LOG_RECORD_SIZE_BYTES], &back[i]);
+    report_mb("log_record_decode", bytes, bench_now_ns() - t0);
+
+    // Zero-copy view vs. copying each record out.
+    t0 = bench_now_ns();
+    uint64_t sum_copy = 0;
+    for (size_t i = 0; i < kRecords; i++) {
+        battery_log_t r;
+        std::memcpy(&r, &wire[i * LOG_RECORD_SIZE_BYTES], sizeof(r));
+        for (int c = 0; c < 16; c++) sum_copy += r.cell_mv[c];
+        sum_copy += (uint32_t)r.current_ma;
+    }
+    report_mb("struct copy + cell sum", bytes, bench_now_ns() - t0);
+
+    t0 = bench_now_ns();
+    uint64_t sum_view = 0;
+    bool view_ok = true;
+    for (fw::RecordView v : fw::RecordSpan(wire.data(), wire.size())) {
+        for (int c = 0; c < 16; c++) sum_view += v.cell_mv(c);
+        sum_view += (uint32_t)v.current_ma();
+    }
+    report_mb("RecordView + cell sum", bytes, bench_now_ns() - t0);
+    fw::RecordSpan span(wire.data(), wire.size());
+    for (size_t i = 0; i < kRecords && view_ok; i += 997) {
+        battery_log_t r = span[i].decode();
+        view_ok = std::memcmp(&r, &recs[i], sizeof(r)) == 0 && span[i].soc() == recs[i].soc;
+    }
+
+    std::printf("\n");
+    ok &= check(std::memcmp(wire.data(), recs.data(), bytes) == 0, "encode == little-endian struct");
+    ok &= check(std::memcmp(back.data(), recs.data(), bytes) == 0, "decode(encode(r)) == r");
+    ok &= check(sum_copy == sum_view && view_ok, "RecordView == struct");
+
+    // This build's advertised table.
+    uint8_t table[LOG_SCHEMA_TABLE_MAX];
+    int tlen = log_schema_table(table, sizeof(table));
+    fw::Schema local;
+    std::string err;
+    bool parsed = tlen > 0 && local.parse(table, (size_t)tlen, &err);
+    if (!parsed) std::printf("  parse: %s\n", err.c_str());
+    bool layout = parsed && local.record_version == LOG_RECORD_VERSION &&
+                  local.record_size == LOG_RECORD_SIZE_BYTES && local.fields.size() == LOG_SCHEMA_FIELDS;
+#define LOG_X_CHECK(t, name, n, e, u)                                                   \
+    {                                                                                   \
+        const fw::SchemaField *f = parsed ? local.find(#name) : nullptr;                \
+        layout = layout && f && f->offset == offsetof(battery_log_t, name) &&           \
+                 f->count == (n) && f->code == LOG_TCODE_##t && f->exp10 == (e);        \
+    }
+    LOG_RECORD_FIELDS(LOG_X_CHECK)
+#undef LOG_X_CHECK
+    std::printf("  field table: %d bytes (characteristic limit %d)\n", tlen, LOG_SCHEMA_TABLE_MAX);
+    ok &= check(layout, "table == battery_log_t");
+    fw::Schema scratch;
+    ok &= check(!scratch.parse(table, (size_t)tlen - 3, &err), "truncated table rejected");
+
+    // Another layout, known only from its table.
+    fw::Schema other_w = reversed(local);
+    std::vector<uint8_t> other_table = table_bytes(other_w);
+    fw::Schema other;
+    ok &= check(other.parse(other_table.data(), other_table.size(), &err), "reversed-layout table parsed");
+
+    std::vector<uint8_t> other_recs(bytes);
+    for (size_t r = 0; r < kRecords; r++) {
+        for (size_t k = 0; k < local.fields.size(); k++) {
+            const fw::SchemaField &a = local.fields[k], &b = other_w.fields[k];
+            std::memcpy(&other_recs[r * other.record_size + b.offset], &wire[r * LOG_RECORD_SIZE_BYTES + a.offset],
+                        a.size() * a.count);
+        }
+    }
+
+    std::vector<int64_t> col(kRecords);
+    bool other_ok = true;
+    size_t values = 0;
+    t0 = bench_now_ns();
+    for (const fw::SchemaField &f : other.fields) {
+        const fw::SchemaField *mine = local.find(f.name);
+        for (size_t i = 0; i < f.count && mine; i++) {
+            other.decode_column(other_recs.data(), kRecords, f, i, col.data());
+            for (size_t r = 0; r < kRecords && other_ok; r += 101) {
+                other_ok = col[r] == fw::Schema::raw(&wire[r * LOG_RECORD_SIZE_BYTES], *mine, i);
+            }
+            values += kRecords;
+        }
+        other_ok = other_ok && mine;
+    }
+    report_mb("Schema::decode_column", bytes, bench_now_ns() - t0);
+    ok &= check(other_ok && values == kRecords * LOG_SCHEMA_VALUES, "reversed layout decodes to the same values");
+
+    std::printf("  %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
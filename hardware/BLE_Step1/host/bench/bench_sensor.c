@@ -0,0 +1,104 @@
+/*
+ * Acquisition cost per snapshot for the host-runnable sensor backends.
+ *
+ * Records a capture from the mock backend, writes it as CSV and as raw
+ * battery_log_t records, then replays both through sensor_read() and checks
+ * the replayed values match the capture.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "esp_random.h"
+#include "sensor_backend.h"
+#include "ble_stats.h"
+
+#define N_RECORDS 20000
+
+static battery_log_t s_capture[N_RECORDS];
+
+static void write_csv(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+
+    fputs("timestamp_s", f);
+    for (int c = 1; c <= 16; c++) fprintf(f, ",cell%d_mv", c);
+    fputs(",pack_total_mv,pack_ld_mv,pack_sum_active_mv,current_ma,"
+          "temp_ts1_c_x100,temp_int_c_x100,soc\n", f);
+
+    for (int i = 0; i < N_RECORDS; i++) {
+        const battery_log_t *r = &s_capture[i];
+        fprintf(f, "%u", (unsigned)r->timestamp_s);
+        for (int c = 0; c < 16; c++) fprintf(f, ",%u", r->cell_mv[c]);
+        fprintf(f, ",%u,%u,%u,%d,%d,%d,%u\n", r->pack_total_mv, r->pack_ld_mv,
+                r->pack_sum_active_mv, r->current_ma, r->temp_ts1_c_x100,
+                r->temp_int_c_x100, r->soc);
+    }
+    fclose(f);
+}
+
+static void write_bin(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); exit(1); }
+    fwrite(s_capture, sizeof(s_capture[0]), N_RECORDS, f);
+    fclose(f);
+}
+
+static int same_measurement(const battery_log_t *a, const battery_log_t *b)
+{
+    return a->timestamp_s == b->timestamp_s &&
+           memcmp(a->cell_mv, b->cell_mv, sizeof(a->cell_mv)) == 0 &&
+           a->pack_total_mv == b->pack_total_mv && a->pack_ld_mv == b->pack_ld_mv &&
+           a->current_ma == b->current_ma && a->temp_ts1_c_x100 == b->temp_ts1_c_x100 &&
+           a->temp_int_c_x100 == b->temp_int_c_x100 && a->soc == b->soc;
+}
+
+static void run(const char *label, const sensor_backend_t *be, int verify)
+{
+    if (sensor_init(be) != ESP_OK) {
+        fprintf(stderr, "%s: init failed\n", label);
+        exit(1);
+    }
+
+    battery_log_t r;
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (int i = 0; i < N_RECORDS; i++) {
+        if (sensor_read(&r) != ESP_OK) {
+            fprintf(stderr, "%s: read %d failed\n", label, i);
+            exit(1);
+        }
+        if (verify && !same_measurement(&r, &s_capture[i])) {
+            fprintf(stderr, "%s: record %d differs from capture\n", label, i);
+            exit(1);
+        }
+    }
+    bench_report(label, N_RECORDS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_sensor"));
+    esp_random_shim_seed(1);
+
+    sensor_init(&sensor_backend_mock);
+    for (int i = 0; i < N_RECORDS; i++) {
+        sensor_read(&s_capture[i]);
+        s_capture[i].timestamp_s = (uint32_t)i * 5;   // mock clock is wall time
+    }
+    write_csv("capture.csv");
+    write_bin("capture.bin");
+
+    run("mock", &sensor_backend_mock, 0);
+
+    sensor_replay_set_source("capture.csv", false);
+    run("replay csv", &sensor_backend_replay, 1);
+
+    sensor_replay_set_source("capture.bin", false);
+    run("replay bin", &sensor_backend_replay, 1);
+
+    ble_stats_log_all();
+    return 0;
+}
@@ -0,0 +1,386 @@
+/*
+ * Wired log dump: the firmware's serial_dump (main/serial_dump.c, real
+ * code on the UART shim) to dumprecv's client (lib/dump_client) over ptys.
+ *
+ * The device's UART is the master of one pty pair, the host's serial port
+ * the slave of another; a wire thread in each direction joins them. Going
+ * to the host it can hold bytes to the line rate of the baud the device is
+ * at (baud / 10 bytes per second), flip bits, and drop a burst.
+ *
+ * Scenarios: a whole log unpaced (CPU per record); 921600 and 2000000 baud
+ * paced (how much of the line carries records); bit errors and a lost burst
+ * (resume from the last good record); a dump cut short and continued in a
+ * second session after the log grew; a paced dump while the main thread
+ * keeps appending, as mock_sender does. The host's copy is compared with
+ * the log byte for byte each time.
+ *
+ * Exits 1 if a record is missing, duplicated or altered, or records get
+ * less than 90% of a paced line.
+ */
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "driver/uart.h"
+#include "freertos/task.h"
+#include "dump_client.hpp"
+#include "serial_dump.h"
+
+#define RECORDS         30000
+#define MORE_RECORDS    2000
+#define PACED_RECORDS   3000
+#define CUT_AT          10000
+#define LIVE_RECORDS    3000        // behind when the dump starts, then 1 per ms
+#define CONSOLE_BAUD    115200
+#define MIN_LINE_USE    0.90
+
+// mem_plan.c needs the IDF heap API; the dump task is not watched here.
+extern "C" void mem_plan_watch_task(TaskHandle_t task, uint32_t stack_bytes)
+{
+    (void)task;
+    (void)stack_bytes;
+}
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+int open_raw(const char *path)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    struct termios t;
+    if (fd < 0 || tcgetattr(fd, &t) != 0) return -1;
+    cfmakeraw(&t);
+    tcsetattr(fd, TCSANOW, &t);
+    return fd;
+}
+
+// Master fd; the slave's path in *slave.
+int open_pty(std::string *slave)
+{
+    int m = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m < 0 || grantpt(m) != 0 || unlockpt(m) != 0) {
+        perror("pty");
+        exit(1);
+    }
+    *slave = ptsname(m);
+    return m;
+}
+
+// 1 readable, 0 not within ms, -1 hung up.
+int wait_in(int fd, int ms)
+{
+    struct pollfd p = {fd, POLLIN, 0};
+    int rc = poll(&p, 1, ms);
+    if (rc <= 0) return 0;
+    return (p.revents & POLLIN) ? 1 : -1;
+}
+
+bool write_all(int fd, const uint8_t *p, size_t n)
+{
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Device UART <-> host port.
+struct Wire {
+    int dev = -1;                           // slave of the device's pty
+    int host = -1;                          // master of the host's pty
+    std::atomic<bool> stop{false};
+    std::atomic<bool> pace{false};
+    std::atomic<uint64_t> flip_every{0};    // device -> host, 0: never
+    std::atomic<uint64_t> drop_at{0};       // drop one chunk there, 0: never
+    std::atomic<uint64_t> down_bytes{0};
+    std::thread down, up;
+
+    void run_down()
+    {
+        uint8_t buf[256];
+        auto line_free = clock_type::now();
+        uint64_t pos = 0;
+        while (!stop) {
+            // Bytes already waiting were queued behind the previous chunk:
+            // they go on the line when it is free, not when this thread
+            // gets round to them.
+            bool queued = wait_in(dev, 0) > 0;
+            if (!queued && wait_in(dev, 20) <= 0) continue;
+            ssize_t n = read(dev, buf, sizeof(buf));
+            if (n <= 0) continue;
+            if (pace) {
+                uint32_t baud = CONSOLE_BAUD;
+                uart_get_baudrate(SERIAL_DUMP_UART, &baud);
+                auto now = clock_type::now();
+                bool behind = queued && now - line_free < std::chrono::milliseconds(5);
+                auto start = behind ? line_free : std::max(line_free, now);
+                line_free = start + std::chrono::nanoseconds((uint64_t)n * 10 * 1000000000ull / baud);
+                std::this_thread::sleep_until(line_free);
+            }
+            uint64_t end = pos + (uint64_t)n;
+            uint64_t every = flip_every, drop = drop_at;
+            if (every && pos / every != end / every) buf[end / every * every - pos] ^= 0x10;
+            bool dropped = drop && pos < drop && drop <= end;
+            pos = end;
+            if (dropped) continue;
+            if (!write_all(host, buf, (size_t)n)) return;
+            down_bytes += (uint64_t)n;
+        }
+    }
+
+    void run_up()
+    {
+        uint8_t buf[256];
+        while (!stop) {
+            if (wait_in(host, 20) <= 0) continue;
+            ssize_t n = read(host, buf, sizeof(buf));
+            if (n > 0 && !write_all(dev, buf, (size_t)n)) return;
+        }
+    }
+};
+
+std::vector<uint8_t> log_image()
+{
+    std::vector<uint8_t> out((size_t)battery_log_count() * LOG_RECORD_SIZE_BYTES);
+    for (int i = 0; i < battery_log_count(); i++) {
+        battery_log_t r;
+        battery_log_read(i, &r);
+        log_record_encode(&r, &out[(size_t)i * LOG_RECORD_SIZE_BYTES]);
+    }
+    return out;
+}
+
+uint32_t s_ts = 1700000000u;
+
+void append_records(int n)
+{
+    for (int i = 0; i < n; i++) {
+        battery_log_t r;
+        std::memset(&r, 0, sizeof(r));
+        r.timestamp_s = s_ts;
+        r.interval_s = 5;
+        r.soc = 80;
+        for (int c = 0; c < 16; c++) r.cell_mv[c] = (uint16_t)(3300 + (s_ts / 5 + c * 7) % 97);
+        r.pack_total_mv = 52800;
+        r.current_ma = (int32_t)(s_ts % 4000) - 2000;
+        s_ts += 5;
+        r.seq = battery_log_next_seq();
+        battery_log_append(&r);
+    }
+}
+
+struct Pull {
+    bool ok = false;
+    uint32_t next = 0;
+    double secs = 0;
+    uint64_t cpu_ns = 0;
+    uint64_t line_bytes = 0;    // device -> host during the pull
+    fw::DumpStats st;
+    std::string err;
+};
+
+// One session: HELLO at `baud`, READ from `from` (max records, 0: all), BYE.
+Pull session(const std::string &port_path, Wire &w, uint32_t baud, uint32_t from, uint32_t max,
+             std::vector<uint8_t> *got)
+{
+    Pull r;
+    fw::SerialPort port;
+    if (!port.open(port_path, CONSOLE_BAUD, &r.err)) return r;
+    fw::DumpClient client(port);
+    if (!client.hello(baud, &r.err)) return r;
+
+    uint64_t line0 = w.down_bytes;
+    uint64_t cpu0 = bench_cpu_ns();
+    auto t0 = clock_type::now();
+    r.ok = client.pull(from, max, [&](const uint8_t *recs, size_t n) {
+        got->insert(got->end(), recs, recs + n * LOG_RECORD_SIZE_BYTES);
+        return true;
+    }, &r.next, &r.err);
+    r.secs = std::chrono::duration<double>(clock_type::now() - t0).count();
+    r.cpu_ns = bench_cpu_ns() - cpu0;
+    r.line_bytes = w.down_bytes - line0;
+    r.st = client.stats();
+    client.bye(CONSOLE_BAUD);
+    // BYE out and taken before the next session says HELLO at the console baud.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return r;
+}
+
+bool same(const char *label, const std::vector<uint8_t> &got, const uint8_t *want, size_t want_len)
+{
+    if (got.size() == want_len && !std::memcmp(got.data(), want, want_len)) return true;
+    size_t i = 0;
+    while (i < got.size() && i < want_len && got[i] == want[i]) i++;
+    std::printf("FAIL %s: got %zu bytes, want %zu, first difference at record %zu\n", label,
+                got.size(), want_len, i / LOG_RECORD_SIZE_BYTES);
+    return false;
+}
+
+// Record bytes over what the line carries in the time (baud / 10 bytes/s):
+// framing, requests and round trips all count against it.
+double line_use(const Pull &p, uint32_t baud)
+{
+    return p.secs > 0 ? (double)p.st.records * LOG_RECORD_SIZE_BYTES * 10.0 / (baud * p.secs) : 0.0;
+}
+
+void report(const char *label, const Pull &p, uint32_t baud)
+{
+    std::printf("%-26s %6" PRIu64 " records %6.2f s %8.0f rec/s %7.1f KB/s", label, p.st.records,
+                p.secs, p.secs > 0 ? p.st.records / p.secs : 0.0,
+                p.secs > 0 ? p.line_bytes / 1e3 / p.secs : 0.0);
+    if (baud) std::printf("  records %5.1f%% of the line", 100.0 * line_use(p, baud));
+    else std::printf("  %6.0f ns cpu/rec", p.st.records ? (double)p.cpu_ns / p.st.records : 0.0);
+    std::printf("\n    frames=%" PRIu64 " bad=%" PRIu64 " lost=%" PRIu64 " resumes=%" PRIu64
+                " stale=%" PRIu64 " timeouts=%" PRIu64 "%s%s\n",
+                p.st.frames, p.st.bad_frames, p.st.lost_frames, p.st.resumes, p.st.stale,
+                p.st.timeouts, p.ok ? "" : "  error: ", p.ok ? "" : p.err.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    int fail = 0;
+    bench_enter_scratch_dir("bench_serial_dump");
+    battery_log_lock_init();
+    battery_log_init();
+    battery_log_seq_init();
+    append_records(RECORDS);
+
+    std::string dev_slave, host_slave;
+    int dev_master = open_pty(&dev_slave);
+    int host_master = open_pty(&host_slave);
+    Wire w;
+    w.dev = open_raw(dev_slave.c_str());
+    w.host = host_master;
+    // Held open so the host port can close between sessions without a hang-up.
+    int host_hold = open_raw(host_slave.c_str());
+    if (w.dev < 0 || host_hold < 0) {
+        perror("pty slave");
+        return 1;
+    }
+
+    uart_shim_attach(SERIAL_DUMP_UART, dev_master);
+    serial_dump_init();
+    std::thread device(serial_dump_run);
+    w.down = std::thread(&Wire::run_down, &w);
+    w.up = std::thread(&Wire::run_up, &w);
+
+    std::vector<uint8_t> want = log_image();
+    std::printf("log: %d records (%zu bytes), %d per frame, device UART on %s\n\n",
+                battery_log_count(), want.size(), SERIAL_DUMP_RECS_PER_FRAME, dev_slave.c_str());
+
+    // Whole log, as fast as the ptys go: the protocol's own cost.
+    std::vector<uint8_t> got;
+    Pull p = session(host_slave, w, SERIAL_DUMP_BAUD, 0, 0, &got);
+    report("unpaced", p, 0);
+    if (!p.ok || !same("unpaced", got, want.data(), want.size())) fail = 1;
+
+    // At the line rate.
+    w.pace = true;
+    for (uint32_t baud : {921600u, 2000000u}) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "paced %" PRIu32, baud);
+        got.clear();
+        p = session(host_slave, w, baud, 0, PACED_RECORDS, &got);
+        report(label, p, baud);
+        double use = line_use(p, baud);
+        if (!p.ok || !same(label, got, want.data(), (size_t)PACED_RECORDS * LOG_RECORD_SIZE_BYTES)) {
+            fail = 1;
+        } else if (use < MIN_LINE_USE) {
+            std::printf("FAIL %s: %.0f%% of the line, want >= %.0f%%\n", label, 100 * use,
+                        100 * MIN_LINE_USE);
+            fail = 1;
+        }
+    }
+    w.pace = false;
+
+    // A flipped bit every 64 KB and a lost burst: resumed, nothing twice.
+    got.clear();
+    w.flip_every = 64 * 1024;
+    w.drop_at = w.down_bytes + 700 * 1000;
+    p = session(host_slave, w, SERIAL_DUMP_BAUD, 0, 0, &got);
+    w.flip_every = 0;
+    w.drop_at = 0;
+    report("bit errors + lost burst", p, 0);
+    if (!p.ok || !same("bit errors", got, want.data(), want.size())) fail = 1;
+    if (p.st.bad_frames == 0 || p.st.resumes == 0) {
+        std::printf("FAIL bit errors: nothing was caught (bad=%" PRIu64 ")\n", p.st.bad_frames);
+        fail = 1;
+    }
+
+    // Cut short, the log grows, the next session continues where it stopped.
+    got.clear();
+    p = session(host_slave, w, SERIAL_DUMP_BAUD, 0, CUT_AT, &got);
+    report("first session, cut", p, 0);
+    bool cut_ok = p.ok && got.size() == (size_t)CUT_AT * LOG_RECORD_SIZE_BYTES;
+    append_records(MORE_RECORDS);
+    want = log_image();
+    Pull p2 = session(host_slave, w, SERIAL_DUMP_BAUD, p.next, 0, &got);
+    report("second session", p2, 0);
+    if (!cut_ok || !p2.ok || !same("resume", got, want.data(), want.size())) fail = 1;
+
+    // The log grows while a paced dump streams it: the dump follows the
+    // appends until it catches up, and a last session takes the rest.
+    append_records(LIVE_RECORDS);
+    w.pace = true;
+    std::atomic<bool> pulled{false};
+    Pull p3;
+    std::thread pull([&] {
+        p3 = session(host_slave, w, 921600, p2.next, 0, &got);
+        pulled = true;
+    });
+    int during = 0;
+    while (!pulled) {
+        append_records(1);
+        during++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    pull.join();
+    w.pace = false;
+    report("appends during a dump", p3, 921600);
+    Pull p4 = session(host_slave, w, SERIAL_DUMP_BAUD, p3.next, 0, &got);
+    report("after the appends", p4, 0);
+    std::printf("    %d records appended while the dump ran\n", during);
+    want = log_image();
+    if (!p3.ok || !p4.ok || !same("appends during a dump", got, want.data(), want.size())) fail = 1;
+
+    w.stop = true;
+    w.down.join();
+    w.up.join();
+    close(w.dev);               // the device's UART hangs up: serial_dump_run() returns
+    device.join();
+    close(host_hold);
+    close(host_master);
+    close(dev_master);
+
+    serial_dump_stats_t st;
+    serial_dump_get_stats(&st);
+    std::printf("\ndevice: sessions=%" PRIu32 " reads=%" PRIu32 " records=%" PRIu32 " frames=%" PRIu32
+                " bytes=%" PRIu32 " bad=%" PRIu32 " idle=%" PRIu32 " baud=%" PRIu32 "\n",
+                st.sessions, st.reads, st.records, st.frames, st.bytes, st.bad_frames,
+                st.idle_timeouts, st.baud);
+    if (st.baud != CONSOLE_BAUD) {
+        std::printf("FAIL: device left at %" PRIu32 " baud after BYE\n", st.baud);
+        fail = 1;
+    }
+
+    std::printf("\n%s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
@@ -0,0 +1,237 @@
+/*
+ * SOC/SOH estimator replay harness.
+ *
+ * Synthetic run: a pack with 90 % of the nominal capacity, OCV from the
+ * estimator's table plus IR drop and a relaxing polarisation voltage, and
+ * a current sensor with gain and offset error, cycled through discharges,
+ * rests and charges for months of 5 s / 60 s samples. The estimator's raw
+ * SOC is compared with the true charge on every sample, with a reboot
+ * (checkpoint save + reload) half way. Exits 1 if the error or the final
+ * capacity estimate is outside the limits below.
+ *
+ *   bench_soc [battery.bin]    also replays a recorded log (timing from
+ *                              interval_s) and prints the SOC it produces
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "battery_log.h"
+#include "soc_est.h"
+#include "bench_common.h"
+
+#define N_SAMPLES       4000000
+#define CHUNK           (1 << 20)
+#define TRUE_CAP_MAH    (SOC_EST_CAPACITY_MAH * 9 / 10)
+#define LOAD_PERIOD_S   5
+#define REST_PERIOD_S   60
+#define GAIN_ERR        1.005           // measured / true current
+#define OFFSET_MA       8.0
+
+// Accuracy limits (0.01 % SOC), after the first OCV correction.
+#define MAX_AVG_ERR_BP  250
+#define MAX_ERR_BP      800
+#define MAX_CAP_ERR_PCT 3
+
+typedef struct {
+    double soc;             // true, 0..1 of TRUE_CAP_MAH
+    double i_ma;            // true current
+    double v_pol;           // polarisation, mV per cell
+    int phase;              // 0 discharge, 1 rest, 2 charge, 3 rest
+    double phase_left_s;
+    double target;
+    uint32_t rng;
+    int64_t t_us;
+} pack_t;
+
+static double urand(pack_t *p)
+{
+    p->rng = p->rng * 1664525u + 1013904223u;
+    return (p->rng >> 8) / 16777216.0;
+}
+
+static double ocv_mv(double soc)
+{
+    static const double t[11] = { 3300, 3550, 3640, 3690, 3730, 3770, 3830, 3910, 3990, 4080, 4190 };
+    double x = soc * 10.0;
+    int i = x <= 0 ? 0 : x >= 10 ? 9 : (int)x;
+    double f = x - i;
+    return t[i] + (t[i + 1] - t[i]) * f;
+}
+
+static void next_phase(pack_t *p)
+{
+    p->phase = (p->phase + 1) % 4;
+    switch (p->phase) {
+    case 0: p->i_ma = -(2000 + 4000 * urand(p)); p->target = 0.05 + 0.3 * urand(p); break;
+    case 2: p->i_ma = 3000 + 2000 * urand(p); p->target = 0.9 + 0.1 * urand(p); break;
+    default: p->i_ma = 0; p->phase_left_s = 1200 + 4800 * urand(p); break;
+    }
+}
+
+// Advance the pack one sample and fill the record the sensor would report.
+static void step(pack_t *p, battery_log_t *r)
+{
+    bool rest = p->phase == 1 || p->phase == 3;
+    double dt = rest ? REST_PERIOD_S : LOAD_PERIOD_S;
+
+    p->soc += p->i_ma * dt / 3600.0 / TRUE_CAP_MAH;
+    double tau = 300.0, rp_mv_per_a = 6.0;
+    p->v_pol += (p->i_ma / 1000.0 * rp_mv_per_a - p->v_pol) * (1.0 - exp(-dt / tau));
+    p->t_us += (int64_t)(dt * 1e6);
+
+    if (rest) {
+        p->phase_left_s -= dt;
+        if (p->phase_left_s <= 0) next_phase(p);
+    } else if ((p->phase == 0 && p->soc <= p->target) || (p->phase == 2 && p->soc >= p->target)) {
+        next_phase(p);
+    }
+
+    memset(r, 0, sizeof(*r));
+    double v = ocv_mv(p->soc) + p->i_ma / 1000.0 * 2.0 + p->v_pol;
+    for (int c = 0; c < 16; c++) {
+        r->cell_mv[c] = (uint16_t)lround(v + (urand(p) - 0.5) * 4.0);
+    }
+    r->current_ma = (int16_t)lround(p->i_ma * GAIN_ERR + OFFSET_MA + (urand(p) - 0.5) * 20.0);
+    r->temp_ts1_c_x100 = 2500;
+    r->timestamp_s = (uint32_t)(p->t_us / 1000000);
+}
+
+static int synthetic(void)
+{
+    static battery_log_t recs[CHUNK];
+    static int64_t t_us[CHUNK];
+    static int16_t truth_bp[CHUNK];
+
+    pack_t p = { .soc = 0.8, .phase = 3, .phase_left_s = 10, .rng = 42 };
+    soc_est_reset();
+    soc_est_init();
+
+    uint64_t cpu_ns = 0, wall_ns = 0, n_err = 0, sum_err = 0;
+    int max_err = 0;
+    int done = 0;
+    bool rebooted = false;
+
+    while (done < N_SAMPLES) {
+        int n = N_SAMPLES - done < CHUNK ? N_SAMPLES - done : CHUNK;
+        for (int i = 0; i < n; i++) {
+            step(&p, &recs[i]);
+            t_us[i] = p.t_us;
+            truth_bp[i] = (int16_t)lround(p.soc * 10000.0);
+        }
+
+        soc_est_state_t st;
+        for (int i = 0; i < n;) {
+            // Estimator only in the timed part; errors are checked per batch.
+            int m = n - i < 4096 ? n - i : 4096;
+            static uint16_t raw[4096];
+            uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+            for (int k = 0; k < m; k++) {
+                soc_est_update(&recs[i + k], t_us[i + k]);
+                soc_est_get(&st);
+                raw[k] = st.soc_raw_bp;
+            }
+            wall_ns += bench_now_ns() - w0;
+            cpu_ns += bench_cpu_ns() - c0;
+
+            if (st.ocv_fixes > 0) {
+                for (int k = 0; k < m; k++) {
+                    int e = abs((int)raw[k] - truth_bp[i + k]);
+                    sum_err += (uint64_t)e;
+                    n_err++;
+                    if (e > max_err) max_err = e;
+                }
+            }
+            i += m;
+        }
+        done += n;
+
+        if (!rebooted && done >= N_SAMPLES / 2) {
+            soc_est_persist();
+            soc_est_init();     // reboot: state comes back from the checkpoint
+            rebooted = true;
+        }
+    }
+
+    soc_est_state_t st;
+    soc_est_get(&st);
+    int cap_err_pct = abs((int)st.cap_mah - TRUE_CAP_MAH) * 100 / TRUE_CAP_MAH;
+    double avg = n_err ? (double)sum_err / n_err : 0.0;
+
+    bench_report("soc_est_update (+get)", (uint64_t)N_SAMPLES, wall_ns, cpu_ns);
+    printf("synthetic: %d samples over %.0f days, true capacity %d mAh\n",
+           N_SAMPLES, p.t_us / 86400e6, TRUE_CAP_MAH);
+    printf("  raw SOC error: avg %.1f bp, max %d bp (limits %d / %d)\n",
+           avg, max_err, MAX_AVG_ERR_BP, MAX_ERR_BP);
+    printf("  capacity %u mAh (soh %u permille), off by %d %% (limit %d), "
+           "%u OCV fixes and %u capacity updates since the reboot\n",
+           st.cap_mah, st.soh_permille, cap_err_pct, MAX_CAP_ERR_PCT,
+           (unsigned)st.ocv_fixes, (unsigned)st.cap_updates);
+
+    bool ok = avg <= MAX_AVG_ERR_BP && max_err <= MAX_ERR_BP && cap_err_pct <= MAX_CAP_ERR_PCT;
+    printf("  %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+static int replay(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    soc_est_reset();
+    soc_est_init();
+
+    battery_log_t r;
+    int64_t t_us = 0;
+    uint64_t n = 0, n_ref = 0, sum_diff = 0, cpu_ns = 0, wall_ns = 0;
+    int soc_min = 100, soc_max = 0, first = -1, last = -1;
+
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        // interval_s 0 marks the first sample after a boot: not integrated.
+        t_us += r.interval_s ? (int64_t)r.interval_s * 1000000
+                             : (int64_t)(SOC_EST_MAX_GAP_S + 1) * 1000000;
+        uint8_t recorded = r.soc;
+        uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+        int soc = soc_est_update(&r, t_us);
+        wall_ns += bench_now_ns() - w0;
+        cpu_ns += bench_cpu_ns() - c0;
+
+        if (first < 0) first = soc;
+        last = soc;
+        if (soc < soc_min) soc_min = soc;
+        if (soc > soc_max) soc_max = soc;
+        if (recorded) {
+            sum_diff += (uint64_t)abs(soc - recorded);
+            n_ref++;
+        }
+        n++;
+    }
+    fclose(f);
+
+    if (!n) {
+        fprintf(stderr, "%s: no records\n", path);
+        return 1;
+    }
+    soc_est_state_t st;
+    soc_est_get(&st);
+    bench_report("replay soc_est_update", n, wall_ns, cpu_ns);
+    printf("%s: %llu records, soc first %d last %d min %d max %d, %u OCV fixes, capacity %u mAh\n",
+           path, (unsigned long long)n, first, last, soc_min, soc_max,
+           (unsigned)st.ocv_fixes, st.cap_mah);
+    if (n_ref) {
+        printf("  vs. the soc stored in the records: avg |diff| %.1f %% over %llu records\n",
+               (double)sum_diff / n_ref, (unsigned long long)n_ref);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int rc = synthetic();
+    if (argc > 1 && replay(argv[1]) != 0) rc = 1;
+    return rc;
+}
@@ -0,0 +1,202 @@
+/*
+ * Trace recorder cost and dump round trip.
+ *
+ * Times trace_rec_event() and the task switch hook disarmed and armed,
+ * then battery_log_append / battery_log_read (which carry spans) with the
+ * recorder running and frozen: frozen, an event is one flag check, the
+ * closest the host gets to building without it. A mock run of switches
+ * between the firmware's tasks then fills the ring; the dump is read back
+ * in characteristic-sized pieces and checked against one whole read and
+ * against what was recorded, and written to trace.bin in the scratch
+ * directory for host/tools/trace2json. Last, a task is deleted and a new
+ * one reuses its TCB: it must get a slot of its own. Exits 1 if the dump
+ * does not match or a disarmed recorder records anything.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "battery_log.h"
+#include "trace_rec.h"
+
+#define N_EVENTS    2000000
+#define N_RECORDS   4000
+#define PIECE       236         // trace characteristic: 240 - 4-byte offset
+
+// In the order the mock run first switches to them (= dump task slots).
+static const char *const k_tasks[] = { "mock_sender", "notify_tx", "nimble_host", "IDLE0" };
+
+static void make_rec(battery_log_t *r, uint32_t seq)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq = seq;
+    r->timestamp_s = 1700000000u + seq * 5;
+    for (int c = 0; c < 16; c++) r->cell_mv[c] = (uint16_t)(3300 + (seq * 7 + (uint32_t)c) % 600);
+    r->interval_s = 5;
+}
+
+static double log_ops_ns(uint32_t *seq)
+{
+    battery_log_t r;
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < N_RECORDS; i++) {
+        make_rec(&r, (*seq)++);
+        battery_log_append(&r);
+        battery_log_read(i, &r);
+    }
+    return (double)(bench_now_ns() - t0) / N_RECORDS;
+}
+
+// Sample, notify, idle: the shape of a connected device's minute.
+static void mock_run(int rounds)
+{
+    battery_log_t r;
+    for (int i = 0; i < rounds; i++) {
+        trace_rec_task_in((void *)k_tasks[0]);
+        TRACE_BEGIN(TRACE_SPAN_SENSOR_READ);
+        make_rec(&r, battery_log_next_seq());
+        TRACE_END(TRACE_SPAN_SENSOR_READ);
+        battery_log_append(&r);
+
+        trace_rec_task_in((void *)k_tasks[1]);
+        TRACE_BEGIN_ARG(TRACE_SPAN_NOTIFY_TX, 1);
+        trace_rec_task_in((void *)k_tasks[2]);      // preempted by the host task
+        trace_rec_task_in((void *)k_tasks[1]);
+        TRACE_END(TRACE_SPAN_NOTIFY_TX);
+
+        if (i % 50 == 0) TRACE_MARK(TRACE_SPAN_BLE_CONNECT, i);
+        trace_rec_task_in((void *)k_tasks[3]);
+    }
+}
+
+static bool check_dump(uint8_t **out, size_t *out_len)
+{
+    size_t size = trace_rec_dump_size();
+    uint8_t *whole = malloc(size);
+    uint8_t *pieces = malloc(size + PIECE);
+    if (!whole || !pieces) exit(1);
+
+    size_t n = trace_rec_dump_read(0, whole, size);
+    size_t got = 0, step;
+    while ((step = trace_rec_dump_read((uint32_t)got, pieces + got, PIECE)) > 0) got += step;
+
+    trace_dump_hdr_t h;
+    memcpy(&h, whole, sizeof(h));
+    size_t names = (size_t)(h.n_tasks + h.n_spans) * h.name_len;
+    const trace_event_t *ev = (const trace_event_t *)(whole + sizeof(h) + names);
+
+    bool ok = n == size && got == size && memcmp(whole, pieces, size) == 0 &&
+              h.magic == TRACE_DUMP_MAGIC && h.n_events == TRACE_REC_EVENTS &&
+              h.n_tasks == sizeof(k_tasks) / sizeof(k_tasks[0]) && h.n_spans == TRACE_SPAN_COUNT &&
+              size == sizeof(h) + names + (size_t)h.n_events * sizeof(trace_event_t);
+    for (int i = 0; ok && i < h.n_tasks; i++) {
+        ok = strncmp((const char *)whole + sizeof(h) + (size_t)i * h.name_len, k_tasks[i], h.name_len) == 0;
+    }
+    // The mock run ends on the idle task.
+    ok = ok && (ev[h.n_events - 1].type & 0x7F) == TRACE_EV_TASK_IN && ev[h.n_events - 1].id == 3;
+
+    printf("dump: %zu bytes, %u events, %u lost, %u tasks, read in %d-byte pieces: %s\n", size,
+           (unsigned)h.n_events, (unsigned)h.lost, (unsigned)h.n_tasks, PIECE, ok ? "match" : "MISMATCH");
+    free(pieces);
+    *out = whole;
+    *out_len = size;
+    return ok;
+}
+
+// Events recorded so far (those in the ring plus those it overwrote).
+static uint32_t events_recorded(void)
+{
+    trace_dump_hdr_t h;
+    trace_rec_freeze(true);
+    size_t n = trace_rec_dump_read(0, (uint8_t *)&h, sizeof(h));
+    trace_rec_freeze(false);
+    return n == sizeof(h) ? h.n_events + h.lost : 0;
+}
+
+// The hook alone on a switch among the mock tasks (the lookup by TCB).
+static void time_hook(const char *label)
+{
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (int i = 0; i < N_EVENTS; i++) {
+        trace_rec_task_in((void *)k_tasks[i & 3]);
+    }
+    bench_report(label, N_EVENTS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+}
+
+// A deleted task's TCB reused by a new task: a new slot with the new name.
+static bool check_tcb_reuse(void)
+{
+    static char tcb[TRACE_NAME_LEN] = "worker_a";
+    trace_rec_task_in(tcb);
+    trace_rec_task_deleted(tcb);
+    strcpy(tcb, "worker_b");
+    trace_rec_task_in(tcb);
+    trace_rec_task_in(tcb);
+
+    trace_rec_freeze(true);
+    uint8_t buf[sizeof(trace_dump_hdr_t) + 8 * TRACE_NAME_LEN];
+    trace_rec_dump_read(0, buf, sizeof(buf));
+    trace_rec_freeze(false);
+    trace_dump_hdr_t h;
+    memcpy(&h, buf, sizeof(h));
+    const char *names = (const char *)buf + sizeof(h);
+    bool ok = h.n_tasks == 6 && strcmp(names + 4 * TRACE_NAME_LEN, "worker_a") == 0 &&
+              strcmp(names + 5 * TRACE_NAME_LEN, "worker_b") == 0;
+    printf("TCB reused after delete: %u tasks named: %s\n", (unsigned)h.n_tasks,
+           ok ? "new slot" : "WRONG");
+    return ok;
+}
+
+int main(void)
+{
+    printf("scratch: %s\n", bench_enter_scratch_dir("bench_trace"));
+    battery_log_lock_init();
+    battery_log_init();
+
+    // Disarmed (the default): nothing is recorded.
+    bool ok = true;
+    uint64_t w0 = bench_now_ns(), c0 = bench_cpu_ns();
+    for (int i = 0; i < N_EVENTS; i++) {
+        trace_rec_event(TRACE_EV_BEGIN, TRACE_SPAN_LOG_READ, 0);
+    }
+    bench_report("trace_rec_event, disarmed", N_EVENTS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+    time_hook("task switch hook, disarmed");
+    if (trace_rec_armed() || events_recorded() != 0) {
+        fprintf(stderr, "disarmed recorder recorded %u events\n", (unsigned)events_recorded());
+        ok = false;
+    }
+
+    trace_rec_arm(true);
+    w0 = bench_now_ns();
+    c0 = bench_cpu_ns();
+    for (int i = 0; i < N_EVENTS; i++) {
+        trace_rec_event(TRACE_EV_BEGIN, TRACE_SPAN_LOG_READ, 0);
+    }
+    bench_report("trace_rec_event", N_EVENTS, bench_now_ns() - w0, bench_cpu_ns() - c0);
+    time_hook("task switch hook");
+
+    uint32_t seq = 0;
+    log_ops_ns(&seq);                               // warm-up
+    trace_rec_freeze(true);
+    double off_ns = log_ops_ns(&seq);
+    trace_rec_freeze(false);
+    double on_ns = log_ops_ns(&seq);
+    printf("append + read: %.0f ns frozen, %.0f ns recording (%+.1f %%, 4 events)\n",
+           off_ns, on_ns, (on_ns / off_ns - 1.0) * 100.0);
+
+    mock_run(TRACE_REC_EVENTS);                     // more than the ring holds
+    trace_rec_freeze(true);
+    uint8_t *dump = NULL;
+    size_t len = 0;
+    ok = check_dump(&dump, &len) && ok;
+
+    FILE *f = fopen("trace.bin", "wb");
+    if (!f || fwrite(dump, 1, len, f) != len || fclose(f) != 0) ok = false;
+    free(dump);
+    trace_rec_freeze(false);
+    ok = check_tcb_reuse() && ok;
+
+    printf("  %s (host/tools/trace2json trace.bin trace.json)\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
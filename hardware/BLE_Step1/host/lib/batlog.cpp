@@ -0,0 +1,442 @@
+#include "batlog.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "records are little-endian and decoded with plain loads");
+
+namespace fw {
+
+// ---------------------------------------------------------------- MappedFile
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path, std::string *err)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (err) *err = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        if (err) *err = path + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    size_ = (size_t)st.st_size;
+    if (size_ > 0) {
+        void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            if (err) *err = path + ": mmap: " + std::strerror(errno);
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t *>(p);
+    }
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) munmap(const_cast<uint8_t *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// ------------------------------------------------------------- input format
+
+const char *format_name(InputFormat f)
+{
+    switch (f) {
+        case InputFormat::Raw: return "raw";
+        case InputFormat::Hex: return "hex";
+        default:               return "auto";
+    }
+}
+
+InputFormat detect_format(const uint8_t *data, size_t len)
+{
+    size_t probe = len < 4096 ? len : 4096;
+    if (probe == 0) return InputFormat::Raw;
+    for (size_t i = 0; i < probe; i++) {
+        uint8_t ch = data[i];
+        if (ch >= 0x80 || (ch < 0x20 && ch != '\n' && ch != '\r' && ch != '\t')) {
+            return InputFormat::Raw;
+        }
+    }
+    return InputFormat::Hex;
+}
+
+static int hex_val(uint8_t ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Keeps the last run of hex bytes on each line, so log prefixes such as
+// "Notification received from ..., value: (0x) " are dropped.
+HexParseResult parse_hex_capture(const uint8_t *text, size_t len)
+{
+    HexParseResult res;
+    res.bytes.reserve(len / 3);
+
+    uint8_t run[LOG_RECORD_SIZE_BYTES];
+    size_t run_len = 0;
+    bool overflow = false;
+    int hi = -1;
+    bool line_has_data = false;
+
+    auto end_line = [&]() {
+        if (line_has_data) {
+            res.lines++;
+            if (hi < 0 && !overflow && run_len == LOG_RECORD_SIZE_BYTES) {
+                res.bytes.insert(res.bytes.end(), run, run + run_len);
+                res.records++;
+            } else {
+                res.skipped++;
+            }
+        }
+        run_len = 0;
+        overflow = false;
+        hi = -1;
+        line_has_data = false;
+    };
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t ch = text[i];
+        if (ch == '\n') {
+            end_line();
+            continue;
+        }
+
+        int v = hex_val(ch);
+        if (v >= 0) {
+            line_has_data = true;
+            if (hi < 0) {
+                hi = v;
+            } else {
+                if (run_len < sizeof(run)) {
+                    run[run_len++] = (uint8_t)(hi << 4 | v);
+                } else {
+                    overflow = true;
+                }
+                hi = -1;
+            }
+        } else if (ch == '-' || ch == ' ' || ch == ':' || ch == ',' || ch == '\t' || ch == '\r') {
+            if (hi >= 0) {          // odd digit count: not a byte run
+                run_len = 0;
+                overflow = false;
+                hi = -1;
+            }
+        } else {
+            run_len = 0;
+            overflow = false;
+            hi = -1;
+        }
+    }
+    end_line();
+    return res;
+}
+
+// ------------------------------------------------------------------ decode
+
+template <typename T>
+static void resize_column(Column<T> &c, size_t n)
+{
+    c.resize(n);
+}
+
+template <typename T, size_t N>
+static void resize_column(std::array<Column<T>, N> &a, size_t n)
+{
+    for (auto &c : a) c.resize(n);
+}
+
+void Columns::resize(size_t n)
+{
+    size = n;
+#define FIELD(t, name, cnt, e, u) resize_column(name, n);
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+}
+
+template <typename T>
+static inline T load(const uint8_t *p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Copies one field of every record in [begin, end) into its column. With the
+// stride and offset known at compile time the inner loop is a plain strided
+// gather the compiler unrolls/vectorises.
+template <typename T, size_t Off>
+static inline void gather(const uint8_t *rec, size_t begin, size_t end, T *dst)
+{
+    for (size_t i = begin; i < end; i++) {
+        dst[i] = load<T>(rec + i * LOG_RECORD_SIZE_BYTES + Off);
+    }
+}
+
+template <typename T, size_t Off>
+static inline void gather_field(const uint8_t *rec, size_t begin, size_t end, Column<T> &out)
+{
+    gather<T, Off>(rec, begin, end, out.data());
+}
+
+template <typename T, size_t Off, size_t N, size_t... K>
+static inline void gather_elems(const uint8_t *rec, size_t begin, size_t end, std::array<Column<T>, N> &out,
+                                std::index_sequence<K...>)
+{
+    (gather<T, Off + K * sizeof(T)>(rec, begin, end, out[K].data()), ...);
+}
+
+template <typename T, size_t Off, size_t N>
+static inline void gather_field(const uint8_t *rec, size_t begin, size_t end, std::array<Column<T>, N> &out)
+{
+    gather_elems<T, Off>(rec, begin, end, out, std::make_index_sequence<N>{});
+}
+
+void decode_columns(const uint8_t *rec, size_t n, Columns &out)
+{
+    out.resize(n);
+
+    // Blocks keep the source records in L1/L2 while every column is filled
+    // from them (64 records = 3.5 KiB).
+    constexpr size_t kBlock = 64;
+    for (size_t b = 0; b < n; b += kBlock) {
+        size_t e = b + kBlock < n ? b + kBlock : n;
+#define FIELD(t, name, cnt, x, u) \
+        gather_field<LOG_CTYPE_##t, offsetof(battery_log_t, name)>(rec, b, e, out.name);
+        LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+    }
+}
+
+// ---------------------------------------------------------------- validate
+
+ValidationReport validate(const Columns &c, size_t max_issues)
+{
+    ValidationReport r;
+    r.records = c.size;
+    if (c.size == 0) return r;
+
+    r.first_seq = c.seq[0];
+    r.last_seq = c.seq[c.size - 1];
+
+    auto note = [&](size_t i, std::string what) {
+        if (r.issues.size() < max_issues) r.issues.push_back({i, std::move(what)});
+    };
+
+    for (size_t i = 1; i < c.size; i++) {
+        int64_t d = (int64_t)c.seq[i] - (int64_t)c.seq[i - 1];
+        if (d == 0) {
+            r.seq_dups++;
+            note(i, "duplicate seq " + std::to_string(c.seq[i]));
+        } else if (d < 0) {
+            r.seq_backwards++;
+            note(i, "seq back " + std::to_string(c.seq[i - 1]) + " -> " + std::to_string(c.seq[i]));
+        } else if (d > 1) {
+            // Records delivered live are never appended, so gaps are expected
+            // in battery.bin; they matter for backlog captures.
+            r.seq_gaps++;
+            r.seq_missing += (uint64_t)(d - 1);
+            note(i, "seq gap " + std::to_string(c.seq[i - 1]) + " -> " + std::to_string(c.seq[i]));
+        }
+
+        if (c.timestamp_s[i] < c.timestamp_s[i - 1]) {
+            r.ts_resets++;
+        } else if (d == 1 && c.interval_s[i] != 0) {
+            int64_t dt = (int64_t)c.timestamp_s[i] - (int64_t)c.timestamp_s[i - 1];
+            int64_t off = dt - (int64_t)c.interval_s[i];
+            if (off > 1 || off < -1) {
+                r.interval_mismatch++;
+                note(i, "interval_s " + std::to_string(c.interval_s[i]) + " but ts delta " + std::to_string(dt));
+            }
+        }
+    }
+    return r;
+}
+
+// ------------------------------------------------------------------ export
+
+namespace {
+
+class OutBuf {
+public:
+    explicit OutBuf(std::FILE *f) : f_(f) {}
+    ~OutBuf() { flush(); }
+
+    void put(char ch)
+    {
+        if (len_ == sizeof(buf_)) flush();
+        buf_[len_++] = ch;
+    }
+    void put(const char *s)
+    {
+        while (*s) put(*s++);
+    }
+    template <typename T>
+    void num(T v)
+    {
+        if (sizeof(buf_) - len_ < 24) flush();
+        auto res = std::to_chars(buf_ + len_, buf_ + sizeof(buf_), v);
+        len_ = (size_t)(res.ptr - buf_);
+    }
+    // Turns the separator just written into the line end.
+    void end_line() { buf_[len_ - 1] = '\n'; }
+    void flush()
+    {
+        if (len_ && std::fwrite(buf_, 1, len_, f_) != len_) ok_ = false;
+        len_ = 0;
+    }
+    bool ok() const { return ok_; }
+
+private:
+    std::FILE *f_;
+    char buf_[1 << 20];
+    size_t len_ = 0;
+    bool ok_ = true;
+};
+
+} // namespace
+
+// Columns in record order, from LOG_RECORD_FIELDS. Array element k is
+// named with k + 1 before the unit suffix (cell_mv -> cell1_mv ...), the
+// names the replay sensor backend expects.
+static std::string element_name(const char *field, size_t k)
+{
+    const char *us = std::strchr(field, '_');
+    size_t head = us ? (size_t)(us - field) : std::strlen(field);
+    return std::string(field, head) + std::to_string(k + 1) + (us ? us : "");
+}
+
+static const char *type_name(int code)
+{
+    switch (code) {
+    case LOG_TCODE_U8:  return "u8";
+    case LOG_TCODE_I8:  return "i8";
+    case LOG_TCODE_U16: return "u16";
+    case LOG_TCODE_I16: return "i16";
+    case LOG_TCODE_U32: return "u32";
+    default:            return "i32";
+    }
+}
+
+template <typename T, typename F>
+static void visit_column(const Column<T> &col, const char *name, int code, F &f)
+{
+    f(std::string(name), type_name(code), col);
+}
+
+template <typename T, size_t N, typename F>
+static void visit_column(const std::array<Column<T>, N> &cols, const char *name, int code, F &f)
+{
+    for (size_t k = 0; k < N; k++) f(element_name(name, k), type_name(code), cols[k]);
+}
+
+template <typename F>
+static void for_each_column(const Columns &c, F &&f)
+{
+#define FIELD(t, name, n, e, u) visit_column(c.name, #name, LOG_TCODE_##t, f);
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+}
+
+template <typename T, typename F>
+static inline void visit_value(const Column<T> &col, size_t i, F &f)
+{
+    f(col[i]);
+}
+
+template <typename T, size_t N, typename F>
+static inline void visit_value(const std::array<Column<T>, N> &cols, size_t i, F &f)
+{
+    for (const auto &col : cols) f(col[i]);
+}
+
+template <typename F>
+static inline void for_each_value(const Columns &c, size_t i, F &&f)
+{
+#define FIELD(t, name, n, e, u) visit_value(c.name, i, f);
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+}
+
+bool write_csv(const Columns &c, std::FILE *out)
+{
+    auto ob = std::make_unique<OutBuf>(out);
+
+    for_each_column(c, [&](const std::string &name, const char *, const auto &) {
+        ob->put(name.c_str());
+        ob->put(',');
+    });
+    ob->end_line();
+
+    for (size_t i = 0; i < c.size; i++) {
+        for_each_value(c, i, [&](auto v) {
+            ob->num(+v);    // u8 as a number
+            ob->put(',');
+        });
+        ob->end_line();
+    }
+    ob->flush();
+    return ob->ok();
+}
+
+template <typename T>
+static bool write_column(const std::string &dir, const char *name, const char *type,
+                         const Column<T> &v, std::FILE *manifest, std::string *err)
+{
+    std::string path = dir + "/" + name + "." + type;
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        if (err) *err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    bool ok = std::fwrite(v.data(), sizeof(T), v.size(), f) == v.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok && err) *err = path + ": write failed";
+    std::fprintf(manifest, "%s %s %zu\n", name, type, v.size());
+    return ok;
+}
+
+bool write_columnar(const Columns &c, const std::string &dir, std::string *err)
+{
+    std::string mpath = dir + "/columns.txt";
+    std::FILE *m = std::fopen(mpath.c_str(), "w");
+    if (!m) {
+        if (err) *err = mpath + ": " + std::strerror(errno);
+        return false;
+    }
+
+    bool ok = true;
+    for_each_column(c, [&](const std::string &name, const char *type, const auto &col) {
+        ok = ok && write_column(dir, name.c_str(), type, col, m, err);
+    });
+
+    std::fclose(m);
+    return ok;
+}
+
+} // namespace fw
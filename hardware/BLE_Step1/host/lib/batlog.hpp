@@ -0,0 +1,131 @@
+#pragma once
+// Decoder for battery_log_t streams: battery.bin pulls from LittleFS and
+// backlog captures taken on the phone / sniffer.
+//
+// Records are decoded straight from a memory map into one array per field
+// (cells as 16 contiguous arrays), which is the layout every consumer wants
+// anyway: plotting, per-cell statistics, CSV export.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "battery_log.h"
+
+namespace fw {
+
+// Read-only memory map of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path, std::string *err = nullptr);
+    void close();
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+enum class InputFormat {
+    Auto,   // hex if the file looks like text, raw otherwise
+    Raw,    // concatenated battery_log_t records (battery.bin, binary capture)
+    Hex,    // one notification per line: "BA-00-00-00-..." / "ba 00 ..." / "ba:00:..."
+};
+
+const char *format_name(InputFormat f);
+InputFormat detect_format(const uint8_t *data, size_t len);
+
+// Parses a hex capture into concatenated records. Lines that are not a whole
+// record (other characteristics, truncated notifications) are counted and
+// skipped.
+struct HexParseResult {
+    std::vector<uint8_t> bytes;
+    size_t lines = 0;
+    size_t records = 0;
+    size_t skipped = 0;
+};
+HexParseResult parse_hex_capture(const uint8_t *text, size_t len);
+
+// Allocator that leaves resized elements uninitialised: decode overwrites
+// every element, and zero-filling 100+ MB of columns first costs as much as
+// the decode itself.
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+    using std::allocator<T>::allocator;
+    template <typename U>
+    void construct(U *p) { ::new (static_cast<void *>(p)) U; }
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&...args) { ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+};
+
+template <typename T>
+using Column = std::vector<T, DefaultInitAllocator<T>>;
+
+// One column per scalar field, an array of columns per array field
+// (cell_mv[k] is cell k), generated from LOG_RECORD_FIELDS.
+template <typename T, size_t N>
+struct ColumnFor {
+    using type = std::array<Column<T>, N>;
+};
+template <typename T>
+struct ColumnFor<T, 1> {
+    using type = Column<T>;
+};
+
+struct Columns {
+    size_t size = 0;
+#define LOG_X_COLUMN(t, name, n, e, u) ColumnFor<LOG_CTYPE_##t, n>::type name;
+    LOG_RECORD_FIELDS(LOG_X_COLUMN)
+#undef LOG_X_COLUMN
+
+    void resize(size_t n);
+};
+
+// Transposes `n` packed records (LOG_RECORD_SIZE_BYTES each) into `out`.
+void decode_columns(const uint8_t *records, size_t n, Columns &out);
+
+struct Issue {
+    size_t index;
+    std::string what;
+};
+
+struct ValidationReport {
+    size_t records = 0;
+    size_t trailing_bytes = 0;      // partial record at end of input
+    uint32_t first_seq = 0;
+    uint32_t last_seq = 0;
+    size_t seq_gaps = 0;            // seq jumped forward by more than one
+    uint64_t seq_missing = 0;       // records lost in those gaps
+    size_t seq_dups = 0;
+    size_t seq_backwards = 0;       // log wipe / seq reset
+    size_t ts_resets = 0;           // timestamp went backwards (reboot)
+    size_t interval_mismatch = 0;   // interval_s disagrees with timestamp delta
+    std::vector<Issue> issues;      // first few, for humans
+};
+
+ValidationReport validate(const Columns &c, size_t max_issues = 20);
+
+// CSV with a header row; column names match the replay sensor backend.
+bool write_csv(const Columns &c, std::FILE *out);
+
+// One little-endian binary file per column plus columns.txt
+// ("name type count" per line) in `dir`, which must exist.
+bool write_columnar(const Columns &c, const std::string &dir, std::string *err = nullptr);
+
+} // namespace fw
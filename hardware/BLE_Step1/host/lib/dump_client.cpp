@@ -0,0 +1,331 @@
+#include "dump_client.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace fw {
+
+// ---------------------------------------------------------------- SerialPort
+
+namespace {
+
+struct BaudCode {
+    uint32_t baud;
+    speed_t code;
+};
+
+const BaudCode kBauds[] = {
+    {9600, B9600},       {19200, B19200},     {38400, B38400},     {57600, B57600},
+    {115200, B115200},   {230400, B230400},
+#ifdef B460800
+    {460800, B460800},
+#endif
+#ifdef B921600
+    {921600, B921600},
+#endif
+#ifdef B1000000
+    {1000000, B1000000},
+#endif
+#ifdef B1500000
+    {1500000, B1500000},
+#endif
+#ifdef B2000000
+    {2000000, B2000000},
+#endif
+#ifdef B3000000
+    {3000000, B3000000},
+#endif
+};
+
+bool baud_code(uint32_t baud, speed_t *code)
+{
+    for (const BaudCode &b : kBauds) {
+        if (b.baud == baud) {
+            *code = b.code;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+SerialPort::~SerialPort() { close(); }
+
+bool SerialPort::open(const std::string &path, uint32_t baud, std::string *err)
+{
+    close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd_ < 0) {
+        if (err) *err = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct termios t;
+    if (tcgetattr(fd_, &t) != 0) {
+        if (err) *err = path + ": not a tty";
+        close();
+        return false;
+    }
+    cfmakeraw(&t);
+    t.c_cflag |= CLOCAL | CREAD;
+    t.c_cflag &= ~(CSTOPB | PARENB);
+#ifdef CRTSCTS
+    t.c_cflag &= ~CRTSCTS;
+#endif
+    t.c_cc[VMIN] = 0;
+    t.c_cc[VTIME] = 0;
+    if (tcsetattr(fd_, TCSANOW, &t) != 0 || !set_baud(baud, err)) {
+        if (err && err->empty()) *err = path + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+    flush_input();
+    return true;
+}
+
+void SerialPort::close()
+{
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool SerialPort::set_baud(uint32_t baud, std::string *err)
+{
+    speed_t code;
+    if (!baud_code(baud, &code)) {
+        if (err) *err = "baud " + std::to_string(baud) + " not supported by this host";
+        return false;
+    }
+    struct termios t;
+    if (tcgetattr(fd_, &t) != 0) return false;
+    cfsetispeed(&t, code);
+    cfsetospeed(&t, code);
+    // Let what was written go out at the old rate first.
+    if (tcsetattr(fd_, TCSADRAIN, &t) != 0) {
+        if (err) *err = std::string("set baud: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+int SerialPort::read(uint8_t *buf, size_t len, int timeout_ms)
+{
+    struct pollfd p = {fd_, POLLIN, 0};
+    int rc;
+    do {
+        rc = poll(&p, 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+    if (rc < 0) return -1;
+    if (rc == 0) return 0;
+    if (!(p.revents & POLLIN)) return -1;
+    ssize_t n = ::read(fd_, buf, len);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return 0;
+    return n > 0 ? (int)n : -1;
+}
+
+bool SerialPort::write(const uint8_t *buf, size_t len)
+{
+    while (len) {
+        ssize_t n = ::write(fd_, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+void SerialPort::flush_input()
+{
+    tcflush(fd_, TCIFLUSH);
+}
+
+// ---------------------------------------------------------------- DumpClient
+
+bool DumpClient::send(uint8_t type, const uint8_t *payload, size_t len)
+{
+    uint8_t frame[DUMP_FRAME_HDR_LEN + 16 + DUMP_FRAME_CRC_LEN];
+    return port_.write(frame, dump_frame_build(frame, type, payload, len));
+}
+
+DumpClient::Rx DumpClient::next_frame(int timeout_ms)
+{
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+        while (rx_pos_ < rx_len_) {
+            uint32_t skipped = parser_.skipped;
+            dump_parse_t r = dump_parser_push(&parser_, rx_[rx_pos_++]);
+            stats_.skipped += parser_.skipped - skipped;
+            if (r == DUMP_PARSE_FRAME) return Rx::Frame;
+            if (r == DUMP_PARSE_BAD) {
+                stats_.bad_frames++;
+                return Rx::Bad;
+            }
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+        if (left.count() <= 0) return Rx::Timeout;
+        int n = port_.read(rx_.data(), rx_.size(), (int)left.count());
+        if (n < 0) return Rx::Closed;
+        if (n == 0) return Rx::Timeout;
+        stats_.bytes += (uint64_t)n;
+        rx_pos_ = 0;
+        rx_len_ = (size_t)n;
+    }
+}
+
+bool DumpClient::hello(uint32_t baud, std::string *err)
+{
+    uint8_t req[DUMP_HELLO_LEN];
+    dump_put_u32(req, baud);
+    for (int attempt = 0; attempt < 5; attempt++) {
+        if (!send(DUMP_T_HELLO, req, sizeof(req))) break;
+        for (;;) {
+            Rx r = next_frame(timeout_ms_);
+            if (r == Rx::Closed) {
+                if (err) *err = "port closed";
+                return false;
+            }
+            if (r == Rx::Timeout) break;
+            if (r != Rx::Frame || parser_.type != DUMP_T_INFO) continue;
+
+            const uint8_t *p = parser_.payload;
+            if (parser_.len < DUMP_INFO_HDR_LEN) continue;
+            DumpInfo info;
+            info.proto = p[0];
+            std::string why;
+            if (!info.schema.parse(p + DUMP_INFO_HDR_LEN, parser_.len - DUMP_INFO_HDR_LEN, &why)) {
+                if (err) *err = "device field table: " + why;
+                return false;
+            }
+            info.count = dump_get_u32(&p[4]);
+            info.first_seq = dump_get_u32(&p[8]);
+            info.last_seq = dump_get_u32(&p[12]);
+            info.baud = dump_get_u32(&p[16]);
+            if (info.schema.record_version != p[1] || info.schema.record_size != dump_get_u16(&p[2])) {
+                if (err) *err = "INFO and its field table disagree";
+                return false;
+            }
+            info_ = std::move(info);
+            seq_ = info_.schema.find("seq");
+            if (!seq_ || seq_->code != LOG_TCODE_U32) {
+                if (err) *err = "device records have no u32 seq";
+                return false;
+            }
+            return port_.set_baud(info_.baud, err);
+        }
+    }
+    if (err) *err = "no answer to HELLO (is the dump built in, and the baud right?)";
+    return false;
+}
+
+bool DumpClient::pull(uint32_t from, uint32_t max, const Sink &sink, uint32_t *next,
+                      std::string *err)
+{
+    auto fail = [&](const std::string &why) {
+        if (err) *err = why;
+        *next = from;
+        return false;
+    };
+    if (!seq_) return fail("no session (hello first)");
+
+    const size_t rsize = info_.schema.record_size;
+    uint32_t left = max;
+    uint16_t expect = 0;
+    int retries = 0;
+    bool first = true;
+
+    // READ from the seq after the last record handed on, under a new tag.
+    auto request = [&]() {
+        uint8_t req[DUMP_READ_LEN];
+        dump_put_u32(&req[0], from);
+        dump_put_u32(&req[4], max ? left : 0);
+        req[8] = ++tag_;
+        expect = 0;
+        if (!first) stats_.resumes++;
+        first = false;
+        return send(DUMP_T_READ, req, sizeof(req));
+    };
+    if (!request()) return fail("port write failed");
+
+    for (;;) {
+        Rx r = next_frame(timeout_ms_);
+        if (r == Rx::Closed) return fail("port closed");
+        if (r != Rx::Frame) {
+            if (r == Rx::Timeout) stats_.timeouts++;
+            if (++retries > kMaxRetries) return fail("too many bad frames / timeouts in a row");
+            if (!request()) return fail("port write failed");
+            continue;
+        }
+
+        const uint8_t *p = parser_.payload;
+        if (parser_.type == DUMP_T_DATA && parser_.len >= DUMP_DATA_HDR_LEN) {
+            if (p[0] != tag_) {
+                stats_.stale++;
+                continue;
+            }
+            size_t n = p[1];
+            if (dump_get_u16(&p[2]) != expect || parser_.len != DUMP_DATA_HDR_LEN + n * rsize) {
+                stats_.lost_frames++;
+                if (++retries > kMaxRetries) return fail("too many lost frames in a row");
+                if (!request()) return fail("port write failed");
+                continue;
+            }
+            const uint8_t *recs = p + DUMP_DATA_HDR_LEN;
+            // Records go out in seq order from `from` on; anything else is
+            // a device bug, not line noise.
+            uint32_t prev = from;
+            for (size_t i = 0; i < n; i++) {
+                uint32_t seq = (uint32_t)Schema::raw(recs + i * rsize, *seq_);
+                if (seq < prev) return fail("device sent records out of order");
+                prev = seq + 1;
+            }
+            expect++;
+            retries = 0;
+            stats_.frames++;
+            stats_.records += n;
+            if (n == 0) continue;
+            from = prev;
+            if (max) left -= (uint32_t)n < left ? (uint32_t)n : left;
+            if (!sink(recs, n)) {
+                send(DUMP_T_ABORT, nullptr, 0);
+                *next = from;
+                return true;
+            }
+            // All that was asked for; the END LIMIT behind it goes stale.
+            if (max && left == 0) {
+                *next = from;
+                return true;
+            }
+        } else if (parser_.type == DUMP_T_END && parser_.len == DUMP_END_LEN) {
+            if (p[0] != tag_) {
+                stats_.stale++;
+                continue;
+            }
+            if (dump_get_u16(&p[2]) != expect) {
+                // The last DATA frames were lost whole.
+                stats_.lost_frames++;
+                if (++retries > kMaxRetries) return fail("too many lost frames in a row");
+                if (!request()) return fail("port write failed");
+                continue;
+            }
+            if (p[1] == DUMP_END_READ_ERR) return fail("device could not read its log");
+            *next = from;
+            return true;
+        }
+    }
+}
+
+void DumpClient::bye(uint32_t console_baud)
+{
+    send(DUMP_T_BYE, nullptr, 0);
+    if (console_baud) port_.set_baud(console_baud);
+}
+
+} // namespace fw
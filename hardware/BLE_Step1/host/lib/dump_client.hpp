@@ -0,0 +1,110 @@
+#pragma once
+// Receiving end of the wired log dump (main/serial_dump.h, frames in
+// main/dump_frame.h): a serial port in raw mode and the session on it.
+//
+// pull() hands every record with seq >= from to its sink once, in order.
+// A frame that fails its CRC, a frame missing from the DATA count, or a
+// silent line makes it ask again from the seq after the last record it
+// handed on, so what the sink saw is always a clean prefix of the stream.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "dump_frame.h"
+#include "record_view.hpp"
+
+namespace fw {
+
+// A tty in raw 8N1 mode, no flow control: a USB-serial adapter, or a pty.
+class SerialPort {
+public:
+    SerialPort() = default;
+    ~SerialPort();
+    SerialPort(const SerialPort &) = delete;
+    SerialPort &operator=(const SerialPort &) = delete;
+
+    bool open(const std::string &path, uint32_t baud, std::string *err = nullptr);
+    void close();
+    bool set_baud(uint32_t baud, std::string *err = nullptr);
+
+    // Up to len bytes, waiting up to timeout_ms for the first; 0 on timeout,
+    // -1 if the port is gone.
+    int read(uint8_t *buf, size_t len, int timeout_ms);
+    bool write(const uint8_t *buf, size_t len);
+    // Drop anything received and not read yet.
+    void flush_input();
+
+private:
+    int fd_ = -1;
+};
+
+struct DumpInfo {
+    unsigned proto = 0;
+    Schema schema;              // the device's record layout, from its field table
+    uint32_t count = 0;
+    uint32_t first_seq = 0;
+    uint32_t last_seq = 0;
+    uint32_t baud = 0;          // what the device switched to
+};
+
+struct DumpStats {
+    uint64_t bytes = 0;         // received, console text included
+    uint64_t frames = 0;        // DATA frames kept
+    uint64_t records = 0;
+    uint64_t skipped = 0;       // bytes outside frames
+    uint64_t bad_frames = 0;    // CRC / length
+    uint64_t lost_frames = 0;   // a gap in the DATA count
+    uint64_t timeouts = 0;
+    uint64_t resumes = 0;       // READs after the first of a pull
+    uint64_t stale = 0;         // frames of an earlier stream
+};
+
+class DumpClient {
+public:
+    // (records, count) in their wire form, info().schema.record_size each;
+    // return false to stop the pull.
+    using Sink = std::function<bool(const uint8_t *, size_t)>;
+
+    static constexpr int kMaxRetries = 8;       // in a row, without progress
+
+    explicit DumpClient(SerialPort &port, int timeout_ms = 1000)
+        : port_(port), timeout_ms_(timeout_ms), rx_(64 * 1024) {}
+
+    // HELLO at the port's current baud; on INFO, switch the port to the
+    // baud the device took. Tries a few times (the device may be printing).
+    bool hello(uint32_t baud, std::string *err = nullptr);
+
+    // Records with seq >= from, up to max (0: until caught up with the log).
+    // *next is where a later pull continues, also after a failure.
+    bool pull(uint32_t from, uint32_t max, const Sink &sink, uint32_t *next,
+              std::string *err = nullptr);
+
+    // End the session: the device goes back to the console baud, and so does
+    // the port if console_baud is given.
+    void bye(uint32_t console_baud = 0);
+
+    const DumpInfo &info() const { return info_; }
+    const DumpStats &stats() const { return stats_; }
+
+private:
+    enum class Rx { Frame, Bad, Timeout, Closed };
+
+    bool send(uint8_t type, const uint8_t *payload, size_t len);
+    Rx next_frame(int timeout_ms);
+
+    SerialPort &port_;
+    int timeout_ms_;
+    DumpInfo info_;
+    DumpStats stats_;
+    const SchemaField *seq_ = nullptr;
+    uint8_t tag_ = 0;
+    dump_parser_t parser_{};
+    std::vector<uint8_t> rx_;
+    size_t rx_pos_ = 0;
+    size_t rx_len_ = 0;
+};
+
+} // namespace fw
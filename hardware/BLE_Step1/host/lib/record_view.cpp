@@ -0,0 +1,106 @@
+#include "record_view.hpp"
+
+#include <cstring>
+
+namespace fw {
+
+static bool fail(std::string *err, const std::string &what)
+{
+    if (err) *err = what;
+    return false;
+}
+
+static bool get_str(const uint8_t *buf, size_t len, size_t *pos, std::string *out)
+{
+    const void *nul = std::memchr(buf + *pos, 0, len - *pos);
+    if (!nul) return false;
+    size_t n = (size_t)(static_cast<const uint8_t *>(nul) - (buf + *pos));
+    out->assign(reinterpret_cast<const char *>(buf + *pos), n);
+    *pos += n + 1;
+    return true;
+}
+
+static bool known_code(uint8_t code)
+{
+    switch (code) {
+    case LOG_TCODE_U8: case LOG_TCODE_I8: case LOG_TCODE_U16:
+    case LOG_TCODE_I16: case LOG_TCODE_U32: case LOG_TCODE_I32:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Schema::parse(const uint8_t *buf, size_t len, std::string *err)
+{
+    if (len < 5) return fail(err, "schema table too short");
+    if (buf[0] != LOG_SCHEMA_TABLE_VERSION) {
+        return fail(err, "unknown schema table version " + std::to_string(buf[0]));
+    }
+    const size_t size = load_le<uint16_t>(buf + 2);
+    const size_t n = buf[4];
+    std::vector<SchemaField> parsed;
+    size_t pos = 5;
+
+    for (size_t i = 0; i < n; i++) {
+        SchemaField f;
+        if (pos + 4 > len) return fail(err, "schema table truncated");
+        f.code = buf[pos++];
+        f.count = buf[pos++];
+        f.offset = buf[pos++];
+        f.exp10 = (int8_t)buf[pos++];
+        if (!get_str(buf, len, &pos, &f.name) || !get_str(buf, len, &pos, &f.unit)) {
+            return fail(err, "schema table truncated");
+        }
+        if (!known_code(f.code)) {
+            return fail(err, f.name + ": unknown type code " + std::to_string(f.code));
+        }
+        if (f.count == 0 || f.offset + f.size() * f.count > size) {
+            return fail(err, f.name + ": outside the record");
+        }
+        parsed.push_back(std::move(f));
+    }
+    record_version = buf[1];
+    record_size = size;
+    fields = std::move(parsed);
+    return true;
+}
+
+Schema Schema::local()
+{
+    uint8_t buf[LOG_SCHEMA_TABLE_MAX];
+    Schema s;
+    int len = log_schema_table(buf, sizeof(buf));
+    if (len > 0) s.parse(buf, (size_t)len);
+    return s;
+}
+
+const SchemaField *Schema::find(const std::string &name) const
+{
+    for (const SchemaField &f : fields) {
+        if (f.name == name) return &f;
+    }
+    return nullptr;
+}
+
+template <typename T>
+static void gather(const uint8_t *p, size_t stride, size_t n, int64_t *out)
+{
+    for (size_t r = 0; r < n; r++, p += stride) out[r] = load_le<T>(p);
+}
+
+void Schema::decode_column(const uint8_t *records, size_t n, const SchemaField &f, size_t i,
+                           int64_t *out) const
+{
+    const uint8_t *p = records + f.offset + i * f.size();
+    switch (f.code) {
+    case LOG_TCODE_U8:  gather<uint8_t>(p, record_size, n, out); break;
+    case LOG_TCODE_I8:  gather<int8_t>(p, record_size, n, out); break;
+    case LOG_TCODE_U16: gather<uint16_t>(p, record_size, n, out); break;
+    case LOG_TCODE_I16: gather<int16_t>(p, record_size, n, out); break;
+    case LOG_TCODE_U32: gather<uint32_t>(p, record_size, n, out); break;
+    default:            gather<int32_t>(p, record_size, n, out); break;
+    }
+}
+
+} // namespace fw
@@ -0,0 +1,140 @@
+#pragma once
+// Zero-copy access to battery_log_t records in a byte buffer (memory map,
+// capture, notification), and a runtime schema for records whose layout
+// comes from the device's Record Schema characteristic instead of this
+// build's log_schema.h.
+//
+// RecordView's accessors are generated from LOG_RECORD_FIELDS: one per
+// field, `T name(size_t i = 0) const`, reading little-endian at the field's
+// offset. Nothing is copied and the buffer need not be aligned.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "log_schema.h"
+
+namespace fw {
+
+template <typename T>
+inline T load_le(const uint8_t *p)
+{
+    using U = typename std::make_unsigned<T>::type;
+    U v = 0;
+    for (size_t i = 0; i < sizeof(T); i++) v |= (U)((U)p[i] << (8 * i));
+    return (T)v;
+}
+
+class RecordView {
+public:
+    static constexpr size_t kSize = LOG_RECORD_SIZE_BYTES;
+    static constexpr unsigned kVersion = LOG_RECORD_VERSION;
+
+    explicit RecordView(const uint8_t *p) : p_(p) {}
+    const uint8_t *data() const { return p_; }
+
+#define LOG_X_ACCESSOR(t, name, n, e, u)                                          \
+    LOG_CTYPE_##t name(size_t i = 0) const                                        \
+    {                                                                             \
+        return load_le<LOG_CTYPE_##t>(p_ + offsetof(battery_log_t, name) +        \
+                                      i * sizeof(LOG_CTYPE_##t));                 \
+    }
+    LOG_RECORD_FIELDS(LOG_X_ACCESSOR)
+#undef LOG_X_ACCESSOR
+
+    // Copy into the native struct (log_record_decode without linking it).
+    battery_log_t decode() const
+    {
+        battery_log_t r;
+        uint8_t *dst = reinterpret_cast<uint8_t *>(&r);
+#define LOG_X_COPY(t, name, n, e, u)                                              \
+        for (size_t i = 0; i < (n); i++) {                                        \
+            const LOG_CTYPE_##t v = name(i);                                      \
+            std::memcpy(dst + offsetof(battery_log_t, name) + i * sizeof(v), &v, sizeof(v)); \
+        }
+        LOG_RECORD_FIELDS(LOG_X_COPY)
+#undef LOG_X_COPY
+        return r;
+    }
+
+private:
+    const uint8_t *p_;
+};
+
+// Whole records in [data, data + len); a trailing partial record is ignored.
+class RecordSpan {
+public:
+    RecordSpan(const uint8_t *data, size_t len) : data_(data), n_(len / RecordView::kSize) {}
+
+    size_t size() const { return n_; }
+    RecordView operator[](size_t i) const { return RecordView(data_ + i * RecordView::kSize); }
+
+    class iterator {
+    public:
+        explicit iterator(const uint8_t *p) : p_(p) {}
+        RecordView operator*() const { return RecordView(p_); }
+        iterator &operator++() { p_ += RecordView::kSize; return *this; }
+        bool operator!=(const iterator &o) const { return p_ != o.p_; }
+
+    private:
+        const uint8_t *p_;
+    };
+    iterator begin() const { return iterator(data_); }
+    iterator end() const { return iterator(data_ + n_ * RecordView::kSize); }
+
+private:
+    const uint8_t *data_;
+    size_t n_;
+};
+
+// Field table as advertised by the device (log_schema_table()).
+struct SchemaField {
+    uint8_t code = 0;       // LOG_TCODE_*
+    uint8_t count = 1;
+    uint8_t offset = 0;
+    int8_t exp10 = 0;
+    std::string name;
+    std::string unit;
+
+    size_t size() const { return LOG_TCODE_SIZE(code); }
+    bool is_signed() const { return LOG_TCODE_SIGNED(code); }
+};
+
+struct Schema {
+    unsigned record_version = 0;
+    size_t record_size = 0;
+    std::vector<SchemaField> fields;
+
+    // Parses a table; false (and *err), leaving *this as it was, if it is
+    // malformed or a field does not fit the record.
+    bool parse(const uint8_t *buf, size_t len, std::string *err = nullptr);
+
+    // This build's own table.
+    static Schema local();
+
+    const SchemaField *find(const std::string &name) const;
+
+    // Element i of field f in the record at p, as a signed 64-bit value.
+    static int64_t raw(const uint8_t *p, const SchemaField &f, size_t i = 0)
+    {
+        const uint8_t *q = p + f.offset + i * f.size();
+        switch (f.code) {
+        case LOG_TCODE_U8:  return q[0];
+        case LOG_TCODE_I8:  return (int8_t)q[0];
+        case LOG_TCODE_U16: return load_le<uint16_t>(q);
+        case LOG_TCODE_I16: return load_le<int16_t>(q);
+        case LOG_TCODE_U32: return load_le<uint32_t>(q);
+        default:            return load_le<int32_t>(q);
+        }
+    }
+
+    // Element i of field f for `n` records at `records` into out[0..n). The
+    // type is switched on once per column, not per value.
+    void decode_column(const uint8_t *records, size_t n, const SchemaField &f, size_t i,
+                       int64_t *out) const;
+};
+
+} // namespace fw
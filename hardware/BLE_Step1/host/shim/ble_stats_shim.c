@@ -0,0 +1,35 @@
+/* Host shim for ble_stats: keeps the registered sections, no GATT service. */
+#include <stdio.h>
+#include "ble_stats.h"
+
+typedef struct {
+    const char *name;
+    ble_stats_section_fn fn;
+} section_t;
+
+static section_t s_sections[BLE_STATS_MAX_SECTIONS];
+static int s_count;
+
+void ble_stats_register_section(const char *name, ble_stats_section_fn fn)
+{
+    for (int i = 0; i < s_count; i++) {
+        if (s_sections[i].fn == fn) return;   // host code may re-init modules
+    }
+    if (s_count >= BLE_STATS_MAX_SECTIONS) return;
+    s_sections[s_count].name = name;
+    s_sections[s_count].fn = fn;
+    s_count++;
+}
+
+void ble_stats_register_service(void)
+{
+}
+
+void ble_stats_log_all(void)
+{
+    char line[BLE_STATS_MAX_LEN];
+    for (int i = 0; i < s_count; i++) {
+        s_sections[i].fn(line, sizeof(line));
+        printf("%s:%s\n", s_sections[i].name, line);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+/*
+ * Host shim: the UART driver calls serial_dump uses, on a file descriptor
+ * (shim/uart_shim.c). A bench attaches one end of a pty to the port; the
+ * baud rate is only recorded. Ticks are milliseconds, as everywhere here.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef int uart_port_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags);
+/** Waits up to ticks_to_wait for all `length` bytes; -1 once the fd is closed or hung up. */
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait);
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size);
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size);
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait);
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate);
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baudrate);
+
+/** Host only: the descriptor that stands in for the port. */
+void uart_shim_attach(uart_port_t uart_num, int fd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+/* Host shim: console routing; stdout stays stdout on the host. */
+
+static inline void uart_vfs_dev_use_driver(int uart_num)
+{
+    (void)uart_num;
+}
@@ -0,0 +1,4 @@
+#pragma once
+/* Host shim: no IRAM/DRAM placement. */
+#define IRAM_ATTR
+#define DRAM_ATTR
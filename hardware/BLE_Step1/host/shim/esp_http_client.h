@@ -0,0 +1,33 @@
+#pragma once
+/*
+ * Host shim: the esp_http_client calls the firmware uses, over POSIX
+ * sockets (shim/esp_http_client_shim.c). Plain http only, one request per
+ * connection.
+ */
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_METHOD_GET,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef struct {
+    const char *url;
+    int timeout_ms;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *cfg);
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t c, const char *url);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t c, esp_http_client_method_t method);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t c, int write_len);
+int esp_http_client_write(esp_http_client_handle_t c, const char *buf, int len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t c);
+int esp_http_client_read_response(esp_http_client_handle_t c, char *buf, int len);
+int esp_http_client_get_status_code(esp_http_client_handle_t c);
+esp_err_t esp_http_client_close(esp_http_client_handle_t c);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c);
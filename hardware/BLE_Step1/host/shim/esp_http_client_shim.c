@@ -0,0 +1,206 @@
+/* Host shim: esp_http_client over POSIX sockets (see esp_http_client.h). */
+#include "esp_http_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define MAX_HEADERS 8
+
+struct esp_http_client {
+    char url[256];
+    esp_http_client_method_t method;
+    int timeout_ms;
+    char hdr_key[MAX_HEADERS][32];
+    char hdr_val[MAX_HEADERS][96];
+    int hdr_count;
+    int fd;
+    int status;
+    int64_t content_length;     // -1 until the headers say
+    int64_t body_read;
+    char buf[2048];             // header block and the body bytes that came with it
+    size_t buf_len;
+    size_t buf_pos;
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *cfg)
+{
+    esp_http_client_handle_t c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->fd = -1;
+    c->timeout_ms = cfg->timeout_ms ? cfg->timeout_ms : 5000;
+    if (cfg->url) snprintf(c->url, sizeof(c->url), "%s", cfg->url);
+    return c;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t c, const char *url)
+{
+    snprintf(c->url, sizeof(c->url), "%s", url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t c, esp_http_client_method_t method)
+{
+    c->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key, const char *value)
+{
+    int i = 0;
+    while (i < c->hdr_count && strcasecmp(c->hdr_key[i], key) != 0) i++;
+    if (i == MAX_HEADERS) return ESP_ERR_NO_MEM;
+    if (i == c->hdr_count) c->hdr_count++;
+    snprintf(c->hdr_key[i], sizeof(c->hdr_key[i]), "%s", key);
+    snprintf(c->hdr_val[i], sizeof(c->hdr_val[i]), "%s", value);
+    return ESP_OK;
+}
+
+static int send_all(int fd, const char *p, size_t len)
+{
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t c, int write_len)
+{
+    char host[128], port[8] = "80";
+    const char *path = "/";
+    if (strncmp(c->url, "http://", 7) != 0) return ESP_ERR_NOT_SUPPORTED;
+
+    const char *h = c->url + 7;
+    size_t hl = strcspn(h, ":/");
+    if (hl == 0 || hl >= sizeof(host)) return ESP_ERR_INVALID_ARG;
+    memcpy(host, h, hl);
+    host[hl] = '\0';
+    const char *rest = h + hl;
+    if (*rest == ':') {
+        size_t pl = strcspn(rest + 1, "/");
+        if (pl == 0 || pl >= sizeof(port)) return ESP_ERR_INVALID_ARG;
+        memcpy(port, rest + 1, pl);
+        port[pl] = '\0';
+        rest += 1 + pl;
+    }
+    if (*rest == '/') path = rest;
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *ai;
+    if (getaddrinfo(host, port, &hints, &ai) != 0) return ESP_FAIL;
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    struct timeval tv = { c->timeout_ms / 1000, (c->timeout_ms % 1000) * 1000 };
+    if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(ai);
+    if (fd < 0) return ESP_FAIL;
+
+    char req[1024];
+    int n = snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: %s:%s\r\nConnection: close\r\n",
+                     c->method == HTTP_METHOD_POST ? "POST" : "GET", path, host, port);
+    if (c->method == HTTP_METHOD_POST) {
+        n += snprintf(req + n, sizeof(req) - n, "Content-Length: %d\r\n", write_len);
+    }
+    for (int i = 0; i < c->hdr_count; i++) {
+        n += snprintf(req + n, sizeof(req) - n, "%s: %s\r\n", c->hdr_key[i], c->hdr_val[i]);
+    }
+    n += snprintf(req + n, sizeof(req) - n, "\r\n");
+    if (n >= (int)sizeof(req) || send_all(fd, req, (size_t)n) != 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+
+    c->fd = fd;
+    c->status = -1;
+    c->content_length = -1;
+    c->body_read = 0;
+    c->buf_len = c->buf_pos = 0;
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t c, const char *buf, int len)
+{
+    if (c->fd < 0 || send_all(c->fd, buf, (size_t)len) != 0) return -1;
+    return len;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t c)
+{
+    if (c->fd < 0) return -1;
+    char *end = NULL;
+    while (!end) {
+        if (c->buf_len == sizeof(c->buf) - 1) return -1;
+        ssize_t n = recv(c->fd, c->buf + c->buf_len, sizeof(c->buf) - 1 - c->buf_len, 0);
+        if (n <= 0) return -1;
+        c->buf_len += (size_t)n;
+        c->buf[c->buf_len] = '\0';
+        end = strstr(c->buf, "\r\n\r\n");
+    }
+
+    if (sscanf(c->buf, "HTTP/1.%*d %d", &c->status) != 1) return -1;
+    for (char *line = strstr(c->buf, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            c->content_length = strtoll(line + 17, NULL, 10);
+        }
+    }
+    c->buf_pos = (size_t)(end + 4 - c->buf);
+    return c->content_length >= 0 ? c->content_length : 0;
+}
+
+int esp_http_client_read_response(esp_http_client_handle_t c, char *buf, int len)
+{
+    int got = 0;
+    while (got < len && (c->content_length < 0 || c->body_read < c->content_length)) {
+        int want = len - got;
+        if (c->content_length >= 0 && want > c->content_length - c->body_read) {
+            want = (int)(c->content_length - c->body_read);
+        }
+        int n;
+        if (c->buf_pos < c->buf_len) {
+            n = (int)(c->buf_len - c->buf_pos);
+            if (n > want) n = want;
+            memcpy(buf + got, c->buf + c->buf_pos, (size_t)n);
+            c->buf_pos += (size_t)n;
+        } else {
+            ssize_t r = recv(c->fd, buf + got, (size_t)want, 0);
+            if (r <= 0) break;
+            n = (int)r;
+        }
+        got += n;
+        c->body_read += n;
+    }
+    return got;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t c)
+{
+    return c->status;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t c)
+{
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c)
+{
+    if (!c) return ESP_FAIL;
+    esp_http_client_close(c);
+    free(c);
+    return ESP_OK;
+}
@@ -0,0 +1,18 @@
+#pragma once
+/* Host shim: ESP_LOGx to stderr, filtered by HOST_LOG_LEVEL (default: warnings). */
+#include <stdio.h>
+
+#ifndef HOST_LOG_LEVEL
+#define HOST_LOG_LEVEL 2   /* 1=E 2=W 3=I 4=D */
+#endif
+
+#define HOST_LOG_(lvl, ch, tag, fmt, ...) do {                          \
+        if ((lvl) <= HOST_LOG_LEVEL)                                    \
+            fprintf(stderr, ch " (%s) " fmt "\n", tag, ##__VA_ARGS__);  \
+    } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG_(1, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG_(2, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG_(3, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG_(4, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG_(5, "V", tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,11 @@
+#pragma once
+/* Host shim: a fixed MAC (shim/esp_wifi_shim.c). */
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_BT,
+} esp_mac_type_t;
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
@@ -0,0 +1,13 @@
+#pragma once
+/* Host shim: the STA netif calls (the host's own stack does the networking). */
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+enum {
+    IP_EVENT_STA_GOT_IP = 0,
+};
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
@@ -0,0 +1,75 @@
+#pragma once
+/*
+ * Host shim: a NOR flash emulator behind the esp_partition API.
+ *
+ * Partitions are RAM buffers created with esp_partition_shim_add(). Writes
+ * can only clear bits (a write that would set one fails, as a bug check),
+ * erases work on whole 4 KB sectors, and mmap returns the buffer itself.
+ * Every operation is counted, and a device time estimate is accumulated
+ * from typical SPI NOR figures (see esp_partition_shim.c).
+ */
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+    ESP_PARTITION_TYPE_ANY = 0xff,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    void *flash_chip;
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+    bool encrypted;
+    bool readonly;
+} esp_partition_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+typedef enum {
+    ESP_PARTITION_MMAP_DATA,
+    ESP_PARTITION_MMAP_INST,
+} esp_partition_mmap_memory_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t len);
+esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t off, size_t len,
+                             esp_partition_mmap_memory_t memory,
+                             const void **out_ptr, esp_partition_mmap_handle_t *out_handle);
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
+
+typedef struct {
+    uint64_t reads, read_bytes;
+    uint64_t writes, write_bytes;
+    uint64_t erases;
+    uint64_t device_ns;     // estimated time on the ESP32's SPI flash
+} esp_partition_shim_stats_t;
+
+/** Create (erased) or replace a data partition with `label`. */
+const esp_partition_t *esp_partition_shim_add(const char *label, uint32_t size);
+void esp_partition_shim_remove(const char *label);
+void esp_partition_shim_get_stats(esp_partition_shim_stats_t *out);
+void esp_partition_shim_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
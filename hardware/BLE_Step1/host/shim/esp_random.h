@@ -0,0 +1,14 @@
+#pragma once
+/* Host shim: deterministic xorshift32 so runs are reproducible. */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_random(void);
+void esp_random_shim_seed(uint32_t seed);
+
+#ifdef __cplusplus
+}
+#endif
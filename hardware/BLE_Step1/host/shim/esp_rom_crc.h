@@ -0,0 +1,13 @@
+#pragma once
+/* Host shim: esp_rom_crc32_le() (IEEE 802.3, as the ROM implements it). */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
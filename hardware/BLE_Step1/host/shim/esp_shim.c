@@ -0,0 +1,40 @@
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+#ifdef ESP_TIMER_SHIM_VIRTUAL
+int64_t esp_timer_shim_now_us;
+#endif
+
+static uint32_t s_rng = 0x2545F491u;
+
+void esp_random_shim_seed(uint32_t seed)
+{
+    s_rng = seed ? seed : 0x2545F491u;
+}
+
+uint32_t esp_random(void)
+{
+    uint32_t x = s_rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return s_rng = x;
+}
+
+// Table-driven like the ROM version, so CRC cost is comparable.
+static uint32_t s_crc_table[256];
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    if (!s_crc_table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1u)));
+            s_crc_table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (len--) crc = (crc >> 8) ^ s_crc_table[(crc ^ *buf++) & 0xFF];
+    return ~crc;
+}
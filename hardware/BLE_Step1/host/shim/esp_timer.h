@@ -0,0 +1,57 @@
+#pragma once
+/*
+ * Host shim: esp_timer_get_time() on CLOCK_MONOTONIC, or on a virtual clock
+ * with ESP_TIMER_SHIM_VIRTUAL. Timers can be created and armed but never
+ * fire: a bench calls their work directly.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+
+#ifdef ESP_TIMER_SHIM_VIRTUAL
+// Simulations run their own clock; esp_timer_get_time() reads it.
+extern int64_t esp_timer_shim_now_us;
+
+static inline int64_t esp_timer_get_time(void)
+{
+    return esp_timer_shim_now_us;
+}
+#else
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+static inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args,
+                                         esp_timer_handle_t *out)
+{
+    (void)args;
+    *out = (esp_timer_handle_t)1;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    (void)timer;
+    (void)timeout_us;
+    return ESP_OK;
+}
@@ -0,0 +1,57 @@
+#pragma once
+/*
+ * Host shim: the STA driver calls. esp_wifi_connect() raises GOT_IP at
+ * once, or STA_DISCONNECTED when the bench took the network away
+ * (esp_wifi_shim_set_reachable); the host's own stack carries the traffic.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct {
+    int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() { 0 }
+
+typedef enum {
+    WIFI_AUTH_OPEN,
+    WIFI_AUTH_WPA2_PSK,
+} wifi_auth_mode_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t password[64];
+    struct {
+        wifi_auth_mode_t authmode;
+    } threshold;
+} wifi_sta_config_t;
+
+typedef union {
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef enum { WIFI_MODE_STA = 1 } wifi_mode_t;
+typedef enum { WIFI_IF_STA } wifi_interface_t;
+typedef enum { WIFI_STORAGE_FLASH, WIFI_STORAGE_RAM } wifi_storage_t;
+
+enum {
+    WIFI_EVENT_STA_DISCONNECTED = 5,
+};
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *cfg);
+esp_err_t esp_wifi_deinit(void);
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t iface, wifi_config_t *cfg);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_stop(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+
+/** Host-only: whether the next esp_wifi_connect() gets an address. */
+void esp_wifi_shim_set_reachable(bool reachable);
+
+/** Host-only: driver init / deinit pairs so far (every session must undo its init). */
+void esp_wifi_shim_counts(uint32_t *inits, uint32_t *deinits);
@@ -0,0 +1,116 @@
+/* Host shim: Wi-Fi STA driver, netif and default event loop (see esp_wifi.h). */
+#include <string.h>
+#include "esp_event.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+#define MAX_HANDLERS 8
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void *arg;
+} handler_t;
+
+static handler_t s_handlers[MAX_HANDLERS];
+static int s_handler_count;
+static bool s_loop;
+static bool s_reachable = true;
+static bool s_inited;
+static uint32_t s_inits, s_deinits;
+
+static void post(esp_event_base_t base, int32_t id)
+{
+    for (int i = 0; i < s_handler_count; i++) {
+        handler_t *h = &s_handlers[i];
+        if (h->base == base && (h->id == id || h->id == ESP_EVENT_ANY_ID)) {
+            h->fn(h->arg, base, id, NULL);
+        }
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_loop) return ESP_ERR_INVALID_STATE;
+    s_loop = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+                                     esp_event_handler_t fn, void *arg)
+{
+    if (!s_loop) return ESP_ERR_INVALID_STATE;
+    if (s_handler_count == MAX_HANDLERS) return ESP_ERR_NO_MEM;
+    s_handlers[s_handler_count++] = (handler_t){ base, id, fn, arg };
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    static int s_netif;
+    return (esp_netif_t *)&s_netif;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    static const uint8_t k_mac[6] = { 0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56 };
+    memcpy(mac, k_mac, sizeof(k_mac));
+    if (type == ESP_MAC_BT) mac[5] += 2;
+    return ESP_OK;
+}
+
+void esp_wifi_shim_set_reachable(bool reachable)
+{
+    s_reachable = reachable;
+}
+
+void esp_wifi_shim_counts(uint32_t *inits, uint32_t *deinits)
+{
+    *inits = s_inits;
+    *deinits = s_deinits;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *cfg)
+{
+    (void)cfg;
+    if (s_inited) return ESP_ERR_INVALID_STATE;
+    s_inited = true;
+    s_inits++;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    s_inited = false;
+    s_deinits++;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage) { (void)storage; return ESP_OK; }
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) { (void)mode; return ESP_OK; }
+esp_err_t esp_wifi_set_config(wifi_interface_t iface, wifi_config_t *cfg) { (void)iface; (void)cfg; return ESP_OK; }
+esp_err_t esp_wifi_start(void) { return s_inited ? ESP_OK : ESP_ERR_INVALID_STATE; }
+esp_err_t esp_wifi_stop(void) { return ESP_OK; }
+esp_err_t esp_wifi_disconnect(void) { return ESP_OK; }
+
+esp_err_t esp_wifi_connect(void)
+{
+    if (!s_inited) return ESP_ERR_INVALID_STATE;
+    if (s_reachable) {
+        post(IP_EVENT, IP_EVENT_STA_GOT_IP);
+    } else {
+        post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED);
+    }
+    return ESP_OK;
+}
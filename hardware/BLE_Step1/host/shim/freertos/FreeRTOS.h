@@ -0,0 +1,28 @@
+#pragma once
+/*
+ * Host shim: the spinlock macros the firmware's shared state uses, the
+ * tick type (1 ms ticks), and the core id (always 0).
+ * Host builds are single-threaded, so the critical sections are no-ops.
+ */
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY     ((TickType_t)0xFFFFFFFFu)
+
+typedef struct {
+    uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux)  ((void)(mux))
+
+static inline int xPortGetCoreID(void)
+{
+    return 0;
+}
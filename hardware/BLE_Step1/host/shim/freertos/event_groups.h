@@ -0,0 +1,40 @@
+#pragma once
+/*
+ * Host shim: event group bits without blocking. Set bits are there at once
+ * (the shim drivers raise their events synchronously), so a wait returns
+ * whatever is set.
+ */
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef EventBits_t *EventGroupHandle_t;
+
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+
+static inline EventGroupHandle_t xEventGroupCreate(void)
+{
+    return (EventGroupHandle_t)calloc(1, sizeof(EventBits_t));
+}
+
+static inline EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    return *g |= bits;
+}
+
+static inline EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    EventBits_t was = *g;
+    *g &= ~bits;
+    return was;
+}
+
+static inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits,
+                                              BaseType_t clear, BaseType_t all, TickType_t ticks)
+{
+    (void)all; (void)ticks;
+    EventBits_t was = *g;
+    if (clear) *g &= ~bits;
+    return was;
+}
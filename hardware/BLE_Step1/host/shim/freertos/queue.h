@@ -0,0 +1,62 @@
+#pragma once
+/*
+ * Host shim: static queues as plain rings. Nothing runs concurrently on
+ * the host, so a receive never waits: it returns pdFALSE when the queue is
+ * empty, whatever the timeout.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void *QueueHandle_t;
+
+typedef struct {
+    uint8_t *storage;
+    uint32_t item_size;
+    uint32_t length;
+    uint32_t head;              // next item out
+    uint32_t count;
+} StaticQueue_t;
+
+static inline QueueHandle_t xQueueCreateStatic(uint32_t length, uint32_t item_size,
+                                               uint8_t *storage, StaticQueue_t *q)
+{
+    q->storage = storage;
+    q->item_size = item_size;
+    q->length = length;
+    q->head = 0;
+    q->count = 0;
+    return (QueueHandle_t)q;
+}
+
+static inline BaseType_t xQueueSendToBack(QueueHandle_t h, const void *item, TickType_t wait)
+{
+    (void)wait;
+    StaticQueue_t *q = (StaticQueue_t *)h;
+    if (q->count == q->length) return pdFALSE;
+    uint32_t slot = (q->head + q->count) % q->length;
+    memcpy(q->storage + slot * q->item_size, item, q->item_size);
+    q->count++;
+    return pdTRUE;
+}
+
+static inline BaseType_t xQueueSendToFront(QueueHandle_t h, const void *item, TickType_t wait)
+{
+    (void)wait;
+    StaticQueue_t *q = (StaticQueue_t *)h;
+    if (q->count == q->length) return pdFALSE;
+    q->head = (q->head + q->length - 1) % q->length;
+    memcpy(q->storage + q->head * q->item_size, item, q->item_size);
+    q->count++;
+    return pdTRUE;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t h, void *out, TickType_t wait)
+{
+    (void)wait;
+    StaticQueue_t *q = (StaticQueue_t *)h;
+    if (q->count == 0) return pdFALSE;
+    memcpy(out, q->storage + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+/*
+ * Host shim: static recursive mutexes on pthread mutexes. Unlike the
+ * critical sections these really lock, so a bench that runs a firmware
+ * task on a thread (bench_serial_dump, bench_offload) exercises them.
+ */
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    pthread_mutex_t m;
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buf)
+{
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&buf->m, &a);
+    pthread_mutexattr_destroy(&a);
+    return buf;
+}
+
+static inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t wait)
+{
+    (void)wait;
+    return pthread_mutex_lock(&s->m) == 0 ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s)
+{
+    return pthread_mutex_unlock(&s->m) == 0 ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,56 @@
+#pragma once
+/*
+ * Host shim: just what trace_rec needs. A task handle is its name here,
+ * so a bench can feed trace_rec_task_in() string literals as tasks.
+ * Tasks are created but never run: a bench calls their work directly.
+ */
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+static inline char *pcTaskGetName(TaskHandle_t task)
+{
+    return (char *)task;
+}
+
+typedef uint8_t StackType_t;        // as on ESP-IDF: stack depth in bytes
+typedef struct {
+    uint32_t unused;
+} StaticTask_t;
+typedef void (*TaskFunction_t)(void *);
+
+static inline TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t depth,
+                                             void *arg, int prio, StackType_t *stack,
+                                             StaticTask_t *tcb)
+{
+    (void)fn; (void)depth; (void)arg; (void)prio; (void)stack; (void)tcb;
+    return (TaskHandle_t)name;
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+}
+
+static inline void vTaskDelete(TaskHandle_t task)
+{
+    (void)task;
+}
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t)"bench";
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    return pdTRUE;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    (void)clear;
+    (void)wait;
+    return 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+/*
+ * Host shim: GATT server definitions as NimBLE declares them, for services
+ * registered with ble_gatts_add_svcs(). Handles are assigned in NimBLE's
+ * order (service, then declaration + value (+ CCCD) per characteristic).
+ * The "client" side is the ble_gatts_shim_* calls: a bench or the
+ * simulator writes and reads characteristics through the access callbacks.
+ */
+#include <stdint.h>
+#include "host/ble_uuid.h"
+#include "os/os_mbuf.h"
+
+#define BLE_GATT_SVC_TYPE_END       0
+#define BLE_GATT_SVC_TYPE_PRIMARY   1
+#define BLE_GATT_SVC_TYPE_SECONDARY 2
+
+#define BLE_GATT_CHR_F_READ         0x0002
+#define BLE_GATT_CHR_F_WRITE_NO_RSP 0x0004
+#define BLE_GATT_CHR_F_WRITE        0x0008
+#define BLE_GATT_CHR_F_NOTIFY       0x0010
+#define BLE_GATT_CHR_F_INDICATE     0x0020
+
+#define BLE_GATT_ACCESS_OP_READ_CHR   0
+#define BLE_GATT_ACCESS_OP_WRITE_CHR  1
+
+#define BLE_ATT_ERR_READ_NOT_PERMITTED      0x02
+#define BLE_ATT_ERR_WRITE_NOT_PERMITTED     0x03
+#define BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN  0x0d
+#define BLE_ATT_ERR_UNLIKELY                0x0e
+#define BLE_ATT_ERR_INSUFFICIENT_RES        0x11
+#define BLE_ATT_ERR_VALUE_NOT_ALLOWED       0x13
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ble_gatt_chr_def;
+
+struct ble_gatt_access_ctxt {
+    uint8_t op;
+    struct os_mbuf *om;
+    const struct ble_gatt_chr_def *chr;
+};
+
+typedef int ble_gatt_access_fn(uint16_t conn_handle, uint16_t attr_handle,
+                               struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+typedef uint16_t ble_gatt_chr_flags;
+
+struct ble_gatt_chr_def {
+    const ble_uuid_t *uuid;
+    ble_gatt_access_fn *access_cb;
+    void *arg;
+    void *descriptors;
+    ble_gatt_chr_flags flags;
+    uint8_t min_key_size;
+    uint16_t *val_handle;
+};
+
+struct ble_gatt_svc_def {
+    uint8_t type;
+    const ble_uuid_t *uuid;
+    const struct ble_gatt_svc_def **includes;
+    const struct ble_gatt_chr_def *characteristics;
+};
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs);
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *svcs);
+
+/** ATT MTU of a connection (the shim has one, ble_att_shim_set_mtu()). */
+uint16_t ble_att_mtu(uint16_t conn_handle);
+void ble_att_shim_set_mtu(uint16_t mtu);
+
+/** Value handle of the registered characteristic with this 128-bit UUID, 0 if none. */
+uint16_t ble_gatts_shim_find_chr(const ble_uuid_t *uuid);
+
+/** Client write: the characteristic's access callback result (0 or a BLE_ATT_ERR_*). */
+int ble_gatts_shim_write(uint16_t conn, uint16_t attr, const void *data, uint16_t len);
+
+/**
+ * @brief Client read (the whole value, as read blob would assemble it).
+ *        `*len` is the buffer size in, the value length out.
+ * @return 0 or a BLE_ATT_ERR_*
+ */
+int ble_gatts_shim_read(uint16_t conn, uint16_t attr, void *buf, uint16_t *len);
+
+#ifdef __cplusplus
+}
+#endif
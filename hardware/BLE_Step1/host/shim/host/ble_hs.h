@@ -0,0 +1,130 @@
+#pragma once
+/*
+ * Host shim: the NimBLE host calls on the notification path. The "link"
+ * behind ble_gatts_notify_custom() is a pluggable sink so benchmarks and the
+ * simulator can model controller ACL copies and backpressure.
+ *
+ * GATT server: services from ble_gatts_add_svcs() are kept, and the
+ * bench or simulator plays the client through host/ble_gatt.h.
+ *
+ * L2CAP connection-oriented channels: one server, one channel. The bench
+ * plays the peer with the ble_l2cap_shim_* calls: it opens the channel,
+ * grants credits (one per K-frame, as LE credit-based flow control does)
+ * and delivers SDUs. A sent SDU is handed to the SDU sink once credits
+ * cover all its K-frames; until then ble_l2cap_send() returns
+ * BLE_HS_ESTALLED and the shim holds it, then raises TX_UNSTALLED.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "os/os_mbuf.h"
+#include "host/ble_gatt.h"
+
+#define BLE_HS_CONN_HANDLE_NONE 0xffff
+#define BLE_HS_ENOMEM           6
+#define BLE_HS_ENOTCONN         7
+#define BLE_HS_EBADDATA         10
+#define BLE_HS_EBUSY            15
+#define BLE_HS_ESTALLED         31
+
+#define BLE_L2CAP_EVENT_COC_CONNECTED       0
+#define BLE_L2CAP_EVENT_COC_DISCONNECTED    1
+#define BLE_L2CAP_EVENT_COC_ACCEPT          2
+#define BLE_L2CAP_EVENT_COC_DATA_RECEIVED   3
+#define BLE_L2CAP_EVENT_COC_TX_UNSTALLED    4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Receives every notified payload; return non-zero to reject it. */
+typedef int (*ble_hs_shim_sink_fn)(uint16_t conn, uint16_t attr,
+                                   const uint8_t *data, uint16_t len, void *arg);
+
+void ble_hs_shim_set_sink(ble_hs_shim_sink_fn fn, void *arg);
+
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len);
+int ble_gatts_notify_custom(uint16_t conn, uint16_t attr, struct os_mbuf *om);
+
+/* GAP: no connections on the host; ble_sync clients identify with an id. */
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} ble_addr_t;
+
+struct ble_gap_conn_desc {
+    ble_addr_t peer_id_addr;
+};
+
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc);
+
+struct ble_l2cap_chan;
+
+struct ble_l2cap_chan_info {
+    uint16_t scid;
+    uint16_t dcid;
+    uint16_t our_l2cap_mtu;
+    uint16_t peer_l2cap_mtu;
+    uint16_t psm;
+    uint16_t our_coc_mtu;
+    uint16_t peer_coc_mtu;
+};
+
+struct ble_l2cap_event {
+    uint8_t type;
+    union {
+        struct {
+            int status;
+            uint16_t conn_handle;
+            struct ble_l2cap_chan *chan;
+        } connect;
+        struct {
+            uint16_t conn_handle;
+            struct ble_l2cap_chan *chan;
+        } disconnect;
+        struct {
+            uint16_t conn_handle;
+            uint16_t peer_sdu_size;
+            struct ble_l2cap_chan *chan;
+        } accept;
+        struct {
+            uint16_t conn_handle;
+            struct ble_l2cap_chan *chan;
+            struct os_mbuf *sdu_rx;
+        } receive;
+        struct {
+            uint16_t conn_handle;
+            struct ble_l2cap_chan *chan;
+            int status;
+        } tx_unstalled;
+    };
+};
+
+typedef int ble_l2cap_event_fn(struct ble_l2cap_event *event, void *arg);
+
+int ble_l2cap_create_server(uint16_t psm, uint16_t mtu, ble_l2cap_event_fn *cb, void *cb_arg);
+int ble_l2cap_send(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_tx);
+int ble_l2cap_recv_ready(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_rx);
+int ble_l2cap_get_chan_info(struct ble_l2cap_chan *chan, struct ble_l2cap_chan_info *info);
+int ble_l2cap_disconnect(struct ble_l2cap_chan *chan);
+
+/** Receives every SDU the device sends, with the K-frames it took. */
+typedef void (*ble_l2cap_shim_sdu_fn)(const uint8_t *sdu, uint16_t len, uint16_t kframes, void *arg);
+
+void ble_l2cap_shim_set_sink(ble_l2cap_shim_sdu_fn fn, void *arg);
+
+/** Peer opens the channel: ACCEPT then CONNECTED. NULL if the server refused. */
+struct ble_l2cap_chan *ble_l2cap_shim_connect(uint16_t conn, uint16_t peer_mtu, uint16_t peer_mps,
+                                              uint16_t credits);
+
+/** Peer returns credits; may complete a stalled SDU (TX_UNSTALLED). */
+void ble_l2cap_shim_credits(struct ble_l2cap_chan *chan, uint16_t credits);
+
+/** Peer sends an SDU; -1 if the device has no receive buffer ready or it is too long. */
+int ble_l2cap_shim_deliver(struct ble_l2cap_chan *chan, const void *sdu, uint16_t len);
+
+void ble_l2cap_shim_disconnect(struct ble_l2cap_chan *chan);
+
+#ifdef __cplusplus
+}
+#endif
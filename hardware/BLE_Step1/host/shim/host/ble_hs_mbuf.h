@@ -0,0 +1,3 @@
+#pragma once
+/* Host shim: ble_hs_mbuf_from_flat() lives in host/ble_hs.h. */
+#include "host/ble_hs.h"
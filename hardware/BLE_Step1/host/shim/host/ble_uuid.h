@@ -0,0 +1,19 @@
+#pragma once
+/* Host shim: 128-bit UUIDs as NimBLE declares them. */
+#include <stdint.h>
+
+#define BLE_UUID_TYPE_16   16
+#define BLE_UUID_TYPE_128  128
+
+typedef struct {
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint8_t value[16];
+} ble_uuid128_t;
+
+#define BLE_UUID128_INIT(uuid128...) { .u = { .type = BLE_UUID_TYPE_128 }, .value = { uuid128 } }
+#define BLE_UUID128_DECLARE(uuid128...) \
+    ((const ble_uuid_t *)(&(ble_uuid128_t)BLE_UUID128_INIT(uuid128)))
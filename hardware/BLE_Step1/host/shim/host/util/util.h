@@ -0,0 +1,2 @@
+#pragma once
+/* Host shim: nothing from NimBLE's host utilities is used on the host. */
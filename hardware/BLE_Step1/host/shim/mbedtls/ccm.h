@@ -0,0 +1,43 @@
+#pragma once
+/*
+ * Host shim: the mbedtls CCM calls frame_crypt uses, on OpenSSL's software
+ * AES-128-CCM (EVP). Only 128-bit AES keys.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_CIPHER_ID_AES           2
+#define MBEDTLS_ERR_CCM_BAD_INPUT      -0x000D
+#define MBEDTLS_ERR_CCM_AUTH_FAILED    -0x000F
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    unsigned char key[16];
+    int keyset;
+    void *evp;          // cached EVP_CIPHER_CTX
+    int evp_dir;        // direction its key schedule is set up for, -1 none
+    size_t evp_iv_len;
+    size_t evp_tag_len;
+} mbedtls_ccm_context;
+
+void mbedtls_ccm_init(mbedtls_ccm_context *ctx);
+void mbedtls_ccm_free(mbedtls_ccm_context *ctx);
+int  mbedtls_ccm_setkey(mbedtls_ccm_context *ctx, int cipher, const unsigned char *key,
+                        unsigned int keybits);
+int  mbedtls_ccm_encrypt_and_tag(mbedtls_ccm_context *ctx, size_t length,
+                                 const unsigned char *iv, size_t iv_len,
+                                 const unsigned char *ad, size_t ad_len,
+                                 const unsigned char *input, unsigned char *output,
+                                 unsigned char *tag, size_t tag_len);
+int  mbedtls_ccm_auth_decrypt(mbedtls_ccm_context *ctx, size_t length,
+                              const unsigned char *iv, size_t iv_len,
+                              const unsigned char *ad, size_t ad_len,
+                              const unsigned char *input, unsigned char *output,
+                              const unsigned char *tag, size_t tag_len);
+
+#ifdef __cplusplus
+}
+#endif
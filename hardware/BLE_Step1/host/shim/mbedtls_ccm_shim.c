@@ -0,0 +1,91 @@
+#include "mbedtls/ccm.h"
+
+#include <string.h>
+#include <openssl/evp.h>
+
+void mbedtls_ccm_init(mbedtls_ccm_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->evp_dir = -1;
+}
+
+void mbedtls_ccm_free(mbedtls_ccm_context *ctx)
+{
+    if (ctx->evp) EVP_CIPHER_CTX_free((EVP_CIPHER_CTX *)ctx->evp);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_ccm_setkey(mbedtls_ccm_context *ctx, int cipher, const unsigned char *key,
+                       unsigned int keybits)
+{
+    if (cipher != MBEDTLS_CIPHER_ID_AES || keybits != 128) return MBEDTLS_ERR_CCM_BAD_INPUT;
+    memcpy(ctx->key, key, 16);
+    ctx->keyset = 1;
+    ctx->evp_dir = -1;
+    if (!ctx->evp) ctx->evp = EVP_CIPHER_CTX_new();
+    return ctx->evp ? 0 : MBEDTLS_ERR_CCM_BAD_INPUT;
+}
+
+// Like mbedtls, expand the key once: the EVP context is keyed per direction
+// and nonce/tag size, and only the nonce, lengths and AAD are set per call.
+static EVP_CIPHER_CTX *begin(mbedtls_ccm_context *ctx, int enc, size_t length,
+                             const unsigned char *iv, size_t iv_len,
+                             const unsigned char *ad, size_t ad_len,
+                             const unsigned char *tag, size_t tag_len)
+{
+    EVP_CIPHER_CTX *c = (EVP_CIPHER_CTX *)ctx->evp;
+    int outl;
+    if (!ctx->keyset || !c) return NULL;
+    if (ctx->evp_dir != enc || ctx->evp_iv_len != iv_len || ctx->evp_tag_len != tag_len) {
+        ctx->evp_dir = -1;
+        if (EVP_CipherInit_ex(c, EVP_aes_128_ccm(), NULL, NULL, NULL, enc) != 1 ||
+            EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_SET_IVLEN, (int)iv_len, NULL) != 1 ||
+            EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_SET_TAG, (int)tag_len, NULL) != 1 ||
+            EVP_CipherInit_ex(c, NULL, NULL, ctx->key, NULL, enc) != 1) {
+            return NULL;
+        }
+        ctx->evp_dir = enc;
+        ctx->evp_iv_len = iv_len;
+        ctx->evp_tag_len = tag_len;
+    }
+    if ((!enc && EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_SET_TAG, (int)tag_len, (void *)tag) != 1) ||
+        EVP_CipherInit_ex(c, NULL, NULL, NULL, iv, enc) != 1 ||
+        EVP_CipherUpdate(c, NULL, &outl, NULL, (int)length) != 1 ||
+        (ad_len && EVP_CipherUpdate(c, NULL, &outl, ad, (int)ad_len) != 1)) {
+        return NULL;
+    }
+    return c;
+}
+
+int mbedtls_ccm_encrypt_and_tag(mbedtls_ccm_context *ctx, size_t length,
+                                const unsigned char *iv, size_t iv_len,
+                                const unsigned char *ad, size_t ad_len,
+                                const unsigned char *input, unsigned char *output,
+                                unsigned char *tag, size_t tag_len)
+{
+    int outl;
+    EVP_CIPHER_CTX *c = begin(ctx, 1, length, iv, iv_len, ad, ad_len, NULL, tag_len);
+    if (!c || EVP_CipherUpdate(c, output, &outl, input, (int)length) != 1 ||
+        EVP_CipherFinal_ex(c, output + outl, &outl) != 1 ||
+        EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_GET_TAG, (int)tag_len, tag) != 1) {
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+    }
+    return 0;
+}
+
+int mbedtls_ccm_auth_decrypt(mbedtls_ccm_context *ctx, size_t length,
+                             const unsigned char *iv, size_t iv_len,
+                             const unsigned char *ad, size_t ad_len,
+                             const unsigned char *input, unsigned char *output,
+                             const unsigned char *tag, size_t tag_len)
+{
+    int outl;
+    EVP_CIPHER_CTX *c = begin(ctx, 0, length, iv, iv_len, ad, ad_len, tag, tag_len);
+    if (!c) return MBEDTLS_ERR_CCM_BAD_INPUT;
+    // For CCM the tag is checked inside this update.
+    if (EVP_CipherUpdate(c, output, &outl, input, (int)length) != 1) {
+        memset(output, 0, length);
+        return MBEDTLS_ERR_CCM_AUTH_FAILED;
+    }
+    return 0;
+}
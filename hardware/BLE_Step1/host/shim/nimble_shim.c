@@ -0,0 +1,342 @@
+#include "host/ble_hs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Leading space reserved by ble_hs_mbuf_att_pkt() in NimBLE. */
+#define ATT_PKT_LEADING_SPACE (4 + 4 + 5)
+
+static ble_hs_shim_sink_fn s_sink;
+static void *s_sink_arg;
+
+void ble_hs_shim_set_sink(ble_hs_shim_sink_fn fn, void *arg)
+{
+    s_sink = fn;
+    s_sink_arg = arg;
+}
+
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len)
+{
+    struct os_mbuf *om = os_msys_get_pkthdr(0, 0);
+    if (!om) return NULL;
+
+    om->om_data += ATT_PKT_LEADING_SPACE;
+    if (os_mbuf_append(om, buf, len) != 0) {
+        os_mbuf_free_chain(om);
+        return NULL;
+    }
+    return om;
+}
+
+int ble_gatts_notify_custom(uint16_t conn, uint16_t attr, struct os_mbuf *om)
+{
+    // Like the controller transport: copy out into an ACL buffer, then the
+    // host frees the chain whether or not the send succeeded.
+    uint8_t acl[256];
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    int rc = 0;
+
+    if (len > sizeof(acl) || os_mbuf_copydata(om, 0, len, acl) != 0) {
+        rc = BLE_HS_ENOMEM;
+    } else if (s_sink) {
+        rc = s_sink(conn, attr, acl, len, s_sink_arg);
+    }
+
+    os_mbuf_free_chain(om);
+    return rc;
+}
+
+// --- GATT server ---
+
+#define SHIM_MAX_CHRS 16
+
+typedef struct {
+    const struct ble_gatt_chr_def *def;
+    uint16_t val_handle;
+} shim_chr_t;
+
+static shim_chr_t s_chrs[SHIM_MAX_CHRS];
+static int s_n_chrs;
+static uint16_t s_next_handle = 1;
+static uint16_t s_mtu = 247;
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs)
+{
+    (void)defs;
+    return 0;
+}
+
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *svcs)
+{
+    for (const struct ble_gatt_svc_def *svc = svcs; svc->type != BLE_GATT_SVC_TYPE_END; svc++) {
+        s_next_handle++;                                // service declaration
+        for (const struct ble_gatt_chr_def *chr = svc->characteristics; chr && chr->uuid; chr++) {
+            if (s_n_chrs == SHIM_MAX_CHRS) return BLE_HS_ENOMEM;
+            s_next_handle++;                            // characteristic declaration
+            uint16_t val = s_next_handle++;
+            if (chr->flags & (BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE)) {
+                s_next_handle++;                        // CCCD
+            }
+            if (chr->val_handle) *chr->val_handle = val;
+            s_chrs[s_n_chrs].def = chr;
+            s_chrs[s_n_chrs].val_handle = val;
+            s_n_chrs++;
+        }
+    }
+    return 0;
+}
+
+uint16_t ble_att_mtu(uint16_t conn_handle)
+{
+    (void)conn_handle;
+    return s_mtu;
+}
+
+void ble_att_shim_set_mtu(uint16_t mtu)
+{
+    s_mtu = mtu;
+}
+
+uint16_t ble_gatts_shim_find_chr(const ble_uuid_t *uuid)
+{
+    const ble_uuid128_t *want = (const ble_uuid128_t *)uuid;
+    for (int i = 0; i < s_n_chrs; i++) {
+        const ble_uuid128_t *u = (const ble_uuid128_t *)s_chrs[i].def->uuid;
+        if (u->u.type == BLE_UUID_TYPE_128 && memcmp(u->value, want->value, 16) == 0) {
+            return s_chrs[i].val_handle;
+        }
+    }
+    return 0;
+}
+
+static const struct ble_gatt_chr_def *chr_of(uint16_t attr)
+{
+    for (int i = 0; i < s_n_chrs; i++) {
+        if (s_chrs[i].val_handle == attr) return s_chrs[i].def;
+    }
+    return NULL;
+}
+
+int ble_gatts_shim_write(uint16_t conn, uint16_t attr, const void *data, uint16_t len)
+{
+    const struct ble_gatt_chr_def *chr = chr_of(attr);
+    if (!chr || !(chr->flags & (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP))) {
+        return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+    if (!om) return BLE_ATT_ERR_INSUFFICIENT_RES;
+
+    struct ble_gatt_access_ctxt ctxt = { .op = BLE_GATT_ACCESS_OP_WRITE_CHR, .om = om, .chr = chr };
+    int rc = chr->access_cb(conn, attr, &ctxt, chr->arg);
+    os_mbuf_free_chain(om);
+    return rc;
+}
+
+int ble_gatts_shim_read(uint16_t conn, uint16_t attr, void *buf, uint16_t *len)
+{
+    const struct ble_gatt_chr_def *chr = chr_of(attr);
+    if (!chr || !(chr->flags & BLE_GATT_CHR_F_READ)) {
+        return BLE_ATT_ERR_READ_NOT_PERMITTED;
+    }
+    struct os_mbuf *om = os_msys_get_pkthdr(0, 0);
+    if (!om) return BLE_ATT_ERR_INSUFFICIENT_RES;
+
+    struct ble_gatt_access_ctxt ctxt = { .op = BLE_GATT_ACCESS_OP_READ_CHR, .om = om, .chr = chr };
+    int rc = chr->access_cb(conn, attr, &ctxt, chr->arg);
+    if (rc == 0) {
+        uint16_t n = OS_MBUF_PKTLEN(om);
+        if (n > *len) n = *len;
+        os_mbuf_copydata(om, 0, n, buf);
+        *len = n;
+    }
+    os_mbuf_free_chain(om);
+    return rc;
+}
+
+// --- GAP ---
+
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc)
+{
+    (void)handle;
+    (void)out_desc;
+    return BLE_HS_ENOTCONN;
+}
+
+// --- L2CAP connection-oriented channel ---
+
+struct ble_l2cap_chan {
+    uint16_t conn;
+    uint16_t our_mtu;
+    uint16_t peer_mtu;
+    uint16_t peer_mps;
+    uint16_t credits;           // K-frames the device may still send
+    struct os_mbuf *rx;         // from ble_l2cap_recv_ready()
+    struct os_mbuf *tx;         // stalled SDU
+    uint16_t tx_kframes;
+    uint16_t tx_left;           // K-frames of `tx` still waiting for credits
+};
+
+static ble_l2cap_event_fn *s_coc_cb;
+static void *s_coc_arg;
+static uint16_t s_coc_psm;
+static uint16_t s_coc_mtu;
+static struct ble_l2cap_chan s_chan;
+static bool s_chan_open;
+static ble_l2cap_shim_sdu_fn s_sdu_sink;
+static void *s_sdu_arg;
+
+int ble_l2cap_create_server(uint16_t psm, uint16_t mtu, ble_l2cap_event_fn *cb, void *cb_arg)
+{
+    if (s_coc_cb) return BLE_HS_EBUSY;
+    s_coc_psm = psm;
+    s_coc_mtu = mtu;
+    s_coc_cb = cb;
+    s_coc_arg = cb_arg;
+    return 0;
+}
+
+void ble_l2cap_shim_set_sink(ble_l2cap_shim_sdu_fn fn, void *arg)
+{
+    s_sdu_sink = fn;
+    s_sdu_arg = arg;
+}
+
+// Like NimBLE: the SDU is copied out into K-frames and the mbuf freed.
+static void sdu_out(struct ble_l2cap_chan *chan)
+{
+    static uint8_t *flat;       // on the heap: not part of a simulated device's image
+    if (!flat) flat = malloc(UINT16_MAX);
+    uint16_t len = OS_MBUF_PKTLEN(chan->tx);
+    os_mbuf_copydata(chan->tx, 0, len, flat);
+    os_mbuf_free_chain(chan->tx);
+    chan->tx = NULL;
+    if (s_sdu_sink) s_sdu_sink(flat, len, chan->tx_kframes, s_sdu_arg);
+}
+
+int ble_l2cap_send(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_tx)
+{
+    if (!chan || !s_chan_open) return BLE_HS_ENOTCONN;
+    if (chan->tx) return BLE_HS_EBUSY;
+    uint16_t len = OS_MBUF_PKTLEN(sdu_tx);
+    if (len > chan->peer_mtu) return BLE_HS_EBADDATA;
+
+    // First K-frame carries the 2-byte SDU length.
+    chan->tx = sdu_tx;
+    chan->tx_kframes = (uint16_t)((len + 2 + chan->peer_mps - 1) / chan->peer_mps);
+    chan->tx_left = chan->tx_kframes;
+    uint16_t take = chan->credits < chan->tx_left ? chan->credits : chan->tx_left;
+    chan->credits -= take;
+    chan->tx_left -= take;
+    if (chan->tx_left) return BLE_HS_ESTALLED;
+    sdu_out(chan);
+    return 0;
+}
+
+void ble_l2cap_shim_credits(struct ble_l2cap_chan *chan, uint16_t credits)
+{
+    chan->credits += credits;
+    if (!chan->tx) return;
+
+    uint16_t take = chan->credits < chan->tx_left ? chan->credits : chan->tx_left;
+    chan->credits -= take;
+    chan->tx_left -= take;
+    if (chan->tx_left) return;
+    sdu_out(chan);
+
+    struct ble_l2cap_event ev = { .type = BLE_L2CAP_EVENT_COC_TX_UNSTALLED };
+    ev.tx_unstalled.conn_handle = chan->conn;
+    ev.tx_unstalled.chan = chan;
+    s_coc_cb(&ev, s_coc_arg);
+}
+
+int ble_l2cap_recv_ready(struct ble_l2cap_chan *chan, struct os_mbuf *sdu_rx)
+{
+    if (!chan || chan->rx) return BLE_HS_EBUSY;
+    chan->rx = sdu_rx;
+    return 0;
+}
+
+int ble_l2cap_get_chan_info(struct ble_l2cap_chan *chan, struct ble_l2cap_chan_info *info)
+{
+    if (!chan) return BLE_HS_ENOTCONN;
+    memset(info, 0, sizeof(*info));
+    info->scid = 0x0040;
+    info->dcid = 0x0040;
+    info->psm = s_coc_psm;
+    info->our_coc_mtu = chan->our_mtu;
+    info->peer_coc_mtu = chan->peer_mtu;
+    return 0;
+}
+
+struct ble_l2cap_chan *ble_l2cap_shim_connect(uint16_t conn, uint16_t peer_mtu, uint16_t peer_mps,
+                                              uint16_t credits)
+{
+    if (!s_coc_cb || s_chan_open) return NULL;
+
+    struct ble_l2cap_chan *chan = &s_chan;
+    memset(chan, 0, sizeof(*chan));
+    chan->conn = conn;
+    chan->our_mtu = s_coc_mtu;
+    chan->peer_mtu = peer_mtu;
+    chan->peer_mps = peer_mps;
+    chan->credits = credits;
+
+    struct ble_l2cap_event ev = { .type = BLE_L2CAP_EVENT_COC_ACCEPT };
+    ev.accept.conn_handle = conn;
+    ev.accept.peer_sdu_size = peer_mtu;
+    ev.accept.chan = chan;
+    if (s_coc_cb(&ev, s_coc_arg) != 0) {
+        if (chan->rx) os_mbuf_free_chain(chan->rx);
+        chan->rx = NULL;
+        return NULL;
+    }
+
+    s_chan_open = true;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = BLE_L2CAP_EVENT_COC_CONNECTED;
+    ev.connect.conn_handle = conn;
+    ev.connect.chan = chan;
+    s_coc_cb(&ev, s_coc_arg);
+    return chan;
+}
+
+int ble_l2cap_shim_deliver(struct ble_l2cap_chan *chan, const void *sdu, uint16_t len)
+{
+    struct os_mbuf *om = chan->rx;
+    if (!s_chan_open || !om || len > chan->our_mtu) return -1;
+    chan->rx = NULL;
+    if (os_mbuf_append(om, sdu, len) != 0) {
+        os_mbuf_free_chain(om);
+        return -1;
+    }
+
+    struct ble_l2cap_event ev = { .type = BLE_L2CAP_EVENT_COC_DATA_RECEIVED };
+    ev.receive.conn_handle = chan->conn;
+    ev.receive.chan = chan;
+    ev.receive.sdu_rx = om;
+    s_coc_cb(&ev, s_coc_arg);
+    return 0;
+}
+
+void ble_l2cap_shim_disconnect(struct ble_l2cap_chan *chan)
+{
+    if (!s_chan_open) return;
+    s_chan_open = false;
+    if (chan->rx) os_mbuf_free_chain(chan->rx);
+    if (chan->tx) os_mbuf_free_chain(chan->tx);
+    chan->rx = NULL;
+    chan->tx = NULL;
+
+    struct ble_l2cap_event ev = { .type = BLE_L2CAP_EVENT_COC_DISCONNECTED };
+    ev.disconnect.conn_handle = chan->conn;
+    ev.disconnect.chan = chan;
+    s_coc_cb(&ev, s_coc_arg);
+}
+
+// The device closes the channel: same as the peer doing it.
+int ble_l2cap_disconnect(struct ble_l2cap_chan *chan)
+{
+    if (!chan || !s_chan_open) return BLE_HS_ENOTCONN;
+    ble_l2cap_shim_disconnect(chan);
+    return 0;
+}
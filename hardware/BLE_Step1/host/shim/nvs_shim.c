@@ -0,0 +1,141 @@
+#include "nvs.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define NVS_SHIM_MAX_NS       8
+#ifndef NVS_SHIM_MAX_ENTRIES
+#define NVS_SHIM_MAX_ENTRIES  64
+#endif
+#define NVS_SHIM_MAX_VALUE    256
+
+typedef struct {
+    bool used;
+    uint32_t ns;
+    char key[16];
+    size_t len;
+    uint8_t value[NVS_SHIM_MAX_VALUE];
+} nvs_entry_t;
+
+static char s_namespaces[NVS_SHIM_MAX_NS][16];
+static nvs_entry_t s_entries[NVS_SHIM_MAX_ENTRIES];
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default:                    return "ESP_ERR_UNKNOWN";
+    }
+}
+
+void nvs_shim_reset(void)
+{
+    memset(s_namespaces, 0, sizeof(s_namespaces));
+    memset(s_entries, 0, sizeof(s_entries));
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)mode;
+    if (!ns || !out || strlen(ns) >= sizeof(s_namespaces[0])) return ESP_ERR_INVALID_ARG;
+
+    for (uint32_t i = 0; i < NVS_SHIM_MAX_NS; i++) {
+        if (s_namespaces[i][0] == '\0') {
+            strcpy(s_namespaces[i], ns);
+        }
+        if (strcmp(s_namespaces[i], ns) == 0) {
+            *out = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t h) { (void)h; }
+esp_err_t nvs_commit(nvs_handle_t h) { (void)h; return ESP_OK; }
+
+static nvs_entry_t *find(nvs_handle_t h, const char *key, bool create)
+{
+    nvs_entry_t *free_slot = NULL;
+    for (int i = 0; i < NVS_SHIM_MAX_ENTRIES; i++) {
+        nvs_entry_t *e = &s_entries[i];
+        if (e->used && e->ns == h && strcmp(e->key, key) == 0) return e;
+        if (!e->used && !free_slot) free_slot = e;
+    }
+    if (!create || !free_slot || strlen(key) >= sizeof(free_slot->key)) return NULL;
+
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->used = true;
+    free_slot->ns = h;
+    strcpy(free_slot->key, key);
+    return free_slot;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    nvs_entry_t *e = find(h, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (!out) { *len = e->len; return ESP_OK; }
+    if (*len < e->len) return ESP_ERR_INVALID_SIZE;
+    memcpy(out, e->value, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *v, size_t len)
+{
+    if (len > NVS_SHIM_MAX_VALUE) return ESP_ERR_INVALID_SIZE;
+    nvs_entry_t *e = find(h, key, true);
+    if (!e) return ESP_ERR_NO_MEM;
+    memcpy(e->value, v, len);
+    e->len = len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out)
+{
+    size_t len = sizeof(*out);
+    return nvs_get_blob(h, key, out, &len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t v)
+{
+    return nvs_set_blob(h, key, &v, sizeof(v));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out)
+{
+    size_t len = sizeof(*out);
+    return nvs_get_blob(h, key, out, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t v)
+{
+    return nvs_set_blob(h, key, &v, sizeof(v));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len)
+{
+    return nvs_get_blob(h, key, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *v)
+{
+    return nvs_set_blob(h, key, v, strlen(v) + 1);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    nvs_entry_t *e = find(h, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    e->used = false;
+    return ESP_OK;
+}
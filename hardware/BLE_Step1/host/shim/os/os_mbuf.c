@@ -0,0 +1,230 @@
+#include "os/os_mbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int os_mempool_init(struct os_mempool *mp, uint16_t blocks, uint32_t block_size,
+                    void *membuf, const char *name)
+{
+    if (!mp || !membuf || blocks == 0) return -1;
+
+    uint32_t stride = OS_ALIGN(block_size, sizeof(os_membuf_t));
+    mp->omp_block_size = stride;
+    mp->omp_num_blocks = blocks;
+    mp->omp_num_free = blocks;
+    mp->omp_min_free = blocks;
+    mp->omp_membuf_addr = (uintptr_t)membuf;
+    mp->name = name;
+    mp->free_list = NULL;
+
+    uint8_t *p = (uint8_t *)membuf + (size_t)stride * (blocks - 1);
+    for (int i = 0; i < blocks; i++, p -= stride) {
+        struct os_memblock *b = (struct os_memblock *)(void *)p;
+        b->next = mp->free_list;
+        mp->free_list = b;
+    }
+    return 0;
+}
+
+void *os_memblock_get(struct os_mempool *mp)
+{
+    struct os_memblock *b = mp->free_list;
+    if (!b) return NULL;
+
+    mp->free_list = b->next;
+    mp->omp_num_free--;
+    if (mp->omp_num_free < mp->omp_min_free) {
+        mp->omp_min_free = mp->omp_num_free;
+    }
+    return b;
+}
+
+int os_memblock_put(struct os_mempool *mp, void *block)
+{
+    struct os_memblock *b = block;
+    b->next = mp->free_list;
+    mp->free_list = b;
+    mp->omp_num_free++;
+    return 0;
+}
+
+int os_mbuf_pool_init(struct os_mbuf_pool *omp, struct os_mempool *mp,
+                      uint16_t block_size, uint16_t nbufs)
+{
+    (void)nbufs;
+    omp->omp_databuf_len = block_size - sizeof(struct os_mbuf);
+    omp->omp_pool = mp;
+    return 0;
+}
+
+struct os_mbuf *os_mbuf_get(struct os_mbuf_pool *omp, uint16_t leadingspace)
+{
+    if (leadingspace > omp->omp_databuf_len) return NULL;
+
+    struct os_mbuf *om = os_memblock_get(omp->omp_pool);
+    if (!om) return NULL;
+
+    om->om_next = NULL;
+    om->om_flags = 0;
+    om->om_pkthdr_len = 0;
+    om->om_len = 0;
+    om->om_data = &om->om_databuf[leadingspace];
+    om->om_omp = omp;
+    return om;
+}
+
+struct os_mbuf *os_mbuf_get_pkthdr(struct os_mbuf_pool *omp, uint8_t user_pkthdr_len)
+{
+    uint16_t pkthdr_len = sizeof(struct os_mbuf_pkthdr) + user_pkthdr_len;
+
+    struct os_mbuf *om = os_mbuf_get(omp, 0);
+    if (!om) return NULL;
+
+    om->om_pkthdr_len = (uint8_t)pkthdr_len;
+    om->om_data += pkthdr_len;
+
+    struct os_mbuf_pkthdr *hdr = OS_MBUF_PKTHDR(om);
+    hdr->omp_len = 0;
+    hdr->omp_flags = 0;
+    hdr->omp_next = NULL;
+    return om;
+}
+
+void *os_mbuf_extend(struct os_mbuf *om, uint16_t len)
+{
+    struct os_mbuf *last = om;
+    while (last->om_next) last = last->om_next;
+
+    if (OS_MBUF_TRAILINGSPACE(last) < len) {
+        struct os_mbuf *nb = os_mbuf_get(om->om_omp, 0);
+        if (!nb) return NULL;
+        last->om_next = nb;
+        last = nb;
+    }
+
+    void *data = last->om_data + last->om_len;
+    last->om_len += len;
+    if (om->om_pkthdr_len) {
+        OS_MBUF_PKTLEN(om) += len;
+    }
+    return data;
+}
+
+// req_len > 0 trims from the head, < 0 from the tail (NimBLE semantics).
+void os_mbuf_adj(struct os_mbuf *om, int req_len)
+{
+    int len = req_len < 0 ? -req_len : req_len;
+    int trimmed = 0;
+    if (req_len >= 0) {
+        for (struct os_mbuf *m = om; m && len > 0; m = m->om_next) {
+            int n = m->om_len < len ? m->om_len : len;
+            m->om_data += n;
+            m->om_len -= n;
+            len -= n;
+            trimmed += n;
+        }
+    } else {
+        int total = 0;
+        for (struct os_mbuf *m = om; m; m = m->om_next) total += m->om_len;
+        int keep = total > len ? total - len : 0;
+        for (struct os_mbuf *m = om; m; m = m->om_next) {
+            if (m->om_len <= keep) {
+                keep -= m->om_len;
+                continue;
+            }
+            trimmed += m->om_len - keep;
+            m->om_len = (uint16_t)keep;
+            keep = 0;
+        }
+    }
+    if (om->om_pkthdr_len) {
+        OS_MBUF_PKTLEN(om) -= trimmed;
+    }
+}
+
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len)
+{
+    const uint8_t *src = data;
+    struct os_mbuf *last = om;
+    while (last->om_next) last = last->om_next;
+
+    uint16_t remainder = len;
+    while (remainder > 0) {
+        uint16_t space = OS_MBUF_TRAILINGSPACE(last);
+        if (space == 0) {
+            struct os_mbuf *nb = os_mbuf_get(om->om_omp, 0);
+            if (!nb) break;
+            last->om_next = nb;
+            last = nb;
+            continue;
+        }
+        uint16_t n = remainder < space ? remainder : space;
+        memcpy(last->om_data + last->om_len, src, n);
+        last->om_len += n;
+        src += n;
+        remainder -= n;
+    }
+
+    if (om->om_pkthdr_len) {
+        OS_MBUF_PKTLEN(om) += len - remainder;
+    }
+    return remainder == 0 ? 0 : -1;
+}
+
+int os_mbuf_copydata(const struct os_mbuf *om, int off, int len, void *dst)
+{
+    uint8_t *out = dst;
+    while (om && off >= om->om_len) {
+        off -= om->om_len;
+        om = om->om_next;
+    }
+    while (om && len > 0) {
+        int n = om->om_len - off;
+        if (n > len) n = len;
+        memcpy(out, om->om_data + off, (size_t)n);
+        out += n;
+        len -= n;
+        off = 0;
+        om = om->om_next;
+    }
+    return len > 0 ? -1 : 0;
+}
+
+int os_mbuf_free(struct os_mbuf *om)
+{
+    return os_memblock_put(om->om_omp->omp_pool, om);
+}
+
+int os_mbuf_free_chain(struct os_mbuf *om)
+{
+    while (om) {
+        struct os_mbuf *next = om->om_next;
+        os_mbuf_free(om);
+        om = next;
+    }
+    return 0;
+}
+
+static struct os_mempool s_msys_mempool;
+static struct os_mbuf_pool s_msys_pool;
+static os_membuf_t *s_msys_mem;
+
+void os_msys_shim_init(uint16_t block_count, uint16_t block_size)
+{
+    free(s_msys_mem);
+    s_msys_mem = calloc(OS_MEMPOOL_SIZE(block_count, block_size), sizeof(os_membuf_t));
+    os_mempool_init(&s_msys_mempool, block_count, block_size, s_msys_mem, "msys");
+    os_mbuf_pool_init(&s_msys_pool, &s_msys_mempool, block_size, block_count);
+}
+
+struct os_mbuf *os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len)
+{
+    (void)dsize;
+    if (!s_msys_mem) os_msys_shim_init(24, 320);
+    return os_mbuf_get_pkthdr(&s_msys_pool, (uint8_t)user_hdr_len);
+}
+
+int os_msys_num_free(void)
+{
+    return s_msys_mem ? s_msys_mempool.omp_num_free : 0;
+}
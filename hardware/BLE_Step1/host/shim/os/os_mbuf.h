@@ -0,0 +1,87 @@
+#pragma once
+/*
+ * Host shim for the NimBLE mbuf/mempool API.
+ *
+ * Same structure layout and allocation semantics as apache-mynewt-nimble
+ * (fixed-size blocks from a free list, packet header right after the mbuf
+ * header, leading space by advancing om_data) so pool sizing and copy costs
+ * measured on the host carry over to the device.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t os_membuf_t;
+
+#define OS_ALIGN(n, a)              (((n) + ((a) - 1)) / (a) * (a))
+#define OS_MEMPOOL_SIZE(n, blksize) ((OS_ALIGN((blksize), sizeof(os_membuf_t)) / sizeof(os_membuf_t)) * (n))
+
+struct os_memblock {
+    struct os_memblock *next;
+};
+
+struct os_mempool {
+    uint32_t omp_block_size;
+    uint16_t omp_num_blocks;
+    uint16_t omp_num_free;
+    uint16_t omp_min_free;
+    uintptr_t omp_membuf_addr;
+    struct os_memblock *free_list;
+    const char *name;
+};
+
+struct os_mbuf_pool {
+    uint16_t omp_databuf_len;
+    struct os_mempool *omp_pool;
+};
+
+struct os_mbuf_pkthdr {
+    uint16_t omp_len;
+    uint16_t omp_flags;
+    void *omp_next;
+};
+
+struct os_mbuf {
+    uint8_t *om_data;
+    uint8_t om_flags;
+    uint8_t om_pkthdr_len;
+    uint16_t om_len;
+    struct os_mbuf_pool *om_omp;
+    struct os_mbuf *om_next;
+    uint8_t om_databuf[];
+};
+
+#define OS_MBUF_PKTHDR(om)          ((struct os_mbuf_pkthdr *)(void *)((om)->om_databuf))
+#define OS_MBUF_PKTLEN(om)          (OS_MBUF_PKTHDR(om)->omp_len)
+#define OS_MBUF_DATA(om, type)      ((type)((om)->om_data))
+#define OS_MBUF_LEADINGSPACE(om)    ((uint16_t)((om)->om_data - (om)->om_databuf - (om)->om_pkthdr_len))
+#define OS_MBUF_TRAILINGSPACE(om)   ((uint16_t)(&(om)->om_databuf[0] + (om)->om_omp->omp_databuf_len - \
+                                                ((om)->om_data + (om)->om_len)))
+
+int os_mempool_init(struct os_mempool *mp, uint16_t blocks, uint32_t block_size,
+                    void *membuf, const char *name);
+void *os_memblock_get(struct os_mempool *mp);
+int os_memblock_put(struct os_mempool *mp, void *block);
+
+int os_mbuf_pool_init(struct os_mbuf_pool *omp, struct os_mempool *mp,
+                      uint16_t block_size, uint16_t nbufs);
+struct os_mbuf *os_mbuf_get(struct os_mbuf_pool *omp, uint16_t leadingspace);
+struct os_mbuf *os_mbuf_get_pkthdr(struct os_mbuf_pool *omp, uint8_t user_pkthdr_len);
+void *os_mbuf_extend(struct os_mbuf *om, uint16_t len);
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len);
+void os_mbuf_adj(struct os_mbuf *om, int req_len);
+int os_mbuf_copydata(const struct os_mbuf *om, int off, int len, void *dst);
+int os_mbuf_free(struct os_mbuf *om);
+int os_mbuf_free_chain(struct os_mbuf *om);
+
+/** The shared "msys" pool NimBLE allocates from by default. */
+void os_msys_shim_init(uint16_t block_count, uint16_t block_size);
+struct os_mbuf *os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len);
+int os_msys_num_free(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,2 @@
+#pragma once
+/* Host shim: no Kconfig options; firmware code takes its defaults. */
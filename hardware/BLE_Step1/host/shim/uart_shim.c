@@ -0,0 +1,108 @@
+/* Host shim: UART driver on a file descriptor (see driver/uart.h). */
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "driver/uart.h"
+
+#define PORTS 3
+
+static int s_fd[PORTS] = { -1, -1, -1 };
+static uint32_t s_baud[PORTS] = { 115200, 115200, 115200 };
+
+static int port_fd(uart_port_t n)
+{
+    return (n >= 0 && n < PORTS) ? s_fd[n] : -1;
+}
+
+void uart_shim_attach(uart_port_t uart_num, int fd)
+{
+    if (uart_num >= 0 && uart_num < PORTS) s_fd[uart_num] = fd;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    (void)rx_buffer_size; (void)tx_buffer_size; (void)queue_size; (void)uart_queue;
+    (void)intr_alloc_flags;
+    return (uart_num >= 0 && uart_num < PORTS) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// 1 readable, 0 timeout, -1 closed / hung up.
+static int wait_readable(int fd, TickType_t ticks)
+{
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    int rc;
+    do {
+        rc = poll(&p, 1, ticks == portMAX_DELAY ? -1 : (int)ticks);
+    } while (rc < 0 && errno == EINTR);
+    if (rc < 0) return -1;
+    if (rc == 0) return 0;
+    return (p.revents & POLLIN) ? 1 : -1;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    int fd = port_fd(uart_num);
+    if (fd < 0) return -1;
+    uint8_t *out = buf;
+    uint32_t got = 0;
+    while (got < length) {
+        int w = wait_readable(fd, got ? 0 : ticks_to_wait);
+        if (w < 0) return got ? (int)got : -1;
+        if (w == 0) break;
+        ssize_t n = read(fd, out + got, length - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return got ? (int)got : -1;
+        got += (uint32_t)n;
+    }
+    return (int)got;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    int fd = port_fd(uart_num);
+    if (fd < 0) return -1;
+    const uint8_t *p = src;
+    size_t left = size;
+    while (left) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        left -= (size_t)n;
+    }
+    return (int)size;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    int fd = port_fd(uart_num);
+    if (fd < 0) return ESP_FAIL;
+    int w = wait_readable(fd, 0);
+    if (w < 0) return ESP_FAIL;
+    int n = 0;
+    if (w > 0 && ioctl(fd, FIONREAD, &n) < 0) return ESP_FAIL;
+    *size = (size_t)n;
+    return ESP_OK;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    return port_fd(uart_num) < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate)
+{
+    if (uart_num < 0 || uart_num >= PORTS) return ESP_ERR_INVALID_ARG;
+    __atomic_store_n(&s_baud[uart_num], baudrate, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baudrate)
+{
+    if (uart_num < 0 || uart_num >= PORTS) return ESP_ERR_INVALID_ARG;
+    *baudrate = __atomic_load_n(&s_baud[uart_num], __ATOMIC_RELAXED);
+    return ESP_OK;
+}
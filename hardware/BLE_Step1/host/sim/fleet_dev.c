@@ -0,0 +1,161 @@
+#include "fleet_dev.h"
+
+#include <stddef.h>
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "host/ble_hs.h"
+#include "host/ble_uuid.h"
+#include "backlog_job.h"
+#include "battery_log.h"
+#include "ble_batt_mock.h"
+#include "ble_sync.h"
+#include "sampler.h"
+#include "sensor_backend.h"
+#include "soc_est.h"
+
+// ---------------------------------------------------------------- not simulated
+
+#include "ble_coc.h"
+#include "ble_link.h"
+#include "frame_crypt.h"
+#include "wifi_offload.h"
+
+void ble_link_bulk_begin(ble_link_user_t user) { (void)user; }
+void ble_link_bulk_end(ble_link_user_t user) { (void)user; }
+void ble_link_set_live_active(bool active) { (void)active; }
+void ble_link_note_tx(size_t bytes) { (void)bytes; }
+
+bool ble_coc_available(void) { return false; }
+bool ble_coc_is_open(void) { return false; }
+int ble_coc_send_backlog_at(int index, int max_n, uint32_t *last_seq)
+{
+    (void)index; (void)max_n; (void)last_seq;
+    return -1;
+}
+
+bool frame_crypt_active(void) { return false; }
+uint8_t frame_crypt_key_id(void) { return 0; }
+int frame_crypt_seal(uint8_t *frame, size_t body_len, frame_type_t type, uint8_t count)
+{
+    (void)frame; (void)body_len; (void)type; (void)count;
+    return -1;
+}
+
+bool wifi_offload_get_watermark(uint32_t *seq)
+{
+    (void)seq;
+    return false;
+}
+
+// ---------------------------------------------------------------- device
+
+static fleet_dev_stats_t s_st;
+
+esp_err_t fleet_dev_boot(uint32_t seed, void (*wake)(void))
+{
+    esp_random_shim_seed(seed);
+    battery_log_lock_init();
+
+    log_maybe_wipe_on_format_change();
+    battery_log_init();
+    esp_err_t err = battery_log_seq_init();
+    ble_sync_init();
+
+    notify_sched_init(wake);
+    ble_batt_mock_register();
+    ble_batt_mock_sync_ready();
+    sampler_init();
+    soc_est_init();
+    if (err == ESP_OK) err = sensor_init(NULL);
+    return err;
+}
+
+void fleet_dev_set_time(int64_t now_us)
+{
+    esp_timer_shim_now_us = now_us;
+}
+
+// sample_task, then mock_sender's store_sample() for it.
+uint32_t fleet_dev_sample(void)
+{
+    battery_log_t rec;
+    int64_t t = esp_timer_get_time();
+    if (sensor_read(&rec) != ESP_OK) {
+        return SAMPLER_PERIOD_NORMAL_MS;
+    }
+    uint32_t period = sampler_on_sample(&rec, t);
+    soc_est_update(&rec, t);
+
+    rec.seq = battery_log_next_seq();
+    s_st.samples++;
+    if (ble_batt_mock_is_subscribed() && ble_batt_mock_notify_live(&rec) == 0) {
+        s_st.live++;
+    }
+    if (battery_log_append(&rec) == 0) {
+        s_st.appended++;
+    } else {
+        s_st.append_err++;
+    }
+    return period;
+}
+
+bool fleet_dev_serve(void)
+{
+    backlog_job_pump();
+
+    backlog_cmd_t cmd;
+    while (ble_backlog_wait_cmd(&cmd, 0)) {
+        backlog_job_handle(&cmd);
+        backlog_job_pump();
+    }
+
+    if (!backlog_job_active()) {
+        battery_log_idle();
+        ble_sync_persist();
+        soc_est_persist();
+    }
+    return backlog_job_active();
+}
+
+int64_t fleet_dev_dispatch(void)
+{
+    return notify_sched_run();
+}
+
+// ble_stack.c's GAP handler, for the modules built in.
+void fleet_dev_connect(uint16_t conn)
+{
+    ble_batt_mock_on_connect(conn);
+    ble_sync_on_connect(conn);
+}
+
+void fleet_dev_disconnect(void)
+{
+    ble_batt_mock_on_disconnect();
+    ble_sync_on_disconnect();
+    notify_sched_on_disconnect();
+}
+
+void fleet_dev_subscribe(bool on)
+{
+    fleet_dev_chrs_t h;
+    if (!fleet_dev_get_chrs(&h)) return;
+    ble_batt_mock_on_subscribe(h.live, on);
+    ble_batt_mock_on_subscribe(h.backlog, on);
+}
+
+bool fleet_dev_get_chrs(fleet_dev_chrs_t *out)
+{
+    out->live = ble_gatts_shim_find_chr(BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xe1));
+    out->cmd = ble_gatts_shim_find_chr(BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xe2));
+    out->backlog = ble_gatts_shim_find_chr(BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xe3));
+    out->summary = ble_gatts_shim_find_chr(BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xe4));
+    return out->live && out->cmd && out->backlog && out->summary;
+}
+
+void fleet_dev_get_stats(fleet_dev_stats_t *out)
+{
+    *out = s_st;
+    notify_sched_get_stats(NS_CLASS_LIVE, &out->sched_live);
+    notify_sched_get_stats(NS_CLASS_BACKLOG, &out->sched_backlog);
+}
@@ -0,0 +1,85 @@
+#pragma once
+/*
+ * One simulated device for fleetsim: the firmware's own modules (log, seq
+ * allocator, GATT service and command parser, sync table, notification
+ * scheduler, backlog sender, mock sensor, sampler) built into a shared
+ * library with the host shims, and the work of its tasks as calls.
+ *
+ *   sample_task + store_sample   -> fleet_dev_sample()
+ *   mock_sender (one pass)       -> fleet_dev_serve()
+ *   notify_tx (dispatcher)       -> fleet_dev_dispatch()
+ *   GAP connect / disconnect     -> fleet_dev_connect() / fleet_dev_disconnect()
+ *
+ * Everything the library keeps is static, as on the device, so one copy is
+ * one device: fleetsim swaps the library's writable segment in and out per
+ * device, and each device's log lives in its own directory (the current
+ * one while it runs, LOG_BASE_PATH is "."). esp_timer reads the simulator's
+ * clock, esp_timer_shim_now_us.
+ *
+ * Not simulated (stubs): the bulk channel, frame sealing, the Wi-Fi
+ * upload and link-profile requests.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "notify_sched.h"               // no C++ guard of its own
+
+typedef struct {
+    uint32_t samples;           // seqs assigned
+    uint32_t live;              // samples queued as live notifications
+    uint32_t appended;          // samples stored in the log
+    uint32_t append_err;
+    ns_class_stats_t sched_live;
+    ns_class_stats_t sched_backlog;
+} fleet_dev_stats_t;
+
+/** Attribute handles of the battery service, for the ble_gatts_shim_* calls. */
+typedef struct {
+    uint16_t live;
+    uint16_t cmd;
+    uint16_t backlog;
+    uint16_t summary;
+} fleet_dev_chrs_t;
+
+/**
+ * @brief Bring the device up in the current directory, as app_main does
+ *        (log, seq, sync table, service, sensor). `wake` is called when a
+ *        notification is queued, so the simulator schedules a dispatch.
+ */
+esp_err_t fleet_dev_boot(uint32_t seed, void (*wake)(void));
+
+/** Set the device's clock (esp_timer_get_time()) before calling into it. */
+void fleet_dev_set_time(int64_t now_us);
+
+/** Take, number and send or store one sample; ms until the next one. */
+uint32_t fleet_dev_sample(void);
+
+/**
+ * @brief One pass of the sender: queued commands, the backlog pump, and
+ *        the idle work when no backlog runs.
+ * @return true while a backlog is running (poll again in 20 ms)
+ */
+bool fleet_dev_serve(void);
+
+/** Send what the scheduler allows; as notify_sched_run(). */
+int64_t fleet_dev_dispatch(void);
+
+void fleet_dev_connect(uint16_t conn);
+void fleet_dev_disconnect(void);
+
+/** The client writing the live and backlog CCCDs. */
+void fleet_dev_subscribe(bool on);
+
+/** Same on every device (one registration order); false before boot. */
+bool fleet_dev_get_chrs(fleet_dev_chrs_t *out);
+
+void fleet_dev_get_stats(fleet_dev_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
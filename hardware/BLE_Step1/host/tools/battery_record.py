@@ -0,0 +1,66 @@
+# Generated by host/tools/log_schema_gen from main/log_schema.h. Do not edit.
+"""battery_log_t decoder: this build's layout, or any layout read from
+the device's Record Schema characteristic."""
+import struct
+
+RECORD_VERSION = 4
+RECORD_SIZE = 56
+FMT = "<II16HHHHhhhBHB"
+
+# (name, count, exp10, unit): value in unit = raw * 10**exp10
+FIELDS = [
+    ("seq", 1, 0, ""),
+    ("timestamp_s", 1, 0, "s"),
+    ("cell_mv", 16, -3, "V"),
+    ("pack_total_mv", 1, -3, "V"),
+    ("pack_ld_mv", 1, -3, "V"),
+    ("pack_sum_active_mv", 1, -3, "V"),
+    ("current_ma", 1, -3, "A"),
+    ("temp_ts1_c_x100", 1, -2, "C"),
+    ("temp_int_c_x100", 1, -2, "C"),
+    ("soc", 1, 0, "%"),
+    ("interval_s", 1, 0, "s"),
+    ("rate", 1, 0, ""),
+]
+
+_TYPES = {0x01: "B", 0x81: "b", 0x02: "H", 0x82: "h", 0x04: "I", 0x84: "i"}
+
+
+def decode(payload):
+    """First RECORD_SIZE bytes of payload to a dict; arrays as lists."""
+    vals = struct.unpack_from(FMT, payload)
+    rec, i = {}, 0
+    for name, count, _, _ in FIELDS:
+        rec[name] = vals[i] if count == 1 else list(vals[i:i + count])
+        i += count
+    return rec
+
+
+def parse_schema_table(buf):
+    """Record Schema characteristic value to (version, size, fields);
+    fields are (name, code, count, offset, exp10, unit)."""
+    if len(buf) < 5 or buf[0] != 1:
+        raise ValueError("unknown schema table")
+    version, size, n = buf[1], buf[2] | buf[3] << 8, buf[4]
+    fields, pos = [], 5
+    for _ in range(n):
+        code, count, offset, exp10 = struct.unpack_from("<BBBb", buf, pos)
+        pos += 4
+        end = buf.index(0, pos)
+        name = bytes(buf[pos:end]).decode()
+        pos = end + 1
+        end = buf.index(0, pos)
+        unit = bytes(buf[pos:end]).decode()
+        pos = end + 1
+        fields.append((name, code, count, offset, exp10, unit))
+    return version, size, fields
+
+
+def decode_with_schema(payload, schema):
+    """Like decode(), for the layout parse_schema_table() returned."""
+    _, _, fields = schema
+    rec = {}
+    for name, code, count, offset, _, _ in fields:
+        vals = struct.unpack_from("<%d%s" % (count, _TYPES[code]), payload, offset)
+        rec[name] = vals[0] if count == 1 else list(vals)
+    return rec
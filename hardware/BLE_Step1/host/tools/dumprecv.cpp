@@ -0,0 +1,166 @@
+// Pull a device's log over its USB-serial port (main/serial_dump.h).
+//
+//   dumprecv [--baud N] [--console-baud N] [--from SEQ] [--max N] [--append]
+//            [-o FILE] PORT
+//
+// Says HELLO at the console baud (115200), switches to --baud (921600), and
+// writes the records in their wire form to FILE (default dump.bin), which
+// batlog reads like a battery.bin pull. Bad and lost frames are asked for
+// again from the last good record. --append continues an earlier dump into
+// the same file from the seq after its last record, e.g. after the cable
+// came out: the file is only ever a clean prefix of the log.
+//
+// Prints the device's summary, then records, bytes, time and how much of
+// the line rate (baud / 10 bytes per second, 8N1) carried records.
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "dump_client.hpp"
+
+namespace {
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: dumprecv [--baud N] [--console-baud N] [--from SEQ] [--max N] [--append]\n"
+                 "                [-o FILE] PORT\n");
+}
+
+// Seq after the last whole record of an earlier dump, or false if there is none.
+bool resume_point(const char *path, const fw::DumpInfo &info, uint32_t *from, std::string *err)
+{
+    std::FILE *f = std::fopen(path, "rb");
+    if (!f) return false;
+    const size_t rsize = info.schema.record_size;
+    std::vector<uint8_t> rec(rsize);
+    bool ok = std::fseek(f, 0, SEEK_END) == 0;
+    long size = ok ? std::ftell(f) : -1;
+    if (size <= 0 || (size_t)size % rsize != 0) {
+        if (size > 0) *err = std::string(path) + ": not whole records of this device's version";
+        std::fclose(f);
+        return false;
+    }
+    ok = std::fseek(f, size - (long)rsize, SEEK_SET) == 0 && std::fread(rec.data(), 1, rsize, f) == rsize;
+    std::fclose(f);
+    if (!ok) return false;
+    *from = (uint32_t)fw::Schema::raw(rec.data(), *info.schema.find("seq")) + 1;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    uint32_t baud = 921600;
+    uint32_t console_baud = 115200;
+    uint32_t from = 0;
+    uint32_t max = 0;
+    bool from_given = false;
+    bool append = false;
+    const char *out_path = "dump.bin";
+    const char *port_path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--baud") && i + 1 < argc) {
+            baud = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--console-baud") && i + 1 < argc) {
+            console_baud = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--from") && i + 1 < argc) {
+            from = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            from_given = true;
+        } else if (!std::strcmp(argv[i], "--max") && i + 1 < argc) {
+            max = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--append")) {
+            append = true;
+        } else if (!std::strcmp(argv[i], "-o") && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage();
+            return 2;
+        } else {
+            port_path = argv[i];
+        }
+    }
+    if (!port_path) {
+        usage();
+        return 2;
+    }
+
+    fw::SerialPort port;
+    std::string err;
+    if (!port.open(port_path, console_baud, &err)) {
+        std::fprintf(stderr, "dumprecv: %s\n", err.c_str());
+        return 1;
+    }
+    fw::DumpClient client(port);
+    if (!client.hello(baud, &err)) {
+        std::fprintf(stderr, "dumprecv: %s\n", err.c_str());
+        return 1;
+    }
+    const fw::DumpInfo &info = client.info();
+    std::fprintf(stderr, "device: %" PRIu32 " records, seq %" PRIu32 "..%" PRIu32
+                 ", record v%u (%zu B), %" PRIu32 " baud\n",
+                 info.count, info.first_seq, info.last_seq, info.schema.record_version,
+                 info.schema.record_size, info.baud);
+    if (info.schema.record_version != LOG_RECORD_VERSION) {
+        std::fprintf(stderr, "note: record v%u, this batlog decodes v%d\n",
+                     info.schema.record_version, LOG_RECORD_VERSION);
+    }
+
+    if (append && !from_given && !resume_point(out_path, info, &from, &err) && !err.empty()) {
+        std::fprintf(stderr, "dumprecv: %s\n", err.c_str());
+        client.bye(console_baud);
+        return 1;
+    }
+    std::FILE *out = std::fopen(out_path, append ? "ab" : "wb");
+    if (!out) {
+        std::fprintf(stderr, "dumprecv: %s: %s\n", out_path, std::strerror(errno));
+        client.bye(console_baud);
+        return 1;
+    }
+    static char s_outbuf[1 << 16];
+    std::setvbuf(out, s_outbuf, _IOFBF, sizeof(s_outbuf));
+    if (from) std::fprintf(stderr, "from seq %" PRIu32 "\n", from);
+
+    const size_t rsize = info.schema.record_size;
+    bool write_ok = true;
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t next = from;
+    bool ok = client.pull(from, max, [&](const uint8_t *recs, size_t n) {
+        write_ok = std::fwrite(recs, rsize, n, out) == n;
+        return write_ok;
+    }, &next, &err);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    client.bye(console_baud);
+    write_ok = (std::fclose(out) == 0) && write_ok;
+
+    const fw::DumpStats &st = client.stats();
+    double line = secs > 0 ? (double)(st.records * rsize) * 10.0 / ((double)info.baud * secs) : 0.0;
+    std::fprintf(stderr,
+                 "%" PRIu64 " records, %" PRIu64 " bytes in %.2f s: %.0f records/s, %.1f KB/s, "
+                 "records %.0f%% of the line\n",
+                 st.records, st.bytes, secs, secs > 0 ? (double)st.records / secs : 0.0,
+                 secs > 0 ? (double)st.bytes / 1e3 / secs : 0.0, 100.0 * line);
+    std::fprintf(stderr,
+                 "frames=%" PRIu64 " bad=%" PRIu64 " lost=%" PRIu64 " timeouts=%" PRIu64
+                 " resumes=%" PRIu64 " skipped=%" PRIu64 "\n",
+                 st.frames, st.bad_frames, st.lost_frames, st.timeouts, st.resumes, st.skipped);
+
+    if (!write_ok) {
+        std::fprintf(stderr, "dumprecv: %s: write failed\n", out_path);
+        return 1;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "dumprecv: %s; continue with --append (next seq %" PRIu32 ")\n",
+                     err.c_str(), next);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Energy model from the firmware's time-in-state counters.
+//
+// Feed it the "power:" (and optionally "link:") stats lines read from the
+// device, over BLE or from the serial log:
+//
+//   energy_model [--capacity-mah N] [--set key=value ...] < stats.txt
+//
+// Every counter and every current/charge constant below can be overridden
+// with --set, which is how configurations are compared ("what if the adv
+// interval were 100 ms?") without a power analyzer.
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "stats_line.hpp"
+
+namespace {
+
+// ESP32-WROOM-32 figures (datasheet + typical BLE event captures). Charges
+// are per event on top of the sleep/idle floor.
+const std::map<std::string, double> kDefaults = {
+    {"cpu_active_ma", 50.0},     // 160 MHz, radio idle
+    {"idle_full_ma", 27.0},      // no PM: idle task spinning at full clock
+    {"light_sleep_ma", 0.8},     // auto light sleep, RTC + 32k XTAL
+    {"adv_event_uc", 300.0},     // 3-channel legacy adv event
+    {"conn_event_uc", 100.0},    // empty-PDU connection event
+    {"tx_byte_uc", 1.0},         // ~8 us air time per payload byte @ 130 mA
+    {"flush_uc", 200.0},         // LittleFS write burst incl. metadata commit
+    {"flush_byte_uc", 0.05},
+    {"conn_itvl_ms", 30.0},      // used when no link: line is given
+    {"conn_latency", 0.0},
+};
+
+struct Breakdown {
+    const char *name;
+    double mc;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, double> p = kDefaults;
+    std::map<std::string, double> overrides;
+    double capacity_mah = 0.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--capacity-mah") && i + 1 < argc) {
+            capacity_mah = std::strtod(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--set") && i + 1 < argc) {
+            std::string kv = argv[++i];
+            size_t eq = kv.find('=');
+            if (eq == std::string::npos) {
+                std::fprintf(stderr, "bad --set '%s' (want key=value)\n", kv.c_str());
+                return 2;
+            }
+            overrides[kv.substr(0, eq)] = std::strtod(kv.c_str() + eq + 1, nullptr);
+        } else {
+            std::fprintf(stderr, "usage: %s [--capacity-mah N] [--set key=value ...] < stats\n", argv[0]);
+            return 2;
+        }
+    }
+
+    fw::StatsSection power, link;
+    std::string line;
+    bool have_power = false;
+    while (std::getline(std::cin, line)) {
+        if (fw::parse_stats_line(line, "power", power)) have_power = true;
+        fw::parse_stats_line(line, "link", link);
+    }
+    if (!have_power && overrides.find("up_ms") == overrides.end()) {
+        std::fprintf(stderr, "no power: stats line on stdin\n");
+        return 1;
+    }
+
+    for (const char *k : {"lp", "up_ms", "active_ms", "samples", "adv_ms", "conn_ms",
+                          "adv_itvl_ms", "flushes", "flush_b"}) {
+        p[k] = fw::stats_num(power, k);
+    }
+    p["tx_b"] = fw::stats_num(link, "tx");
+    if (link.count("itvl_us") && fw::stats_num(link, "itvl_us") > 0) {
+        p["conn_itvl_ms"] = fw::stats_num(link, "itvl_us") / 1000.0;
+        p["conn_latency"] = fw::stats_num(link, "lat");
+    }
+    for (const auto &kv : overrides) p[kv.first] = kv.second;
+
+    const double up_s = p["up_ms"] / 1000.0;
+    if (up_s <= 0) {
+        std::fprintf(stderr, "up_ms must be > 0\n");
+        return 1;
+    }
+
+    const double active_s = p["active_ms"] / 1000.0;
+    const double floor_ma = p["lp"] != 0 ? p["light_sleep_ma"] : p["idle_full_ma"];
+    const double adv_events = p["adv_itvl_ms"] > 0 ? p["adv_ms"] / p["adv_itvl_ms"] : 0.0;
+    const double conn_events = p["conn_itvl_ms"] > 0
+        ? p["conn_ms"] / (p["conn_itvl_ms"] * (1.0 + p["conn_latency"])) : 0.0;
+
+    const Breakdown parts[] = {
+        {"cpu active", active_s * p["cpu_active_ma"]},
+        {p["lp"] != 0 ? "light sleep" : "idle (full clock)", (up_s - active_s) * floor_ma},
+        {"advertising", adv_events * p["adv_event_uc"] / 1000.0},
+        {"connection events", conn_events * p["conn_event_uc"] / 1000.0},
+        {"notify payload", p["tx_b"] * p["tx_byte_uc"] / 1000.0},
+        {"flash writes", (p["flushes"] * p["flush_uc"] + p["flush_b"] * p["flush_byte_uc"]) / 1000.0},
+    };
+
+    double total_mc = 0.0;
+    for (const auto &b : parts) total_mc += b.mc;
+
+    std::printf("window %.1f s, %s mode, %.0f samples\n\n", up_s,
+                p["lp"] != 0 ? "low-power" : "normal", p["samples"]);
+    std::printf("%-20s %12s %8s\n", "state", "charge mC", "share");
+    for (const auto &b : parts) {
+        std::printf("%-20s %12.1f %7.1f%%\n", b.name, b.mc, total_mc > 0 ? 100.0 * b.mc / total_mc : 0.0);
+    }
+
+    const double avg_ma = total_mc / up_s;
+    std::printf("\naverage current      %10.3f mA\n", avg_ma);
+    std::printf("per sample           %10.3f mC\n", p["samples"] > 0 ? total_mc / p["samples"] : 0.0);
+    if (capacity_mah > 0 && avg_ma > 0) {
+        std::printf("runtime on %.0f mAh   %10.1f h\n", capacity_mah, capacity_mah / avg_ma);
+    }
+    return 0;
+}
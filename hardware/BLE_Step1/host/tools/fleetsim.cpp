@@ -0,0 +1,906 @@
+// Fleet simulator: thousands of devices running the firmware's own log,
+// seq allocator, GATT command parser, sync table, notification scheduler
+// and backlog sender (libfleet_fw, sim/fleet_dev.h), each synced by a
+// simulated phone over a simulated BLE link, on a virtual clock.
+//
+//   fleetsim [--devices N] [--workers W | --scale] [--hours H]
+//            [--session-min M] [--session-s S] [--ack-s S] [--link-bps B]
+//            [--budget B] [--slice-s S] [--seed N] [--csv FILE] [--dir DIR] [--keep]
+//
+// One device is one copy of libfleet_fw's writable segment (its statics,
+// as on the device) plus a directory for its log. A worker process keeps
+// an image per device and runs them in turn, each for --slice-s of virtual
+// time: restore the image, chdir to the device's directory, run its events
+// (samples, sender passes, dispatches, link deliveries, the phone's
+// actions), save the image. Devices do not interact, so a slice needs no
+// other device's clock. --workers forks that many workers (one per core),
+// each with a share of the fleet; --scale runs 1, 2, 4, ... up to
+// --workers or the core count. Device directories go under --dir, by
+// default a new directory in /dev/shm (the log fsyncs every record; on
+// tmpfs that is free); --keep leaves them for batlog.
+//
+// The phone connects every --session-min minutes on average (exponential),
+// subscribes to live and backlog, sends its id (CMD 0x06) and a SYNC (CMD
+// 0x05), ACKs (CMD 0x04) every --ack-s seconds and at the end, and leaves
+// after --session-s. The link carries --link-bps of notification payload,
+// in order, and loses what is still in flight at a disconnect. At the end
+// every device gets one more session that runs until the phone holds the
+// whole log; a device fails if the phone misses any seq. Live samples lost
+// at a disconnect (on the link, or stale in the scheduler) are in the log
+// too, so a later SYNC brings them.
+//
+// Reports per-device throughput (records and link bytes per connected
+// second, time to catch up after connecting, redundant records),
+// aggregate throughput (virtual device-hours and records per wall second),
+// memory per device (image, firmware heap, simulator state, open files,
+// log on disk) and the scaling across workers. Exits 1 if a device fails.
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "battery_log.h"
+#include "fleet_dev.h"
+#include "host/ble_hs.h"
+
+namespace {
+
+struct Config {
+    uint32_t devices = 1000;
+    unsigned workers = 0;           // 1, or the core count with --scale
+    bool scale = false;
+    double hours = 1.0;
+    double session_min = 15.0;
+    double session_s = 60.0;
+    double ack_s = 5.0;
+    uint32_t link_bps = 16000;
+    uint32_t budget = NOTIFY_SCHED_BUDGET_BPS;
+    double slice_s = 60.0;
+    uint32_t seed = 1;
+    const char *csv = nullptr;
+    std::string dir;
+    bool keep = false;
+};
+
+constexpr int64_t kUs = 1000000;
+constexpr int64_t kNever = INT64_MAX;
+constexpr int64_t kPollUs = 20000;              // mock_sender's backlog poll
+constexpr int64_t kDrainMaxUs = 3600 * kUs;     // final session gives up after this
+constexpr uint16_t kConn = 1;
+const uint8_t kPhoneId[] = "fleet-phone";
+
+double wall_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+double cpu_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// ---------------------------------------------------------------- device image
+
+// libfleet_fw's writable segment past RELRO: .data and .bss, every static
+// of the firmware and the shims.
+struct Image {
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    std::vector<uint8_t> pristine;      // as loaded, before any device booted
+};
+
+Image g_image;
+
+int find_segment(struct dl_phdr_info *info, size_t, void *arg)
+{
+    const char *want = (const char *)arg;
+    if (!info->dlpi_name || std::strcmp(info->dlpi_name, want) != 0) return 0;
+
+    uintptr_t lo = 0, hi = 0, relro_hi = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) &ph = info->dlpi_phdr[i];
+        uintptr_t start = info->dlpi_addr + ph.p_vaddr;
+        if (ph.p_type == PT_LOAD && (ph.p_flags & PF_W)) {
+            lo = start;
+            hi = start + ph.p_memsz;
+        } else if (ph.p_type == PT_GNU_RELRO) {
+            relro_hi = start + ph.p_memsz;
+        }
+    }
+    if (relro_hi > lo && relro_hi <= hi) lo = relro_hi;
+    g_image.base = (uint8_t *)lo;
+    g_image.size = hi - lo;
+    return 1;
+}
+
+bool image_init()
+{
+    Dl_info dl;
+    if (!dladdr((void *)&fleet_dev_boot, &dl) || !dl.dli_fname) return false;
+    dl_iterate_phdr(find_segment, (void *)dl.dli_fname);
+    if (!g_image.base || !g_image.size) return false;
+    g_image.pristine.assign(g_image.base, g_image.base + g_image.size);
+    return true;
+}
+
+// ---------------------------------------------------------------- per device
+
+struct InFlight {
+    int64_t at;                 // on the phone
+    uint32_t seq;
+    bool live;
+};
+
+enum class Phone : uint8_t { Away, Connected, Draining, Done };
+
+struct Dev {
+    uint32_t id;
+    std::vector<uint8_t> image;
+
+    // device side
+    int64_t t_sample = 0;
+    int64_t t_dispatch = kNever;
+    int64_t t_serve = kNever;
+
+    // link
+    std::deque<InFlight> air;
+    int64_t link_free = 0;
+
+    // phone
+    Phone phone = Phone::Away;
+    int64_t t_phone = kNever;   // next connect, ACK or disconnect
+    int64_t t_leave = kNever;
+    int64_t t_connected = 0;
+    int64_t wm = -1;            // every seq up to this is held or not in the log
+    int64_t acked = -1;
+    int64_t stream_next = 0;    // next seq the backlog stream may carry
+    int64_t target = -1;        // log's last seq at connect: caught up once wm reaches it
+    bool catching_up = false;
+    std::vector<uint8_t> seen;  // per seq: 1 received, 2 skipped by a backlog stream
+    uint32_t rng;
+
+    // results
+    uint32_t live_rx = 0, backlog_rx = 0, dup_rx = 0, order_err = 0;
+    uint32_t lost_live = 0, lost_backlog = 0;
+    uint32_t sessions = 0, caught_up = 0;
+    uint64_t link_bytes = 0;
+    double connected_s = 0, catchup_sum_s = 0, catchup_max_s = 0;
+};
+
+// What a worker sends back per device.
+struct DevResult {
+    uint32_t id;
+    uint32_t samples, live_tx, appended, append_err;
+    uint32_t live_rx, backlog_rx, dup_rx, order_err;
+    uint32_t missing, lost_live, stale_live, lost_backlog;
+    uint32_t sessions, caught_up;
+    uint64_t link_bytes;
+    uint64_t disk_bytes;
+    double connected_s, catchup_sum_s, catchup_max_s;
+    uint8_t ok;
+};
+
+struct WorkerResult {
+    uint32_t devices;
+    double boot_s, run_s, cpu_s;
+    uint64_t steps, swaps;
+    double heap_per_dev;        // firmware heap (stdio, mbuf pools)
+    double fds_per_dev;
+    double sim_bytes_per_dev;   // image copy + simulator state
+    uint32_t failed;
+};
+
+Config g_cfg;
+Dev *g_cur;                     // device whose image is loaded
+int64_t g_now;
+uint64_t g_steps;
+fleet_dev_chrs_t h;             // same on every device
+
+uint32_t rnd(Dev &d)
+{
+    uint32_t x = d.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return d.rng = x;
+}
+
+int64_t exp_us(Dev &d, double mean_s)
+{
+    double u = ((double)(rnd(d) >> 8) + 0.5) / 16777216.0;
+    return (int64_t)(-std::log(u) * mean_s * (double)kUs);
+}
+
+void wake()
+{
+    if (g_cur->t_dispatch > g_now) g_cur->t_dispatch = g_now;
+}
+
+// The link: payload goes out at --link-bps, in order.
+int sink(uint16_t, uint16_t attr, const uint8_t *data, uint16_t len, void *)
+{
+    Dev &d = *g_cur;
+    bool live = attr == h.live;
+    if (len < sizeof(battery_log_t) || (!live && attr != h.backlog)) return BLE_HS_EBADDATA;
+
+    battery_log_t rec;
+    std::memcpy(&rec, data, sizeof(rec));
+    int64_t start = std::max(d.link_free, g_now);
+    d.link_free = start + (int64_t)len * kUs / g_cfg.link_bps;
+    d.air.push_back({d.link_free, rec.seq, live});
+    d.link_bytes += len;
+    return 0;
+}
+
+// ---------------------------------------------------------------- phone
+
+uint8_t &seen(Dev &d, uint32_t seq)
+{
+    if (seq >= d.seen.size()) d.seen.resize(std::max<size_t>(seq + 1, d.seen.size() * 2), 0);
+    return d.seen[seq];
+}
+
+void advance_wm(Dev &d)
+{
+    while ((size_t)(d.wm + 1) < d.seen.size() && d.seen[d.wm + 1]) d.wm++;
+    if (d.catching_up && d.wm >= d.target) {
+        double s = (double)(g_now - d.t_connected) / kUs;
+        d.catching_up = false;
+        d.caught_up++;
+        d.catchup_sum_s += s;
+        d.catchup_max_s = std::max(d.catchup_max_s, s);
+    }
+}
+
+void phone_rx(Dev &d, const InFlight &f)
+{
+    uint8_t &s = seen(d, f.seq);
+    if (s & 1) {
+        d.dup_rx++;
+    } else if (f.live) {
+        d.live_rx++;
+    } else {
+        d.backlog_rx++;
+    }
+    if (!f.live) {
+        // A backlog stream is in seq order, so what it skipped is not in the log.
+        if ((int64_t)f.seq < d.stream_next) {
+            d.order_err++;
+        } else {
+            for (int64_t q = d.stream_next; q < f.seq; q++) seen(d, (uint32_t)q) |= 2;
+        }
+        d.stream_next = (int64_t)f.seq + 1;
+    }
+    seen(d, f.seq) |= 1;
+    advance_wm(d);
+}
+
+int write_cmd(const uint8_t *cmd, uint16_t len)
+{
+    int rc = ble_gatts_shim_write(kConn, h.cmd, cmd, len);
+    g_cur->t_serve = g_now;     // the command queue wakes the sender
+    return rc;
+}
+
+void ack(Dev &d)
+{
+    if (d.wm < 0 || d.wm == d.acked) return;
+    uint8_t cmd[5] = {0x04};
+    uint32_t seq = (uint32_t)d.wm;
+    std::memcpy(&cmd[1], &seq, 4);
+    if (write_cmd(cmd, sizeof(cmd)) == 0) d.acked = d.wm;
+}
+
+// Summary characteristic: the log's last seq, or -1 if it is empty.
+int64_t read_last_seq()
+{
+    uint8_t buf[64];
+    uint16_t len = sizeof(buf);
+    if (ble_gatts_shim_read(kConn, h.summary, buf, &len) != 0 || len < 17 || buf[0] != 3) return -1;
+    uint32_t count, last;
+    std::memcpy(&count, &buf[1], 4);
+    std::memcpy(&last, &buf[13], 4);
+    return count ? (int64_t)last : -1;
+}
+
+void sync(Dev &d)
+{
+    d.target = read_last_seq();
+    d.catching_up = true;
+    d.stream_next = d.acked + 1;
+    const uint8_t cmd = 0x05;
+    write_cmd(&cmd, 1);
+    advance_wm(d);
+}
+
+void connect(Dev &d, Phone state)
+{
+    fleet_dev_connect(kConn);
+    fleet_dev_subscribe(true);
+    uint8_t cmd[1 + sizeof(kPhoneId) - 1] = {0x06};
+    std::memcpy(&cmd[1], kPhoneId, sizeof(kPhoneId) - 1);
+    d.t_connected = g_now;
+    d.phone = state;
+    d.sessions++;
+    // Backlog streams (a resume on the id, or the SYNC) start after the ACK.
+    d.stream_next = d.acked + 1;
+    write_cmd(cmd, sizeof(cmd));
+    sync(d);
+}
+
+void disconnect(Dev &d)
+{
+    ack(d);
+    fleet_dev_disconnect();
+    for (const InFlight &f : d.air) {
+        if (f.live) {
+            d.lost_live++;
+        } else {
+            d.lost_backlog++;
+        }
+    }
+    d.air.clear();
+    d.link_free = g_now;
+    d.catching_up = false;
+    d.connected_s += (double)(g_now - d.t_connected) / kUs;
+}
+
+void phone_step(Dev &d, int64_t t_end)
+{
+    switch (d.phone) {
+    case Phone::Away:
+        if (g_now >= t_end) {
+            d.t_phone = kNever;     // the final session starts it
+            return;
+        }
+        connect(d, Phone::Connected);
+        d.t_leave = g_now + (int64_t)(g_cfg.session_s * kUs);
+        d.t_phone = std::min(d.t_leave, g_now + (int64_t)(g_cfg.ack_s * kUs));
+        return;
+    case Phone::Connected:
+        if (g_now >= d.t_leave) {
+            disconnect(d);
+            d.phone = Phone::Away;
+            d.t_phone = g_now + exp_us(d, g_cfg.session_min * 60.0);
+            return;
+        }
+        ack(d);
+        d.t_phone = std::min(d.t_leave, g_now + (int64_t)(g_cfg.ack_s * kUs));
+        return;
+    case Phone::Draining:
+        // Done once the sender, the scheduler and the link are idle and the
+        // phone holds everything up to the log's last record.
+        if (d.t_serve == kNever && d.t_dispatch == kNever && d.air.empty()) {
+            int64_t last = read_last_seq();
+            if (last <= d.wm || g_now - d.t_connected > kDrainMaxUs) {
+                disconnect(d);
+                d.phone = Phone::Done;
+                d.t_phone = kNever;
+                return;
+            }
+            if (!d.catching_up) sync(d);
+        }
+        ack(d);
+        d.t_phone = g_now + (int64_t)(g_cfg.ack_s * kUs);
+        return;
+    case Phone::Done:
+        d.t_phone = kNever;
+        return;
+    }
+}
+
+// ---------------------------------------------------------------- event loop
+
+// Runs d (its image loaded) up to t_end, or until its final session is
+// over. Events due at the same time go in a fixed order: link, phone,
+// sample, sender, dispatcher.
+void run_until(Dev &d, int64_t t_end, int64_t phone_end)
+{
+    for (;;) {
+        int64_t next = std::min({d.t_sample, d.t_dispatch, d.t_serve, d.t_phone,
+                                 d.air.empty() ? kNever : d.air.front().at});
+        if (next >= t_end) return;
+        g_now = next;
+        fleet_dev_set_time(g_now);
+        g_steps++;
+
+        while (!d.air.empty() && d.air.front().at <= g_now) {
+            phone_rx(d, d.air.front());
+            d.air.pop_front();
+        }
+        if (d.t_phone <= g_now) phone_step(d, phone_end);
+        if (d.phone == Phone::Done) return;
+        if (d.t_sample <= g_now) {
+            d.t_sample = g_now + (int64_t)fleet_dev_sample() * 1000;
+            d.t_serve = g_now;  // sample_task kicks the sender
+        }
+        if (d.t_serve <= g_now) {
+            d.t_serve = fleet_dev_serve() ? g_now + kPollUs : kNever;
+        }
+        if (d.t_dispatch <= g_now) {
+            int64_t wait = fleet_dev_dispatch();
+            d.t_dispatch = wait < 0 ? kNever : g_now + std::max<int64_t>(wait, 1);
+        }
+    }
+}
+
+std::string dev_dir(uint32_t id)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/d%06" PRIu32, id);
+    return g_cfg.dir + name;
+}
+
+uint64_t dir_bytes(const std::string &path)
+{
+    uint64_t total = 0;
+    DIR *dir = opendir(path.c_str());
+    if (!dir) return 0;
+    while (struct dirent *e = readdir(dir)) {
+        struct stat st;
+        std::string p = path + "/" + e->d_name;
+        if (e->d_name[0] != '.' && stat(p.c_str(), &st) == 0) total += (uint64_t)st.st_size;
+    }
+    closedir(dir);
+    return total;
+}
+
+void rm_dir(const std::string &path)
+{
+    DIR *dir = opendir(path.c_str());
+    if (!dir) return;
+    while (struct dirent *e = readdir(dir)) {
+        if (e->d_name[0] == '.') continue;
+        std::string p = path + "/" + e->d_name;
+        if (unlink(p.c_str()) != 0) rm_dir(p);
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+int open_fds()
+{
+    int n = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) return 0;
+    while (struct dirent *e = readdir(dir)) {
+        if (e->d_name[0] != '.') n++;
+    }
+    closedir(dir);
+    return n - 1;   // the DIR itself
+}
+
+void swap_in(Dev &d)
+{
+    std::memcpy(g_image.base, d.image.data(), g_image.size);
+    g_cur = &d;
+    if (chdir(dev_dir(d.id).c_str()) != 0) {
+        std::perror("chdir");
+        std::exit(2);
+    }
+}
+
+void swap_out(Dev &d)
+{
+    std::memcpy(d.image.data(), g_image.base, g_image.size);
+}
+
+// Hosts devices [lo, hi) and writes their results to `out`.
+int worker(uint32_t lo, uint32_t hi, const char *out)
+{
+    if (!std::freopen("/dev/null", "w", stdout)) return 2;  // the firmware's printf lines
+    const int64_t t_end = (int64_t)(g_cfg.hours * 3600.0 * kUs);
+    const int64_t slice = std::max<int64_t>((int64_t)(g_cfg.slice_s * kUs), kPollUs);
+
+    std::vector<Dev> devs(hi - lo);
+    for (uint32_t i = 0; i < devs.size(); i++) {
+        Dev &d = devs[i];
+        d.id = lo + i;
+        d.rng = (g_cfg.seed * 2654435761u) ^ (d.id * 40503u + 1);
+        if (!d.rng) d.rng = 1;
+        d.image = g_image.pristine;
+        if (mkdir(dev_dir(d.id).c_str(), 0755) != 0 && errno != EEXIST) {
+            std::perror("mkdir");
+            return 2;
+        }
+    }
+
+    WorkerResult wr = {};
+    wr.devices = hi - lo;
+    struct mallinfo2 m0 = mallinfo2();
+    int fd0 = open_fds();
+    double w0 = wall_s(), c0 = cpu_s();
+
+    for (Dev &d : devs) {
+        swap_in(d);
+        g_now = 0;
+        fleet_dev_set_time(0);
+        if (fleet_dev_boot(g_cfg.seed + d.id, wake) != ESP_OK) {
+            std::fprintf(stderr, "device %" PRIu32 ": boot failed\n", d.id);
+            return 2;
+        }
+        if (!h.cmd && !fleet_dev_get_chrs(&h)) {
+            std::fprintf(stderr, "battery service not registered\n");
+            return 2;
+        }
+        ble_hs_shim_set_sink(sink, nullptr);
+        notify_sched_set_budget(g_cfg.budget, NOTIFY_SCHED_BURST_BYTES);
+        d.t_sample = (int64_t)(rnd(d) % 5000) * 1000;       // devices not in step
+        d.t_phone = exp_us(d, g_cfg.session_min * 60.0);
+        swap_out(d);
+        wr.swaps++;
+    }
+
+    struct mallinfo2 m1 = mallinfo2();
+    wr.heap_per_dev = (double)(m1.uordblks - m0.uordblks) / wr.devices;
+    wr.fds_per_dev = (double)(open_fds() - fd0) / wr.devices;
+    double w1 = wall_s();
+    wr.boot_s = w1 - w0;
+
+    for (int64_t t = 0; t < t_end; t += slice) {
+        int64_t t1 = std::min(t + slice, t_end);
+        for (Dev &d : devs) {
+            swap_in(d);
+            run_until(d, t1, t_end);
+            swap_out(d);
+            wr.swaps++;
+        }
+    }
+
+    // Final session: each phone stays until it holds the whole log.
+    std::vector<DevResult> res(devs.size());
+    for (size_t i = 0; i < devs.size(); i++) {
+        Dev &d = devs[i];
+        swap_in(d);
+        g_now = t_end;
+        fleet_dev_set_time(g_now);
+        if (d.phone == Phone::Connected) disconnect(d);
+        connect(d, Phone::Draining);
+        d.t_phone = g_now + (int64_t)(g_cfg.ack_s * kUs);
+        run_until(d, t_end + kDrainMaxUs + kUs, t_end);
+        if (d.phone != Phone::Done) disconnect(d);
+        fleet_dev_dispatch();   // frees what the disconnect left queued
+
+        fleet_dev_stats_t st;
+        fleet_dev_get_stats(&st);
+        DevResult &r = res[i];
+        std::memset(&r, 0, sizeof(r));
+        r.id = d.id;
+        r.samples = st.samples;
+        r.live_tx = st.live;
+        r.appended = st.appended;
+        r.append_err = st.append_err;
+        r.live_rx = d.live_rx;
+        r.backlog_rx = d.backlog_rx;
+        r.dup_rx = d.dup_rx;
+        r.order_err = d.order_err;
+        for (uint32_t q = 0; q < st.samples; q++) {
+            if (q >= d.seen.size() || !(d.seen[q] & 1)) r.missing++;
+        }
+        r.lost_live = d.lost_live;
+        r.stale_live = st.sched_live.stale;
+        r.lost_backlog = d.lost_backlog;
+        r.sessions = d.sessions;
+        r.caught_up = d.caught_up;
+        r.link_bytes = d.link_bytes;
+        r.connected_s = d.connected_s;
+        r.catchup_sum_s = d.catchup_sum_s;
+        r.catchup_max_s = d.catchup_max_s;
+        r.ok = r.order_err == 0 && r.append_err == 0 && d.phone == Phone::Done && r.missing == 0;
+        if (!r.ok) wr.failed++;
+        swap_out(d);
+    }
+    wr.run_s = wall_s() - w1;
+    wr.cpu_s = cpu_s() - c0;
+    wr.steps = g_steps;
+
+    size_t state = 0;
+    for (const Dev &d : devs) {
+        state += sizeof(Dev) + d.image.capacity() + d.seen.capacity() +
+                 d.air.size() * sizeof(InFlight);
+    }
+    wr.sim_bytes_per_dev = (double)state / wr.devices;
+    for (DevResult &r : res) r.disk_bytes = dir_bytes(dev_dir(r.id));
+
+    std::FILE *f = std::fopen(out, "wb");
+    if (!f) return 2;
+    bool ok = std::fwrite(&wr, sizeof(wr), 1, f) == 1 &&
+              std::fwrite(res.data(), sizeof(DevResult), res.size(), f) == res.size();
+    return std::fclose(f) == 0 && ok ? 0 : 2;
+}
+
+// ---------------------------------------------------------------- report
+
+struct RunResult {
+    unsigned workers;
+    double wall;
+    std::vector<WorkerResult> w;
+    std::vector<DevResult> devs;
+};
+
+bool run(unsigned workers, RunResult *out)
+{
+    out->workers = workers;
+    out->w.assign(workers, WorkerResult{});
+    out->devs.clear();
+    std::vector<pid_t> pids;
+    std::vector<std::string> files;
+
+    double t0 = wall_s();
+    std::fflush(stdout);
+    for (unsigned k = 0; k < workers; k++) {
+        uint32_t lo = (uint32_t)((uint64_t)g_cfg.devices * k / workers);
+        uint32_t hi = (uint32_t)((uint64_t)g_cfg.devices * (k + 1) / workers);
+        files.push_back(g_cfg.dir + "/w" + std::to_string(k) + ".res");
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::perror("fork");
+            return false;
+        }
+        if (pid == 0) _exit(worker(lo, hi, files.back().c_str()));
+        pids.push_back(pid);
+    }
+    bool ok = true;
+    for (pid_t pid : pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    out->wall = wall_s() - t0;
+    if (!ok) {
+        std::fprintf(stderr, "fleetsim: a worker failed\n");
+        return false;
+    }
+
+    for (unsigned k = 0; k < workers; k++) {
+        std::FILE *f = std::fopen(files[k].c_str(), "rb");
+        if (!f || std::fread(&out->w[k], sizeof(WorkerResult), 1, f) != 1) {
+            if (f) std::fclose(f);
+            return false;
+        }
+        size_t n = out->w[k].devices;
+        size_t at = out->devs.size();
+        out->devs.resize(at + n);
+        bool got = std::fread(&out->devs[at], sizeof(DevResult), n, f) == n;
+        std::fclose(f);
+        unlink(files[k].c_str());
+        if (!got) return false;
+    }
+    if (!g_cfg.keep) {
+        for (uint32_t id = 0; id < g_cfg.devices; id++) rm_dir(dev_dir(id));
+    }
+    return true;
+}
+
+double pct(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * (double)(v.size() - 1) + 0.5))];
+}
+
+void report(const RunResult &r)
+{
+    const double dev_hours = g_cfg.hours * g_cfg.devices;
+    uint64_t samples = 0, delivered = 0, dups = 0, lost = 0, link = 0, steps = 0, swaps = 0;
+    uint32_t failed = 0;
+    double heap = 0, fds = 0, sim = 0, boot = 0, run_s = 0, cpu = 0;
+    std::vector<double> rate, catchup, dup_share;
+    uint64_t disk = 0;
+    for (const DevResult &d : r.devs) {
+        samples += d.samples;
+        delivered += d.live_rx + d.backlog_rx;
+        dups += d.dup_rx;
+        lost += d.lost_live + d.stale_live;
+        link += d.link_bytes;
+        disk += d.disk_bytes;
+        if (!d.ok) failed++;
+        if (d.connected_s > 0) rate.push_back((double)(d.live_rx + d.backlog_rx + d.dup_rx) / d.connected_s);
+        if (d.caught_up) catchup.push_back(d.catchup_max_s);
+        uint32_t rx = d.live_rx + d.backlog_rx + d.dup_rx;
+        dup_share.push_back(rx ? 100.0 * d.dup_rx / rx : 0.0);
+    }
+    for (const WorkerResult &w : r.w) {
+        heap += w.heap_per_dev * w.devices;
+        fds += w.fds_per_dev * w.devices;
+        sim += w.sim_bytes_per_dev * w.devices;
+        boot = std::max(boot, w.boot_s);
+        run_s = std::max(run_s, w.run_s);
+        cpu += w.cpu_s;
+        steps += w.steps;
+        swaps += w.swaps;
+    }
+    const double n = (double)g_cfg.devices;
+
+    std::printf("fleet: %" PRIu32 " devices x %.2f h virtual, %u worker(s), session every %.0f min for %.0f s, "
+                "link %" PRIu32 " B/s, bulk budget %" PRIu32 " B/s\n",
+                g_cfg.devices, g_cfg.hours, r.workers, g_cfg.session_min, g_cfg.session_s,
+                g_cfg.link_bps, g_cfg.budget);
+    std::printf("wall %.2f s (boot %.2f s, run %.2f s), cpu %.2f s, %" PRIu64 " events, %" PRIu64
+                " image swaps\n", r.wall, boot, run_s, cpu, steps, swaps);
+    std::printf("aggregate: %.0f device-hours/s, %.0f x real time per device, %.0f samples/s, "
+                "%.0f records delivered/s, %.0f events/s\n",
+                dev_hours / r.wall, g_cfg.hours * 3600.0 * n / r.wall, samples / r.wall,
+                delivered / r.wall, steps / r.wall);
+    std::printf("per device: %.0f samples, %.0f delivered, %.1f%% redundant (p50 %.1f%%, max %.1f%%), "
+                "%.2f live lost at disconnect (then synced from the log), %.1f KB on the link\n",
+                samples / n, delivered / n, 100.0 * dups / std::max<uint64_t>(1, delivered + dups),
+                pct(dup_share, 0.5), pct(dup_share, 1.0), lost / n, link / n / 1e3);
+    std::printf("  records/s while connected: p10 %.1f  p50 %.1f  p90 %.1f  max %.1f\n",
+                pct(rate, 0.1), pct(rate, 0.5), pct(rate, 0.9), pct(rate, 1.0));
+    std::printf("  worst catch-up after connect: p50 %.1f s  p90 %.1f s  max %.1f s\n",
+                pct(catchup, 0.5), pct(catchup, 0.9), pct(catchup, 1.0));
+    std::printf("memory per device: image %zu B, firmware heap %.0f B, simulator %.0f B "
+                "(image copy + phone + link), %.2f open files, log %.1f KB on disk\n",
+                g_image.size, heap / n, sim / n, fds / n, disk / n / 1e3);
+    if (failed) std::printf("FAIL: %" PRIu32 " device(s) lost records or misordered a stream\n", failed);
+}
+
+void write_csv(const RunResult &r)
+{
+    std::FILE *f = std::fopen(g_cfg.csv, "w");
+    if (!f) {
+        std::fprintf(stderr, "fleetsim: %s: %s\n", g_cfg.csv, std::strerror(errno));
+        return;
+    }
+    std::fprintf(f, "device,samples,live_tx,appended,live_rx,backlog_rx,dup_rx,missing,lost_live,"
+                    "stale_live,lost_backlog,sessions,caught_up,connected_s,catchup_avg_s,"
+                    "catchup_max_s,link_bytes,disk_bytes,ok\n");
+    for (const DevResult &d : r.devs) {
+        std::fprintf(f, "%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32
+                        ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32
+                        ",%.1f,%.2f,%.2f,%" PRIu64 ",%" PRIu64 ",%d\n",
+                     d.id, d.samples, d.live_tx, d.appended, d.live_rx, d.backlog_rx, d.dup_rx,
+                     d.missing, d.lost_live, d.stale_live, d.lost_backlog, d.sessions, d.caught_up,
+                     d.connected_s, d.caught_up ? d.catchup_sum_s / d.caught_up : 0.0,
+                     d.catchup_max_s, d.link_bytes, d.disk_bytes, (int)d.ok);
+    }
+    std::fclose(f);
+}
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: fleetsim [--devices N] [--workers W | --scale] [--hours H]\n"
+                 "                [--session-min M] [--session-s S] [--ack-s S] [--link-bps B]\n"
+                 "                [--budget B] [--slice-s S] [--seed N] [--csv FILE] [--dir DIR] [--keep]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config &c = g_cfg;
+    const char *dir = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool more = i + 1 < argc;
+        if (!std::strcmp(a, "--devices") && more) {
+            c.devices = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(a, "--workers") && more) {
+            c.workers = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(a, "--scale")) {
+            c.scale = true;
+        } else if (!std::strcmp(a, "--hours") && more) {
+            c.hours = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--session-min") && more) {
+            c.session_min = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--session-s") && more) {
+            c.session_s = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--ack-s") && more) {
+            c.ack_s = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--link-bps") && more) {
+            c.link_bps = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(a, "--budget") && more) {
+            c.budget = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(a, "--slice-s") && more) {
+            c.slice_s = std::atof(argv[++i]);
+        } else if (!std::strcmp(a, "--seed") && more) {
+            c.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(a, "--csv") && more) {
+            c.csv = argv[++i];
+        } else if (!std::strcmp(a, "--dir") && more) {
+            dir = argv[++i];
+        } else if (!std::strcmp(a, "--keep")) {
+            c.keep = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!c.devices || c.hours <= 0 || c.session_min <= 0 || c.session_s <= 0 ||
+        c.ack_s <= 0 || !c.link_bps || !c.budget || c.slice_s <= 0) {
+        usage();
+        return 2;
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (!c.workers) c.workers = c.scale ? (unsigned)std::max(1L, cores) : 1;
+    if (c.workers > c.devices) c.workers = c.devices;
+
+    if (!image_init()) {
+        std::fprintf(stderr, "fleetsim: libfleet_fw's data segment not found\n");
+        return 2;
+    }
+    if (dir) {
+        // Devices chdir into their directories, so the path must not be relative.
+        char *abs = (mkdir(dir, 0755) == 0 || errno == EEXIST) ? realpath(dir, nullptr) : nullptr;
+        if (!abs) {
+            std::fprintf(stderr, "fleetsim: %s: %s\n", dir, std::strerror(errno));
+            return 2;
+        }
+        c.dir = abs;
+        std::free(abs);
+    } else {
+        // The log fsyncs every append; on tmpfs that costs nothing.
+        struct stat st;
+        const char *tmp = std::getenv("TMPDIR");
+        if (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) tmp = "/dev/shm";
+        std::string tmpl = std::string(tmp ? tmp : "/tmp") + "/fleetsim.XXXXXX";
+        std::vector<char> path(tmpl.begin(), tmpl.end());
+        path.push_back('\0');
+        if (!mkdtemp(path.data())) {
+            std::perror("fleetsim: scratch dir");
+            return 2;
+        }
+        c.dir = path.data();
+    }
+    // A device keeps its log open between samples.
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    std::vector<unsigned> plan;
+    if (c.scale) {
+        for (unsigned w = 1; w < c.workers; w *= 2) plan.push_back(w);
+        plan.push_back(c.workers);
+    } else {
+        plan.push_back(c.workers);
+    }
+
+    bool all_ok = true;
+    std::vector<RunResult> runs;
+    for (unsigned w : plan) {
+        RunResult r;
+        if (!run(w, &r)) return 2;
+        report(r);
+        for (const DevResult &d : r.devs) all_ok = all_ok && d.ok;
+        runs.push_back(std::move(r));
+        if (plan.size() > 1) std::printf("\n");
+    }
+    if (c.csv) write_csv(runs.back());
+
+    if (plan.size() > 1) {
+        std::printf("scaling (%ld cores):\n  workers  wall s  device-h/s  speedup  efficiency\n", cores);
+        for (const RunResult &r : runs) {
+            double speedup = runs[0].wall / r.wall;
+            std::printf("  %7u  %6.2f  %10.0f  %7.2f  %9.0f%%\n", r.workers, r.wall,
+                        g_cfg.hours * g_cfg.devices / r.wall, speedup, 100.0 * speedup / r.workers);
+        }
+    }
+    if (!c.keep && !dir) rmdir(c.dir.c_str());
+    return all_ok ? 0 : 1;
+}
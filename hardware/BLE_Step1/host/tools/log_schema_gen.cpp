@@ -0,0 +1,289 @@
+// Generate the Python and JS record decoders from main/log_schema.h.
+//
+//   log_schema_gen [--check] [--py FILE] [--js FILE] [--cjs FILE]
+//
+// The field list comes from the firmware's own log_schema_table(), so the
+// generated decoders match whatever this tree builds. Both also carry a
+// parser for the advertised table (Record Schema characteristic) and a
+// decoder driven by it, for records of another version. --cjs writes just
+// the layout as a CommonJS module, for the backend's log_pack batch decoder.
+//
+// --check compares instead of writing and exits 1 if a file is stale;
+// run it after changing LOG_RECORD_FIELDS.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "record_view.hpp"
+
+namespace {
+
+void usage()
+{
+    std::fprintf(stderr, "usage: log_schema_gen [--check] [--py FILE] [--js FILE] [--cjs FILE]\n");
+}
+
+char py_code(const fw::SchemaField &f)
+{
+    switch (f.code) {
+    case LOG_TCODE_U8:  return 'B';
+    case LOG_TCODE_I8:  return 'b';
+    case LOG_TCODE_U16: return 'H';
+    case LOG_TCODE_I16: return 'h';
+    case LOG_TCODE_U32: return 'I';
+    default:            return 'i';
+    }
+}
+
+const char *js_read(const fw::SchemaField &f)
+{
+    switch (f.code) {
+    case LOG_TCODE_U8:  return "readUInt8";
+    case LOG_TCODE_I8:  return "readInt8";
+    case LOG_TCODE_U16: return "readUInt16LE";
+    case LOG_TCODE_I16: return "readInt16LE";
+    case LOG_TCODE_U32: return "readUInt32LE";
+    default:            return "readInt32LE";
+    }
+}
+
+std::string py_module(const fw::Schema &s)
+{
+    std::ostringstream o;
+    o << "# Generated by host/tools/log_schema_gen from main/log_schema.h. Do not edit.\n"
+         "\"\"\"battery_log_t decoder: this build's layout, or any layout read from\n"
+         "the device's Record Schema characteristic.\"\"\"\n"
+         "import struct\n\n"
+      << "RECORD_VERSION = " << s.record_version << "\n"
+      << "RECORD_SIZE = " << s.record_size << "\n";
+
+    o << "FMT = \"<";
+    for (const fw::SchemaField &f : s.fields) {
+        if (f.count > 1) o << (unsigned)f.count;
+        o << py_code(f);
+    }
+    o << "\"\n\n# (name, count, exp10, unit): value in unit = raw * 10**exp10\nFIELDS = [\n";
+    for (const fw::SchemaField &f : s.fields) {
+        o << "    (\"" << f.name << "\", " << (unsigned)f.count << ", " << (int)f.exp10 << ", \""
+          << f.unit << "\"),\n";
+    }
+    o << "]\n\n";
+
+    o << "_TYPES = {0x01: \"B\", 0x81: \"b\", 0x02: \"H\", 0x82: \"h\", 0x04: \"I\", 0x84: \"i\"}\n\n\n"
+         "def decode(payload):\n"
+         "    \"\"\"First RECORD_SIZE bytes of payload to a dict; arrays as lists.\"\"\"\n"
+         "    vals = struct.unpack_from(FMT, payload)\n"
+         "    rec, i = {}, 0\n"
+         "    for name, count, _, _ in FIELDS:\n"
+         "        rec[name] = vals[i] if count == 1 else list(vals[i:i + count])\n"
+         "        i += count\n"
+         "    return rec\n\n\n"
+         "def parse_schema_table(buf):\n"
+         "    \"\"\"Record Schema characteristic value to (version, size, fields);\n"
+         "    fields are (name, code, count, offset, exp10, unit).\"\"\"\n"
+         "    if len(buf) < 5 or buf[0] != " << LOG_SCHEMA_TABLE_VERSION << ":\n"
+         "        raise ValueError(\"unknown schema table\")\n"
+         "    version, size, n = buf[1], buf[2] | buf[3] << 8, buf[4]\n"
+         "    fields, pos = [], 5\n"
+         "    for _ in range(n):\n"
+         "        code, count, offset, exp10 = struct.unpack_from(\"<BBBb\", buf, pos)\n"
+         "        pos += 4\n"
+         "        end = buf.index(0, pos)\n"
+         "        name = bytes(buf[pos:end]).decode()\n"
+         "        pos = end + 1\n"
+         "        end = buf.index(0, pos)\n"
+         "        unit = bytes(buf[pos:end]).decode()\n"
+         "        pos = end + 1\n"
+         "        fields.append((name, code, count, offset, exp10, unit))\n"
+         "    return version, size, fields\n\n\n"
+         "def decode_with_schema(payload, schema):\n"
+         "    \"\"\"Like decode(), for the layout parse_schema_table() returned.\"\"\"\n"
+         "    _, _, fields = schema\n"
+         "    rec = {}\n"
+         "    for name, code, count, offset, _, _ in fields:\n"
+         "        vals = struct.unpack_from(\"<%d%s\" % (count, _TYPES[code]), payload, offset)\n"
+         "        rec[name] = vals[0] if count == 1 else list(vals)\n"
+         "    return rec\n";
+    return o.str();
+}
+
+std::string js_module(const fw::Schema &s)
+{
+    std::ostringstream o;
+    o << "// Generated by hardware/BLE_Step1/host/tools/log_schema_gen from\n"
+         "// main/log_schema.h. Do not edit.\n"
+         "//\n"
+         "// decodeRecord() reads this build's battery_log_t layout from a Buffer;\n"
+         "// parseSchemaTable() / decodeWithSchema() decode any layout the device\n"
+         "// advertises on its Record Schema characteristic.\n\n"
+      << "export const RECORD_VERSION = " << s.record_version << ";\n"
+      << "export const RECORD_SIZE = " << s.record_size << ";\n"
+      << "export const RECORD_SCHEMA_UUID = 'aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee5';\n\n"
+      << "// { name, count, exp10, unit }: value in unit = raw * 10 ** exp10\n"
+         "export const FIELDS = [\n";
+    for (const fw::SchemaField &f : s.fields) {
+        o << "  { name: '" << f.name << "', count: " << (unsigned)f.count << ", exp10: " << (int)f.exp10
+          << ", unit: '" << f.unit << "' },\n";
+    }
+    o << "];\n\n"
+         "export const decodeRecord = (buf) => {\n"
+         "  if (buf.length < RECORD_SIZE) {\n"
+         "    return null;\n"
+         "  }\n"
+         "  return {\n";
+    for (const fw::SchemaField &f : s.fields) {
+        o << "    " << f.name << ": ";
+        if (f.count == 1) {
+            o << "buf." << js_read(f) << "(" << (unsigned)f.offset << "),\n";
+            continue;
+        }
+        o << "[";
+        for (unsigned i = 0; i < f.count; i++) {
+            o << (i ? (i % 4 ? ", " : ",\n      ") : "\n      ") << "buf." << js_read(f) << "("
+              << f.offset + i * f.size() << ")";
+        }
+        o << ",\n    ],\n";
+    }
+    o << "  };\n"
+         "};\n\n"
+         "const READERS = {\n"
+         "  0x01: 'readUInt8', 0x81: 'readInt8',\n"
+         "  0x02: 'readUInt16LE', 0x82: 'readInt16LE',\n"
+         "  0x04: 'readUInt32LE', 0x84: 'readInt32LE',\n"
+         "};\n\n"
+         "export const parseSchemaTable = (buf) => {\n"
+         "  if (buf.length < 5 || buf[0] !== " << LOG_SCHEMA_TABLE_VERSION << ") {\n"
+         "    return null;\n"
+         "  }\n"
+         "  const schema = { version: buf[1], size: buf.readUInt16LE(2), fields: [] };\n"
+         "  let pos = 5;\n"
+         "  const str = () => {\n"
+         "    const end = buf.indexOf(0, pos);\n"
+         "    const s = buf.toString('utf8', pos, end);\n"
+         "    pos = end + 1;\n"
+         "    return s;\n"
+         "  };\n"
+         "  for (let i = 0; i < buf[4]; i++) {\n"
+         "    const code = buf[pos];\n"
+         "    const count = buf[pos + 1];\n"
+         "    const offset = buf[pos + 2];\n"
+         "    const exp10 = buf.readInt8(pos + 3);\n"
+         "    pos += 4;\n"
+         "    const name = str();\n"
+         "    const unit = str();\n"
+         "    if (!READERS[code]) {\n"
+         "      return null;\n"
+         "    }\n"
+         "    schema.fields.push({ name, code, count, offset, exp10, unit, size: code & 0x0f });\n"
+         "  }\n"
+         "  return schema;\n"
+         "};\n\n"
+         "export const decodeWithSchema = (buf, schema) => {\n"
+         "  if (!schema || schema.version === RECORD_VERSION) {\n"
+         "    return decodeRecord(buf);\n"
+         "  }\n"
+         "  if (buf.length < schema.size) {\n"
+         "    return null;\n"
+         "  }\n"
+         "  const rec = {};\n"
+         "  for (const f of schema.fields) {\n"
+         "    const read = (i) => buf[READERS[f.code]](f.offset + i * f.size);\n"
+         "    rec[f.name] = f.count === 1 ? read(0) : Array.from({ length: f.count }, (_, i) => read(i));\n"
+         "  }\n"
+         "  return rec;\n"
+         "};\n";
+    return o.str();
+}
+
+std::string cjs_module(const fw::Schema &s)
+{
+    std::ostringstream o;
+    o << "// Generated by hardware/BLE_Step1/host/tools/log_schema_gen from\n"
+         "// main/log_schema.h. Do not edit.\n"
+         "//\n"
+         "// This build's battery_log_t layout; utils/logBatch.js decodes the\n"
+         "// device's log_pack upload batches with it.\n\n"
+      << "const RECORD_VERSION = " << s.record_version << ";\n"
+      << "const RECORD_SIZE = " << s.record_size << ";\n\n"
+      << "// { name, code, count, offset, exp10, unit }: code is LOG_TCODE_* (low\n"
+         "// nibble = bytes, 0x80 = signed); value in unit = raw * 10 ** exp10\n"
+         "const FIELDS = [\n";
+    for (const fw::SchemaField &f : s.fields) {
+        char code[8];
+        std::snprintf(code, sizeof(code), "0x%02x", f.code);
+        o << "  { name: '" << f.name << "', code: " << code << ", count: " << (unsigned)f.count
+          << ", offset: " << (unsigned)f.offset << ", exp10: " << (int)f.exp10 << ", unit: '"
+          << f.unit << "' },\n";
+    }
+    o << "];\n\n"
+         "module.exports = { RECORD_VERSION, RECORD_SIZE, FIELDS };\n";
+    return o.str();
+}
+
+// Writes (or with check, compares); false if the file was stale or unwritable.
+bool emit(const char *path, const std::string &text, bool check)
+{
+    if (check) {
+        std::ifstream in(path, std::ios::binary);
+        std::string cur((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.is_open() || cur != text) {
+            std::fprintf(stderr, "%s: stale, rerun log_schema_gen\n", path);
+            return false;
+        }
+        std::printf("%s: up to date\n", path);
+        return true;
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+    if (!out.good()) {
+        std::fprintf(stderr, "%s: write failed\n", path);
+        return false;
+    }
+    std::printf("%s: record v%u, %d bytes\n", path, LOG_RECORD_VERSION, LOG_RECORD_SIZE_BYTES);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *py = nullptr;
+    const char *js = nullptr;
+    const char *cjs = nullptr;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--check")) {
+            check = true;
+        } else if (!std::strcmp(argv[i], "--py") && i + 1 < argc) {
+            py = argv[++i];
+        } else if (!std::strcmp(argv[i], "--js") && i + 1 < argc) {
+            js = argv[++i];
+        } else if (!std::strcmp(argv[i], "--cjs") && i + 1 < argc) {
+            cjs = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!py && !js && !cjs) {
+        usage();
+        return 2;
+    }
+
+    fw::Schema s = fw::Schema::local();
+    if (s.fields.empty()) {
+        std::fprintf(stderr, "log_schema_table failed\n");
+        return 1;
+    }
+
+    bool ok = true;
+    if (py) ok = emit(py, py_module(s), check) && ok;
+    if (js) ok = emit(js, js_module(s), check) && ok;
+    if (cjs) ok = emit(cjs, cjs_module(s), check) && ok;
+    return ok ? 0 : 1;
+}
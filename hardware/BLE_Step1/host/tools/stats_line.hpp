@@ -0,0 +1,43 @@
+#pragma once
+// Parser for stats characteristic lines ("section:key=value,key=value").
+// Lines may carry a serial-log prefix; everything before "<section>:" is ignored.
+
+#include <cstdlib>
+#include <map>
+#include <string>
+
+namespace fw {
+
+using StatsSection = std::map<std::string, std::string>;
+
+inline bool parse_stats_line(const std::string &line, const std::string &section, StatsSection &out)
+{
+    const std::string tag = section + ":";
+    size_t pos = line.find(tag);
+    if (pos == std::string::npos) return false;
+    if (pos > 0 && line[pos - 1] != ' ' && line[pos - 1] != ')') return false;
+
+    size_t i = pos + tag.size();
+    while (i < line.size()) {
+        size_t comma = line.find(',', i);
+        std::string kv = line.substr(i, comma == std::string::npos ? std::string::npos : comma - i);
+        size_t eq = kv.find('=');
+        if (eq != std::string::npos) {
+            std::string v = kv.substr(eq + 1);
+            while (!v.empty() && (v.back() == '\r' || v.back() == '\n' || v.back() == ' ')) v.pop_back();
+            out[kv.substr(0, eq)] = v;
+        }
+        if (comma == std::string::npos) break;
+        i = comma + 1;
+    }
+    return true;
+}
+
+inline double stats_num(const StatsSection &s, const std::string &key, double def = 0.0)
+{
+    auto it = s.find(key);
+    if (it == s.end()) return def;
+    return std::strtod(it->second.c_str(), nullptr);
+}
+
+} // namespace fw
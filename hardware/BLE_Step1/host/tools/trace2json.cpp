@@ -0,0 +1,386 @@
+// Convert a trace_rec dump to Chrome / Perfetto trace JSON.
+//
+//   trace2json [--summary-only] INPUT [OUTPUT.json]
+//
+// INPUT is the binary dump (pieces read from the trace characteristic,
+// offsets stripped and concatenated) or a serial capture containing the
+// "TRACE <off> <hex>" lines of trace_rec_dump_serial(); other log lines
+// are ignored. Open the JSON in ui.perfetto.dev or chrome://tracing:
+// "cores" has one track per CPU showing which task ran, "tasks" one track
+// per task with the log / sensor / notify / OTA spans it executed.
+//
+// A summary goes to stderr: CPU time per task and, per span, the count,
+// mean and worst duration, which is where flash stalls show up first.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "trace_rec.h"
+
+namespace {
+
+constexpr int kTaskUnknown = 0xFF;
+
+void usage()
+{
+    std::fprintf(stderr, "usage: trace2json [--summary-only] INPUT [OUTPUT.json]\n");
+}
+
+int hexval(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "TRACE <off> <hex>" lines, possibly behind a log prefix. Pieces are
+// placed at their offset, so a capture with repeated lines still works.
+bool parse_serial(const std::string &text, std::vector<uint8_t> &out)
+{
+    bool any = false;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        std::string line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        size_t t = line.find("TRACE ");
+        if (t == std::string::npos) continue;
+        const char *p = line.c_str() + t + 6;
+        char *end = nullptr;
+        unsigned long off = std::strtoul(p, &end, 16);
+        if (end == p || *end != ' ') continue;      // "TRACE begin" / "TRACE end"
+        p = end + 1;
+
+        std::vector<uint8_t> bytes;
+        while (hexval(p[0]) >= 0 && hexval(p[1]) >= 0) {
+            bytes.push_back((uint8_t)(hexval(p[0]) << 4 | hexval(p[1])));
+            p += 2;
+        }
+        if (out.size() < off + bytes.size()) out.resize(off + bytes.size());
+        std::copy(bytes.begin(), bytes.end(), out.begin() + (long)off);
+        any = true;
+    }
+    return any;
+}
+
+struct Dump {
+    trace_dump_hdr_t hdr{};
+    std::vector<std::string> tasks;
+    std::vector<std::string> spans;
+    std::vector<trace_event_t> events;
+};
+
+bool parse_dump(const std::vector<uint8_t> &b, Dump &d, std::string *err)
+{
+    if (b.size() < sizeof(d.hdr)) {
+        *err = "too short for a dump header";
+        return false;
+    }
+    std::memcpy(&d.hdr, b.data(), sizeof(d.hdr));
+    if (d.hdr.magic != TRACE_DUMP_MAGIC || d.hdr.version != TRACE_DUMP_VERSION) {
+        *err = "not a trace_rec dump (magic/version)";
+        return false;
+    }
+    size_t nl = d.hdr.name_len;
+    size_t names = (size_t)(d.hdr.n_tasks + d.hdr.n_spans) * nl;
+    size_t need = sizeof(d.hdr) + names + (size_t)d.hdr.n_events * sizeof(trace_event_t);
+    if (b.size() < need) {
+        *err = "truncated: " + std::to_string(b.size()) + " of " + std::to_string(need) + " bytes";
+        return false;
+    }
+
+    const uint8_t *p = b.data() + sizeof(d.hdr);
+    for (int i = 0; i < d.hdr.n_tasks + d.hdr.n_spans; i++, p += nl) {
+        std::string s(reinterpret_cast<const char *>(p), strnlen(reinterpret_cast<const char *>(p), nl));
+        (i < d.hdr.n_tasks ? d.tasks : d.spans).push_back(s);
+    }
+    d.events.resize(d.hdr.n_events);
+    std::memcpy(d.events.data(), p, d.events.size() * sizeof(trace_event_t));
+    return true;
+}
+
+std::string json_str(const std::string &s)
+{
+    std::string o = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') o += '\\';
+        if ((unsigned char)c < 0x20) continue;
+        o += c;
+    }
+    return o + "\"";
+}
+
+struct SpanStat {
+    uint64_t n = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    int64_t max_at = 0;
+};
+
+class Converter {
+public:
+    explicit Converter(const Dump &d) : d_(d) {}
+
+    void run(std::FILE *out)
+    {
+        out_ = out;
+        emit_meta();
+
+        int64_t t = 0;
+        uint32_t prev = d_.events.empty() ? 0 : d_.events[0].ts_us;
+        for (const trace_event_t &e : d_.events) {
+            // 32-bit microseconds: unwrap, tolerating the slight disorder of
+            // two cores stamping their events.
+            t += (int32_t)(e.ts_us - prev);
+            prev = e.ts_us;
+
+            int core = e.type >> 7;
+            int type = e.type & 0x7F;
+            switch (type) {
+            case TRACE_EV_TASK_IN: task_in(core, e.id, t); break;
+            case TRACE_EV_BEGIN:   span_begin(core, e.id, e.arg, t); break;
+            case TRACE_EV_END:     span_end(core, e.id, t); break;
+            case TRACE_EV_MARK:    mark(core, e.id, e.arg, t); break;
+            default: bad_++; break;
+            }
+        }
+        end_ = t;
+        for (int c = 0; c < 2; c++) task_in(c, -1, t);     // close the last slices
+
+        if (out_) {
+            std::fprintf(out_, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"events\":%u,"
+                               "\"lost\":%u,\"dropped\":%u}}\n",
+                         (unsigned)d_.hdr.n_events, (unsigned)d_.hdr.lost, (unsigned)d_.hdr.dropped);
+        }
+    }
+
+    void summary() const
+    {
+        std::fprintf(stderr, "events=%u lost=%u dropped=%u span=%.3f s tasks=%zu spans=%zu\n",
+                     (unsigned)d_.hdr.n_events, (unsigned)d_.hdr.lost, (unsigned)d_.hdr.dropped,
+                     (double)end_ / 1e6, d_.tasks.size(), d_.spans.size());
+        if (bad_ || unmatched_) {
+            std::fprintf(stderr, "  %llu unknown events, %llu unmatched span ends (ring wrap)\n",
+                         (unsigned long long)bad_, (unsigned long long)unmatched_);
+        }
+
+        std::fprintf(stderr, "\n%-16s %10s %7s %9s\n", "task", "cpu ms", "cpu %", "switches");
+        for (const auto &kv : cpu_) {
+            std::fprintf(stderr, "%-16s %10.3f %6.2f%% %9llu\n", task_name(kv.first).c_str(),
+                         (double)kv.second / 1e3, end_ ? 100.0 * (double)kv.second / (double)end_ : 0.0,
+                         (unsigned long long)switches_.at(kv.first));
+        }
+
+        std::fprintf(stderr, "\n%-16s %8s %10s %10s %12s\n", "span", "count", "mean us", "max us", "max at ms");
+        for (const auto &kv : spans_) {
+            const SpanStat &s = kv.second;
+            std::fprintf(stderr, "%-16s %8llu %10.1f %10llu %12.3f\n", span_name(kv.first).c_str(),
+                         (unsigned long long)s.n, s.n ? (double)s.total_us / (double)s.n : 0.0,
+                         (unsigned long long)s.max_us, (double)s.max_at / 1e3);
+        }
+    }
+
+private:
+    std::string task_name(int slot) const
+    {
+        if (slot >= 0 && slot < (int)d_.tasks.size()) return d_.tasks[slot];
+        return slot == kTaskUnknown ? "?" : "task" + std::to_string(slot);
+    }
+
+    std::string span_name(int id) const
+    {
+        return id < (int)d_.spans.size() ? d_.spans[id] : "span" + std::to_string(id);
+    }
+
+    void sep()
+    {
+        std::fputs(first_ ? "\n" : ",\n", out_);
+        first_ = false;
+    }
+
+    void emit_meta()
+    {
+        if (!out_) return;
+        std::fputs("{\"traceEvents\":[", out_);
+        sep();
+        std::fputs("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"cores\"}}", out_);
+        sep();
+        std::fputs("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"tasks\"}}", out_);
+        for (int c = 0; c < 2; c++) {
+            sep();
+            std::fprintf(out_, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%d,"
+                               "\"args\":{\"name\":\"core %d\"}}", c, c);
+        }
+        for (size_t i = 0; i < d_.tasks.size(); i++) {
+            sep();
+            std::fprintf(out_, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%zu,"
+                               "\"args\":{\"name\":%s}}", i, json_str(d_.tasks[i]).c_str());
+        }
+    }
+
+    // A slice on the core track for whatever ran since the last switch.
+    void task_in(int core, int slot, int64_t t)
+    {
+        if (cur_[core] >= 0) {
+            int64_t dur = t - since_[core];
+            cpu_[cur_[core]] += (uint64_t)dur;
+            if (out_) {
+                sep();
+                std::fprintf(out_, "{\"ph\":\"X\",\"name\":%s,\"pid\":0,\"tid\":%d,\"ts\":%" PRId64
+                                   ",\"dur\":%" PRId64 "}",
+                             json_str(task_name(cur_[core])).c_str(), core, since_[core], dur);
+            }
+        }
+        if (slot >= 0) switches_[slot]++;
+        cur_[core] = slot;
+        since_[core] = t;
+    }
+
+    int task_on(int core) const
+    {
+        return cur_[core] >= 0 ? cur_[core] : kTaskUnknown;
+    }
+
+    void span_begin(int core, int id, uint16_t arg, int64_t t)
+    {
+        int tid = task_on(core);
+        open_[{tid, id}].push_back(t);
+        if (!out_) return;
+        sep();
+        std::fprintf(out_, "{\"ph\":\"B\",\"name\":%s,\"pid\":1,\"tid\":%d,\"ts\":%" PRId64,
+                     json_str(span_name(id)).c_str(), tid, t);
+        if (arg) std::fprintf(out_, ",\"args\":{\"arg\":%u}", (unsigned)arg);
+        std::fputs("}", out_);
+    }
+
+    // Ends whose begin was overwritten are dropped: the viewers would pair
+    // them with the wrong slice.
+    void span_end(int core, int id, int64_t t)
+    {
+        int tid = task_on(core);
+        auto it = open_.find({tid, id});
+        if (it == open_.end() || it->second.empty()) {
+            unmatched_++;
+            return;
+        }
+        int64_t t0 = it->second.back();
+        it->second.pop_back();
+
+        SpanStat &s = spans_[id];
+        uint64_t dur = (uint64_t)(t - t0);
+        s.n++;
+        s.total_us += dur;
+        if (dur > s.max_us) {
+            s.max_us = dur;
+            s.max_at = t0;
+        }
+        if (!out_) return;
+        sep();
+        std::fprintf(out_, "{\"ph\":\"E\",\"name\":%s,\"pid\":1,\"tid\":%d,\"ts\":%" PRId64 "}",
+                     json_str(span_name(id)).c_str(), tid, t);
+    }
+
+    void mark(int core, int id, uint16_t arg, int64_t t)
+    {
+        if (!out_) return;
+        sep();
+        std::fprintf(out_, "{\"ph\":\"i\",\"s\":\"g\",\"name\":%s,\"pid\":1,\"tid\":%d,\"ts\":%" PRId64
+                           ",\"args\":{\"arg\":%u}}",
+                     json_str(span_name(id)).c_str(), task_on(core), t, (unsigned)arg);
+    }
+
+    const Dump &d_;
+    std::FILE *out_ = nullptr;
+    bool first_ = true;
+    int cur_[2] = {-1, -1};
+    int64_t since_[2] = {0, 0};
+    int64_t end_ = 0;
+    uint64_t bad_ = 0;
+    uint64_t unmatched_ = 0;
+    std::map<std::pair<int, int>, std::vector<int64_t>> open_;
+    std::map<int, uint64_t> cpu_;
+    std::map<int, uint64_t> switches_;
+    std::map<int, SpanStat> spans_;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *input = nullptr;
+    const char *output = nullptr;
+    bool summary_only = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--summary-only")) {
+            summary_only = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage();
+            return 2;
+        } else if (!input) {
+            input = argv[i];
+        } else if (!output) {
+            output = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!input) {
+        usage();
+        return 2;
+    }
+
+    std::ifstream in(input, std::ios::binary);
+    if (!in) {
+        std::perror(input);
+        return 1;
+    }
+    std::vector<uint8_t> raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Binary dumps start with the magic; anything else is taken as a capture.
+    std::vector<uint8_t> bytes;
+    uint32_t magic = 0;
+    if (raw.size() >= 4) std::memcpy(&magic, raw.data(), 4);
+    if (magic == TRACE_DUMP_MAGIC) {
+        bytes = std::move(raw);
+    } else if (!parse_serial(std::string(raw.begin(), raw.end()), bytes)) {
+        std::fprintf(stderr, "trace2json: %s: no dump and no TRACE lines\n", input);
+        return 1;
+    }
+
+    Dump d;
+    std::string err;
+    if (!parse_dump(bytes, d, &err)) {
+        std::fprintf(stderr, "trace2json: %s: %s\n", input, err.c_str());
+        return 1;
+    }
+
+    Converter conv(d);
+    std::FILE *out = nullptr;
+    if (!summary_only) {
+        out = output ? std::fopen(output, "w") : stdout;
+        if (!out) {
+            std::perror(output);
+            return 1;
+        }
+    }
+    conv.run(out);
+    if (out && out != stdout && std::fclose(out) != 0) {
+        std::fprintf(stderr, "trace2json: write failed\n");
+        return 1;
+    }
+    conv.summary();
+    return 0;
+}
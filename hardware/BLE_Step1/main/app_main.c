@@ -1,147 +1,272 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "nvs_flash.h"
 #include "esp_err.h"
 
 #include "ble_stack.h"
 #include "ble_batt_mock.h"
+#include "backlog_job.h"
 #include "storage.h"
 #include "battery_log.h"
+#include "log_migrate.h"
+#include "ble_sync.h"
+#include "power_mgmt.h"
+#include "sampler.h"
+#include "sample_clock.h"
+#include "soc_est.h"
+#include "frame_crypt.h"
+#include "mem_plan.h"
+#include "trace_rec.h"
+#include "sensor_backend.h"
+#include "boot_prof.h"
+#include "wifi_offload.h"
+#include "serial_dump.h"
 
 #include <stdio.h>
 #include <time.h>
 #include <inttypes.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <dirent.h>
 
 static const char *TAGT = "APP_MAIN";
 
-const TickType_t mbuf_retry_delay   = pdMS_TO_TICKS(200);
+const TickType_t mbuf_retry_delay   = pdMS_TO_TICKS(20);
 
+// Fast boot: BLE starts first and advertises while LittleFS mounts and the
+// log loads; the boot-log write runs later in a low-priority task, without
+// the remount. -DAPP_FAST_BOOT=0 restores the serial sequence.
+#ifndef APP_FAST_BOOT
+#define APP_FAST_BOOT 1
+#endif
 
-static void mock_sender_task(void *arg)
+// Stack bytes; the "stacks" stats section shows the peak actually used.
+#define MOCK_SENDER_STACK  4096
+#define SAMPLE_TASK_STACK  3072
+
+#define SAMPLE_TASK_PRIO   7        // above mock_sender (5) and notify_tx (6)
+#define MOCK_SENDER_PRIO   5
+
+// Sampling and storage run on the core the NimBLE host does not (the
+// controller, esp_timer and Wi-Fi are on core 0 too), so a flash write or a
+// sensor read never waits for host work, nor host work for them.
+#ifndef APP_SAMPLE_CORE
+#if CONFIG_FREERTOS_UNICORE
+#define APP_SAMPLE_CORE 0
+#elif defined(CONFIG_BT_NIMBLE_PINNED_TO_CORE)
+#define APP_SAMPLE_CORE (1 - CONFIG_BT_NIMBLE_PINNED_TO_CORE)
+#else
+#define APP_SAMPLE_CORE 1
+#endif
+#endif
+
+// Samples from sample_task to mock_sender, which numbers, sends and stores them.
+typedef struct {
+    battery_log_t rec;
+    int64_t t_wake;             // esp_timer at the wake-up that took it
+} sample_item_t;
+
+#define SAMPLE_QUEUE_LEN 4
+
+static QueueHandle_t s_sampleq;
+static StaticQueue_t s_sampleq_buf;
+static uint8_t s_sampleq_storage[SAMPLE_QUEUE_LEN * sizeof(sample_item_t)];
+
+// Converts an old-format log a batch at a time below the sampler's priority;
+// the swap itself happens on the next append (mock_sender).
+static void log_migrate_task(void *arg)
+{
+    (void)arg;
+    const TickType_t batch_gap = pdMS_TO_TICKS(20);
+    int left;
+
+    for (;;) {
+        battery_log_lock();     // readers go through the converted view
+        left = log_migrate_run_batch();
+        battery_log_unlock();
+        if (left <= 0) break;
+        vTaskDelay(batch_gap);
+    }
+    if (left < 0) {
+        ESP_LOGE(TAGT, "log migration stopped, resumes on next boot");
+    }
+    vTaskDelete(NULL);
+}
+
+
+// Acquisition, on the sampling clock's grid. It runs above mock_sender, so a
+// sample due while the sender writes flash or pumps a backlog is still taken
+// on time; the sender then numbers, sends and stores it.
+static void sample_task(void *arg)
 {
     (void)arg;
-    const TickType_t backlog_cooldown = pdMS_TO_TICKS(250);
+    sample_item_t item;
 
     while (1) {
+        // With tickless idle this wait is where the CPU light-sleeps.
+        item.t_wake = sample_clock_wait();
+        if (sensor_read(&item.rec) != ESP_OK) {
+            continue;   // keep the cadence; a missed snapshot is visible in the sensor stats
+        }
+        sample_clock_set_period(sampler_on_sample(&item.rec, item.t_wake));
+        soc_est_update(&item.rec, item.t_wake);
+
+        // Blocks only while the sender is a whole queue behind; the slots
+        // that costs show up as missed in the "clock" stats.
+        xQueueSendToBack(s_sampleq, &item, portMAX_DELAY);
+        ble_backlog_kick();
+    }
+}
+
+static void store_sample(sample_item_t *item)
+{
+    battery_log_t *rec = &item->rec;
+
+    rec->seq = battery_log_next_seq();
+    boot_prof_mark(BOOT_PH_FIRST_SAMPLE);
+    ESP_LOGI(TAGT, "LIVE rec ts=%u seq=%" PRIu32, rec->timestamp_s, rec->seq);
+    // Live first, for its latency. A queued live frame can still be dropped
+    // (stale at a disconnect, class queue overflow), so every sample goes
+    // to the log too; the client's ACK watermark skips what it got live.
+    if (ble_batt_mock_is_subscribed()) {
+        (void)ble_batt_mock_notify_live(rec);
+    }
+    int ar = battery_log_append(rec);
+    if (ar != 0) ESP_LOGW(TAGT, "append failed rc=%d", ar);
+
+    power_mgmt_note_sample();
+    power_mgmt_note_active((uint32_t)(esp_timer_get_time() - item->t_wake));
+    mem_plan_boot_done();   // first pass done: heap baseline (once)
+}
+
+static void mock_sender_task(void *arg)
+{
+    (void)arg;
+    // While a backlog is queued, wake at least this often to refill the
+    // scheduler's backlog queue (8 records per 20 ms is well above the budget).
+    const TickType_t backlog_poll = mbuf_retry_delay;
 
-        if (ble_backlog_requested()) {
-
-            if (ble_batt_is_sending_backlog()) {
-                ESP_LOGI(TAGT, "BACKLOG: request ignored - already sending");
-                ble_backlog_clear_request();
-                vTaskDelay(pdMS_TO_TICKS(200));
-                continue;
-            }
-
-            // Gate on backlog subscription
-            if (!ble_backlog_is_subscribed()) {
-                ESP_LOGI(TAGT, "BACKLOG: request ignored - backlog not subscribed");
-                ble_backlog_clear_request();
-                vTaskDelay(pdMS_TO_TICKS(200));
-                continue;
-            }
-
-            ble_batt_set_sending_backlog(true);
-            ble_backlog_clear_request();
-
-            int count = battery_log_count();
-
-            backlog_request_t req = ble_backlog_get_request();
-            int start_idx = 0;
-
-            if (req.mode == BACKLOG_MODE_FROM_SEQ) {
-                start_idx = battery_log_find_start_index_by_seq(req.start_seq);
-            } else {
-                start_idx = 0;
-            }
-
-            printf("BACKLOG: start count=%d start_idx=%d mode=%d start_seq=%u\n",
-                count, start_idx, (int)req.mode, (unsigned)req.start_seq);
-
-            if (start_idx >= count) {
-                printf("BACKLOG: nothing to send (start_idx=%d count=%d)\n", start_idx, count);
-            } else {
-
-                ble_backlog_clear_abort();
-                for (int i = start_idx; i < count; i++) {
-                    // Check for abort request during sending
-                    if (ble_backlog_abort_requested()) {
-                        ESP_LOGI(TAGT, "BACKLOG: abort signal received at i=%d", i);
-                        break;
-                    }
-
-                    battery_log_t rec;
-                    if (!battery_log_read(i, &rec)) {
-                        printf("BACKLOG: read failed i=%d\n", i);
-                        continue;
-                    }
-
-                    
-                    if (i == start_idx) {
-                        printf("BACKLOG: first seq=%u idx=%u\n",
-                            (unsigned)rec.seq, (unsigned)i);
-                    }
-
-                    int rc = ble_batt_mock_notify_backlog(&rec);
-
-                    
-                    if (rc == -2) { // mbuf alloc failed
-                        ESP_LOGW(TAGT, "BACKLOG: mbuf alloc failed, cooling down and retry i=%d", i);
-                        vTaskDelay(mbuf_retry_delay);
-                        i--; // retry same record
-                        continue;
-                    }
-
-                    if (rc != 0) {
-                        printf("BACKLOG: notify rc=%d i=%d - aborting\n", rc, i);
-                        break;
-                    }
-
-                    vTaskDelay(pdMS_TO_TICKS(20));
-                }
-            }
-            printf("BACKLOG: done\n");
-            vTaskDelay(backlog_cooldown);
-            ble_batt_set_sending_backlog(false);
-            continue;
+    while (1) {
+        sample_item_t item;
+        while (xQueueReceive(s_sampleq, &item, 0) == pdTRUE) {
+            store_sample(&item);
         }
 
-        battery_log_t rec;
-        ble_batt_mock_build_record(&rec);
-        rec.seq = battery_log_next_seq();
-        ESP_LOGI(TAGT, "LIVE rec ts=%u seq=%" PRIu32, rec.timestamp_s, rec.seq);
-        if (ble_batt_mock_is_subscribed()) {
-            int rc = ble_batt_mock_notify_live(&rec);
-            if (rc != 0) {
-                int ar = battery_log_append(&rec);
-                if (ar != 0) ESP_LOGW(TAGT, "append failed rc=%d", ar);
-            }
+        backlog_job_pump();
+
+        // Block on the command queue; sample_task wakes it with a kick.
+        TickType_t wait = portMAX_DELAY;
+        if (backlog_job_active()) {
+            wait = backlog_poll;
         } else {
-            int ar = battery_log_append(&rec);
-            if (ar != 0) ESP_LOGW(TAGT, "append failed rc=%d", ar);
+            battery_log_idle();     // e.g. pre-erase the next log sector
+            ble_sync_persist();     // ACKs since the last wait
+            soc_est_persist();
         }
 
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        backlog_cmd_t cmd;
+        if (ble_backlog_wait_cmd(&cmd, wait)) {
+            // A PUMP (sample queued or bulk channel SDU done) is handled at the top.
+            backlog_job_handle(&cmd);
+        }
     }
 }
 
+#if APP_FAST_BOOT
+// Diagnostics that used to sit on the boot path. No remount: the log is
+// already in use by the time this runs.
+static void boot_diag_task(void *arg)
+{
+    (void)arg;
+    storage_boot_diag(false);
+    boot_prof_mark(BOOT_PH_DIAG);
+    vTaskDelete(NULL);
+}
+#endif
+
+// Everything that needs the filesystem, in dependency order.
+static void log_bringup(void)
+{
+    log_maybe_wipe_on_format_change();
+    battery_log_init();
+    battery_log_seq_init();
+    ble_sync_init();
+    boot_prof_mark(BOOT_PH_LOG);
+}
+
 void app_main(void)
 {
+    battery_log_lock_init();    // BLE commands can reach the log before log_bringup()
+    boot_prof_init();
+    mem_plan_init();
+    trace_rec_init();
+
     esp_err_t ret = nvs_flash_init();
     
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         nvs_flash_erase();
         nvs_flash_init();
     }
+    boot_prof_mark(BOOT_PH_NVS);
+
+#if APP_FAST_BOOT
+    // BLE needs NVS (bonds) but not the filesystem: commands that touch the
+    // log are served by mock_sender, which starts once the log is loaded.
+    power_mgmt_init();
+    frame_crypt_init();     // NVS only; before any frame can go out
+    ble_stack_start();
+    boot_prof_mark(BOOT_PH_BLE_START);
+
+    storage_mount();
+    boot_prof_mark(BOOT_PH_FS);
+    log_bringup();
+    ble_batt_mock_sync_ready();
+    sampler_init();
+    sample_clock_init();
+    soc_est_init();
+    sensor_init(NULL);      // the replay backend reads its file from LittleFS
+#else
     storage_init();     // mount first
-    log_maybe_wipe_on_format_change();
-    battery_log_seq_init();
+    boot_prof_mark(BOOT_PH_FS);
+    boot_prof_mark(BOOT_PH_DIAG);
+    log_bringup();
+    power_mgmt_init();
+    sampler_init();
+    sample_clock_init();
+    soc_est_init();
+    sensor_init(NULL);
+    frame_crypt_init();
     ble_stack_start();  // start BLE after FS is ready
+    boot_prof_mark(BOOT_PH_BLE_START);
+#endif
     ESP_LOGW(TAGT, "New version updated");
     // (Remove test_battery_log_append now — already tested)
-    xTaskCreate(mock_sender_task, "mock_sender", 4096, NULL, 5, NULL);
-}
\ No newline at end of file
+    // Long-lived, so static: its stack never comes from (or returns to) the heap.
+    s_sampleq = xQueueCreateStatic(SAMPLE_QUEUE_LEN, sizeof(sample_item_t), s_sampleq_storage,
+                                   &s_sampleq_buf);
+    static StackType_t s_sender_stack[MOCK_SENDER_STACK];
+    static StaticTask_t s_sender_tcb;
+    TaskHandle_t sender = xTaskCreateStaticPinnedToCore(mock_sender_task, "mock_sender",
+                                                        MOCK_SENDER_STACK, NULL, MOCK_SENDER_PRIO,
+                                                        s_sender_stack, &s_sender_tcb,
+                                                        APP_SAMPLE_CORE);
+    mem_plan_watch_task(sender, MOCK_SENDER_STACK);
+    static StackType_t s_sample_stack[SAMPLE_TASK_STACK];
+    static StaticTask_t s_sample_tcb;
+    TaskHandle_t sampler = xTaskCreateStaticPinnedToCore(sample_task, "sample", SAMPLE_TASK_STACK,
+                                                         NULL, SAMPLE_TASK_PRIO, s_sample_stack,
+                                                         &s_sample_tcb, APP_SAMPLE_CORE);
+    mem_plan_watch_task(sampler, SAMPLE_TASK_STACK);
+    wifi_offload_init();
+    serial_dump_init();
+    if (log_migrate_count() > 0) {
+        xTaskCreatePinnedToCore(log_migrate_task, "log_migrate", 3072, NULL, 2, NULL,
+                                APP_SAMPLE_CORE);
+    }
+#if APP_FAST_BOOT
+    xTaskCreate(boot_diag_task, "boot_diag", 3072, NULL, 1, NULL);
+#endif
+}
@@ -0,0 +1,201 @@
+#include "backlog_job.h"
+
+#include <stdio.h>
+#include "esp_log.h"
+#include "battery_log.h"
+#include "ble_coc.h"
+#include "ble_sync.h"
+#include "notify_sched.h"
+#include "wifi_offload.h"
+
+static const char *TAG = "BACKLOG";
+
+typedef struct {
+    bool active;
+    bool first_sent;
+    backlog_cmd_t cmd;
+    int start_idx;
+    int next;
+    int end;
+    uint32_t sched_failed;      // backlog notify failures in the scheduler at start
+    uint32_t sched_epoch;       // connection the frames are queued for
+    uint32_t evicted;           // battery_log_evicted() the indices are relative to
+} backlog_job_t;
+
+static backlog_job_t s_job;
+
+static void backlog_finish(bool complete)
+{
+    printf("BACKLOG: done next=%d end=%d complete=%d\n", s_job.next, s_job.end, (int)complete);
+    ble_sync_note_backlog_end(complete);
+    ble_sync_persist();
+    ble_batt_set_sending_backlog(false);
+    s_job.active = false;
+}
+
+// Appends between pumps can make a ring store drop its oldest sector, which
+// moves every index down. Follow the records rather than the indices; only
+// this task appends, so nothing moves within one pump.
+static void backlog_follow_eviction(void)
+{
+    uint32_t ev = battery_log_evicted();
+    int shift = (int)(ev - s_job.evicted);
+    if (shift == 0) return;
+
+    s_job.evicted = ev;
+    s_job.start_idx -= shift;
+    s_job.next -= shift;
+    s_job.end -= shift;
+    if (s_job.next < 0) {
+        printf("BACKLOG: %d record(s) evicted before they were sent\n", -s_job.next);
+        s_job.next = 0;
+    }
+    if (s_job.end < 0) s_job.end = 0;
+}
+
+static void backlog_begin(const backlog_cmd_t *cmd)
+{
+    // Gate on backlog subscription (or the channel the request came on)
+    if (cmd->via == BACKLOG_VIA_COC) {
+        if (!ble_coc_is_open()) {
+            ESP_LOGI(TAG, "BACKLOG: request ignored - bulk channel closed");
+            return;
+        }
+    } else if (!ble_backlog_is_subscribed()) {
+        ESP_LOGI(TAG, "BACKLOG: request ignored - backlog not subscribed");
+        return;
+    }
+
+    ble_batt_set_sending_backlog(true);
+
+    int count = battery_log_count();
+
+    backlog_request_t req = cmd->req;
+    int start_idx = 0;
+
+    if (req.mode == BACKLOG_MODE_SYNC) {
+        // What the backend already got over Wi-Fi is not relayed again.
+        uint32_t wm, up;
+        bool has = ble_sync_get_watermark(&wm);
+        if (wifi_offload_get_watermark(&up) && (!has || up > wm)) {
+            wm = up;
+            has = true;
+        }
+        if (has) {
+            req.mode = BACKLOG_MODE_FROM_SEQ;
+            req.start_seq = wm + 1;
+        } else {
+            req.mode = BACKLOG_MODE_FULL;
+        }
+    }
+
+    if (req.mode == BACKLOG_MODE_FROM_SEQ) {
+        start_idx = battery_log_find_start_index_by_seq(req.start_seq);
+    } else {
+        start_idx = 0;
+    }
+
+    printf("BACKLOG: start count=%d start_idx=%d mode=%d start_seq=%u via=%s\n",
+        count, start_idx, (int)req.mode, (unsigned)req.start_seq,
+        cmd->via == BACKLOG_VIA_COC ? "coc" : "gatt");
+
+    s_job.active = true;
+    s_job.first_sent = false;
+    s_job.cmd = *cmd;
+    s_job.start_idx = start_idx;
+    s_job.next = start_idx;
+    s_job.end = count;
+    s_job.evicted = battery_log_evicted();
+    ns_class_stats_t st;
+    notify_sched_get_stats(NS_CLASS_BACKLOG, &st);
+    s_job.sched_failed = st.failed;
+    s_job.sched_epoch = notify_sched_epoch();
+    ble_sync_note_backlog_start();
+
+    if (start_idx >= count) {
+        printf("BACKLOG: nothing to send (start_idx=%d count=%d)\n", start_idx, count);
+        backlog_finish(true);
+    }
+}
+
+void backlog_job_pump(void)
+{
+    if (!s_job.active) return;
+
+    const bool coc = s_job.cmd.via == BACKLOG_VIA_COC;
+
+    // The dispatcher sends them later; a record it could not send leaves a
+    // gap, so stop here and let the client resume from its watermark.
+    ns_class_stats_t st;
+    notify_sched_get_stats(NS_CLASS_BACKLOG, &st);
+    if (!coc && st.failed != s_job.sched_failed) {
+        printf("BACKLOG: notify failed near i=%d - aborting\n", s_job.next);
+        backlog_finish(false);
+        return;
+    }
+    // What was queued for a connection that dropped is discarded; if the
+    // client is back already, carrying on from `next` would skip those.
+    if (!coc && notify_sched_epoch() != s_job.sched_epoch) {
+        printf("BACKLOG: link dropped near i=%d - aborting\n", s_job.next);
+        backlog_finish(false);
+        return;
+    }
+
+    backlog_follow_eviction();
+    while (s_job.active && s_job.next < s_job.end) {
+        int i = s_job.next;
+        uint32_t seq = 0;
+        int rc = coc ? ble_coc_send_backlog_at(i, s_job.end - i, &seq)
+                     : ble_batt_mock_notify_backlog_at(i, s_job.end - i, &seq);
+
+        if (rc == -2) {
+            return;     // queue full, pool empty or SDU in flight: the next pump retries i
+        }
+
+        if (rc == -4) {
+            printf("BACKLOG: read failed i=%d\n", i);
+            s_job.next++;
+            continue;
+        }
+
+        if (rc < 0) {
+            printf("BACKLOG: notify rc=%d i=%d - aborting\n", rc, i);
+            backlog_finish(false);   // resumes from the watermark on reconnect
+            return;
+        }
+
+        if (!s_job.first_sent) {
+            s_job.first_sent = true;
+            ble_backlog_note_first_notify(&s_job.cmd);
+            printf("BACKLOG: first frame idx=%u..seq=%u\n", (unsigned)i, (unsigned)seq);
+        }
+        s_job.next += rc;   // records in the frame / SDU
+    }
+
+    if (s_job.active) {
+        backlog_finish(true);
+    }
+}
+
+void backlog_job_handle(const backlog_cmd_t *cmd)
+{
+    if (cmd->type == BACKLOG_CMD_START) {
+        if (s_job.active) {
+            ESP_LOGI(TAG, "BACKLOG: request ignored - already sending");
+        } else {
+            backlog_begin(cmd);
+        }
+    } else if (cmd->type == BACKLOG_CMD_ABORT) {
+        if (s_job.active) {
+            ESP_LOGI(TAG, "BACKLOG: abort signal received at i=%d", s_job.next);
+            backlog_finish(true);
+        } else {
+            ESP_LOGI(TAG, "BACKLOG: abort ignored - no backlog in progress");
+        }
+    }
+}
+
+bool backlog_job_active(void)
+{
+    return s_job.active;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdbool.h>
+#include "ble_batt_mock.h"
+
+/**
+ * Backlog sender.
+ *
+ * One backlog request in progress. mock_sender owns it and pumps it between
+ * samples: records are queued to the notification scheduler until its
+ * backlog queue is full, and the scheduler paces them against the bulk
+ * budget, so live samples keep their cadence during a long backlog. A
+ * request made on the bulk channel goes out there instead, a page per SDU,
+ * paced by the peer's credits.
+ *
+ * Only the sender task calls these (the host fleet simulator drives them
+ * the same way, per virtual device).
+ */
+
+/**
+ * @brief Act on a command from ble_backlog_wait_cmd(): START begins a
+ *        backlog unless one is running, ABORT ends the running one. PUMP
+ *        needs nothing here (the caller pumps an active backlog anyway).
+ */
+void backlog_job_handle(const backlog_cmd_t *cmd);
+
+/** Queue records until the scheduler, the notify pool or the channel is full. */
+void backlog_job_pump(void);
+
+bool backlog_job_active(void);
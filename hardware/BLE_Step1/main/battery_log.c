@@ -1,4 +1,7 @@
 #include "battery_log.h"
+#include "log_store.h"
+#include "log_migrate.h"
+#include "trace_rec.h"
 
 #include <stdio.h>
 #include <sys/stat.h>
@@ -10,13 +13,16 @@
 #include <unistd.h>   
 #include "nvs.h"
 #include <fcntl.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
-#define NVS_NS_LOG            "blog"
+#define NVS_NS_LOG            LOG_NVS_NS
 #define NVS_KEY_LOG_VER       "log_ver"
 #define NVS_KEY_LOG_SIZE      "log_sz"
+#define NVS_KEY_LOG_LAYOUT    "log_lay"
 
-#define SEQ_CHECKPOINT_FILE      "/littlefs/seq_checkpoint.bin"
-#define SEQ_CHECKPOINT_TMP_FILE  "/littlefs/seq_checkpoint.tmp"
+#define SEQ_CHECKPOINT_FILE      LOG_BASE_PATH "/seq_checkpoint.bin"
+#define SEQ_CHECKPOINT_TMP_FILE  LOG_BASE_PATH "/seq_checkpoint.tmp"
 #define SEQ_CHECKPOINT_MAGIC     0x53455131u   // 'SEQ1'
 #define SEQ_CHECKPOINT_EVERY_N   12
 
@@ -26,10 +32,59 @@ typedef struct __attribute__((packed)) {
 } seq_checkpoint_t;
 
 
+// Records held in RAM until a batch is written (low-power mode batches
+// flash writes so the sampler wakes the flash once per batch, not per sample).
+#define LOG_STAGE_MAX            32
+
 static const char *TAG = "BATTERY_LOG";
-static const char *LOG_FILE = "/littlefs/battery.bin";
 static uint32_t g_seq_next = 0;
 
+static const log_store_t *s_store = NULL;
+static bool s_store_ready = false;
+
+static battery_log_t s_stage[LOG_STAGE_MAX];
+static int s_stage_count = 0;
+static int s_flush_batch = 1;     // 1 = write-through (default)
+static uint32_t s_flush_count = 0;
+static uint32_t s_flush_bytes = 0;
+
+// Summary of the records on flash, loaded once per store selection and kept
+// current by the append path, so count/read/find do not ask the store (a
+// stat() for battery.bin) on every call. s_summary is the published copy
+// for other tasks (the summary characteristic).
+static int s_flash_count = -1;            // -1: load on next use
+static uint32_t s_flash_first_seq, s_flash_first_ts;
+static uint32_t s_flash_last_seq, s_flash_last_ts;
+static battery_log_summary_t s_summary;
+static bool s_summary_valid = false;
+static portMUX_TYPE s_summary_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// The stage, the summary above and the stores' own state (log_store_row's
+// shared handle and read position, the ring's indices) belong to whoever
+// holds this. Every public function below takes it, so the writer
+// (mock_sender) and the readers on other tasks (serial dump, Wi-Fi upload,
+// OTA's final flush) never interleave inside a store. Recursive, so a
+// caller can hold it across several calls with battery_log_lock().
+static SemaphoreHandle_t s_log_lock = NULL;
+static StaticSemaphore_t s_log_lock_buf;
+
+static void summary_load(void);
+
+void battery_log_lock_init(void)
+{
+    if (!s_log_lock) s_log_lock = xSemaphoreCreateRecursiveMutexStatic(&s_log_lock_buf);
+}
+
+void battery_log_lock(void)
+{
+    xSemaphoreTakeRecursive(s_log_lock, portMAX_DELAY);
+}
+
+void battery_log_unlock(void)
+{
+    xSemaphoreGiveRecursive(s_log_lock);
+}
+
 
 static esp_err_t seq_checkpoint_load(void)
 {
@@ -124,6 +179,11 @@ uint32_t battery_log_next_seq(void)
     return assigned;
 }
 
+uint32_t battery_log_peek_next_seq(void)
+{
+    return g_seq_next;
+}
+
 esp_err_t battery_log_seq_init(void)
 {
     esp_err_t err = seq_checkpoint_load();
@@ -143,7 +203,16 @@ static esp_err_t nvs_get_u32_safe(nvs_handle_t h, const char *key, uint32_t *out
     if (err == ESP_ERR_NVS_NOT_FOUND) { *found = false; return ESP_OK; }
     return err;
 }
-esp_err_t log_maybe_wipe_on_format_change(void)
+// The layout actually in use: PARTITION needs its partition in the table.
+static uint32_t log_layout(void)
+{
+    if (LOG_LAYOUT == LOG_LAYOUT_PARTITION && !log_store_partition_present()) {
+        return LOG_LAYOUT_ROW;
+    }
+    return LOG_LAYOUT;
+}
+
+static esp_err_t wipe_on_format_change(void)
 {
     nvs_handle_t h;
     esp_err_t err = nvs_open(NVS_NS_LOG, NVS_READWRITE, &h);
@@ -158,108 +227,434 @@ esp_err_t log_maybe_wipe_on_format_change(void)
     err = nvs_get_u32_safe(h, NVS_KEY_LOG_SIZE, &stored_sz, &sz_found);
     if (err != ESP_OK) { nvs_close(h); return err; }
 
+    // Logs written before the layout key existed are row layout.
+    uint32_t stored_lay = LOG_LAYOUT_ROW;
+    bool lay_found = false;
+    err = nvs_get_u32_safe(h, NVS_KEY_LOG_LAYOUT, &stored_lay, &lay_found);
+    if (err != ESP_OK) { nvs_close(h); return err; }
+
     const uint32_t cur_ver = LOG_RECORD_VERSION;
     const uint32_t cur_sz  = (uint32_t)sizeof(battery_log_t);
+    const uint32_t cur_lay = log_layout();
 
     if (!ver_found || !sz_found) {
-        ESP_LOGI(TAG, "LOG META init ver=%u size=%u", (unsigned)cur_ver, (unsigned)cur_sz);
+        ESP_LOGI(TAG, "LOG META init ver=%u size=%u layout=%u",
+                 (unsigned)cur_ver, (unsigned)cur_sz, (unsigned)cur_lay);
         ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_VER, cur_ver));
         ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_SIZE, cur_sz));
+        ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_LAYOUT, cur_lay));
         err = nvs_commit(h);
         nvs_close(h);
         return err;
     }
 
-    if (stored_ver == cur_ver && stored_sz == cur_sz) {
-        ESP_LOGI(TAG, "LOG META ok ver=%u size=%u", (unsigned)stored_ver, (unsigned)stored_sz);
+    if (stored_ver == cur_ver && stored_sz == cur_sz && stored_lay == cur_lay) {
+        ESP_LOGI(TAG, "LOG META ok ver=%u size=%u layout=%u",
+                 (unsigned)stored_ver, (unsigned)stored_sz, (unsigned)stored_lay);
+        if (!lay_found) {
+            nvs_set_u32(h, NVS_KEY_LOG_LAYOUT, cur_lay);
+            nvs_commit(h);
+        }
         nvs_close(h);
         return ESP_OK;
     }
 
-    ESP_LOGW(TAG,
-             "LOG META mismatch old(ver=%u sz=%u) new(ver=%u sz=%u) -> WIPE %s",
-             (unsigned)stored_ver, (unsigned)stored_sz,
-             (unsigned)cur_ver, (unsigned)cur_sz,
-             LOG_FILE);
+    // A record format change within the row layout is converted in the
+    // background (log_migrate.c); seq numbering carries on.
+    if (stored_lay == cur_lay && cur_lay == LOG_LAYOUT_ROW &&
+        log_migrate_begin(h, stored_ver, stored_sz) == ESP_OK) {
+        ESP_LOGW(TAG, "LOG META old(ver=%u sz=%u) new(ver=%u sz=%u) -> MIGRATE",
+                 (unsigned)stored_ver, (unsigned)stored_sz, (unsigned)cur_ver, (unsigned)cur_sz);
+        ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_VER, cur_ver));
+        ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_SIZE, cur_sz));
+        ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_LAYOUT, cur_lay));
+        err = nvs_commit(h);
+        nvs_close(h);
+        return err;
+    }
 
-    unlink(LOG_FILE);
+    // Anything else (a layout switch, a version with no converter) starts a
+    // fresh log; the old files are not converted.
+    ESP_LOGW(TAG,
+             "LOG META mismatch old(ver=%u sz=%u lay=%u) new(ver=%u sz=%u lay=%u) -> WIPE",
+             (unsigned)stored_ver, (unsigned)stored_sz, (unsigned)stored_lay,
+             (unsigned)cur_ver, (unsigned)cur_sz, (unsigned)cur_lay);
+
+    log_store_row.wipe();
+    log_store_columnar.wipe();
+    log_store_partition.wipe();
+    s_flash_count = -1;
+    log_migrate_discard(h);
     seq_checkpoint_delete();
 
     ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_VER, cur_ver));
     ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_SIZE, cur_sz));
+    ESP_ERROR_CHECK(nvs_set_u32(h, NVS_KEY_LOG_LAYOUT, cur_lay));
     err = nvs_commit(h);
 
     nvs_close(h);
     return err;
 }
 
-int battery_log_append(const battery_log_t *log)
+esp_err_t log_maybe_wipe_on_format_change(void)
 {
-    if (!log) {
-        ESP_LOGE(TAG, "Invalid log pointer");
-        return -1;
+    battery_log_lock();
+    esp_err_t err = wipe_on_format_change();
+    battery_log_unlock();
+    return err;
+}
+
+// ---------------------------------------------------------------- fields
+
+// One entry per value, array elements expanded: log_field_t is in record
+// order, so LOG_FIELD_CELL(i) lands on cell_mv[i].
+static const log_field_desc_t s_fields[LOG_FIELD_COUNT] = {
+#define DESC(t, name, i) { offsetof(battery_log_t, name) + (i) * sizeof(LOG_CTYPE_##t), sizeof(LOG_CTYPE_##t) },
+#define FIELD(t, name, n, e, u) LOG_EACH_##n(DESC, t, name)
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+#undef DESC
+};
+_Static_assert(LOG_FIELD_COUNT == LOG_SCHEMA_VALUES, "log_field_t out of step with LOG_RECORD_FIELDS");
+
+const log_field_desc_t *log_field_desc(log_field_t field)
+{
+    return &s_fields[field];
+}
+
+size_t battery_log_field_size(log_field_t field)
+{
+    if ((unsigned)field >= LOG_FIELD_COUNT) return 0;
+    return s_fields[field].size;
+}
+
+void log_extract_field(const battery_log_t *recs, int n, log_field_t field, void *out)
+{
+    const log_field_desc_t *d = &s_fields[field];
+    const uint8_t *src = (const uint8_t *)recs + d->offset;
+    uint8_t *dst = (uint8_t *)out;
+
+    for (int i = 0; i < n; i++) {
+        memcpy(dst, src, d->size);
+        src += sizeof(battery_log_t);
+        dst += d->size;
     }
+}
 
-    FILE *f = fopen(LOG_FILE, "ab");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open %s for append: errno=%d (%s)",
-                 LOG_FILE, errno, strerror(errno));
-        return -1;
+// ---------------------------------------------------------------- store
+
+void battery_log_use_store(const log_store_t *store)
+{
+    battery_log_lock();
+    s_store = store;
+    s_store_ready = false;
+    s_flash_count = -1;
+    battery_log_unlock();
+}
+
+static const log_store_t *log_store(void)
+{
+    if (!s_store) {
+        switch (log_layout()) {
+            case LOG_LAYOUT_COLUMNAR:  s_store = &log_store_columnar;  break;
+            case LOG_LAYOUT_PARTITION: s_store = &log_store_partition; break;
+            default:                   s_store = &log_store_row;       break;
+        }
+    }
+    if (!s_store_ready) {
+        s_store_ready = true;
+        esp_err_t err = s_store->init();
+        if (err == ESP_ERR_NOT_FOUND && s_store != &log_store_row) {
+            ESP_LOGW(TAG, "%s store unavailable, using row", s_store->name);
+            s_store = &log_store_row;
+            err = s_store->init();
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "%s store recovery failed", s_store->name);
+        }
     }
+    return s_store;
+}
 
-    size_t wrote = fwrite(log, 1, sizeof(battery_log_t), f);
-    if (wrote != sizeof(battery_log_t)) {
-        ESP_LOGE(TAG, "Partial/failed write: wrote=%u expected=%u errno=%d (%s)",
-                 (unsigned)wrote, (unsigned)sizeof(battery_log_t), errno, strerror(errno));
-        fclose(f);
-        return -1;
+esp_err_t battery_log_init(void)
+{
+    battery_log_lock();
+    s_store_ready = false;
+    s_flash_count = -1;
+    const log_store_t *st = log_store();
+    log_migrate_init();
+    summary_load();
+    ESP_LOGI(TAG, "log store: %s, %d record(s) + %d awaiting migration",
+             st->name, s_flash_count - log_migrate_count(), log_migrate_count());
+    battery_log_unlock();
+    return ESP_OK;
+}
+
+/*
+ * Records on flash: while a migration is pending, the converted view of the
+ * old file comes first, then the store. Staged records follow both.
+ */
+static bool flash_read(int index, battery_log_t *out);
+
+static int flash_count(void)
+{
+    if (s_flash_count < 0) summary_load();
+    return s_flash_count;
+}
+
+static bool flash_read(int index, battery_log_t *out)
+{
+    int old = log_migrate_count();
+    TRACE_BEGIN(TRACE_SPAN_LOG_READ);
+    bool ok = index < old ? log_migrate_read(index, out) : log_store()->read(index - old, out);
+    TRACE_END(TRACE_SPAN_LOG_READ);
+    return ok;
+}
+
+static int flash_read_field(log_field_t field, int start, int n, void *out)
+{
+    int old = log_migrate_count();
+    int done = 0;
+
+    if (start < old) {
+        int want = (start + n <= old) ? n : old - start;
+        done = log_migrate_read_field(field, start, want, out);
+        if (done < want) return done;
+    }
+    if (done < n) {
+        int got = log_store()->read_field(field, start + done - old, n - done,
+                                          (uint8_t *)out + (size_t)done * s_fields[field].size);
+        if (got < 0) return done ? done : -1;
+        done += got;
+    }
+    return done;
+}
+
+static int flash_find_seq(uint32_t start_seq)
+{
+    int old = log_migrate_count();
+    if (old > 0) {
+        int idx = log_migrate_find_seq(start_seq);
+        if (idx < old) return idx;
+    }
+    return old + log_store()->find_seq(start_seq);
+}
+
+// ------------------------------------------------------------------ summary
+
+static void summary_publish(void)
+{
+    battery_log_summary_t sum = {0};
+    int n = s_flash_count + s_stage_count;
+
+    sum.count = (uint32_t)n;
+    sum.bytes = (uint32_t)n * (uint32_t)sizeof(battery_log_t);
+    if (s_flash_count > 0) {
+        sum.first_seq = s_flash_first_seq;
+        sum.first_ts = s_flash_first_ts;
+    } else if (s_stage_count > 0) {
+        sum.first_seq = s_stage[0].seq;
+        sum.first_ts = s_stage[0].timestamp_s;
+    }
+    if (s_stage_count > 0) {
+        sum.last_seq = s_stage[s_stage_count - 1].seq;
+        sum.last_ts = s_stage[s_stage_count - 1].timestamp_s;
+    } else if (s_flash_count > 0) {
+        sum.last_seq = s_flash_last_seq;
+        sum.last_ts = s_flash_last_ts;
     }
 
-    fflush(f); // ensure data written to LITTLEFS
-    fclose(f);
+    portENTER_CRITICAL(&s_summary_lock);
+    s_summary = sum;
+    s_summary_valid = true;
+    portEXIT_CRITICAL(&s_summary_lock);
+}
 
-    // Optional: quick sanity stat/log
-    struct stat st;
-    if (stat(LOG_FILE, &st) == 0) {
-        int count = (int)(st.st_size / (off_t)sizeof(battery_log_t));
-        ESP_LOGI(TAG, "APPEND ok: file=%s size=%" PRIiMAX " bytes, count=%d",
-                 LOG_FILE, (intmax_t)st.st_size, count);
-    } else {
-        ESP_LOGW(TAG, "APPEND: stat failed after write (errno=%d %s)",
-                 errno, strerror(errno));
+static void summary_set_first(void)
+{
+    battery_log_t r;
+    if (flash_read(0, &r)) {
+        s_flash_first_seq = r.seq;
+        s_flash_first_ts = r.timestamp_s;
     }
+}
 
+// The only place the store is asked for its size: both ends of the log are
+// read once here, then log_write_records() keeps them.
+static void summary_load(void)
+{
+    s_flash_count = log_migrate_count() + log_store()->count();
+    if (s_flash_count > 0) {
+        battery_log_t r;
+        summary_set_first();
+        if (flash_read(s_flash_count - 1, &r)) {
+            s_flash_last_seq = r.seq;
+            s_flash_last_ts = r.timestamp_s;
+        }
+    }
+    summary_publish();
+}
+
+static void summary_note_append(const battery_log_t *recs, int n)
+{
+    if (s_flash_count < 0) {
+        summary_load();
+        return;
+    }
+
+    int want = s_flash_count + n;
+    if (s_flash_count == 0) {
+        s_flash_first_seq = recs[0].seq;
+        s_flash_first_ts = recs[0].timestamp_s;
+    }
+    s_flash_count = want;
+    if (log_store()->evicts) {
+        // A ring store may have dropped its oldest sector to make room.
+        s_flash_count = log_migrate_count() + log_store()->count();
+        if (s_flash_count < want) summary_set_first();
+    }
+    s_flash_last_seq = recs[n - 1].seq;
+    s_flash_last_ts = recs[n - 1].timestamp_s;
+}
+
+bool battery_log_get_summary(battery_log_summary_t *out)
+{
+    portENTER_CRITICAL(&s_summary_lock);
+    bool valid = s_summary_valid;
+    if (valid) *out = s_summary;
+    portEXIT_CRITICAL(&s_summary_lock);
+    return valid;
+}
+
+// ------------------------------------------------------------------ writes
+
+static int log_write_records(const battery_log_t *recs, int n)
+{
+    if (log_store()->append(recs, n) != 0) {
+        s_flash_count = -1;     // a partial write may have landed
+        return -1;
+    }
+    summary_note_append(recs, n);
+
+    s_flush_count++;
+    s_flush_bytes += (uint32_t)n * (uint32_t)sizeof(battery_log_t);
     return 0;
 }
 
-int battery_log_count(void)
+static int log_flush(void)
 {
-    struct stat st;
-    int ret = stat(LOG_FILE, &st);
-    if (ret != 0) {
-        // File doesn't exist yet or stat failed - treat as 0 records
-        if (errno == ENOENT) {
-            ESP_LOGD(TAG, "Log file does not exist yet: %s", LOG_FILE);
-            return 0;
-        } else {
-            ESP_LOGW(TAG, "stat(%s) failed: errno=%d (%s)", LOG_FILE, errno, strerror(errno));
-            return 0;
+    if (s_stage_count == 0) return 0;
+
+    TRACE_BEGIN(TRACE_SPAN_LOG_FLUSH);
+    int rc = log_write_records(s_stage, s_stage_count);
+    TRACE_END(TRACE_SPAN_LOG_FLUSH);
+    if (rc == 0) {
+        ESP_LOGI(TAG, "FLUSH ok: %d staged record(s)", s_stage_count);
+        s_stage_count = 0;
+        summary_publish();
+    }
+    return rc;
+}
+
+int battery_log_flush(void)
+{
+    battery_log_lock();
+    int rc = log_flush();
+    battery_log_unlock();
+    return rc;
+}
+
+void battery_log_set_flush_batch(int records)
+{
+    if (records < 1) records = 1;
+    if (records > LOG_STAGE_MAX) records = LOG_STAGE_MAX;
+
+    battery_log_lock();
+    s_flush_batch = records;
+    if (s_stage_count >= s_flush_batch) {
+        log_flush();
+    }
+    battery_log_unlock();
+}
+
+void battery_log_idle(void)
+{
+    battery_log_lock();
+    const log_store_t *st = log_store();
+    if (st->idle) {
+        TRACE_BEGIN(TRACE_SPAN_LOG_IDLE);
+        st->idle();
+        TRACE_END(TRACE_SPAN_LOG_IDLE);
+    }
+    battery_log_unlock();
+}
+
+void battery_log_get_io_stats(uint32_t *flushes, uint32_t *bytes)
+{
+    if (flushes) *flushes = s_flush_count;
+    if (bytes) *bytes = s_flush_bytes;
+}
+
+static int log_append(const battery_log_t *log)
+{
+    if (!log) {
+        ESP_LOGE(TAG, "Invalid log pointer");
+        return -1;
+    }
+
+    if (log_migrate_swap_due()) {
+        // Migration only runs on the row store; its init() drops the cached
+        // handle before the swap replaces battery.bin. Only then: on other
+        // appends it would reopen the file and lose the read position.
+        log_store()->init();
+        log_migrate_poll();
+    }
+
+    if (s_flush_batch > 1) {
+        if (s_stage_count >= LOG_STAGE_MAX && log_flush() != 0) {
+            return -1;
         }
+        s_stage[s_stage_count++] = *log;
+        if (s_flash_count < 0) summary_load(); else summary_publish();
+        return (s_stage_count >= s_flush_batch) ? log_flush() : 0;
     }
 
-    if (st.st_size < (off_t)sizeof(battery_log_t)) {
-        // File present but too small to contain a full record -> treat as 0
-        ESP_LOGW(TAG, "Log file too small: size=%" PRIiMAX, (intmax_t)st.st_size);
-        return 0;
+    if (log_write_records(log, 1) != 0) {
+        return -1;
     }
+    summary_publish();
 
-    int count = (int)(st.st_size / (off_t)sizeof(battery_log_t));
-    ESP_LOGI(TAG, "Log file size: %" PRIiMAX " bytes, record count: %d",
-             (intmax_t)st.st_size, count);
-    return count;
+    ESP_LOGI(TAG, "APPEND ok: seq=%" PRIu32 " count=%d", log->seq, s_flash_count);
+    return 0;
 }
 
-bool battery_log_read(int index, battery_log_t *out)
+int battery_log_append(const battery_log_t *log)
+{
+    battery_log_lock();
+    TRACE_BEGIN(TRACE_SPAN_LOG_APPEND);
+    int rc = log_append(log);
+    TRACE_END(TRACE_SPAN_LOG_APPEND);
+    battery_log_unlock();
+    return rc;
+}
+
+uint32_t battery_log_evicted(void)
+{
+    battery_log_lock();
+    uint32_t n = log_store()->evicted ? log_store()->evicted() : 0;
+    battery_log_unlock();
+    return n;
+}
+
+int battery_log_count(void)
+{
+    battery_log_lock();
+    int n = flash_count() + s_stage_count;
+    battery_log_unlock();
+    return n;
+}
+
+static bool log_read(int index, battery_log_t *out)
 {
     if (!out) {
         ESP_LOGE(TAG, "NULL out pointer");
@@ -271,7 +666,8 @@ bool battery_log_read(int index, battery_log_t *out)
         return false;
     }
 
-    int count = battery_log_count();
+    int file_count = flash_count();
+    int count = file_count + s_stage_count;
     if (count <= 0) {
         ESP_LOGW(TAG, "No records to read (count=%d)", count);
         return false;
@@ -282,75 +678,80 @@ bool battery_log_read(int index, battery_log_t *out)
         return false;
     }
 
-    FILE *f = fopen(LOG_FILE, "rb");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open %s for read: errno=%d (%s)",
-                 LOG_FILE, errno, strerror(errno));
-        return false;
+    if (index >= file_count) {
+        *out = s_stage[index - file_count];
+        return true;
     }
 
-    // compute offset and seek
-    off_t offset = (off_t)index * (off_t)sizeof(battery_log_t);
-    if (fseeko(f, offset, SEEK_SET) != 0) {
-        ESP_LOGE(TAG, "fseeko failed offset=%" PRIiMAX " errno=%d (%s)",
-                 (intmax_t)offset, errno, strerror(errno));
-        fclose(f);
-        return false;
-    }
-
-    size_t nr = fread(out, 1, sizeof(battery_log_t), f);
-    fclose(f);
-
-    if (nr != sizeof(battery_log_t)) {
-        ESP_LOGE(TAG, "fread failed or partial read: got=%u want=%u errno=%d (%s)",
-                 (unsigned)nr, (unsigned)sizeof(battery_log_t), errno, strerror(errno));
-        return false;
-    }
+    return flash_read(index, out);
+}
 
-    return true;
+bool battery_log_read(int index, battery_log_t *out)
+{
+    battery_log_lock();
+    bool ok = log_read(index, out);
+    battery_log_unlock();
+    return ok;
 }
-int battery_log_find_start_index_by_seq(uint32_t start_seq)
+
+static int log_read_field(log_field_t field, int start, int n, void *out)
 {
-    int count = battery_log_count();
-    if (count <= 0) return 0;
 
-    FILE *f = fopen(LOG_FILE, "rb");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open %s for seq search: errno=%d (%s)",
-                 LOG_FILE, errno, strerror(errno));
-        return 0; 
+    int file_count = flash_count();
+    int done = 0;
+
+    if (start < file_count) {
+        int want = (start + n <= file_count) ? n : file_count - start;
+        done = flash_read_field(field, start, want, out);
+        if (done < want) return done;
     }
 
-    int lo = 0;
-    int hi = count;  
+    // Staged records follow the file.
+    int si = start + done - file_count;
+    int sn = n - done;
+    if (si + sn > s_stage_count) sn = s_stage_count - si;
+    if (sn > 0) {
+        log_extract_field(&s_stage[si], sn, field,
+                          (uint8_t *)out + (size_t)done * s_fields[field].size);
+        done += sn;
+    }
+    return done;
+}
 
-    while (lo < hi) {
-        int mid = lo + (hi - lo) / 2;
+int battery_log_read_field(log_field_t field, int start, int n, void *out)
+{
+    if (!out || start < 0 || n < 0 || (unsigned)field >= LOG_FIELD_COUNT) return -1;
 
-        off_t offset = (off_t)mid * (off_t)sizeof(battery_log_t);
-        if (fseeko(f, offset, SEEK_SET) != 0) {
-            ESP_LOGE(TAG, "fseeko failed mid=%d offset=%" PRIiMAX " errno=%d (%s)",
-                     mid, (intmax_t)offset, errno, strerror(errno));
-            fclose(f);
-            return 0;
-        }
+    battery_log_lock();
+    int done = log_read_field(field, start, n, out);
+    battery_log_unlock();
+    return done;
+}
 
-        battery_log_t rec;
-        size_t nr = fread(&rec, 1, sizeof(rec), f);
-        if (nr != sizeof(rec)) {
-            ESP_LOGE(TAG, "fread failed mid=%d got=%u want=%u errno=%d (%s)",
-                     mid, (unsigned)nr, (unsigned)sizeof(rec), errno, strerror(errno));
-            fclose(f);
-            return 0;
-        }
+// Staged records always follow the file, so a seq past the end of the file
+// continues the search here.
+static int log_stage_find(uint32_t start_seq, int file_count)
+{
+    int i = 0;
+    while (i < s_stage_count && s_stage[i].seq < start_seq) i++;
+    return file_count + i;
+}
 
-        if (rec.seq < start_seq) {
-            lo = mid + 1;
-        } else {
-            hi = mid;
-        }
-    }
+static int log_find_seq(uint32_t start_seq)
+{
+    int count = flash_count();
+    if (count <= 0) return log_stage_find(start_seq, 0);
 
-    fclose(f);
-    return lo; 
-}
\ No newline at end of file
+    TRACE_BEGIN(TRACE_SPAN_LOG_FIND);
+    int idx = flash_find_seq(start_seq);
+    TRACE_END(TRACE_SPAN_LOG_FIND);
+    return (idx == count) ? log_stage_find(start_seq, count) : idx;
+}
+
+int battery_log_find_start_index_by_seq(uint32_t start_seq)
+{
+    battery_log_lock();
+    int idx = log_find_seq(start_seq);
+    battery_log_unlock();
+    return idx;
+}
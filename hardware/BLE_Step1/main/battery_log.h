@@ -3,34 +3,70 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "log_schema.h"    // battery_log_t, LOG_RECORD_VERSION, LOG_RECORD_SIZE_BYTES
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
- * @brief Battery log record - packed struct for binary storage
- *
- * Keep this struct packed and stable; its binary representation is written/read
- * directly to/from flash. Changing this struct after deployed devices exist
- * will break compatibility.
+ * On-flash layout. ROW stores battery_log_t records back to back
+ * (battery.bin). COLUMNAR stores blocks of LOG_COL_BLOCK_RECORDS records with
+ * each field contiguous (battery.col), plus a row-wise tail for the block
+ * being filled; per-field scans then read only the bytes of that field.
+ * PARTITION bypasses LittleFS: records go to a circular log of sectors in the
+ * "blog" data partition (partitions_rawlog.csv), oldest sector overwritten
+ * when full. Without that partition the ROW layout is used.
+ */
+#define LOG_LAYOUT_ROW       0
+#define LOG_LAYOUT_COLUMNAR  1
+#define LOG_LAYOUT_PARTITION 2
+
+#ifndef LOG_LAYOUT
+#define LOG_LAYOUT LOG_LAYOUT_ROW
+#endif
+
+#define LOG_COL_BLOCK_RECORDS 64
+
+/** Fields for battery_log_read_field(), in record order. */
+typedef enum {
+    LOG_FIELD_SEQ = 0,
+    LOG_FIELD_TIMESTAMP,
+    LOG_FIELD_CELL0,                            // cell_mv[0]; cell i is LOG_FIELD_CELL(i)
+    LOG_FIELD_PACK_TOTAL = LOG_FIELD_CELL0 + 16,
+    LOG_FIELD_PACK_LD,
+    LOG_FIELD_PACK_SUM_ACTIVE,
+    LOG_FIELD_CURRENT,
+    LOG_FIELD_TEMP_TS1,
+    LOG_FIELD_TEMP_INT,
+    LOG_FIELD_SOC,
+    LOG_FIELD_INTERVAL,
+    LOG_FIELD_RATE,
+    LOG_FIELD_COUNT
+} log_field_t;
+
+#define LOG_FIELD_CELL(i) ((log_field_t)(LOG_FIELD_CELL0 + (i)))
+
+/**
+ * @brief Select the store for LOG_LAYOUT and run its recovery (torn writes,
+ *        half-committed blocks). Call once after the filesystem is mounted
+ *        and log_maybe_wipe_on_format_change() has run.
  */
-typedef struct __attribute__((packed)) {
-    uint32_t seq;  
-    uint32_t timestamp_s;              // Unix timestamp in seconds
-    uint16_t cell_mv[16];              // Individual cell voltages (mV)
-    uint16_t pack_total_mv;            // Total pack voltage (mV)
-    uint16_t pack_ld_mv;               // Pack load drop voltage (mV)
-    uint16_t pack_sum_active_mv;       // Pack sum active voltage (mV)
-    int16_t  current_ma;               // Pack current (mA)
-    int16_t  temp_ts1_c_x100;          // Temperature sensor 1 (°C * 100)
-    int16_t  temp_int_c_x100;          // Internal temp (°C * 100)
-    uint8_t  soc;                      // State of charge (0-100)
-    uint8_t  _pad[3];                  // padding to align size to multiple of 4 (optional)
-} battery_log_t;
+esp_err_t battery_log_init(void);
+
+/** Size in bytes of one value of `field` (1, 2 or 4). */
+size_t battery_log_field_size(log_field_t field);
 
-#define LOG_RECORD_VERSION 3
-#define LOG_RECORD_SIZE_BYTES 56  // set to exact sizeof(battery_log_t)
+/**
+ * @brief Read `n` consecutive values of one field starting at record `start`.
+ *
+ * Values are written to `out` packed at their native width (see
+ * battery_log_field_size). Staged records are included.
+ *
+ * @return number of values read (fewer than `n` at the end of the log), -1 on error
+ */
+int battery_log_read_field(log_field_t field, int start, int n, void *out);
 
-_Static_assert(sizeof(battery_log_t) == LOG_RECORD_SIZE_BYTES,
-               "battery_log_t size changed! Bump LOG_RECORD_VERSION and migrate/wipe battery.bin");
-               
 /**
  * @brief Append a battery log record to /littlefs/battery.bin
  *
@@ -42,11 +78,41 @@ int battery_log_append(const battery_log_t *log);
 /**
  * @brief Get the number of records in the log file
  *
+ * Served from the RAM summary (see battery_log_get_summary); the store is
+ * only asked once after battery_log_init().
+ *
  * @return Number of records (>=0). Returns 0 if file doesn't exist or is empty.
  *         (We avoid returning -1 so callers can treat 0 as "no records").
  */
 int battery_log_count(void);
 
+/**
+ * @brief Records a ring store has dropped from the front of the log since
+ *        boot (0 for stores that never evict).
+ *
+ * Each one moves every index down by one, so a reader that keeps an index
+ * across calls subtracts the change in this count from it.
+ */
+uint32_t battery_log_evicted(void);
+
+/** What the log holds, for planning a sync (staged records included). */
+typedef struct {
+    uint32_t count;         // records
+    uint32_t bytes;         // count * sizeof(battery_log_t)
+    uint32_t first_seq;     // oldest record; first/last are 0 when count is 0
+    uint32_t last_seq;
+    uint32_t first_ts;
+    uint32_t last_ts;
+} battery_log_summary_t;
+
+/**
+ * @brief Copy of the log summary kept in RAM. Loaded at battery_log_init()
+ *        and updated by every append, flush and ring eviction; no flash
+ *        access, safe from any task.
+ * @return false (and `out` untouched) before battery_log_init() has run
+ */
+bool battery_log_get_summary(battery_log_summary_t *out);
+
 /**
  * @brief Read record at `index` (0-based) into `out`.
  *
@@ -56,8 +122,55 @@ int battery_log_count(void);
  */
 bool battery_log_read(int index, battery_log_t *out);
 
+/**
+ * @brief Write records at most every `records` appends (1 = write-through).
+ *
+ * Staged records are visible to battery_log_count/read/find immediately;
+ * they are lost on power failure before the next flush. Capped at 32.
+ */
+void battery_log_set_flush_batch(int records);
+
+/**
+ * @brief Write any staged records to flash now.
+ * @return 0 on success, -1 on failure (records stay staged)
+ */
+int battery_log_flush(void);
+
+/** Number of flash write batches and bytes written since boot. */
+void battery_log_get_io_stats(uint32_t *flushes, uint32_t *bytes);
+
+/**
+ * @brief Housekeeping the store can do off the append path (the partition
+ *        store pre-erases its next sector). Call from the writer task when it
+ *        is about to wait.
+ */
+void battery_log_idle(void);
+
 esp_err_t log_maybe_wipe_on_format_change(void);
 
+/**
+ * @brief Hold the log across several calls (recursive).
+ *
+ * Every battery_log_* call takes this lock itself, so single calls are safe
+ * from any task. A reader that pairs calls - find a seq, then read from that
+ * index - holds it around the pair so an append or a ring eviction on the
+ * writer task cannot move the records in between. Keep it short: the
+ * writer waits on it.
+ *
+ * battery_log_lock_init() creates the lock. Call it before anything that
+ * can touch the log runs (top of app_main, ahead of the BLE stack); later
+ * calls do nothing.
+ */
+void battery_log_lock_init(void);
+void battery_log_lock(void);
+void battery_log_unlock(void);
+
 uint32_t battery_log_next_seq(void);
+/** The seq the next battery_log_next_seq() call will assign (no side effects). */
+uint32_t battery_log_peek_next_seq(void);
 esp_err_t battery_log_seq_init(void);
 int battery_log_find_start_index_by_seq(uint32_t start_seq);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,10 +1,23 @@
 #include "ble_batt_mock.h"
 
+#include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include "esp_log.h"
-#include "esp_timer.h"
-#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "battery_log.h"
+#include "ble_coc.h"
+#include "ble_link.h"
+#include "ble_stats.h"
+#include "ble_sync.h"
+#include "notify_pool.h"
+#include "notify_sched.h"
+#include "cell_stats.h"
+#include "frame_crypt.h"
+#include "wifi_offload.h"
+#include "lat_hist.h"
+#include "esp_timer.h"
 
 
 #include "host/ble_hs.h"
@@ -22,107 +35,112 @@ static uint16_t s_live_val_handle = 0;
 static bool s_live_notify = false;
 
 static uint16_t s_cmd_val_handle = 0;
-static volatile bool s_backlog_requested = false;
-static volatile bool s_backlog_abort = false;
 
 static uint16_t s_backlog_val_handle = 0;
 static bool s_backlog_notify = false;
-static volatile bool s_is_sending_backlog = false;
+static bool s_is_sending_backlog = false;      // sender task only
 
-static volatile backlog_request_t s_backlog_req = {
-    .mode = BACKLOG_MODE_FULL,
-    .start_seq = 0,
-};
+// Backlog commands: the GATT callback enqueues, the sender blocks on the
+// queue (between samples and between backlog records), so a request is
+// picked up as soon as the sender is free instead of at its next poll.
+#define BACKLOG_CMDQ_LEN 4
 
-backlog_request_t ble_backlog_get_request(void)
-{
-    backlog_request_t r;
-    r.mode = s_backlog_req.mode;
-    r.start_seq = s_backlog_req.start_seq;
-    return r;
-}
+static QueueHandle_t s_cmdq = NULL;
+static StaticQueue_t s_cmdq_buf;
+static uint8_t s_cmdq_storage[BACKLOG_CMDQ_LEN * sizeof(backlog_cmd_t)];
 
-bool ble_backlog_requested(void) { return s_backlog_requested; }
-void ble_backlog_clear_request(void) { s_backlog_requested = false; }
-void ble_backlog_clear_abort(void) { s_backlog_abort = false; }
+static portMUX_TYPE s_lat_lock = portMUX_INITIALIZER_UNLOCKED;
+static lat_hist_t s_req_lat;                   // GATT write -> first backlog notification
+static uint32_t s_cmd_full = 0;                // rejected, queue full
+static uint32_t s_cmd_stale = 0;               // dropped, from an earlier connection
 
-bool ble_backlog_is_subscribed(void) { return s_backlog_notify && s_conn != BLE_HS_CONN_HANDLE_NONE; }
-
-bool ble_backlog_abort_requested(void)
+int ble_backlog_submit(backlog_cmd_type_t type, backlog_mode_t mode, uint32_t start_seq,
+                       backlog_via_t via)
 {
-    if (s_backlog_abort) {
-        s_backlog_abort = false;  // clear on read
-        return true;
+    backlog_cmd_t c = {
+        .type = type,
+        .req = { .mode = mode, .start_seq = start_seq },
+        .via = via,
+        .conn = s_conn,
+        .t_rx_us = esp_timer_get_time(),
+    };
+    // An abort jumps the queue so it is seen before any queued request.
+    BaseType_t ok = (type == BACKLOG_CMD_ABORT) ? xQueueSendToFront(s_cmdq, &c, 0)
+                                                : xQueueSendToBack(s_cmdq, &c, 0);
+    if (ok != pdTRUE) {
+        if (type == BACKLOG_CMD_PUMP) return -1;   // the queue already wakes the sender
+        s_cmd_full++;
+        ESP_LOGW(TAG, "backlog command queue full");
+        return -1;
     }
-    return false;
+    return 0;
 }
 
-
-void ble_batt_set_sending_backlog(bool v)
+static int backlog_enqueue(backlog_cmd_type_t type, backlog_mode_t mode, uint32_t start_seq)
 {
-    s_is_sending_backlog = v;
+    return ble_backlog_submit(type, mode, start_seq, BACKLOG_VIA_GATT);
 }
 
-bool ble_batt_is_sending_backlog(void)
+void ble_backlog_kick(void)
 {
-    return s_is_sending_backlog;
+    ble_backlog_submit(BACKLOG_CMD_PUMP, BACKLOG_MODE_FULL, 0, BACKLOG_VIA_COC);
 }
 
-bool ble_batt_mock_is_subscribed(void)
+bool ble_backlog_wait_cmd(backlog_cmd_t *out, TickType_t wait)
 {
-    return s_live_notify && s_conn != BLE_HS_CONN_HANDLE_NONE;
+    while (xQueueReceive(s_cmdq, out, wait) == pdTRUE) {
+        // A pump only wakes the sender, so it is never stale.
+        if (out->conn == s_conn || out->type == BACKLOG_CMD_PUMP) return true;
+        s_cmd_stale++;
+        wait = 0;   // keep draining stale commands, but don't wait again
+    }
+    return false;
 }
 
-static uint16_t rand_u16(uint16_t min, uint16_t max)
+void ble_backlog_note_first_notify(const backlog_cmd_t *cmd)
 {
-    if (max <= min) return min;
-    return (uint16_t)(min + (esp_random() % (max - min + 1)));
+    int64_t dt = esp_timer_get_time() - cmd->t_rx_us;
+    if (dt < 0) dt = 0;
+    portENTER_CRITICAL(&s_lat_lock);
+    lat_hist_add(&s_req_lat, dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt);
+    portEXIT_CRITICAL(&s_lat_lock);
 }
 
-static int16_t rand_i16(int16_t min, int16_t max)
+static int cmdq_stats_section(char *buf, size_t len)
 {
-    if (max <= min) return min;
-    return (int16_t)(min + (int32_t)(esp_random() % (uint32_t)(max - min + 1)));
+    lat_hist_t h;
+    portENTER_CRITICAL(&s_lat_lock);
+    h = s_req_lat;
+    portEXIT_CRITICAL(&s_lat_lock);
+
+    int n = snprintf(buf, len, "full=%" PRIu32 ",stale=%" PRIu32 ",", s_cmd_full, s_cmd_stale);
+    if (n < 0 || (size_t)n >= len) return n;
+    return n + lat_hist_format(&h, buf + n, len - (size_t)n);
 }
-static void build_mock(battery_log_t *r)
-{
-    memset(r, 0, sizeof(*r));
-
-    r->timestamp_s = (uint32_t)(esp_timer_get_time() / 1000000ULL);
 
-    // Random-ish cells around 3600–4200 mV
-    uint32_t sum = 0;
-    uint16_t base = rand_u16(3600, 4100);
+bool ble_backlog_is_subscribed(void) { return s_backlog_notify && s_conn != BLE_HS_CONN_HANDLE_NONE; }
 
-    for (int i = 0; i < 16; i++) {
-        int16_t noise = rand_i16(-15, 15);     // small cell-to-cell variation
-        uint16_t v = (uint16_t)((int32_t)base + noise);
 
-        // clamp
-        if (v < 3300) v = 3300;
-        if (v > 4200) v = 4200;
+void ble_batt_set_sending_backlog(bool v)
+{
+    bool was = s_is_sending_backlog;
+    s_is_sending_backlog = v;
 
-        r->cell_mv[i] = v;
-        sum += v;
+    if (v && !was) {
+        ble_link_bulk_begin(BLE_LINK_USER_BACKLOG);
+    } else if (!v && was) {
+        ble_link_bulk_end(BLE_LINK_USER_BACKLOG);
     }
+}
 
-    r->pack_total_mv = (uint16_t)sum;
-
-    // Load drop 20–150 mV (just a mock)
-    uint16_t drop = rand_u16(20, 150);
-    r->pack_ld_mv = (r->pack_total_mv > drop) ? (r->pack_total_mv - drop) : r->pack_total_mv;
-
-    r->pack_sum_active_mv = r->pack_total_mv;
-
-    // Current -5000 to +5000 mA
-    r->current_ma = rand_i16(-5000, 5000);
-
-    // Temps: 20.00°C–45.00°C
-    r->temp_ts1_c_x100 = (int16_t)rand_u16(2000, 4500);
-    r->temp_int_c_x100 = (int16_t)rand_u16(2000, 4500);
+bool ble_batt_is_sending_backlog(void)
+{
+    return s_is_sending_backlog;
+}
 
-    // SOC 0–100
-    r->soc = (uint8_t)rand_u16(0, 100);
+bool ble_batt_mock_is_subscribed(void)
+{
+    return s_live_notify && s_conn != BLE_HS_CONN_HANDLE_NONE;
 }
 
 static uint32_t u32_le(const uint8_t *p)
@@ -133,6 +151,23 @@ static uint32_t u32_le(const uint8_t *p)
            ((uint32_t)p[3] << 24);
 }
 
+// Called when the client is known and backlog notify is on: restart a backlog
+// that a disconnect cut off, from the client's watermark.
+static void maybe_resume_backlog(void)
+{
+    uint32_t start;
+    if (ble_sync_take_resume(&start)) {
+        backlog_enqueue(BACKLOG_CMD_START, BACKLOG_MODE_FROM_SEQ, start);
+    }
+}
+
+void ble_batt_mock_sync_ready(void)
+{
+    if (s_backlog_notify) {
+        maybe_resume_backlog();
+    }
+}
+
 static int cmd_access_cb(uint16_t conn_handle, uint16_t attr_handle,
                          struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
@@ -155,56 +190,77 @@ static int cmd_access_cb(uint16_t conn_handle, uint16_t attr_handle,
         return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
 
+    // Abort: [03] - the sender ignores it when no backlog is running
     if (cmd == 0x03) {
-        if (s_is_sending_backlog) {
-            s_backlog_abort = true;
-            ESP_LOGI(TAG, "Backlog abort requested (CMD=0x03)");
-        } else {
-           
-            s_backlog_abort = false;
-            ESP_LOGI(TAG, "Abort ignored (no backlog in progress)");
+        ESP_LOGI(TAG, "Backlog abort requested (CMD=0x03)");
+        return backlog_enqueue(BACKLOG_CMD_ABORT, BACKLOG_MODE_FULL, 0) == 0
+                   ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    // ACK: [04][u32 seq LE] - client holds every record up to seq
+    if (cmd == 0x04) {
+        uint8_t buf[5];
+        if (len != 5 || os_mbuf_copydata(ctxt->om, 0, 5, buf) != 0) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        if (ble_sync_ack(u32_le(&buf[1])) != 0) {
+            return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
         }
         return 0;
     }
 
-    if (cmd != 0x01) {
-        ESP_LOGW(TAG, "Unknown CMD=0x%02X (len=%u)", cmd, (unsigned)len);
+    // Client id: [06][1..16 bytes]
+    if (cmd == 0x06) {
+        uint8_t buf[1 + BLE_SYNC_ID_MAX];
+        if (len < 2 || len > sizeof(buf) || os_mbuf_copydata(ctxt->om, 0, len, buf) != 0) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        if (ble_sync_set_client_id(&buf[1], len - 1u) != 0) {
+            return BLE_ATT_ERR_UNLIKELY;    // sync state still loading, retry
+        }
+        if (s_backlog_notify) {
+            maybe_resume_backlog();
+        }
         return 0;
     }
 
-    if (s_is_sending_backlog) {
-        ESP_LOGI(TAG, "Backlog request ignored: already sending");
+    if (cmd != 0x01 && cmd != 0x05) {
+        ESP_LOGW(TAG, "Unknown CMD=0x%02X (len=%u)", cmd, (unsigned)len);
         return 0;
     }
 
+    // Sync: [05] - everything after the client's watermark, or all if none.
+    // The sender looks the watermark up, so this also works during fast boot
+    // before the sync table is loaded.
+    if (cmd == 0x05) {
+        if (len != 1) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        ESP_LOGI(TAG, "Sync requested (CMD=0x05)");
+        return backlog_enqueue(BACKLOG_CMD_START, BACKLOG_MODE_SYNC, 0) == 0
+                   ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
     // Legacy: [01]
     if (len == 1) {
-        ble_backlog_clear_abort();
-        s_backlog_req.mode = BACKLOG_MODE_FULL;
-        s_backlog_req.start_seq = 0;
-        s_backlog_requested = true;
-
-
         ESP_LOGI(TAG, "Backlog requested: FULL (CMD=0x01, len=1)");
-        return 0;
+        return backlog_enqueue(BACKLOG_CMD_START, BACKLOG_MODE_FULL, 0) == 0
+                   ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
     }
 
     // New: [01][u32 start_seq LE] => len == 5
     if (len == 5) {
-        ble_backlog_clear_abort();
         uint8_t buf[5] = {0};
         rc = os_mbuf_copydata(ctxt->om, 0, 5, buf);
         if (rc != 0) {
             return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
         }
 
-        s_backlog_req.mode = BACKLOG_MODE_FROM_SEQ;
-        s_backlog_req.start_seq = u32_le(&buf[1]);
-        s_backlog_requested = true;
-
+        uint32_t start_seq = u32_le(&buf[1]);
         ESP_LOGI(TAG, "Backlog requested: FROM_SEQ start_seq=%u (CMD=0x01, len=5)",
-                 (unsigned)s_backlog_req.start_seq);
-        return 0;
+                 (unsigned)start_seq);
+        return backlog_enqueue(BACKLOG_CMD_START, BACKLOG_MODE_FROM_SEQ, start_seq) == 0
+                   ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
     }
 
     ESP_LOGW(TAG, "Backlog CMD=0x01 invalid len=%u (expected 1 or 5)", (unsigned)len);
@@ -225,25 +281,232 @@ static int notify_only_access_cb(uint16_t conn_handle, uint16_t attr_handle,
 }
 
 
+// Read-only, so the phone can plan a sync without starting a backlog.
+typedef struct __attribute__((packed)) {
+    uint8_t  version;       // 3
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t first_seq;
+    uint32_t last_seq;
+    uint32_t first_ts;
+    uint32_t last_ts;
+    uint32_t next_seq;      // seq of the next sample
+    uint32_t watermark;     // this client's ACK watermark, 0xFFFFFFFF if none
+    uint8_t  frame_flags;   // SUMMARY_FRAMES_SEALED: live/backlog frames are frame_crypt sealed;
+                            // SUMMARY_COC_AVAILABLE: bulk channel on BLE_COC_PSM
+    uint8_t  key_id;        // device key in use when sealed
+    uint32_t upload_wm;     // newest seq the backend got over Wi-Fi, 0xFFFFFFFF if none
+} log_summary_frame_t;
+
+#define SUMMARY_FRAMES_SEALED  0x01
+#define SUMMARY_COC_AVAILABLE  0x02
+
+static int summary_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                             struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    battery_log_summary_t sum;
+    if (!battery_log_get_summary(&sum)) {
+        return BLE_ATT_ERR_UNLIKELY;    // log still loading (fast boot)
+    }
+
+    log_summary_frame_t f = {
+        .version = 3,
+        .count = sum.count,
+        .bytes = sum.bytes,
+        .first_seq = sum.first_seq,
+        .last_seq = sum.last_seq,
+        .first_ts = sum.first_ts,
+        .last_ts = sum.last_ts,
+        .next_seq = battery_log_peek_next_seq(),
+        .watermark = 0xFFFFFFFFu,
+        .frame_flags = (frame_crypt_active() ? SUMMARY_FRAMES_SEALED : 0) |
+                       (ble_coc_available() ? SUMMARY_COC_AVAILABLE : 0),
+        .key_id = frame_crypt_key_id(),
+        .upload_wm = 0xFFFFFFFFu,
+    };
+    uint32_t wm;
+    if (ble_sync_get_watermark(&wm)) {
+        f.watermark = wm;
+    }
+    if (wifi_offload_get_watermark(&wm)) {
+        f.upload_wm = wm;
+    }
+
+    int rc = os_mbuf_append(ctxt->om, &f, sizeof(f));
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+// Read-only: the record layout (log_schema.h) so a client decodes records
+// of any LOG_RECORD_VERSION without an app update. Long reads past the
+// MTU are handled by NimBLE (read blob).
+static int schema_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                            struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+
+    static uint8_t s_table[LOG_SCHEMA_TABLE_MAX];
+    static int s_table_len = 0;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    if (s_table_len <= 0) {
+        s_table_len = log_schema_table(s_table, sizeof(s_table));
+        if (s_table_len < 0) return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    int rc = os_mbuf_append(ctxt->om, s_table, (uint16_t)s_table_len);
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static volatile uint32_t s_notify_fail = 0;
+
+// Frames go through the scheduler rather than straight to the host; it
+// consumes `om` whether or not the submit succeeds, so the caller must not
+// free it afterwards. -2 means the class queue is full.
+static int notify_frame(ns_class_t cls, uint16_t val_handle, struct os_mbuf *om, uint16_t payload_len)
+{
+    int rc = notify_sched_submit(cls, s_conn, val_handle, om, payload_len);
+    if (rc != 0) {
+        s_notify_fail++;
+    }
+    return rc;
+}
+
+// With a device key every frame is sealed in place: the header goes in
+// front of the payload and frame_crypt_seal() appends the tag, so the
+// producers below still write records straight into the mbuf.
+static uint8_t *frame_begin(struct os_mbuf *om, bool sealed)
+{
+    if (!sealed) {
+        return OS_MBUF_DATA(om, uint8_t *) + om->om_len;
+    }
+    return notify_pool_reserve(om, FRAME_CRYPT_HDR_LEN);
+}
+
+// Seal `frame` (from frame_begin) once the body is in; returns the payload
+// length to notify, or -1.
+static int frame_end(struct os_mbuf *om, uint8_t *frame, bool sealed, size_t body_len,
+                     frame_type_t type, uint8_t count)
+{
+    if (!sealed) {
+        return (int)body_len;
+    }
+    if (!notify_pool_reserve(om, FRAME_CRYPT_TAG_LEN)) {
+        return -1;
+    }
+    return frame_crypt_seal(frame, body_len, type, count);
+}
+
 int ble_batt_mock_notify_backlog(const battery_log_t *rec)
 {
     if (s_conn == BLE_HS_CONN_HANDLE_NONE || !s_backlog_notify) {
         return -1;
     }
 
-    struct os_mbuf *om = ble_hs_mbuf_from_flat(rec, sizeof(*rec));
+    struct os_mbuf *om = notify_pool_get();
     if (!om) {
-        ESP_LOGE(TAG, "ble_hs_mbuf_from_flat failed");
         return -2;
     }
 
-    int rc = ble_gatts_notify_custom(s_conn, s_backlog_val_handle, om);
-    if (rc != 0) {
-        ESP_LOGW(TAG, "BACKLOG notify failed rc=%d", rc);
-        os_mbuf_free_chain(om);   // IMPORTANT: free on error
+    bool sealed = frame_crypt_active();
+    uint8_t *frame = frame_begin(om, sealed);
+    battery_log_t *dst = frame ? notify_pool_reserve(om, sizeof(*rec)) : NULL;
+    if (!dst) {
+        os_mbuf_free_chain(om);
+        return -2;
     }
+    memcpy(dst, rec, sizeof(*rec));
 
-    return rc;
+    int len = frame_end(om, frame, sealed, sizeof(*rec), FRAME_TYPE_BACKLOG, 1);
+    if (len < 0) {
+        os_mbuf_free_chain(om);
+        return -2;
+    }
+    return notify_frame(NS_CLASS_BACKLOG, s_backlog_val_handle, om, (uint16_t)len);
+}
+
+// Records per sealed backlog frame: what the connection's ATT payload
+// holds, up to FRAME_CRYPT_BACKLOG_RECS.
+static int backlog_batch_max(void)
+{
+    int payload = (int)ble_att_mtu(s_conn) - 3 - FRAME_CRYPT_OVERHEAD;
+    int n = payload / (int)sizeof(battery_log_t);
+    if (n > (int)FRAME_CRYPT_BACKLOG_RECS) n = FRAME_CRYPT_BACKLOG_RECS;
+    return n > 1 ? n : 1;
+}
+
+int ble_batt_mock_notify_backlog_at(int index, int max_n, uint32_t *last_seq)
+{
+    if (s_conn == BLE_HS_CONN_HANDLE_NONE || !s_backlog_notify) {
+        return -1;
+    }
+    if (!notify_sched_has_room(NS_CLASS_BACKLOG)) {
+        return -2;      // don't read a record the scheduler can't take yet
+    }
+
+    struct os_mbuf *om = notify_pool_get();
+    if (!om) {
+        return -2;
+    }
+
+    bool sealed = frame_crypt_active();
+    int batch = sealed ? backlog_batch_max() : 1;
+    if (max_n < batch) batch = max_n > 1 ? max_n : 1;
+
+    uint8_t *frame = frame_begin(om, sealed);
+    battery_log_t *dst = frame ? notify_pool_reserve(om, batch * sizeof(battery_log_t)) : NULL;
+    if (!dst) {
+        os_mbuf_free_chain(om);
+        return -2;
+    }
+
+    // Read the records from flash straight into the frame payload. A read
+    // error ends the batch early; the caller gets that index on its own next.
+    int n = 0;
+    while (n < batch && battery_log_read(index + n, &dst[n])) {
+        n++;
+    }
+    if (n == 0) {
+        os_mbuf_free_chain(om);
+        return -4;
+    }
+    if (n < batch) {
+        os_mbuf_adj(om, -(int)((batch - n) * sizeof(battery_log_t)));
+    }
+
+    if (last_seq) {
+        *last_seq = dst[n - 1].seq;
+    }
+
+    int len = frame_end(om, frame, sealed, n * sizeof(battery_log_t), FRAME_TYPE_BACKLOG, (uint8_t)n);
+    if (len < 0) {
+        os_mbuf_free_chain(om);
+        return -2;
+    }
+    int rc = notify_frame(NS_CLASS_BACKLOG, s_backlog_val_handle, om, (uint16_t)len);
+    return rc == 0 ? n : rc;
+}
+
+static int npool_stats_section(char *buf, size_t len)
+{
+    notify_pool_stats_t st;
+    notify_pool_get_stats(&st);
+    return snprintf(buf, len,
+                    "blocks=%u,free=%u,min_free=%u,allocs=%" PRIu32
+                    ",exhausted=%" PRIu32 ",notify_fail=%" PRIu32,
+                    (unsigned)st.blocks, (unsigned)st.free_now, (unsigned)st.min_free,
+                    st.allocs, st.exhausted, s_notify_fail);
 }
 
 
@@ -251,6 +514,8 @@ int ble_batt_mock_notify_backlog(const battery_log_t *rec)
 // LIVE char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee1
 // CMD  char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee2
 // BACKLOG char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee3
+// SUMMARY char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee4
+// SCHEMA char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeee5
 static const struct ble_gatt_svc_def g_svcs[] = {
     {
         .type = BLE_GATT_SVC_TYPE_PRIMARY,
@@ -274,6 +539,16 @@ static const struct ble_gatt_svc_def g_svcs[] = {
                 .flags = BLE_GATT_CHR_F_NOTIFY,
                 .val_handle = &s_backlog_val_handle,
             },
+            {
+                .uuid = BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xe4),
+                .access_cb = summary_access_cb,
+                .flags = BLE_GATT_CHR_F_READ,
+            },
+            {
+                .uuid = BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xe5),
+                .access_cb = schema_access_cb,
+                .flags = BLE_GATT_CHR_F_READ,
+            },
             { 0 }
         }
     },
@@ -284,6 +559,16 @@ void ble_batt_mock_register(void)
 {
     int rc;
 
+    rc = notify_pool_init();
+    if (rc != 0) {
+        ESP_LOGE(TAG, "notify_pool_init failed rc=%d", rc);
+        return;
+    }
+    ble_stats_register_section("npool", npool_stats_section);
+
+    s_cmdq = xQueueCreateStatic(BACKLOG_CMDQ_LEN, sizeof(backlog_cmd_t), s_cmdq_storage, &s_cmdq_buf);
+    ble_stats_register_section("cmdq", cmdq_stats_section);
+
     rc = ble_gatts_count_cfg(g_svcs);
     if (rc != 0) {
         ESP_LOGE(TAG, "ble_gatts_count_cfg failed rc=%d", rc);
@@ -304,41 +589,58 @@ void ble_batt_mock_on_connect(uint16_t conn_handle)
     s_conn = conn_handle;
 }
 
-void ble_batt_mock_build_record(battery_log_t *out)
-{
-    if (!out) return;
-    build_mock(out);
-}
+_Static_assert(sizeof(live_frame_t) + FRAME_CRYPT_OVERHEAD <= NOTIFY_POOL_FRAME_MAX || !FRAME_CRYPT_ENABLE,
+               "sealed live frame must fit a notify pool block");
+_Static_assert(sizeof(live_frame_t) <= NOTIFY_POOL_FRAME_MAX, "live frame must fit a notify pool block");
+
 int ble_batt_mock_notify_live(const battery_log_t *rec)
 {
     if (!rec) return -2;
     if (!ble_batt_mock_is_subscribed()) return -1;
 
-    struct os_mbuf *om = ble_hs_mbuf_from_flat(rec, sizeof(*rec));
+    struct os_mbuf *om = notify_pool_get();
     if (!om) {
-        ESP_LOGE(TAG, "ble_hs_mbuf_from_flat failed (LIVE)");
+        ESP_LOGW(TAG, "notify pool exhausted (LIVE)");
         return -3;
     }
 
-    int rc = ble_gatts_notify_custom(s_conn, s_live_val_handle, om);
-    if (rc != 0) {
-        ESP_LOGW(TAG, "LIVE notify failed rc=%d", rc);
+    bool sealed = frame_crypt_active();
+    uint8_t *frame = frame_begin(om, sealed);
+#if BLE_LIVE_CELL_STATS
+    live_frame_t *dst = frame ? notify_pool_reserve(om, sizeof(*dst)) : NULL;
+    if (!dst) {
         os_mbuf_free_chain(om);
+        return -3;
+    }
+    memcpy(&dst->rec, rec, sizeof(*rec));
+    cell_stats_compute(rec, &dst->cells, NULL);
+#else
+    battery_log_t *dst = frame ? notify_pool_reserve(om, sizeof(*rec)) : NULL;
+    if (!dst) {
+        os_mbuf_free_chain(om);
+        return -3;
+    }
+    memcpy(dst, rec, sizeof(*rec));
+#endif
+
+    int len = frame_end(om, frame, sealed, sizeof(*dst), FRAME_TYPE_LIVE, 1);
+    if (len < 0) {
+        os_mbuf_free_chain(om);
+        return -3;
+    }
+    int rc = notify_frame(NS_CLASS_LIVE, s_live_val_handle, om, (uint16_t)len);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "LIVE queue full, sample is in the log only");
     }
     return rc;
 }
 
-
 void ble_batt_mock_on_disconnect(void)
 {
     s_conn = BLE_HS_CONN_HANDLE_NONE;
     s_live_notify = false;
     s_backlog_notify = false;
-    s_backlog_requested = false;
-    s_is_sending_backlog = false;
-    ble_backlog_clear_abort();
-    s_backlog_req.mode = BACKLOG_MODE_FULL;
-    s_backlog_req.start_seq = 0;
+    // Queued commands carry the old connection handle; the sender drops them.
 }
 
 void ble_batt_mock_on_subscribe(uint16_t attr_handle, bool notify_enabled)
@@ -346,8 +648,12 @@ void ble_batt_mock_on_subscribe(uint16_t attr_handle, bool notify_enabled)
     if (attr_handle == s_live_val_handle) {
         s_live_notify = notify_enabled;
         ESP_LOGI(TAG, "LIVE notify %s", notify_enabled ? "ENABLED" : "DISABLED");
+        ble_link_set_live_active(notify_enabled);
     } else if (attr_handle == s_backlog_val_handle) {
         s_backlog_notify = notify_enabled;
         ESP_LOGI(TAG, "BACKLOG notify %s", notify_enabled ? "ENABLED" : "DISABLED");
+        if (notify_enabled) {
+            maybe_resume_backlog();
+        }
     }
 }
\ No newline at end of file
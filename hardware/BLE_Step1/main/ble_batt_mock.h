@@ -2,9 +2,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "battery_log.h"
+#include "cell_stats.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 typedef enum {
     BACKLOG_MODE_FULL = 0,
     BACKLOG_MODE_FROM_SEQ = 1,
+    BACKLOG_MODE_SYNC = 2,      // after the client's watermark, resolved by the sender
 } backlog_mode_t;
 
 typedef struct {
@@ -12,12 +17,55 @@ typedef struct {
     uint32_t start_seq;
 } backlog_request_t;
 
-backlog_request_t ble_backlog_get_request(void);
+typedef enum {
+    BACKLOG_CMD_START = 0,      // CMD 0x01 / 0x05, or a resume after reconnect
+    BACKLOG_CMD_ABORT,          // CMD 0x03
+    BACKLOG_CMD_PUMP,           // wake-up: a sample is queued, or the bulk channel can send
+} backlog_cmd_type_t;
+
+typedef enum {
+    BACKLOG_VIA_GATT = 0,       // backlog characteristic notifications
+    BACKLOG_VIA_COC,            // L2CAP bulk channel (ble_coc.h)
+} backlog_via_t;
+
+typedef struct {
+    backlog_cmd_type_t type;
+    backlog_request_t req;      // START only
+    backlog_via_t via;          // START only
+    uint16_t conn;              // connection the command arrived on
+    int64_t t_rx_us;            // esp_timer at the GATT write
+} backlog_cmd_t;
+
 void ble_batt_mock_register(void);
+
+/**
+ * @brief Wait up to `wait` ticks for the next backlog command (the sender
+ *        task). Commands from an earlier connection are dropped here.
+ */
+bool ble_backlog_wait_cmd(backlog_cmd_t *out, TickType_t wait);
+
+/** Queue a backlog command for the sender; -1 if the queue is full. */
+int ble_backlog_submit(backlog_cmd_type_t type, backlog_mode_t mode, uint32_t start_seq,
+                       backlog_via_t via);
+
+/**
+ * Wake the sender: a sample is queued for it, or a bulk channel send can be
+ * retried. Dropped if the queue is full, since what is queued wakes it too.
+ */
+void ble_backlog_kick(void);
+
+/** The first backlog notification for `cmd` went out (request latency histogram). */
+void ble_backlog_note_first_notify(const backlog_cmd_t *cmd);
 void ble_batt_mock_on_connect(uint16_t conn_handle);
 void ble_batt_mock_on_disconnect(void);
 void ble_batt_mock_on_subscribe(uint16_t attr_handle, bool notify_enabled);
 
+/**
+ * @brief ble_sync state is loaded. With fast boot a client can connect and
+ *        subscribe before that; this picks up a backlog resume it missed.
+ */
+void ble_batt_mock_sync_ready(void);
+
 bool ble_batt_mock_is_subscribed(void);
 
 /**
@@ -26,25 +74,36 @@ bool ble_batt_mock_is_subscribed(void);
  */
 bool ble_backlog_is_subscribed(void);
 
-bool ble_backlog_requested(void);
-void ble_backlog_clear_request(void);
-void ble_backlog_clear_abort(void);
-
-/**
- * @brief Check if client has requested backlog abort (CMD 0x03)
- * @return true if abort was requested; clears flag on read
- */
-bool ble_backlog_abort_requested(void);
 
 
 int ble_batt_mock_notify_backlog(const battery_log_t *rec);
 
+/**
+ * @brief Notify log records from `index` on the backlog characteristic,
+ *        reading them from flash directly into the notification mbuf (no
+ *        stack copy). Plaintext frames carry one record; sealed frames
+ *        (frame_crypt) batch up to `max_n` of them, as many as the MTU allows.
+ * @param last_seq optional, receives the seq of the last record in the frame
+ * @return records queued (>= 1), -1 not subscribed, -2 notify pool exhausted
+ *         or backlog queue full (retry), -4 log read failed at `index`
+ */
+int ble_batt_mock_notify_backlog_at(int index, int max_n, uint32_t *last_seq);
+
 
 void ble_batt_set_sending_backlog(bool v);
 bool ble_batt_is_sending_backlog(void);
 
+// Live frames carry the record followed by its cell analytics, so clients
+// don't each recompute them; -DBLE_LIVE_CELL_STATS=0 sends the bare record.
+// Backlog frames are always bare records. Either may be sealed, see
+// frame_crypt.h.
+#ifndef BLE_LIVE_CELL_STATS
+#define BLE_LIVE_CELL_STATS 1
+#endif
 
-void ble_batt_mock_build_record(battery_log_t *out);
-
+typedef struct __attribute__((packed)) {
+    battery_log_t rec;
+    cell_stats_t cells;
+} live_frame_t;
 
 int ble_batt_mock_notify_live(const battery_log_t *rec);
\ No newline at end of file
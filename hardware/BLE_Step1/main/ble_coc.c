@@ -0,0 +1,419 @@
+#include "ble_coc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "battery_log.h"
+#include "ble_batt_mock.h"
+#include "ble_link.h"
+#include "ble_ota.h"
+#include "ble_stats.h"
+#include "ble_sync.h"
+#include "frame_crypt.h"
+
+#include "host/ble_hs.h"
+#include "os/os_mbuf.h"
+
+static const char *TAG = "BLE_COC";
+
+#define COC_STATUS_MAX  64
+
+// Smallest peer MTU a backlog SDU fits in: the header and one record, sealed
+// or not. A smaller channel could carry nothing and is refused.
+#define COC_PEER_MTU_MIN (BLE_COC_HDR_LEN + FRAME_CRYPT_OVERHEAD + sizeof(battery_log_t))
+
+// Two SDU buffers: one lent to the host for the next received SDU, one for
+// the SDU being sent. Each holds a whole SDU in one block, so neither the
+// host's reassembly nor a producer ever chains.
+#define COC_POOL_BLOCKS 2
+#define COC_BLOCK_SIZE  (sizeof(struct os_mbuf) + sizeof(struct os_mbuf_pkthdr) + BLE_COC_SDU_MAX)
+
+static os_membuf_t s_pool_mem[BLE_COC_ENABLE ? OS_MEMPOOL_SIZE(COC_POOL_BLOCKS, COC_BLOCK_SIZE) : 1];
+static struct os_mempool s_mempool;
+static struct os_mbuf_pool s_pool;
+static bool s_ready = false;
+static bool s_listening = false;
+
+// Channel state: events arrive on the host task, backlog SDUs are sent
+// from mock_sender, so the TX claim and the pending status are taken
+// under the lock.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct ble_l2cap_chan *s_chan = NULL;
+static uint16_t s_sdu_len = 0;              // largest SDU the peer takes, <= BLE_COC_SDU_MAX
+static bool s_tx_busy = false;              // an SDU is with the host (waiting for credits)
+static bool s_status_queued = false;
+static char s_status[COC_STATUS_MAX];
+
+static ble_coc_stats_t s_stats;
+
+static uint32_t u32_le(const uint8_t *p)
+{
+    return ((uint32_t)p[0]) |
+           ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static struct os_mbuf *sdu_get(void)
+{
+    struct os_mbuf *om = s_ready ? os_mbuf_get_pkthdr(&s_pool, 0) : NULL;
+    if (!om) s_stats.no_buf++;
+    return om;
+}
+
+// One SDU at a time: NimBLE holds a single TX SDU per channel.
+static bool tx_claim(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool ok = s_chan != NULL && !s_tx_busy;
+    if (ok) s_tx_busy = true;
+    portEXIT_CRITICAL(&s_lock);
+    return ok;
+}
+
+static void tx_release(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_tx_busy = false;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// Caller holds the TX claim; `om` is consumed. A stalled SDU stays with the
+// host and keeps the claim until BLE_L2CAP_EVENT_COC_TX_UNSTALLED.
+static int tx_send(struct os_mbuf *om)
+{
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    int rc = ble_l2cap_send(s_chan, om);
+
+    if (rc == BLE_HS_ESTALLED) {
+        s_stats.stalls++;
+        rc = 0;
+    } else {
+        // EBUSY / EBADDATA are refused before the host takes the SDU; on
+        // any other error it has freed it, and the caller resends the records.
+        if (rc == BLE_HS_EBUSY || rc == BLE_HS_EBADDATA) {
+            os_mbuf_free_chain(om);
+        }
+        tx_release();
+    }
+
+    if (rc == 0) {
+        s_stats.sdu_tx++;
+        s_stats.bytes_tx += len;
+        ble_link_note_tx(len);
+    }
+    return rc;
+}
+
+// Latest OTA status, once the channel is free.
+static void flush_status(void)
+{
+    char msg[COC_STATUS_MAX];
+
+    portENTER_CRITICAL(&s_lock);
+    bool go = s_status_queued && s_chan != NULL && !s_tx_busy;
+    if (go) {
+        memcpy(msg, s_status, sizeof(msg));
+        s_status_queued = false;
+        s_tx_busy = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!go) return;
+
+    struct os_mbuf *om = sdu_get();
+    uint8_t op = BLE_COC_OP_OTA_STATUS;
+    if (!om || os_mbuf_append(om, &op, 1) != 0 || os_mbuf_append(om, msg, (uint16_t)strlen(msg)) != 0) {
+        if (om) os_mbuf_free_chain(om);
+        tx_release();
+        return;
+    }
+    tx_send(om);
+}
+
+int ble_coc_send_status(const char *msg)
+{
+    if (!msg) return -1;
+
+    portENTER_CRITICAL(&s_lock);
+    bool open = s_chan != NULL;
+    if (open) {
+        snprintf(s_status, sizeof(s_status), "%s", msg);
+        s_status_queued = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!open) return -1;
+
+    flush_status();
+    return 0;
+}
+
+int ble_coc_send_backlog_at(int index, int max_n, uint32_t *last_seq)
+{
+    if (!s_chan) return -1;
+    if (!tx_claim()) return -2;
+
+    struct os_mbuf *om = sdu_get();
+    uint8_t *sdu = om ? os_mbuf_extend(om, s_sdu_len) : NULL;
+    if (!sdu) {
+        if (om) os_mbuf_free_chain(om);
+        tx_release();
+        return -2;
+    }
+
+    // Records go from flash straight into the SDU; sealed, as frame_crypt
+    // frames of up to FRAME_CRYPT_BACKLOG_RECS records each, so the client
+    // opens them exactly like backlog notifications.
+    bool sealed = frame_crypt_active();
+    size_t pos = BLE_COC_HDR_LEN;
+    size_t overhead = sealed ? FRAME_CRYPT_OVERHEAD : 0;
+    int per_frame = sealed ? (int)FRAME_CRYPT_BACKLOG_RECS : max_n;
+    int n = 0;
+    int err = -4;
+    uint32_t seq = 0;
+
+    while (n < max_n) {
+        int room = (int)((s_sdu_len - pos - overhead) / sizeof(battery_log_t));
+        int want = max_n - n;
+        if (want > per_frame) want = per_frame;
+        if (want > room) want = room;
+        if (want <= 0) {
+            err = -5;
+            break;
+        }
+
+        uint8_t *frame = sdu + pos;
+        battery_log_t *recs = (battery_log_t *)(frame + (sealed ? FRAME_CRYPT_HDR_LEN : 0));
+        int got = 0;
+        while (got < want && battery_log_read(index + n + got, &recs[got])) {
+            got++;
+        }
+        if (got == 0) break;
+        seq = recs[got - 1].seq;
+
+        size_t len = got * sizeof(battery_log_t);
+        if (sealed) {
+            int sl = frame_crypt_seal(frame, len, FRAME_TYPE_BACKLOG, (uint8_t)got);
+            if (sl < 0) {
+                err = -1;
+                break;
+            }
+            len = (size_t)sl;
+        }
+        pos += len;
+        n += got;
+        if (got < want) break;      // read error: the caller gets that index on its own next
+    }
+
+    if (n == 0) {
+        os_mbuf_free_chain(om);
+        tx_release();
+        return err;
+    }
+
+    sdu[0] = BLE_COC_OP_BACKLOG_DATA;
+    sdu[1] = sealed ? BLE_COC_F_SEALED : 0;
+    sdu[2] = (uint8_t)n;
+    sdu[3] = (uint8_t)(n >> 8);
+    os_mbuf_adj(om, -(int)(s_sdu_len - pos));
+    if (last_seq) *last_seq = seq;
+
+    int rc = tx_send(om);
+    if (rc == 0) return n;
+    return (rc == BLE_HS_EBUSY || rc == BLE_HS_ENOMEM) ? -2 : -1;
+}
+
+static void rx_sdu(const uint8_t *p, uint16_t len)
+{
+    s_stats.sdu_rx++;
+    s_stats.bytes_rx += len;
+    if (len < 1) {
+        s_stats.bad_sdu++;
+        return;
+    }
+
+    switch (p[0]) {
+    case BLE_COC_OP_BACKLOG_REQ:
+        if (len != 6 || p[1] > BACKLOG_MODE_SYNC) break;
+        ESP_LOGI(TAG, "Backlog requested: mode=%u start_seq=%" PRIu32, p[1], u32_le(&p[2]));
+        ble_backlog_submit(BACKLOG_CMD_START, (backlog_mode_t)p[1], u32_le(&p[2]), BACKLOG_VIA_COC);
+        return;
+    case BLE_COC_OP_BACKLOG_ABORT:
+        if (len != 1) break;
+        ble_backlog_submit(BACKLOG_CMD_ABORT, BACKLOG_MODE_FULL, 0, BACKLOG_VIA_COC);
+        return;
+    case BLE_COC_OP_ACK:
+        if (len != 5) break;
+        ble_sync_ack(u32_le(&p[1]));
+        return;
+    case BLE_COC_OP_OTA_CTRL:
+        ble_ota_coc_control(p + 1, len - 1u);
+        return;
+    case BLE_COC_OP_OTA_DATA:
+        ble_link_note_rx(len - 1u);
+        ble_ota_coc_data(p + 1, len - 1u);
+        return;
+    default:
+        break;
+    }
+    s_stats.bad_sdu++;
+    ESP_LOGW(TAG, "Bad SDU op=0x%02X len=%u", p[0], (unsigned)len);
+}
+
+// A fresh receive buffer for the host; without one the peer gets no
+// credits for the next SDU.
+static int rx_arm(struct ble_l2cap_chan *chan)
+{
+    struct os_mbuf *om = sdu_get();
+    if (!om) return BLE_HS_ENOMEM;
+    int rc = ble_l2cap_recv_ready(chan, om);
+    if (rc != 0) os_mbuf_free_chain(om);
+    return rc;
+}
+
+static void chan_closed(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_chan = NULL;
+    s_tx_busy = false;          // the host frees SDUs still queued on the channel
+    s_status_queued = false;
+    portEXIT_CRITICAL(&s_lock);
+    s_stats.open = false;
+}
+
+static int coc_event_cb(struct ble_l2cap_event *event, void *arg)
+{
+    (void)arg;
+
+    switch (event->type) {
+    case BLE_L2CAP_EVENT_COC_ACCEPT:
+        if (s_chan) {
+            return BLE_HS_EBUSY;    // one bulk channel
+        }
+        if (event->accept.peer_sdu_size < COC_PEER_MTU_MIN) {
+            s_stats.small_mtu++;
+            ESP_LOGW(TAG, "Channel refused: peer_mtu=%u < %u", (unsigned)event->accept.peer_sdu_size,
+                     (unsigned)COC_PEER_MTU_MIN);
+            return BLE_HS_ENOMEM;
+        }
+        return rx_arm(event->accept.chan);
+
+    case BLE_L2CAP_EVENT_COC_CONNECTED: {
+        if (event->connect.status != 0) {
+            ESP_LOGW(TAG, "Channel connect failed status=%d", event->connect.status);
+            return 0;
+        }
+        struct ble_l2cap_chan_info info;
+        uint16_t peer_mtu = BLE_COC_SDU_MAX;
+        if (ble_l2cap_get_chan_info(event->connect.chan, &info) == 0) {
+            peer_mtu = info.peer_coc_mtu;
+        }
+        if (peer_mtu < COC_PEER_MTU_MIN) {
+            s_stats.small_mtu++;
+            ESP_LOGW(TAG, "Channel closed: peer_mtu=%u < %u", (unsigned)peer_mtu,
+                     (unsigned)COC_PEER_MTU_MIN);
+            ble_l2cap_disconnect(event->connect.chan);
+            return 0;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_chan = event->connect.chan;
+        s_sdu_len = peer_mtu < BLE_COC_SDU_MAX ? peer_mtu : BLE_COC_SDU_MAX;
+        s_tx_busy = false;
+        portEXIT_CRITICAL(&s_lock);
+        s_stats.opens++;
+        s_stats.open = true;
+        s_stats.peer_mtu = peer_mtu;
+        ESP_LOGI(TAG, "Channel open: conn=%u peer_mtu=%u sdu=%u", event->connect.conn_handle,
+                 (unsigned)peer_mtu, (unsigned)s_sdu_len);
+        return 0;
+    }
+
+    case BLE_L2CAP_EVENT_COC_DISCONNECTED:
+        ESP_LOGI(TAG, "Channel closed");
+        chan_closed();
+        return 0;
+
+    case BLE_L2CAP_EVENT_COC_DATA_RECEIVED: {
+        struct os_mbuf *om = event->receive.sdu_rx;
+        if (!om) return 0;
+        uint16_t len = OS_MBUF_PKTLEN(om);
+        if (om->om_len == len) {
+            rx_sdu(om->om_data, len);
+        } else {
+            s_stats.bad_sdu++;      // cannot happen with one-block buffers
+        }
+        os_mbuf_free_chain(om);
+        rx_arm(event->receive.chan);
+        return 0;
+    }
+
+    case BLE_L2CAP_EVENT_COC_TX_UNSTALLED:
+        tx_release();
+        flush_status();
+        ble_backlog_kick();         // the sender got -2 while this SDU was out
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+bool ble_coc_available(void)
+{
+    return s_listening;
+}
+
+bool ble_coc_is_open(void)
+{
+    return s_chan != NULL;
+}
+
+void ble_coc_on_disconnect(void)
+{
+    chan_closed();
+}
+
+void ble_coc_get_stats(ble_coc_stats_t *out)
+{
+    if (!out) return;
+    *out = s_stats;
+}
+
+static int coc_stats_section(char *buf, size_t len)
+{
+    return snprintf(buf, len,
+                    "open=%u,peer_mtu=%u,opens=%" PRIu32 ",sdu_tx=%" PRIu32 ",sdu_rx=%" PRIu32
+                    ",kb_tx=%" PRIu32 ",kb_rx=%" PRIu32 ",stalls=%" PRIu32 ",no_buf=%" PRIu32
+                    ",bad=%" PRIu32 ",small_mtu=%" PRIu32,
+                    (unsigned)s_stats.open, (unsigned)s_stats.peer_mtu, s_stats.opens,
+                    s_stats.sdu_tx, s_stats.sdu_rx, s_stats.bytes_tx / 1024, s_stats.bytes_rx / 1024,
+                    s_stats.stalls, s_stats.no_buf, s_stats.bad_sdu, s_stats.small_mtu);
+}
+
+int ble_coc_init(void)
+{
+    if (!BLE_COC_ENABLE || s_ready) return 0;
+
+    int rc = os_mempool_init(&s_mempool, COC_POOL_BLOCKS, COC_BLOCK_SIZE, s_pool_mem, "coc_pool");
+    if (rc == 0) {
+        rc = os_mbuf_pool_init(&s_pool, &s_mempool, COC_BLOCK_SIZE, COC_POOL_BLOCKS);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "SDU pool init failed rc=%d", rc);
+        return rc;
+    }
+    s_ready = true;
+
+    rc = ble_l2cap_create_server(BLE_COC_PSM, BLE_COC_SDU_MAX, coc_event_cb, NULL);
+    if (rc != 0) {
+        // CONFIG_BT_NIMBLE_L2CAP_COC_MAX_NUM = 0: GATT only.
+        ESP_LOGE(TAG, "ble_l2cap_create_server rc=%d", rc);
+        return rc;
+    }
+    s_listening = true;
+    ble_stats_register_section("coc", coc_stats_section);
+    ESP_LOGI(TAG, "Bulk channel on PSM 0x%04X, SDU %u", BLE_COC_PSM, (unsigned)BLE_COC_SDU_MAX);
+    return 0;
+}
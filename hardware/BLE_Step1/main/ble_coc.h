@@ -0,0 +1,95 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * L2CAP connection-oriented channel for bulk transfers.
+ *
+ * A client that can open an LE credit-based channel to BLE_COC_PSM gets
+ * the backlog and OTA image transfer over it: one SDU carries a whole
+ * flash page (4 KB of records, or of image), segmented by the host into
+ * K-frames under the peer's credits, instead of one ATT PDU and one host
+ * callback per 56-244 bytes. Clients that cannot (or that never open the
+ * channel) keep using the battery and OTA characteristics unchanged.
+ *
+ * Every SDU starts with a one-byte opcode; multi-byte fields are LE.
+ *
+ *   client -> device
+ *     01 <u8 mode> <u32 start_seq>   backlog: 0 all, 1 from start_seq,
+ *                                     2 after this client's watermark
+ *     03                              backlog abort
+ *     04 <u32 seq>                    ACK, as CMD 0x04
+ *     10 <OTA control payload>        as the OTA control characteristic
+ *     11 <image bytes>                OTA data, up to BLE_COC_PAGE per SDU
+ *   device -> client
+ *     81 <u8 flags> <u16 count> ...   backlog records: `count` records, or
+ *                                     with BLE_COC_F_SEALED the frame_crypt
+ *                                     frames holding them, back to back
+ *     90 <ascii>                      OTA status, as the status characteristic
+ *
+ * One SDU is in flight at a time; the backlog sender is woken when it
+ * completes. See docs/BULK_CHANNEL.md.
+ */
+#ifndef BLE_COC_ENABLE
+#define BLE_COC_ENABLE 1
+#endif
+
+#define BLE_COC_PSM         0x0080      // first LE dynamic PSM
+#define BLE_COC_PAGE        4096        // flash sector: SDU payload
+#define BLE_COC_HDR_LEN     4           // backlog SDU header, the largest
+#define BLE_COC_SDU_MAX     (BLE_COC_HDR_LEN + BLE_COC_PAGE)
+
+#define BLE_COC_OP_BACKLOG_REQ    0x01
+#define BLE_COC_OP_BACKLOG_ABORT  0x03
+#define BLE_COC_OP_ACK            0x04
+#define BLE_COC_OP_OTA_CTRL       0x10
+#define BLE_COC_OP_OTA_DATA       0x11
+#define BLE_COC_OP_BACKLOG_DATA   0x81
+#define BLE_COC_OP_OTA_STATUS     0x90
+
+#define BLE_COC_F_SEALED          0x01
+
+typedef struct {
+    uint32_t opens;
+    uint32_t sdu_tx;
+    uint32_t sdu_rx;
+    uint32_t bytes_tx;          // SDU payload
+    uint32_t bytes_rx;
+    uint32_t stalls;            // SDUs that waited for credits
+    uint32_t no_buf;            // SDU buffer not free (retried)
+    uint32_t bad_sdu;           // unknown opcode / bad length
+    uint32_t small_mtu;         // channels refused: peer MTU below one record
+    uint16_t peer_mtu;          // of the open channel
+    bool     open;
+} ble_coc_stats_t;
+
+/** Register the channel server and its SDU buffers (host task not yet running). */
+int ble_coc_init(void);
+
+/** The server is registered: clients may open the channel. */
+bool ble_coc_available(void);
+
+/** A client has the channel open. */
+bool ble_coc_is_open(void);
+
+/** GAP disconnect; the channel is gone with the link. */
+void ble_coc_on_disconnect(void);
+
+/**
+ * @brief Read log records from `index` into one SDU and send it, like
+ *        ble_batt_mock_notify_backlog_at() for the channel: as many whole
+ *        records as a page holds, up to `max_n`.
+ * @return records sent (>= 1), -1 channel not open or sealing failed, -2
+ *         previous SDU still in flight (retry when woken), -4 log read
+ *         failed at `index`, -5 not one record fits the peer's SDU
+ */
+int ble_coc_send_backlog_at(int index, int max_n, uint32_t *last_seq);
+
+/**
+ * OTA status string on the channel (ble_ota.c). Sent when the channel is
+ * free; a newer status replaces one still waiting. -1 if no channel is open.
+ */
+int ble_coc_send_status(const char *msg);
+
+void ble_coc_get_stats(ble_coc_stats_t *out);
@@ -0,0 +1,396 @@
+#include "ble_link.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "host/ble_hs.h"
+#include "host/ble_gap.h"
+
+#include "ble_stats.h"
+
+static const char *TAG = "BLE_LINK";
+
+// Connection intervals are in 1.25 ms units, supervision timeout in 10 ms.
+// Both sets satisfy the iOS accessory rules (min + 15 ms <= max,
+// max * (latency + 1) <= 2 s, timeout > 3 * max * (latency + 1)).
+#define BULK_ITVL_MIN      12     // 15 ms
+#define BULK_ITVL_MAX      24     // 30 ms
+#define BULK_LATENCY       0
+#define BULK_SUPERVISION   400    // 4 s
+
+#define IDLE_ITVL_MIN      320    // 400 ms
+#define IDLE_ITVL_MAX      400    // 500 ms
+#define IDLE_LATENCY       2
+#define IDLE_SUPERVISION   600    // 6 s
+
+// A refused or failed parameter request is retried this much later, a few
+// times, while the profile is still the one wanted.
+#ifndef LINK_RETRY_MS
+#define LINK_RETRY_MS      5000
+#endif
+#define LINK_RETRY_MAX     5
+
+#define DLE_TX_OCTETS      251
+#define DLE_TX_TIME_US     2120   // (251 + 14) * 8 us on 1M PHY
+
+typedef struct {
+    uint16_t conn;
+    uint32_t bulk_users;              // ble_link_user_t mask
+    bool live_active;
+    ble_link_profile_t requested;     // asked for, or in effect
+    ble_link_profile_t applied;       // last one the central accepted
+    uint8_t retries;                  // for the profile being retried
+
+    // last achieved values reported by the controller
+    uint16_t itvl;                    // 1.25 ms units
+    uint16_t latency;
+    uint16_t supervision;             // 10 ms units
+    uint8_t tx_phy;
+    uint8_t rx_phy;
+    uint16_t dle_tx_octets;
+    uint16_t dle_rx_octets;
+
+    uint32_t updates_ok;
+    uint32_t updates_failed;
+
+    // throughput accounting
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    int64_t  bulk_start_us;
+    uint64_t bulk_start_bytes;
+    uint32_t last_bulk_bps;           // payload bytes/s of the last bulk session
+    uint32_t last_bulk_ms;
+} link_state_t;
+
+static link_state_t s_link = {
+    .conn = BLE_HS_CONN_HANDLE_NONE,
+    .requested = BLE_LINK_PROFILE_NONE,
+};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_retry_timer;
+
+static const char *profile_name(ble_link_profile_t p)
+{
+    switch (p) {
+        case BLE_LINK_PROFILE_IDLE: return "IDLE";
+        case BLE_LINK_PROFILE_BULK: return "BULK";
+        default:                    return "NONE";
+    }
+}
+
+// GAP callbacks write s_link under s_lock, as everything else does, so
+// link_stats_section() never copies a half-updated struct. NimBLE calls
+// stay outside the critical section.
+static void refresh_conn_desc(void)
+{
+    struct ble_gap_conn_desc desc;
+    portENTER_CRITICAL(&s_lock);
+    uint16_t conn = s_link.conn;
+    portEXIT_CRITICAL(&s_lock);
+    if (conn == BLE_HS_CONN_HANDLE_NONE) return;
+    if (ble_gap_conn_find(conn, &desc) != 0) return;
+
+    portENTER_CRITICAL(&s_lock);
+    s_link.itvl = desc.conn_itvl;
+    s_link.latency = desc.conn_latency;
+    s_link.supervision = desc.supervision_timeout;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void request_phy(uint16_t conn, bool want_2m)
+{
+#if defined(CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT)
+    uint8_t mask = want_2m ? (BLE_GAP_LE_PHY_2M_MASK | BLE_GAP_LE_PHY_1M_MASK)
+                           : BLE_GAP_LE_PHY_1M_MASK;
+    int rc = ble_gap_set_prefered_le_phy(conn, mask, mask, BLE_GAP_LE_PHY_CODED_ANY);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "set_prefered_le_phy rc=%d", rc);
+    }
+#else
+    // ESP32 (BLE 4.2 controller) has no 2M PHY; stay on 1M.
+    (void)conn;
+    (void)want_2m;
+#endif
+}
+
+// Caller holds s_lock. The request goes back to what the central last
+// accepted, so a later apply_profile() of the same profile is not a no-op.
+// True if another attempt is due.
+static bool request_failed(void)
+{
+    s_link.updates_failed++;
+    s_link.requested = s_link.applied;
+    if (s_link.retries >= LINK_RETRY_MAX) return false;
+    s_link.retries++;
+    return true;
+}
+
+static void schedule_retry(void)
+{
+    if (!s_retry_timer) return;
+    esp_timer_stop(s_retry_timer);      // ESP_ERR_INVALID_STATE if not running
+    esp_timer_start_once(s_retry_timer, (uint64_t)LINK_RETRY_MS * 1000u);
+}
+
+static void apply_profile(ble_link_profile_t p)
+{
+    uint16_t conn;
+
+    portENTER_CRITICAL(&s_lock);
+    conn = s_link.conn;
+    if (conn == BLE_HS_CONN_HANDLE_NONE || p == s_link.requested || p == BLE_LINK_PROFILE_NONE) {
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    s_link.requested = p;
+    portEXIT_CRITICAL(&s_lock);
+
+    struct ble_gap_upd_params params = {0};
+    if (p == BLE_LINK_PROFILE_BULK) {
+        params.itvl_min = BULK_ITVL_MIN;
+        params.itvl_max = BULK_ITVL_MAX;
+        params.latency = BULK_LATENCY;
+        params.supervision_timeout = BULK_SUPERVISION;
+    } else {
+        params.itvl_min = IDLE_ITVL_MIN;
+        params.itvl_max = IDLE_ITVL_MAX;
+        params.latency = IDLE_LATENCY;
+        params.supervision_timeout = IDLE_SUPERVISION;
+    }
+
+    ESP_LOGI(TAG, "Requesting %s profile itvl=%u-%u lat=%u to=%u",
+             profile_name(p), params.itvl_min, params.itvl_max,
+             params.latency, params.supervision_timeout);
+
+    int rc = ble_gap_update_params(conn, &params);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "ble_gap_update_params rc=%d", rc);
+        portENTER_CRITICAL(&s_lock);
+        bool retry = request_failed();
+        portEXIT_CRITICAL(&s_lock);
+        if (retry) schedule_retry();
+    }
+
+    request_phy(conn, p == BLE_LINK_PROFILE_BULK);
+}
+
+// Caller holds s_lock. Once connected the link is never left on whatever a
+// bulk session set: without one it goes back to IDLE, live subscriber or not.
+static ble_link_profile_t desired_profile(void)
+{
+    if (s_link.conn == BLE_HS_CONN_HANDLE_NONE) return BLE_LINK_PROFILE_NONE;
+    if (s_link.bulk_users != 0) return BLE_LINK_PROFILE_BULK;
+    return BLE_LINK_PROFILE_IDLE;
+}
+
+static void retry_cb(void *arg)
+{
+    (void)arg;
+    portENTER_CRITICAL(&s_lock);
+    ble_link_profile_t want = desired_profile();
+    portEXIT_CRITICAL(&s_lock);
+
+    apply_profile(want);
+}
+
+static int link_stats_section(char *buf, size_t len)
+{
+    uint32_t cur_bps = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    link_state_t st = s_link;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (st.bulk_users != 0) {
+        int64_t dt_ms = (esp_timer_get_time() - st.bulk_start_us) / 1000;
+        if (dt_ms > 0) {
+            cur_bps = (uint32_t)((st.tx_bytes + st.rx_bytes - st.bulk_start_bytes) * 1000ULL / (uint64_t)dt_ms);
+        }
+    }
+
+    return snprintf(buf, len,
+                    "prof=%s,users=0x%02" PRIx32 ",itvl_us=%u,lat=%u,to_ms=%u,"
+                    "phy=%u/%u,dle=%u/%u,upd_ok=%" PRIu32 ",upd_fail=%" PRIu32 ","
+                    "tx=%" PRIu64 ",rx=%" PRIu64 ",bulk_bps=%" PRIu32 ","
+                    "last_bps=%" PRIu32 ",last_ms=%" PRIu32,
+                    profile_name(st.requested), st.bulk_users,
+                    (unsigned)st.itvl * 1250u, (unsigned)st.latency,
+                    (unsigned)st.supervision * 10u,
+                    (unsigned)st.tx_phy, (unsigned)st.rx_phy,
+                    (unsigned)st.dle_tx_octets, (unsigned)st.dle_rx_octets,
+                    st.updates_ok, st.updates_failed,
+                    st.tx_bytes, st.rx_bytes, cur_bps,
+                    st.last_bulk_bps, st.last_bulk_ms);
+}
+
+void ble_link_init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = retry_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "link_retry",
+    };
+    if (esp_timer_create(&args, &s_retry_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "retry timer create failed");
+        s_retry_timer = NULL;
+    }
+    ble_stats_register_section("link", link_stats_section);
+}
+
+void ble_link_on_connect(uint16_t conn_handle)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_link.conn = conn_handle;
+    s_link.requested = BLE_LINK_PROFILE_NONE;
+    s_link.applied = BLE_LINK_PROFILE_NONE;
+    s_link.retries = 0;
+    s_link.bulk_users = 0;
+    s_link.live_active = false;
+    s_link.tx_phy = 1;
+    s_link.rx_phy = 1;
+    s_link.dle_tx_octets = 27;
+    s_link.dle_rx_octets = 27;
+    portEXIT_CRITICAL(&s_lock);
+
+    refresh_conn_desc();
+
+    // DLE helps every traffic pattern and costs nothing at long intervals,
+    // so it is requested once per connection rather than per profile.
+    int rc = ble_gap_set_data_len(conn_handle, DLE_TX_OCTETS, DLE_TX_TIME_US);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "ble_gap_set_data_len rc=%d", rc);
+    }
+}
+
+void ble_link_on_disconnect(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_link.conn = BLE_HS_CONN_HANDLE_NONE;
+    s_link.requested = BLE_LINK_PROFILE_NONE;
+    s_link.applied = BLE_LINK_PROFILE_NONE;
+    s_link.bulk_users = 0;
+    s_link.live_active = false;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_retry_timer) esp_timer_stop(s_retry_timer);
+}
+
+void ble_link_on_conn_update(int status)
+{
+    if (status != 0) {
+        ESP_LOGW(TAG, "Connection update failed status=%d", status);
+        portENTER_CRITICAL(&s_lock);
+        bool retry = request_failed();      // keeps the old profile
+        portEXIT_CRITICAL(&s_lock);
+        if (retry) schedule_retry();
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_link.updates_ok++;
+    s_link.applied = s_link.requested;
+    s_link.retries = 0;
+    portEXIT_CRITICAL(&s_lock);
+    refresh_conn_desc();
+
+    portENTER_CRITICAL(&s_lock);
+    uint16_t itvl = s_link.itvl, latency = s_link.latency, supervision = s_link.supervision;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "Conn params: itvl=%u (x1.25ms) lat=%u to=%u (x10ms)",
+             itvl, latency, supervision);
+}
+
+void ble_link_on_phy_update(int status, uint8_t tx_phy, uint8_t rx_phy)
+{
+    if (status != 0) {
+        ESP_LOGW(TAG, "PHY update failed status=%d", status);
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_link.tx_phy = tx_phy;
+    s_link.rx_phy = rx_phy;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "PHY: tx=%u rx=%u", tx_phy, rx_phy);
+}
+
+void ble_link_on_data_len(uint16_t tx_octets, uint16_t rx_octets)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_link.dle_tx_octets = tx_octets;
+    s_link.dle_rx_octets = rx_octets;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "Data length: tx=%u rx=%u", tx_octets, rx_octets);
+}
+
+void ble_link_bulk_begin(ble_link_user_t user)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_link.bulk_users == 0) {
+        s_link.bulk_start_us = esp_timer_get_time();
+        s_link.bulk_start_bytes = s_link.tx_bytes + s_link.rx_bytes;
+    }
+    s_link.bulk_users |= (uint32_t)user;
+    s_link.retries = 0;
+    ble_link_profile_t want = desired_profile();
+    portEXIT_CRITICAL(&s_lock);
+
+    apply_profile(want);
+}
+
+void ble_link_bulk_end(ble_link_user_t user)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool was_bulk = (s_link.bulk_users != 0);
+    s_link.bulk_users &= ~(uint32_t)user;
+    s_link.retries = 0;
+
+    if (was_bulk && s_link.bulk_users == 0) {
+        int64_t dt_ms = (esp_timer_get_time() - s_link.bulk_start_us) / 1000;
+        uint64_t bytes = s_link.tx_bytes + s_link.rx_bytes - s_link.bulk_start_bytes;
+        s_link.last_bulk_ms = (uint32_t)dt_ms;
+        s_link.last_bulk_bps = (dt_ms > 0) ? (uint32_t)(bytes * 1000ULL / (uint64_t)dt_ms) : 0;
+    }
+    ble_link_profile_t want = desired_profile();
+    portEXIT_CRITICAL(&s_lock);
+
+    if (was_bulk && want != BLE_LINK_PROFILE_BULK) {
+        ESP_LOGI(TAG, "Bulk session done: %" PRIu32 " B/s over %" PRIu32 " ms",
+                 s_link.last_bulk_bps, s_link.last_bulk_ms);
+    }
+    apply_profile(want);
+}
+
+void ble_link_set_live_active(bool active)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_link.live_active = active;
+    s_link.retries = 0;
+    ble_link_profile_t want = desired_profile();
+    portEXIT_CRITICAL(&s_lock);
+
+    apply_profile(want);
+}
+
+void ble_link_note_tx(size_t bytes)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_link.tx_bytes += bytes;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ble_link_note_rx(size_t bytes)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_link.rx_bytes += bytes;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+ble_link_profile_t ble_link_current_profile(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    ble_link_profile_t p = s_link.requested;
+    portEXIT_CRITICAL(&s_lock);
+    return p;
+}
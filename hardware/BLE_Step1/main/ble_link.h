@@ -0,0 +1,51 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Link-profile manager.
+ *
+ * Bulk transfers (backlog, OTA) want a short connection interval, 251-byte
+ * LL PDUs and 2M PHY; a link that only carries the 5 s live notification
+ * should sit on a long, low-power interval. Session owners call
+ * ble_link_bulk_begin()/ble_link_bulk_end() and the manager requests the
+ * matching parameters from the central. Once anything has asked, the link
+ * is BULK while a session runs and IDLE otherwise; a refused request keeps
+ * the previous profile and is retried a few times, LINK_RETRY_MS apart.
+ */
+typedef enum {
+    BLE_LINK_PROFILE_NONE = 0,   // nothing requested yet, central's choice
+    BLE_LINK_PROFILE_IDLE,       // long interval + slave latency
+    BLE_LINK_PROFILE_BULK,       // short interval, DLE, 2M PHY
+} ble_link_profile_t;
+
+typedef enum {
+    BLE_LINK_USER_BACKLOG = 1u << 0,
+    BLE_LINK_USER_OTA     = 1u << 1,
+} ble_link_user_t;
+
+void ble_link_init(void);
+
+void ble_link_on_connect(uint16_t conn_handle);
+void ble_link_on_disconnect(void);
+
+/** GAP event hooks (called from the host task). */
+void ble_link_on_conn_update(int status);
+void ble_link_on_phy_update(int status, uint8_t tx_phy, uint8_t rx_phy);
+void ble_link_on_data_len(uint16_t tx_octets, uint16_t rx_octets);
+
+void ble_link_bulk_begin(ble_link_user_t user);
+void ble_link_bulk_end(ble_link_user_t user);
+
+/**
+ * @brief Live notifications enabled/disabled by the client. With no bulk
+ *        session running the link drops to the IDLE profile.
+ */
+void ble_link_set_live_active(bool active);
+
+/** Payload byte accounting for effective-throughput reporting. */
+void ble_link_note_tx(size_t bytes);
+void ble_link_note_rx(size_t bytes);
+
+ble_link_profile_t ble_link_current_profile(void);
@@ -1,4 +1,10 @@
 #include "ble_ota.h"
+#include "ble_coc.h"
+#include "ble_link.h"
+#include "battery_log.h"
+#include "notify_sched.h"
+#include "notify_pool.h"
+#include "trace_rec.h"
 #include <stdbool.h>
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
@@ -18,7 +24,7 @@ static const char *TAG = "BLE_OTA";
 #define OTA_CMD_FINISH  0x02
 #define OTA_CMD_ABORT   0x03
 
-#define OTA_DATA_MAX_CHUNK 244
+#define OTA_DATA_MAX_CHUNK 244                 // GATT write; the bulk channel takes BLE_COC_PAGE
 #define OTA_STATUS_MAX_LEN 64
 #define OTA_SIZE_UNKNOWN ((size_t)0)
 
@@ -78,6 +84,7 @@ static const ble_uuid128_t ota_status_uuid =
 static uint16_t ota_status_val_handle;
 static uint16_t s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
 static bool s_status_notify_enabled = false;
+static bool s_via_coc = false;          // session driven over the bulk channel (ble_coc.h)
 static char s_last_status[OTA_STATUS_MAX_LEN] = "IDLE";
 
 static uint16_t ota_control_val_handle;
@@ -142,6 +149,12 @@ static void ble_ota_send_status(const char *msg)
     ble_ota_update_last_status(msg);
     ESP_LOGI(TAG, "OTA status -> %s", s_last_status);
 
+    // On the channel the session is driven over; a closed channel falls
+    // back to the status characteristic.
+    if (s_via_coc && ble_coc_send_status(s_last_status) == 0) {
+        return;
+    }
+
     if (s_conn_handle == BLE_HS_CONN_HANDLE_NONE) {
         ESP_LOGW(TAG, "Cannot notify OTA status: no connection");
         return;
@@ -152,18 +165,20 @@ static void ble_ota_send_status(const char *msg)
         return;
     }
 
-    struct os_mbuf *om = ble_hs_mbuf_from_flat(
-        s_last_status,
-        (uint16_t)strlen(s_last_status)
-    );
-    if (om == NULL) {
+    // From the notify pool like every other notification; msys stays for RX.
+    struct os_mbuf *om = notify_pool_get();
+    if (om == NULL || os_mbuf_append(om, s_last_status, (uint16_t)strlen(s_last_status)) != 0) {
+        if (om) os_mbuf_free_chain(om);
         ESP_LOGW(TAG, "Failed to allocate mbuf for OTA status notify");
         return;
     }
 
-    int rc = ble_gatts_notify_custom(s_conn_handle, ota_status_val_handle, om);
+    // Lowest class: status frames wait behind alerts, live and backlog
+    // traffic, but are small enough to go within one budget refill.
+    int rc = notify_sched_submit(NS_CLASS_OTA, s_conn_handle, ota_status_val_handle,
+                                 om, (uint16_t)OS_MBUF_PKTLEN(om));
     if (rc != 0) {
-        ESP_LOGW(TAG, "ble_gatts_notify_custom failed rc=%d", rc);
+        ESP_LOGW(TAG, "OTA status not queued rc=%d", rc);
     }
 }
 
@@ -250,6 +265,13 @@ static void ble_ota_set_state(ble_ota_state_t new_state)
                  ble_ota_state_to_string(new_state));
         s_ota.state = new_state;
     }
+
+    // READY/RECEIVING are the only states where image data flows.
+    if (new_state == BLE_OTA_STATE_READY || new_state == BLE_OTA_STATE_RECEIVING) {
+        ble_link_bulk_begin(BLE_LINK_USER_OTA);
+    } else {
+        ble_link_bulk_end(BLE_LINK_USER_OTA);
+    }
 }
 static uint32_t ble_ota_read_u32_le(const uint8_t *buf)
 {
@@ -281,7 +303,7 @@ static const char *ble_ota_state_to_string(ble_ota_state_t state)
     }
 }
 
-static int ble_ota_handle_start(const uint8_t *data, uint16_t len)
+static int ble_ota_handle_start(const uint8_t *data, uint16_t len, bool coc)
 {
     esp_err_t err;
 
@@ -291,7 +313,7 @@ static int ble_ota_handle_start(const uint8_t *data, uint16_t len)
         return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
     }
 
-    if (!s_status_notify_enabled) {
+    if (!coc && !s_status_notify_enabled) {
         ESP_LOGW(TAG, "START rejected: phone did not enable OTA status notifications");
         ble_ota_update_last_status("ERROR:NO_NOTIFY");
         return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
@@ -299,6 +321,7 @@ static int ble_ota_handle_start(const uint8_t *data, uint16_t len)
 
     // Fresh session init
     ble_ota_reset_session();
+    s_via_coc = coc;
 
     s_ota.expected_size = OTA_SIZE_UNKNOWN;
 
@@ -326,9 +349,11 @@ static int ble_ota_handle_start(const uint8_t *data, uint16_t len)
              (unsigned long)s_ota.update_partition->size,
              (unsigned int)s_ota.expected_size);
 
+    TRACE_BEGIN(TRACE_SPAN_OTA_BEGIN);
     err = esp_ota_begin(s_ota.update_partition,
                         s_ota.expected_size,
                         &s_ota.ota_handle);
+    TRACE_END(TRACE_SPAN_OTA_BEGIN);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
         ble_ota_set_state(BLE_OTA_STATE_ERROR);
@@ -348,24 +373,17 @@ static int ble_ota_handle_start(const uint8_t *data, uint16_t len)
     ESP_LOGI(TAG, "OTA START accepted, session ready");
     return 0;
 }
-static int ble_ota_data_chr_write(uint16_t conn_handle,
-                                  uint16_t attr_handle,
-                                  struct ble_gatt_access_ctxt *ctxt,
-                                  void *arg)
+// One image chunk, from a GATT write (up to OTA_DATA_MAX_CHUNK) or a bulk
+// channel SDU (up to BLE_COC_PAGE); statuses go back the same way.
+static int ble_ota_write_chunk(const uint8_t *buf, uint16_t len, uint16_t max_len, bool coc)
 {
-    (void)conn_handle;
-    (void)attr_handle;
-    (void)arg;
-
-    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
-        return BLE_ATT_ERR_UNLIKELY;
-    }
     if (s_ota.state == BLE_OTA_STATE_PAUSED) {
         ESP_LOGI(TAG, "Resuming OTA from byte offset %u",
                 (unsigned)s_ota.bytes_received);
         s_ota.paused_by_disconnect = false;
         ble_ota_set_state(BLE_OTA_STATE_RECEIVING);
     }
+    s_via_coc = coc;
 
     if (!s_ota.in_progress || !s_ota.start_received) {
         ESP_LOGW(TAG, "OTA data rejected: START not received");
@@ -392,33 +410,25 @@ static int ble_ota_data_chr_write(uint16_t conn_handle,
         return BLE_ATT_ERR_UNLIKELY;
     }
 
-    uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
     if (len == 0) {
         ESP_LOGW(TAG, "OTA data write empty");
         ble_ota_send_status("ERROR:EMPTY");
         return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
 
-    if (len > OTA_DATA_MAX_CHUNK) {
+    if (len > max_len) {
         ESP_LOGW(TAG, "OTA data chunk too large: %u", len);
         ble_ota_send_status("ERROR:CHUNK_TOO_LARGE");
         return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
 
-    uint8_t buf[OTA_DATA_MAX_CHUNK];
-    int rc = os_mbuf_copydata(ctxt->om, 0, len, buf);
-    if (rc != 0) {
-        ESP_LOGE(TAG, "Failed reading OTA data chunk from mbuf");
-        ble_ota_set_state(BLE_OTA_STATE_ERROR);
-        ble_ota_send_status("ERROR:READ_FAIL");
-        return BLE_ATT_ERR_UNLIKELY;
-    }
-
     if (s_ota.state == BLE_OTA_STATE_READY) {
         ble_ota_set_state(BLE_OTA_STATE_RECEIVING);
     }
 
+    TRACE_BEGIN_ARG(TRACE_SPAN_OTA_WRITE, len);
     esp_err_t err = esp_ota_write(s_ota.ota_handle, buf, len);
+    TRACE_END(TRACE_SPAN_OTA_WRITE);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_ota_write failed at chunk=%u bytes=%u err=%s",
                  (unsigned)(s_ota.chunk_count + 1),
@@ -442,10 +452,11 @@ static int ble_ota_data_chr_write(uint16_t conn_handle,
 
     return 0;
 }
-static int ota_control_access_cb(uint16_t conn_handle,
-                                 uint16_t attr_handle,
-                                 struct ble_gatt_access_ctxt *ctxt,
-                                 void *arg)
+
+static int ble_ota_data_chr_write(uint16_t conn_handle,
+                                  uint16_t attr_handle,
+                                  struct ble_gatt_access_ctxt *ctxt,
+                                  void *arg)
 {
     (void)conn_handle;
     (void)attr_handle;
@@ -455,29 +466,52 @@ static int ota_control_access_cb(uint16_t conn_handle,
         return BLE_ATT_ERR_UNLIKELY;
     }
 
+    // A single-buffer write (the usual case) goes to flash straight from the
+    // mbuf; a chained one is gathered into a static buffer, not the stack.
+    // Access callbacks all run on the NimBLE host task.
+    static uint8_t s_chunk[OTA_DATA_MAX_CHUNK];
     uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+    const uint8_t *buf = ctxt->om->om_data;
+    if (ctxt->om->om_len < len && len <= OTA_DATA_MAX_CHUNK) {
+        if (os_mbuf_copydata(ctxt->om, 0, len, s_chunk) != 0) {
+            ESP_LOGE(TAG, "Failed reading OTA data chunk from mbuf");
+            ble_ota_set_state(BLE_OTA_STATE_ERROR);
+            ble_ota_send_status("ERROR:READ_FAIL");
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+        buf = s_chunk;
+    }
+
+    int rc = ble_ota_write_chunk(buf, len, OTA_DATA_MAX_CHUNK, false);
+    if (rc == 0) {
+        ble_link_note_rx(len);
+    }
+    return rc;
+}
+
+int ble_ota_coc_data(const uint8_t *data, uint16_t len)
+{
+    return ble_ota_write_chunk(data, len, BLE_COC_PAGE, true);
+}
+#define OTA_CONTROL_MAX_LEN 20
+
+static int ble_ota_control(const uint8_t *buf, uint16_t len, bool coc)
+{
     if (len < 1) {
         ESP_LOGW(TAG, "OTA control write too short");
         return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
 
-    uint8_t buf[20];
-    if (len > sizeof(buf)) {
+    if (len > OTA_CONTROL_MAX_LEN) {
         ESP_LOGW(TAG, "OTA control payload too large: %u", len);
         return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
 
-    int rc = os_mbuf_copydata(ctxt->om, 0, len, buf);
-    if (rc != 0) {
-        ESP_LOGW(TAG, "Failed reading OTA control payload");
-        return BLE_ATT_ERR_UNLIKELY;
-    }
-
     uint8_t cmd = buf[0];
     switch (cmd) {        
         case OTA_CMD_START:
-            ESP_LOGI(TAG, "Received OTA START");
-            return ble_ota_handle_start(buf, len);
+            ESP_LOGI(TAG, "Received OTA START%s", coc ? " (bulk channel)" : "");
+            return ble_ota_handle_start(buf, len, coc);
             
         case OTA_CMD_FINISH:
             if (!s_ota.in_progress || !s_ota.start_received) {
@@ -519,7 +553,9 @@ static int ota_control_access_cb(uint16_t conn_handle,
             ESP_LOGI(TAG, "Finalizing OTA...");
 
         
+            TRACE_BEGIN(TRACE_SPAN_OTA_END);
             esp_err_t err = esp_ota_end(s_ota.ota_handle);
+            TRACE_END(TRACE_SPAN_OTA_END);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(err));
                 ble_ota_set_state(BLE_OTA_STATE_ERROR);
@@ -549,6 +585,11 @@ static int ota_control_access_cb(uint16_t conn_handle,
             ble_ota_send_status("SUCCESS");
 
             ESP_LOGI(TAG, "OTA SUCCESS. Rebooting...");
+            // Runs on the NimBLE host task. Keep the log locked through the
+            // restart: mock_sender blocks instead of staging records the
+            // reboot would drop, or being mid-write to the store when it hits.
+            battery_log_lock();
+            battery_log_flush();   // don't lose records staged in RAM
             vTaskDelay(pdMS_TO_TICKS(700));
             esp_restart();
 
@@ -587,6 +628,40 @@ static int ota_control_access_cb(uint16_t conn_handle,
     return 0;
 }
 
+static int ota_control_access_cb(uint16_t conn_handle,
+                                 uint16_t attr_handle,
+                                 struct ble_gatt_access_ctxt *ctxt,
+                                 void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+    uint8_t buf[OTA_CONTROL_MAX_LEN];
+    if (len > sizeof(buf)) {
+        ESP_LOGW(TAG, "OTA control payload too large: %u", len);
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    int rc = os_mbuf_copydata(ctxt->om, 0, len, buf);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "Failed reading OTA control payload");
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    return ble_ota_control(buf, len, false);
+}
+
+int ble_ota_coc_control(const uint8_t *data, uint16_t len)
+{
+    return ble_ota_control(data, len, true);
+}
+
 
 static const struct ble_gatt_svc_def ota_gatt_svcs[] = {
     {
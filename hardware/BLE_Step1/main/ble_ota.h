@@ -4,4 +4,12 @@
 void ble_ota_register_service(void);
 void ble_ota_on_connect(uint16_t conn_handle);
 void ble_ota_on_disconnect(void);
-void ble_ota_on_subscribe(uint16_t attr_handle, uint8_t cur_notify);
\ No newline at end of file
+void ble_ota_on_subscribe(uint16_t attr_handle, uint8_t cur_notify);
+
+/**
+ * OTA control payload / image bytes received on the bulk channel
+ * (ble_coc.c), handled as the control and data characteristics; status
+ * goes back on the channel. 0 or a BLE_ATT_ERR_* code.
+ */
+int ble_ota_coc_control(const uint8_t *data, uint16_t len);
+int ble_ota_coc_data(const uint8_t *data, uint16_t len);
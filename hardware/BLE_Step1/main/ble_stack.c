@@ -2,11 +2,23 @@
 
 #include <string.h>
 #include "esp_log.h"
+#include "sdkconfig.h"
 
 #include "ble_batt_mock.h"
+#include "ble_coc.h"
+#include "boot_prof.h"
+#include "ble_link.h"
 #include "ble_ota.h"
+#include "ble_stats.h"
+#include "ble_sync.h"
+#include "notify_sched.h"
+#include "power_mgmt.h"
+#include "mem_plan.h"
+#include "trace_rec.h"
 #include "nimble/nimble_port.h"
 #include "nimble/nimble_port_freertos.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "host/ble_hs.h"
 #include "host/util/util.h"
@@ -21,8 +33,16 @@ extern void ble_store_config_init(void);
 #define BLE_ENABLE_BONDING 0
 #endif
 
+// Runs above the sampler/sender (5) so a queued live frame goes out as
+// soon as it is submitted.
+#ifndef NOTIFY_DISPATCH_PRIO
+#define NOTIFY_DISPATCH_PRIO 6
+#endif
+#define NOTIFY_DISPATCH_STACK 3072
+
 static const char *TAG = "BLE";
 static uint16_t s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+static TaskHandle_t s_dispatch_task = NULL;
 
 static void start_advertising(void);
 
@@ -46,7 +66,11 @@ static int gap_event_cb(struct ble_gap_event *event, void *arg)
         if (event->connect.status == 0) {
             s_conn_handle = event->connect.conn_handle;
             ESP_LOGI(TAG, "Connected (handle=%d)", s_conn_handle);
+            TRACE_MARK(TRACE_SPAN_BLE_CONNECT, s_conn_handle);
+            power_mgmt_note_radio(PWR_RADIO_CONN);
+            ble_link_on_connect(s_conn_handle);
             ble_batt_mock_on_connect(s_conn_handle);
+            ble_sync_on_connect(s_conn_handle);
             ble_ota_on_connect(s_conn_handle);
         } else {
             ESP_LOGW(TAG, "Connect failed; status=%d", event->connect.status);
@@ -58,12 +82,34 @@ static int gap_event_cb(struct ble_gap_event *event, void *arg)
                  event->mtu.conn_handle, event->mtu.value);
         return 0;
 
+    case BLE_GAP_EVENT_CONN_UPDATE:
+        ble_link_on_conn_update(event->conn_update.status);
+        return 0;
+
+    case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE:
+        ble_link_on_phy_update(event->phy_updated.status,
+                               event->phy_updated.tx_phy,
+                               event->phy_updated.rx_phy);
+        return 0;
+
+#ifdef BLE_GAP_EVENT_DATA_LEN_CHG
+    case BLE_GAP_EVENT_DATA_LEN_CHG:
+        ble_link_on_data_len(event->data_len_chg.max_tx_octets,
+                             event->data_len_chg.max_rx_octets);
+        return 0;
+#endif
+
     case BLE_GAP_EVENT_DISCONNECT:
         ESP_LOGI(TAG, "Disconnected; reason=%d", event->disconnect.reason);
+        TRACE_MARK(TRACE_SPAN_BLE_DISCONNECT, event->disconnect.reason);
         s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
 
+        ble_link_on_disconnect();
         ble_batt_mock_on_disconnect();
+        ble_sync_on_disconnect();
+        ble_coc_on_disconnect();
         ble_ota_on_disconnect();
+        notify_sched_on_disconnect();
         start_advertising();
         return 0;
 
@@ -113,6 +159,12 @@ static void start_advertising(void)
     memset(&adv_params, 0, sizeof(adv_params));
     adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
     adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+    if (power_mgmt_low_power()) {
+        // ~1 s keeps discovery usable while cutting adv events ~25x
+        // versus the stack default.
+        adv_params.itvl_min = BLE_GAP_ADV_ITVL_MS(LP_ADV_ITVL_MIN_MS);
+        adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(LP_ADV_ITVL_MAX_MS);
+    }
 
     uint8_t addr_type;
     rc = ble_hs_id_infer_auto(0, &addr_type);
@@ -128,9 +180,34 @@ static void start_advertising(void)
         return;
     }
 
+    power_mgmt_note_radio(PWR_RADIO_ADV);
+    boot_prof_mark(BOOT_PH_FIRST_ADV);
     ESP_LOGI(TAG, "Advertising as %s", name);
 }
 
+static void notify_wake(void)
+{
+    if (s_dispatch_task) {
+        xTaskNotifyGive(s_dispatch_task);
+    }
+}
+
+// Drains the notification scheduler; sleeps until the next submit or until
+// the bulk budget allows the next queued frame.
+static void notify_dispatch_task(void *param)
+{
+    (void)param;
+    for (;;) {
+        int64_t wait_us = notify_sched_run();
+        TickType_t wait = portMAX_DELAY;
+        if (wait_us >= 0) {
+            wait = pdMS_TO_TICKS((uint32_t)((wait_us + 999) / 1000));
+            if (wait == 0) wait = 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
 static void host_task(void *param)
 {
     (void)param;
@@ -161,10 +238,21 @@ void ble_stack_start(void)
 
     ble_hs_cfg.reset_cb = on_reset;
     ble_hs_cfg.sync_cb = on_sync;
+    ble_link_init();
     ble_ota_register_service();
     ble_batt_mock_register();
+    ble_stats_register_service();
+    ble_coc_init();             // GATT only if the server can't be registered
+
+    notify_sched_init(notify_wake);
+    static StackType_t s_dispatch_stack[NOTIFY_DISPATCH_STACK];
+    static StaticTask_t s_dispatch_tcb;
+    s_dispatch_task = xTaskCreateStatic(notify_dispatch_task, "notify_tx", NOTIFY_DISPATCH_STACK,
+                                        NULL, NOTIFY_DISPATCH_PRIO, s_dispatch_stack, &s_dispatch_tcb);
+    mem_plan_watch_task(s_dispatch_task, NOTIFY_DISPATCH_STACK);
 
     nimble_port_freertos_init(host_task);
+    mem_plan_watch_task(xTaskGetHandle("nimble_host"), CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE);
 
     ESP_LOGI(TAG, "BLE stack started");
 }
\ No newline at end of file
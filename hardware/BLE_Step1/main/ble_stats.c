@@ -0,0 +1,223 @@
+#include "ble_stats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "trace_rec.h"
+
+#include "host/ble_hs.h"
+#include "host/ble_uuid.h"
+#include "os/os_mbuf.h"
+
+static const char *TAG = "BLE_STATS";
+
+#define STATS_SEL_INDEX 0xFF   // selector value that returns the section index
+
+// Trace characteristic commands (first byte of a write).
+#define TRACE_CMD_RESUME    0x00
+#define TRACE_CMD_FREEZE    0x01   // freeze and rewind the read offset
+#define TRACE_CMD_SERIAL    0x02   // print the dump on the console
+#define TRACE_CMD_SEEK      0x03   // + u32 offset
+#define TRACE_CMD_ARM       0x04   // + u8: 1 start recording, 0 stop
+#define TRACE_READ_MAX      240    // offset (4) + data, within one ATT_MTU 247 read
+
+typedef struct {
+    const char *name;
+    ble_stats_section_fn fn;
+} stats_section_t;
+
+static stats_section_t s_sections[BLE_STATS_MAX_SECTIONS];
+static int s_section_count = 0;
+static uint8_t s_selected = STATS_SEL_INDEX;
+static uint16_t s_stats_val_handle = 0;
+static uint16_t s_trace_val_handle = 0;
+static uint32_t s_trace_off = 0;
+
+void ble_stats_register_section(const char *name, ble_stats_section_fn fn)
+{
+    if (!name || !fn) return;
+
+    if (s_section_count >= BLE_STATS_MAX_SECTIONS) {
+        ESP_LOGW(TAG, "No room for stats section '%s'", name);
+        return;
+    }
+
+    s_sections[s_section_count].name = name;
+    s_sections[s_section_count].fn = fn;
+    s_section_count++;
+}
+
+static int format_index(char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "sections:n=%d", s_section_count);
+    for (int i = 0; i < s_section_count && n > 0 && (size_t)n < len; i++) {
+        n += snprintf(buf + n, len - n, ",%d=%s", i, s_sections[i].name);
+    }
+    return n;
+}
+
+static int format_section(int idx, char *buf, size_t len)
+{
+    if (idx < 0 || idx >= s_section_count) {
+        return format_index(buf, len);
+    }
+
+    int n = snprintf(buf, len, "%s:", s_sections[idx].name);
+    if (n < 0 || (size_t)n >= len) return n;
+
+    int m = s_sections[idx].fn(buf + n, len - n);
+    return (m < 0) ? n : n + m;
+}
+
+void ble_stats_log_all(void)
+{
+    char line[BLE_STATS_MAX_LEN];
+    for (int i = 0; i < s_section_count; i++) {
+        format_section(i, line, sizeof(line));
+        ESP_LOGI(TAG, "%s", line);
+    }
+}
+
+static int stats_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                           struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+
+    if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        if (OS_MBUF_PKTLEN(ctxt->om) != 1) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        uint8_t sel = STATS_SEL_INDEX;
+        if (os_mbuf_copydata(ctxt->om, 0, 1, &sel) != 0) {
+            return BLE_ATT_ERR_UNLIKELY;
+        }
+        s_selected = sel;
+        return 0;
+    }
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    char line[BLE_STATS_MAX_LEN];
+    int n = format_section(s_selected, line, sizeof(line));
+    if (n < 0) n = 0;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+
+    int rc = os_mbuf_append(ctxt->om, line, (uint16_t)n);
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static void trace_dump_task(void *arg)
+{
+    (void)arg;
+    trace_rec_dump_serial();
+    vTaskDelete(NULL);
+}
+
+// Reads return the dump in pieces: u32 offset (LE), then the bytes from
+// there; the offset advances, so the client reads until only the offset
+// comes back, and can seek back to retry a piece.
+static int trace_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                           struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    (void)attr_handle;
+    (void)arg;
+
+    if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        uint8_t cmd[5];
+        uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+        if (len < 1 || len > sizeof(cmd) || os_mbuf_copydata(ctxt->om, 0, len, cmd) != 0) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        switch (cmd[0]) {
+        case TRACE_CMD_RESUME:
+            trace_rec_freeze(false);
+            return 0;
+        case TRACE_CMD_FREEZE:
+            trace_rec_freeze(true);
+            s_trace_off = 0;
+            return 0;
+        case TRACE_CMD_SERIAL:
+            // Seconds of console output at 115200 baud: not on the host task.
+            if (xTaskCreate(trace_dump_task, "trace_dump", 3072, NULL, 1, NULL) != pdPASS) {
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+            return 0;
+        case TRACE_CMD_ARM:
+            if (len != 2) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            trace_rec_arm(cmd[1] != 0);
+            return 0;
+        case TRACE_CMD_SEEK:
+            if (len != 5) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            s_trace_off = (uint32_t)cmd[1] | (uint32_t)cmd[2] << 8 |
+                          (uint32_t)cmd[3] << 16 | (uint32_t)cmd[4] << 24;
+            return 0;
+        default:
+            return BLE_ATT_ERR_REQ_NOT_SUPPORTED;
+        }
+    }
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    uint8_t buf[TRACE_READ_MAX];
+    size_t max = ble_att_mtu(conn_handle) - 1;
+    if (max > sizeof(buf)) max = sizeof(buf);
+    if (max < 4) return BLE_ATT_ERR_UNLIKELY;
+
+    memcpy(buf, &s_trace_off, 4);
+    size_t n = trace_rec_dump_read(s_trace_off, buf + 4, max - 4);
+    s_trace_off += n;
+
+    int rc = os_mbuf_append(ctxt->om, buf, (uint16_t)(4 + n));
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+// Service UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeef0
+// STATS char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeef1  (write u8 section, read text)
+// TRACE char UUID: aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeef2  (write command, read dump pieces)
+static const struct ble_gatt_svc_def g_stats_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xf0),
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xf1),
+                .access_cb = stats_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                .val_handle = &s_stats_val_handle,
+            },
+            {
+                .uuid = BLE_UUID128_DECLARE(0xaa,0xaa,0xaa,0xaa,0xbb,0xbb,0xcc,0xcc,0xdd,0xdd,0xee,0xee,0xee,0xee,0xee,0xf2),
+                .access_cb = trace_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                .val_handle = &s_trace_val_handle,
+            },
+            { 0 }
+        }
+    },
+    { 0 }
+};
+
+void ble_stats_register_service(void)
+{
+    int rc = ble_gatts_count_cfg(g_stats_svcs);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "ble_gatts_count_cfg failed rc=%d", rc);
+        return;
+    }
+
+    rc = ble_gatts_add_svcs(g_stats_svcs);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "ble_gatts_add_svcs failed rc=%d", rc);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Stats service registered (%d sections)", s_section_count);
+}
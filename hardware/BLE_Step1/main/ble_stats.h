@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+
+/**
+ * @brief Formatter for one stats section.
+ *
+ * Writes a single ASCII line of comma separated key=value pairs into `buf`
+ * (NUL terminated) and returns the number of characters written, like snprintf.
+ */
+typedef int (*ble_stats_section_fn)(char *buf, size_t len);
+
+#define BLE_STATS_MAX_SECTIONS 24
+#define BLE_STATS_MAX_LEN      240
+
+/**
+ * @brief Register a named section on the stats characteristic.
+ *
+ * Must be called before ble_stack_start(). Sections are indexed in
+ * registration order; the client selects one by writing its index.
+ */
+void ble_stats_register_section(const char *name, ble_stats_section_fn fn);
+
+void ble_stats_register_service(void);
+
+/**
+ * @brief Print every section to the console (serial diagnostics).
+ */
+void ble_stats_log_all(void);
@@ -0,0 +1,400 @@
+#include "ble_sync.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "host/ble_hs.h"
+#include "battery_log.h"
+#include "ble_stats.h"
+
+static const char *TAG = "BLE_SYNC";
+
+#define NVS_NS_SYNC        "bsync"
+#define NVS_KEY_CLIENTS    "clients"
+#define SYNC_TABLE_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint8_t  id_len;                 // 0 = free slot
+    uint8_t  id[BLE_SYNC_ID_MAX];
+    uint8_t  has_wm;
+    uint8_t  resume;                 // last backlog was cut off
+    uint8_t  _pad;
+    uint32_t wm;                     // highest contiguous seq the client holds
+    uint32_t last_used;              // LRU stamp
+} sync_client_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t _pad[3];
+    uint32_t stamp;
+    sync_client_t c[BLE_SYNC_MAX_CLIENTS];
+} sync_table_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static sync_table_t s_tab;
+static int s_cur = -1;               // slot of the connected client
+static bool s_dirty = false;
+static uint32_t s_seq_floor = 0;     // one past the newest record at boot
+static bool s_ready = false;         // table loaded (fast boot connects earlier)
+static uint16_t s_early_conn = BLE_HS_CONN_HANDLE_NONE;
+
+static uint32_t s_acks = 0;
+static uint32_t s_acks_rejected = 0;
+static uint32_t s_resumes = 0;
+
+// Caller holds s_lock. Never evicts the connected client's slot.
+static int find_or_add(const uint8_t *id, size_t len)
+{
+    int free_slot = -1, lru = -1;
+    for (int i = 0; i < BLE_SYNC_MAX_CLIENTS; i++) {
+        sync_client_t *c = &s_tab.c[i];
+        if (c->id_len == len && memcmp(c->id, id, len) == 0) return i;
+        if (c->id_len == 0 && free_slot < 0) free_slot = i;
+        if (i != s_cur && (lru < 0 || c->last_used < s_tab.c[lru].last_used)) lru = i;
+    }
+
+    int slot = free_slot >= 0 ? free_slot : lru;
+    memset(&s_tab.c[slot], 0, sizeof(s_tab.c[slot]));
+    s_tab.c[slot].id_len = (uint8_t)len;
+    memcpy(s_tab.c[slot].id, id, len);
+    return slot;
+}
+
+// Caller holds s_lock.
+static void select_client(const uint8_t *id, size_t len)
+{
+    s_cur = find_or_add(id, len);
+    s_tab.c[s_cur].last_used = ++s_tab.stamp;
+    s_dirty = true;
+}
+
+static void load_table(void)
+{
+    nvs_handle_t h;
+    size_t len = sizeof(s_tab);
+    bool ok = nvs_open(NVS_NS_SYNC, NVS_READONLY, &h) == ESP_OK;
+    if (ok) {
+        ok = nvs_get_blob(h, NVS_KEY_CLIENTS, &s_tab, &len) == ESP_OK &&
+             len == sizeof(s_tab) && s_tab.version == SYNC_TABLE_VERSION;
+        nvs_close(h);
+    }
+    if (!ok) {
+        memset(&s_tab, 0, sizeof(s_tab));
+        s_tab.version = SYNC_TABLE_VERSION;
+    }
+}
+
+static int sync_stats_section(char *buf, size_t len)
+{
+    int clients = 0;
+    uint32_t wm = 0, reclaim = 0;
+    bool has_wm, has_reclaim;
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < BLE_SYNC_MAX_CLIENTS; i++) {
+        if (s_tab.c[i].id_len) clients++;
+    }
+    int cur = s_cur;
+    has_wm = cur >= 0 && s_tab.c[cur].has_wm;
+    if (has_wm) wm = s_tab.c[cur].wm;
+    portEXIT_CRITICAL(&s_lock);
+    has_reclaim = ble_sync_reclaimable_seq(&reclaim);
+
+    return snprintf(buf, len,
+                    "clients=%d,cur=%d,wm=%" PRId64 ",reclaim=%" PRId64 ",acks=%" PRIu32
+                    ",rejected=%" PRIu32 ",resumes=%" PRIu32,
+                    clients, cur, has_wm ? (int64_t)wm : -1, has_reclaim ? (int64_t)reclaim : -1,
+                    s_acks, s_acks_rejected, s_resumes);
+}
+
+void ble_sync_init(void)
+{
+    load_table();
+
+    // The seq checkpoint lags the log by up to SEQ_CHECKPOINT_EVERY_N, so the
+    // newest stored record decides which seqs exist. A watermark past it means
+    // the log was wiped and restarted; keeping it would hide the new records.
+    battery_log_t last;
+    int n = battery_log_count();
+    bool have_last = n > 0 && battery_log_read(n - 1, &last);
+    uint32_t next = have_last ? last.seq + 1 : 0;
+    s_seq_floor = next;
+
+    int dropped = 0;
+    for (int i = 0; i < BLE_SYNC_MAX_CLIENTS; i++) {
+        sync_client_t *c = &s_tab.c[i];
+        if (c->id_len && c->has_wm && c->wm >= next) {
+            c->has_wm = 0;
+            c->resume = 0;
+            dropped++;
+        }
+    }
+    if (dropped) {
+        ESP_LOGW(TAG, "%d watermark(s) ahead of seq %" PRIu32 " dropped (log was reset)", dropped, next);
+        s_dirty = true;
+        ble_sync_persist();
+    }
+
+    ble_stats_register_section("sync", sync_stats_section);
+
+    portENTER_CRITICAL(&s_lock);
+    s_ready = true;
+    uint16_t early = s_early_conn;
+    s_early_conn = BLE_HS_CONN_HANDLE_NONE;
+    portEXIT_CRITICAL(&s_lock);
+    if (early != BLE_HS_CONN_HANDLE_NONE) {
+        ble_sync_on_connect(early);
+    }
+}
+
+void ble_sync_on_connect(uint16_t conn_handle)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool ready = s_ready;
+    if (!ready) s_early_conn = conn_handle;
+    portEXIT_CRITICAL(&s_lock);
+    if (!ready) return;     // selected by ble_sync_init()
+
+    struct ble_gap_conn_desc desc;
+    if (ble_gap_conn_find(conn_handle, &desc) != 0) return;
+
+    // Default identity: the peer's identity address (stable once bonded).
+    uint8_t id[7];
+    id[0] = desc.peer_id_addr.type;
+    memcpy(&id[1], desc.peer_id_addr.val, 6);
+
+    portENTER_CRITICAL(&s_lock);
+    select_client(id, sizeof(id));
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ble_sync_on_disconnect(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_cur = -1;
+    s_early_conn = BLE_HS_CONN_HANDLE_NONE;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int ble_sync_set_client_id(const uint8_t *id, size_t len)
+{
+    if (!id || len == 0 || len > BLE_SYNC_ID_MAX) return -1;
+
+    portENTER_CRITICAL(&s_lock);
+    if (!s_ready) {
+        portEXIT_CRITICAL(&s_lock);
+        return -1;
+    }
+    // The address-keyed slot made at connect is dropped if it never got a watermark.
+    if (s_cur >= 0 && !s_tab.c[s_cur].has_wm && s_tab.c[s_cur].id_len == 7) {
+        memset(&s_tab.c[s_cur], 0, sizeof(s_tab.c[s_cur]));
+    }
+    select_client(id, len);
+    int slot = s_cur;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "client id set (%u bytes) -> slot %d", (unsigned)len, slot);
+    return 0;
+}
+
+// Caller holds s_lock.
+static void advance_wm(sync_client_t *c, uint32_t seq)
+{
+    // Watermarks only move forward; a late ACK for older data is a no-op.
+    if (!c->has_wm || seq > c->wm) {
+        c->wm = seq;
+        c->has_wm = 1;
+        s_dirty = true;
+    }
+}
+
+// One past the newest seq an ACK may name.
+static uint32_t ack_limit(void)
+{
+    uint32_t next = battery_log_peek_next_seq();
+    return next < s_seq_floor ? s_seq_floor : next;
+}
+
+static void count_ack(int rc, uint32_t seq, uint32_t next)
+{
+    if (rc == 0) {
+        s_acks++;
+        ESP_LOGD(TAG, "ACK seq=%" PRIu32, seq);
+    } else {
+        s_acks_rejected++;
+        ESP_LOGW(TAG, "ACK seq=%" PRIu32 " rejected (next=%" PRIu32 ")", seq, next);
+    }
+}
+
+int ble_sync_ack(uint32_t seq)
+{
+    uint32_t next = ack_limit();
+    int rc = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_cur < 0 || seq >= next) {
+        rc = -1;
+    } else {
+        advance_wm(&s_tab.c[s_cur], seq);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    count_ack(rc, seq, next);
+    return rc;
+}
+
+bool ble_sync_get_watermark(uint32_t *seq)
+{
+    bool has;
+    portENTER_CRITICAL(&s_lock);
+    has = s_cur >= 0 && s_tab.c[s_cur].has_wm;
+    if (has) *seq = s_tab.c[s_cur].wm;
+    portEXIT_CRITICAL(&s_lock);
+    return has;
+}
+
+int ble_sync_ack_named(const uint8_t *id, size_t len, uint32_t seq)
+{
+    if (!id || len == 0 || len > BLE_SYNC_ID_MAX) return -1;
+
+    uint32_t next = ack_limit();
+    int rc = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    if (!s_ready || seq >= next) {
+        rc = -1;
+    } else {
+        int slot = find_or_add(id, len);
+        s_tab.c[slot].last_used = ++s_tab.stamp;
+        advance_wm(&s_tab.c[slot], seq);
+        s_dirty = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    count_ack(rc, seq, next);
+    return rc;
+}
+
+bool ble_sync_get_named_watermark(const uint8_t *id, size_t len, uint32_t *seq)
+{
+    bool has = false;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < BLE_SYNC_MAX_CLIENTS && id && len; i++) {
+        const sync_client_t *c = &s_tab.c[i];
+        if (c->id_len == len && memcmp(c->id, id, len) == 0) {
+            has = c->has_wm;
+            if (has) *seq = c->wm;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return has;
+}
+
+bool ble_sync_newest_watermark(const uint8_t *except_id, size_t len, uint32_t *seq)
+{
+    bool any = false;
+    uint32_t max = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < BLE_SYNC_MAX_CLIENTS; i++) {
+        const sync_client_t *c = &s_tab.c[i];
+        if (!c->id_len || !c->has_wm) continue;
+        if (c->id_len == len && memcmp(c->id, except_id, len) == 0) continue;
+        if (!any || c->wm > max) max = c->wm;
+        any = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (any) *seq = max;
+    return any;
+}
+
+static void set_resume(uint8_t resume)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_cur >= 0 && s_tab.c[s_cur].resume != resume) {
+        s_tab.c[s_cur].resume = resume;
+        s_dirty = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ble_sync_note_backlog_start(void)
+{
+    set_resume(1);
+}
+
+void ble_sync_note_backlog_end(bool complete)
+{
+    if (complete) set_resume(0);
+}
+
+bool ble_sync_take_resume(uint32_t *start_seq)
+{
+    bool resume = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_cur >= 0 && s_tab.c[s_cur].resume) {
+        sync_client_t *c = &s_tab.c[s_cur];
+        *start_seq = c->has_wm ? c->wm + 1 : 0;
+        c->resume = 0;
+        s_dirty = true;
+        resume = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (resume) {
+        s_resumes++;
+        ESP_LOGI(TAG, "resuming cut-off backlog from seq %" PRIu32, *start_seq);
+    }
+    return resume;
+}
+
+bool ble_sync_reclaimable_seq(uint32_t *seq)
+{
+    bool any = false, all = true;
+    uint32_t min = UINT32_MAX;
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < BLE_SYNC_MAX_CLIENTS; i++) {
+        const sync_client_t *c = &s_tab.c[i];
+        if (!c->id_len) continue;
+        any = true;
+        if (!c->has_wm) { all = false; break; }
+        if (c->wm < min) min = c->wm;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!any || !all) return false;
+    *seq = min;
+    return true;
+}
+
+void ble_sync_persist(void)
+{
+    sync_table_t snap;
+
+    portENTER_CRITICAL(&s_lock);
+    bool dirty = s_dirty;
+    s_dirty = false;
+    if (dirty) snap = s_tab;
+    portEXIT_CRITICAL(&s_lock);
+    if (!dirty) return;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NS_SYNC, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, NVS_KEY_CLIENTS, &snap, sizeof(snap));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "persist failed: %s", esp_err_to_name(err));
+        portENTER_CRITICAL(&s_lock);
+        s_dirty = true;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Per-client sync watermark.
+ *
+ * A client acknowledges the highest seq it holds durably with every record
+ * before it (CMD 0x04). The watermark is kept per client in NVS, so a SYNC
+ * (CMD 0x05) only sends what came after it, and a backlog cut off by a
+ * disconnect resumes from the watermark as soon as the same client
+ * subscribes to the backlog characteristic again.
+ *
+ * Clients are identified by their identity address, or by an id they send
+ * with CMD 0x06 (needed without bonding: phones rotate private addresses).
+ * The NVS copy is written from the log writer's task (ble_sync_persist), so
+ * a reset can lose the last few seconds of ACKs; the client then gets those
+ * records again, which it must tolerate anyway.
+ *
+ * A transport that is not a BLE connection (the Wi-Fi upload) keeps its
+ * watermark in the same table under a fixed id, through the *_named calls;
+ * it counts for reclaiming like any other client.
+ */
+
+#define BLE_SYNC_MAX_CLIENTS  4
+#define BLE_SYNC_ID_MAX       16
+
+/** Load the client table. Call after battery_log_seq_init(). */
+void ble_sync_init(void);
+
+void ble_sync_on_connect(uint16_t conn_handle);
+void ble_sync_on_disconnect(void);
+
+/** CMD 0x06: identify the connected client by an app-chosen id (-1 before init). */
+int ble_sync_set_client_id(const uint8_t *id, size_t len);
+
+/**
+ * @brief CMD 0x04: the client holds every record up to and including `seq`.
+ * @return 0, or -1 if no client is selected or `seq` was never assigned
+ */
+int ble_sync_ack(uint32_t seq);
+
+/** Watermark of the connected client; false if it has none yet. */
+bool ble_sync_get_watermark(uint32_t *seq);
+
+/**
+ * @brief ble_sync_ack() for the client with this id, connected or not.
+ * @return 0, or -1 before init, for a bad id or if `seq` was never assigned
+ */
+int ble_sync_ack_named(const uint8_t *id, size_t len, uint32_t seq);
+
+/** Watermark of the client with this id; false if unknown or none yet. */
+bool ble_sync_get_named_watermark(const uint8_t *id, size_t len, uint32_t *seq);
+
+/** Newest watermark over all clients but the one with `except_id`; false if none has one. */
+bool ble_sync_newest_watermark(const uint8_t *except_id, size_t len, uint32_t *seq);
+
+/**
+ * @brief Backlog bookkeeping from the sender. A backlog is marked as cut off
+ *        when it starts and cleared when it ends with `complete` (end of the
+ *        log or an abort command), so a disconnect in between leaves the mark
+ *        on the client that was receiving it.
+ */
+void ble_sync_note_backlog_start(void);
+void ble_sync_note_backlog_end(bool complete);
+
+/**
+ * @brief If the connected client's last backlog was cut off, clear the mark
+ *        and return the seq to resume from.
+ */
+bool ble_sync_take_resume(uint32_t *start_seq);
+
+/**
+ * @brief Oldest watermark over all known clients: records up to it have
+ *        reached every client and can be reclaimed first. False if some
+ *        client has no watermark yet.
+ */
+bool ble_sync_reclaimable_seq(uint32_t *seq);
+
+/** Write the client table to NVS if it changed (log writer's task). */
+void ble_sync_persist(void);
@@ -0,0 +1,66 @@
+#include "boot_prof.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "ble_stats.h"
+
+static const char *TAG = "BOOT";
+
+static const char *const s_names[BOOT_PH_COUNT] = {
+    "nvs", "ble", "fs", "log", "adv", "sample", "diag",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_at[BOOT_PH_COUNT] = { -1, -1, -1, -1, -1, -1, -1 };
+
+_Static_assert(sizeof(s_names) / sizeof(s_names[0]) == BOOT_PH_COUNT, "boot phase names");
+
+static int boot_stats_section(char *buf, size_t len)
+{
+    int n = 0;
+    for (int i = 0; i < BOOT_PH_COUNT && n < (int)len; i++) {
+        int64_t us = boot_prof_get_us((boot_phase_t)i);
+        // ms since reset; -1 = not reached
+        n += snprintf(buf + n, len - (size_t)n, "%s%s=%ld", i ? "," : "", s_names[i],
+                      us < 0 ? -1L : (long)(us / 1000));
+    }
+    return n;
+}
+
+void boot_prof_init(void)
+{
+    ble_stats_register_section("boot", boot_stats_section);
+}
+
+void boot_prof_mark(boot_phase_t ph)
+{
+    if ((unsigned)ph >= BOOT_PH_COUNT || s_at[ph] >= 0) return;
+
+    int64_t now = esp_timer_get_time();
+    bool first = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_at[ph] < 0) {
+        s_at[ph] = now;
+        first = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!first) return;
+
+    ESP_LOGI(TAG, "%s at %ld ms", s_names[ph], (long)(now / 1000));
+    if (ph == BOOT_PH_FIRST_SAMPLE) {
+        ESP_LOGI(TAG, "boot to first advertisement %ld ms, to first sample %ld ms",
+                 (long)(boot_prof_get_us(BOOT_PH_FIRST_ADV) / 1000), (long)(now / 1000));
+    }
+}
+
+int64_t boot_prof_get_us(boot_phase_t ph)
+{
+    if ((unsigned)ph >= BOOT_PH_COUNT) return -1;
+    portENTER_CRITICAL(&s_lock);
+    int64_t v = s_at[ph];
+    portEXIT_CRITICAL(&s_lock);
+    return v;
+}
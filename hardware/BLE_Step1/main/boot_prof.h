@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Boot phase timestamps (esp_timer, microseconds since reset).
+ *
+ * Each phase is recorded the first time it is marked; later marks are
+ * ignored, so hooks on paths that repeat (advertising restarts, every
+ * sample) cost one compare after boot. Reported in the "boot" stats
+ * section and logged once the first sample is taken.
+ */
+typedef enum {
+    BOOT_PH_NVS = 0,        // nvs_flash_init done
+    BOOT_PH_BLE_START,      // ble_stack_start returned (host task running)
+    BOOT_PH_FS,             // LittleFS mounted
+    BOOT_PH_LOG,            // battery log, seq and sync state loaded
+    BOOT_PH_FIRST_ADV,      // first ble_gap_adv_start succeeded
+    BOOT_PH_FIRST_SAMPLE,   // first record built by the sampler
+    BOOT_PH_DIAG,           // deferred diagnostics finished
+    BOOT_PH_COUNT
+} boot_phase_t;
+
+void boot_prof_init(void);
+void boot_prof_mark(boot_phase_t ph);
+
+/** Time of `ph` in microseconds since reset, or -1 if not reached yet. */
+int64_t boot_prof_get_us(boot_phase_t ph);
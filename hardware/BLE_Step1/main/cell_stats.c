@@ -0,0 +1,51 @@
+#include "cell_stats.h"
+
+#include <string.h>
+
+// Keys put the voltage above the index, so one unsigned min (or max) gives
+// both. The max key stores 15 - i so ties still resolve to the lowest cell.
+#define KEY_SHIFT 4
+
+void cell_stats_compute(const battery_log_t *rec, cell_stats_t *out,
+                        int16_t dev_mv[CELL_STATS_CELLS])
+{
+    uint16_t mv[CELL_STATS_CELLS];
+    memcpy(mv, rec->cell_mv, sizeof(mv));    // the record is packed; work on an aligned copy
+
+    uint32_t kmin = UINT32_MAX, kmax = 0, sum = 0;
+    for (int i = 0; i < CELL_STATS_CELLS; i++) {
+        uint32_t v = mv[i];
+        uint32_t lo = (v << KEY_SHIFT) | (uint32_t)i;
+        uint32_t hi = (v << KEY_SHIFT) | (uint32_t)(CELL_STATS_CELLS - 1 - i);
+        kmin = lo < kmin ? lo : kmin;
+        kmax = hi > kmax ? hi : kmax;
+        sum += v;
+    }
+
+    uint32_t min_mv = kmin >> KEY_SHIFT;
+    uint32_t max_mv = kmax >> KEY_SHIFT;
+    uint32_t mean = (sum + CELL_STATS_CELLS / 2) / CELL_STATS_CELLS;
+    uint32_t spread = max_mv - min_mv;
+
+    out->min_mv = (uint16_t)min_mv;
+    out->max_mv = (uint16_t)max_mv;
+    out->mean_mv = (uint16_t)mean;
+    out->spread_mv = (uint16_t)spread;
+    // mean == 0 only if every cell reads 0, and then spread is 0 too.
+    out->imbalance_bp = (uint16_t)(spread * 10000u / (mean | (mean == 0)));
+    out->min_cell = (uint8_t)(kmin & (CELL_STATS_CELLS - 1));
+    out->max_cell = (uint8_t)(CELL_STATS_CELLS - 1 - (kmax & (CELL_STATS_CELLS - 1)));
+
+    if (dev_mv) {
+        for (int i = 0; i < CELL_STATS_CELLS; i++) {
+            dev_mv[i] = (int16_t)((int32_t)mv[i] - (int32_t)mean);
+        }
+    }
+}
+
+void cell_stats_compute_batch(const battery_log_t *recs, int n, cell_stats_t *out)
+{
+    for (int r = 0; r < n; r++) {
+        cell_stats_compute(&recs[r], &out[r], NULL);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include "battery_log.h"
+
+/**
+ * Per-record cell analytics: min/max cell (and which), spread, mean,
+ * imbalance and each cell's deviation from the mean, computed once on the
+ * device instead of by every consumer.
+ *
+ * The kernel has no data-dependent branches: min/max reduce packed
+ * (value, index) keys, so the loops vectorize on the host and lower to
+ * MINU/MAXU on Xtensa. There is no SIMD path for the classic ESP32.
+ */
+#define CELL_STATS_CELLS 16
+
+typedef struct __attribute__((packed)) {
+    uint16_t min_mv;
+    uint16_t max_mv;
+    uint16_t mean_mv;           // rounded to the nearest mV
+    uint16_t spread_mv;         // max - min
+    uint16_t imbalance_bp;      // spread / mean in 0.01 % (0 if mean is 0)
+    uint8_t  min_cell;          // lowest index on ties
+    uint8_t  max_cell;
+} cell_stats_t;
+
+_Static_assert(sizeof(cell_stats_t) == 12, "cell_stats_t is part of the live frame");
+
+/**
+ * @brief Analytics for `rec->cell_mv`.
+ * @param dev_mv optional, receives cell_mv[i] - mean_mv for each cell
+ */
+void cell_stats_compute(const battery_log_t *rec, cell_stats_t *out,
+                        int16_t dev_mv[CELL_STATS_CELLS]);
+
+/** cell_stats_compute() over `n` records (no deviations). */
+void cell_stats_compute_batch(const battery_log_t *recs, int n, cell_stats_t *out);
@@ -0,0 +1,88 @@
+#include "dump_frame.h"
+
+#include <string.h>
+#include "esp_rom_crc.h"
+
+enum {
+    ST_SYNC0 = 0,
+    ST_SYNC1,
+    ST_TYPE,
+    ST_LEN0,
+    ST_LEN1,
+    ST_BODY,            // payload, then the CRC
+};
+
+static uint32_t frame_crc(uint8_t type, uint16_t len, const uint8_t *payload)
+{
+    uint8_t hdr[3] = { type, (uint8_t)len, (uint8_t)(len >> 8) };
+    uint32_t crc = esp_rom_crc32_le(0, hdr, sizeof(hdr));
+    return esp_rom_crc32_le(crc, payload, len);
+}
+
+size_t dump_frame_seal(uint8_t *frame, uint8_t type, size_t payload_len)
+{
+    frame[0] = DUMP_SYNC0;
+    frame[1] = DUMP_SYNC1;
+    frame[2] = type;
+    dump_put_u16(&frame[3], (uint16_t)payload_len);
+    uint32_t crc = frame_crc(type, (uint16_t)payload_len, frame + DUMP_FRAME_HDR_LEN);
+    dump_put_u32(frame + DUMP_FRAME_HDR_LEN + payload_len, crc);
+    return DUMP_FRAME_HDR_LEN + payload_len + DUMP_FRAME_CRC_LEN;
+}
+
+size_t dump_frame_build(uint8_t *out, uint8_t type, const void *payload, size_t payload_len)
+{
+    if (payload_len) memcpy(out + DUMP_FRAME_HDR_LEN, payload, payload_len);
+    return dump_frame_seal(out, type, payload_len);
+}
+
+void dump_parser_reset(dump_parser_t *p)
+{
+    p->state = ST_SYNC0;
+    p->pos = 0;
+}
+
+dump_parse_t dump_parser_push(dump_parser_t *p, uint8_t byte)
+{
+    switch (p->state) {
+    case ST_SYNC0:
+        if (byte == DUMP_SYNC0) p->state = ST_SYNC1;
+        else p->skipped++;
+        return DUMP_PARSE_MORE;
+    case ST_SYNC1:
+        if (byte == DUMP_SYNC1) {
+            p->state = ST_TYPE;
+        } else {
+            p->skipped++;
+            if (byte != DUMP_SYNC0) p->state = ST_SYNC0;
+        }
+        return DUMP_PARSE_MORE;
+    case ST_TYPE:
+        p->type = byte;
+        p->state = ST_LEN0;
+        return DUMP_PARSE_MORE;
+    case ST_LEN0:
+        p->len = byte;
+        p->state = ST_LEN1;
+        return DUMP_PARSE_MORE;
+    case ST_LEN1:
+        p->len |= (uint16_t)(byte << 8);
+        p->pos = 0;
+        if (p->len > DUMP_FRAME_PAYLOAD_MAX) {
+            p->bad++;
+            p->state = ST_SYNC0;
+            return DUMP_PARSE_BAD;
+        }
+        p->state = ST_BODY;
+        return DUMP_PARSE_MORE;
+    default:
+        p->payload[p->pos++] = byte;
+        if (p->pos < p->len + DUMP_FRAME_CRC_LEN) return DUMP_PARSE_MORE;
+        p->state = ST_SYNC0;
+        if (dump_get_u32(p->payload + p->len) != frame_crc(p->type, p->len, p->payload)) {
+            p->bad++;
+            return DUMP_PARSE_BAD;
+        }
+        return DUMP_PARSE_FRAME;
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frames of the wired log dump (serial_dump.c), both directions.
+ *
+ *   u8  DUMP_SYNC0, u8 DUMP_SYNC1
+ *   u8  type       DUMP_T_*
+ *   u16 length     of the payload, at most DUMP_FRAME_PAYLOAD_MAX
+ *   payload
+ *   u32 crc        esp_rom_crc32_le(0, ...) over type, length and payload
+ *
+ * Multi-byte fields are little-endian. The UART is also the console, so a
+ * receiver hunts for the sync bytes and skips whatever lies between frames
+ * (log lines). A frame that fails its CRC is dropped whole and the hunt
+ * starts again after it; the receiver then resumes (below).
+ */
+#define DUMP_SYNC0              0xA5
+#define DUMP_SYNC1              0x5A
+#define DUMP_FRAME_HDR_LEN      5
+#define DUMP_FRAME_CRC_LEN      4
+#define DUMP_FRAME_PAYLOAD_MAX  1024
+#define DUMP_FRAME_MAX          (DUMP_FRAME_HDR_LEN + DUMP_FRAME_PAYLOAD_MAX + DUMP_FRAME_CRC_LEN)
+
+#define DUMP_PROTO_VERSION      1
+
+/*
+ * host -> device
+ *   01 HELLO  u32 baud                 start a session; switch to `baud` after INFO
+ *   02 READ   u32 from_seq, u32 max, u8 tag
+ *                                      stream records with seq >= from_seq, up to
+ *                                      `max` (0: to the end of the log); replaces
+ *                                      a stream in progress
+ *   03 ABORT                           stop the stream (answered with END)
+ *   04 BYE                             end the session: back to the console baud
+ * device -> host
+ *   81 INFO   u8 proto, u8 record version, u16 record size, u32 count,
+ *             u32 first_seq, u32 last_seq, u32 baud, field table (log_schema_table)
+ *   82 DATA   u8 tag, u8 count, u16 frame, `count` records (wire form)
+ *   83 END    u8 tag, u8 status, u16 frames, u32 records, u32 next_seq
+ *
+ * `frame` counts the stream's DATA frames from 0, so a receiver notices a
+ * frame lost whole; END carries how many there were and the seq to resume
+ * from. The receiver resumes by sending READ from the seq after the last
+ * record it kept, with a new tag; frames of the old stream still on the
+ * wire carry the old tag and are ignored.
+ */
+#define DUMP_T_HELLO    0x01
+#define DUMP_T_READ     0x02
+#define DUMP_T_ABORT    0x03
+#define DUMP_T_BYE      0x04
+#define DUMP_T_INFO     0x81
+#define DUMP_T_DATA     0x82
+#define DUMP_T_END      0x83
+
+#define DUMP_HELLO_LEN      4
+#define DUMP_READ_LEN       9
+#define DUMP_INFO_HDR_LEN   20          // before the field table
+#define DUMP_DATA_HDR_LEN   4
+#define DUMP_END_LEN        12
+
+#define DUMP_END_DONE       0           // caught up with the log
+#define DUMP_END_LIMIT      1           // `max` records sent
+#define DUMP_END_ABORTED    2
+#define DUMP_END_READ_ERR   3           // the log could not be read; resume later
+
+typedef enum {
+    DUMP_PARSE_MORE = 0,                // need more bytes
+    DUMP_PARSE_FRAME,                   // a valid frame: type, len, payload
+    DUMP_PARSE_BAD,                     // CRC or length check failed (frame dropped)
+} dump_parse_t;
+
+typedef struct {
+    uint8_t  state;
+    uint8_t  type;
+    uint16_t len;
+    uint16_t pos;
+    uint32_t skipped;                   // bytes outside frames
+    uint32_t bad;
+    uint8_t  payload[DUMP_FRAME_PAYLOAD_MAX + DUMP_FRAME_CRC_LEN];
+} dump_parser_t;
+
+/**
+ * @brief Finish a frame whose payload was written in place at
+ *        frame + DUMP_FRAME_HDR_LEN: fill in the header and the CRC.
+ * @return length of the whole frame
+ */
+size_t dump_frame_seal(uint8_t *frame, uint8_t type, size_t payload_len);
+
+/** Build a frame from a separate payload into out (DUMP_FRAME_MAX bytes). */
+size_t dump_frame_build(uint8_t *out, uint8_t type, const void *payload, size_t payload_len);
+
+/** Back to hunting for sync bytes (a zeroed parser starts there); counters are kept. */
+void dump_parser_reset(dump_parser_t *p);
+
+/**
+ * @brief Feed one byte. After DUMP_PARSE_FRAME the frame is in p->type,
+ *        p->len and p->payload until the next call.
+ */
+dump_parse_t dump_parser_push(dump_parser_t *p, uint8_t byte);
+
+static inline void dump_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void dump_put_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint16_t dump_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t dump_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+#ifdef __cplusplus
+}
+#endif
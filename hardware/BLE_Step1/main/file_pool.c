@@ -0,0 +1,78 @@
+#include "file_pool.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_bufs[FILE_POOL_BUFS][FILE_POOL_BUF_SIZE];
+static FILE *s_owner[FILE_POOL_BUFS];
+static file_pool_stats_t s_stats;
+
+FILE *file_pool_open(const char *path, const char *mode)
+{
+    FILE *f = fopen(path, mode);
+    if (!f) return NULL;
+
+    int slot = -1;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < FILE_POOL_BUFS; i++) {
+        if (!s_owner[i]) {
+            s_owner[i] = f;
+            slot = i;
+            break;
+        }
+    }
+    s_stats.opens++;
+    if (slot >= 0) {
+        s_stats.in_use++;
+        if (s_stats.in_use > s_stats.peak) s_stats.peak = s_stats.in_use;
+    } else {
+        s_stats.fallback++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    // Must come before the first read or write on the stream.
+    if (slot >= 0 && setvbuf(f, (char *)s_bufs[slot], _IOFBF, FILE_POOL_BUF_SIZE) != 0) {
+        portENTER_CRITICAL(&s_lock);
+        s_owner[slot] = NULL;
+        s_stats.in_use--;
+        s_stats.fallback++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    return f;
+}
+
+int file_pool_close(FILE *f)
+{
+    if (!f) return EOF;
+
+    // Find the slot first: once closed, another task's fopen() may get the
+    // same FILE pointer back.
+    int slot = -1;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < FILE_POOL_BUFS; i++) {
+        if (s_owner[i] == f) {
+            slot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    int rc = fclose(f);     // flushes through the pool buffer
+
+    if (slot >= 0) {
+        portENTER_CRITICAL(&s_lock);
+        s_owner[slot] = NULL;
+        s_stats.in_use--;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    return rc;
+}
+
+void file_pool_get_stats(file_pool_stats_t *out)
+{
+    if (!out) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
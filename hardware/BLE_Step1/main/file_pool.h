@@ -0,0 +1,32 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Static stdio buffers for the log, migration and replay files.
+ *
+ * newlib mallocs a stream buffer on the first read or write after fopen()
+ * and frees it again in fclose(); with the log's open/read/close patterns
+ * that was a malloc/free pair per block read or flush, and one of the
+ * sources of slow heap fragmentation on soak runs. Streams opened here get
+ * a buffer from a fixed pool (setvbuf) that goes back on close. newlib
+ * keeps closed FILE objects for reuse, so stdio allocates nothing more
+ * once the first few streams have been opened.
+ */
+#define FILE_POOL_BUFS      4       // row/col log + replay + migration in/out
+#define FILE_POOL_BUF_SIZE  512     // one LittleFS cache (CONFIG_LITTLEFS_CACHE_SIZE)
+
+typedef struct {
+    uint32_t opens;
+    uint32_t fallback;      // opened with a libc (heap) buffer: pool was empty
+    uint16_t in_use;
+    uint16_t peak;
+} file_pool_stats_t;
+
+/** fopen() with a pool buffer; falls back to a libc buffer when the pool is empty. */
+FILE *file_pool_open(const char *path, const char *mode);
+
+/** fclose() a stream from file_pool_open() and return its buffer. */
+int file_pool_close(FILE *f);
+
+void file_pool_get_stats(file_pool_stats_t *out);
@@ -0,0 +1,213 @@
+#include "frame_crypt.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "mbedtls/ccm.h"
+#include "freertos/FreeRTOS.h"
+#include "ble_stats.h"
+
+static const char *TAG = "FRAME_CRYPT";
+
+#define NVS_NS_CRYPT    "fcrypt"
+#define NVS_KEY_KEY     "key"
+#define NVS_KEY_KEY_ID  "key_id"
+#define NVS_KEY_EPOCH   "epoch"
+#define NONCE_LEN       13
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static mbedtls_ccm_context s_ccm;
+static bool s_active = false;
+static uint8_t s_key_id = 0;
+static uint32_t s_epoch = 0;
+static uint32_t s_ctr = 0;
+
+static uint32_t s_sealed = 0;
+static uint32_t s_failed = 0;
+static uint64_t s_seal_us = 0;
+static uint64_t s_sealed_bytes = 0;
+static bool s_stats_registered = false;
+
+static void make_nonce(uint8_t nonce[NONCE_LEN], const frame_crypt_hdr_t *h)
+{
+    memset(nonce, 0, NONCE_LEN);
+    nonce[0] = h->type;
+    memcpy(&nonce[1], &h->epoch, 4);
+    memcpy(&nonce[5], &h->ctr, 4);
+    nonce[9] = h->key_id;
+}
+
+static int crypt_stats_section(char *buf, size_t len)
+{
+    uint32_t sealed = s_sealed;
+    return snprintf(buf, len,
+                    "on=%d,key_id=%u,epoch=%" PRIu32 ",sealed=%" PRIu32 ",fail=%" PRIu32
+                    ",avg_us=%" PRIu32 ",bytes=%" PRIu64,
+                    (int)s_active, s_key_id, s_epoch, sealed, s_failed,
+                    sealed ? (uint32_t)(s_seal_us / sealed) : 0, s_sealed_bytes);
+}
+
+static esp_err_t use_key(const uint8_t key[FRAME_CRYPT_KEY_LEN], uint8_t key_id)
+{
+    mbedtls_ccm_free(&s_ccm);
+    mbedtls_ccm_init(&s_ccm);
+    if (mbedtls_ccm_setkey(&s_ccm, MBEDTLS_CIPHER_ID_AES, key, FRAME_CRYPT_KEY_LEN * 8) != 0) {
+        s_active = false;
+        return ESP_FAIL;
+    }
+    s_key_id = key_id;
+    s_active = true;
+    return ESP_OK;
+}
+
+esp_err_t frame_crypt_init(void)
+{
+    if (!s_stats_registered) {
+        ble_stats_register_section("crypt", crypt_stats_section);
+        s_stats_registered = true;
+    }
+    s_active = false;
+    mbedtls_ccm_free(&s_ccm);
+    mbedtls_ccm_init(&s_ccm);
+
+#if FRAME_CRYPT_ENABLE
+    nvs_handle_t h;
+    if (nvs_open(NVS_NS_CRYPT, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGI(TAG, "no key provisioned, frames stay plaintext");
+        return ESP_OK;
+    }
+
+    uint8_t key[FRAME_CRYPT_KEY_LEN];
+    size_t len = sizeof(key);
+    uint8_t key_id = 0;
+    esp_err_t err = nvs_get_blob(h, NVS_KEY_KEY, key, &len);
+    if (err != ESP_OK || len != sizeof(key)) {
+        nvs_close(h);
+        ESP_LOGI(TAG, "no key provisioned, frames stay plaintext");
+        return ESP_OK;
+    }
+    nvs_get_u8(h, NVS_KEY_KEY_ID, &key_id);
+
+    // A fresh epoch per boot keeps nonces unique with a RAM-only counter.
+    uint32_t epoch = 0;
+    nvs_get_u32(h, NVS_KEY_EPOCH, &epoch);
+    epoch++;
+    err = nvs_set_u32(h, NVS_KEY_EPOCH, epoch);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) {
+        memset(key, 0, sizeof(key));
+        ESP_LOGE(TAG, "epoch not saved (%s), frames stay plaintext", esp_err_to_name(err));
+        return err;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_epoch = epoch;
+    s_ctr = 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    err = use_key(key, key_id);
+    memset(key, 0, sizeof(key));
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "frames sealed, key_id=%u epoch=%" PRIu32, key_id, epoch);
+    }
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+bool frame_crypt_active(void)
+{
+    return s_active;
+}
+
+uint8_t frame_crypt_key_id(void)
+{
+    return s_key_id;
+}
+
+esp_err_t frame_crypt_provision(const uint8_t key[FRAME_CRYPT_KEY_LEN], uint8_t key_id)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NS_CRYPT, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, NVS_KEY_KEY, key, FRAME_CRYPT_KEY_LEN);
+    if (err == ESP_OK) err = nvs_set_u8(h, NVS_KEY_KEY_ID, key_id);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) return err;
+    return frame_crypt_init();
+}
+
+int frame_crypt_seal(uint8_t *frame, size_t body_len, frame_type_t type, uint8_t count)
+{
+    if (!s_active || body_len + FRAME_CRYPT_OVERHEAD > FRAME_CRYPT_MAX_FRAME) return -1;
+
+    frame_crypt_hdr_t h = {
+        .version = FRAME_CRYPT_VERSION,
+        .type = (uint8_t)type,
+        .count = count,
+        .key_id = s_key_id,
+    };
+    portENTER_CRITICAL(&s_lock);
+    bool exhausted = s_ctr == UINT32_MAX;
+    h.epoch = s_epoch;
+    h.ctr = s_ctr;
+    if (!exhausted) s_ctr++;
+    portEXIT_CRITICAL(&s_lock);
+    if (exhausted) {
+        s_failed++;
+        return -1;      // a nonce would repeat; a reboot moves to a new epoch
+    }
+
+    uint8_t nonce[NONCE_LEN];
+    make_nonce(nonce, &h);
+    memcpy(frame, &h, sizeof(h));
+
+    int64_t t0 = esp_timer_get_time();
+    uint8_t *body = frame + FRAME_CRYPT_HDR_LEN;
+    int rc = mbedtls_ccm_encrypt_and_tag(&s_ccm, body_len, nonce, sizeof(nonce),
+                                         frame, FRAME_CRYPT_HDR_LEN, body, body,
+                                         body + body_len, FRAME_CRYPT_TAG_LEN);
+    if (rc != 0) {
+        s_failed++;
+        return -1;
+    }
+    s_seal_us += (uint64_t)(esp_timer_get_time() - t0);
+    s_sealed++;
+    s_sealed_bytes += body_len;
+    return (int)(body_len + FRAME_CRYPT_OVERHEAD);
+}
+
+int frame_crypt_open(const uint8_t key[FRAME_CRYPT_KEY_LEN], uint8_t *frame, size_t len,
+                     frame_crypt_hdr_t *hdr_out)
+{
+    if (len < FRAME_CRYPT_OVERHEAD) return -1;
+
+    frame_crypt_hdr_t h;
+    memcpy(&h, frame, sizeof(h));
+    if (h.version != FRAME_CRYPT_VERSION) return -1;
+
+    uint8_t nonce[NONCE_LEN];
+    make_nonce(nonce, &h);
+
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    size_t body_len = len - FRAME_CRYPT_OVERHEAD;
+    uint8_t *body = frame + FRAME_CRYPT_HDR_LEN;
+    int rc = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, FRAME_CRYPT_KEY_LEN * 8);
+    if (rc == 0) {
+        rc = mbedtls_ccm_auth_decrypt(&ccm, body_len, nonce, sizeof(nonce),
+                                      frame, FRAME_CRYPT_HDR_LEN, body, body,
+                                      body + body_len, FRAME_CRYPT_TAG_LEN);
+    }
+    mbedtls_ccm_free(&ccm);
+    if (rc != 0) return -1;
+
+    if (hdr_out) *hdr_out = h;
+    return (int)body_len;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "battery_log.h"
+
+/**
+ * Application-layer authenticated encryption for live and backlog frames.
+ *
+ * AES-128-CCM with an 8-byte tag (mbedtls; the ESP32 AES accelerator runs
+ * both CCM passes). A sealed frame is
+ *
+ *   frame_crypt_hdr_t (12 B, authenticated) | ciphertext | tag (8 B)
+ *
+ * and the nonce is type | epoch | ctr | key_id, so it never repeats for a
+ * key: epoch is a boot counter kept in NVS and ctr counts frames within
+ * the boot. Backlog frames carry up to FRAME_CRYPT_BACKLOG_RECS records so
+ * the 20-byte overhead is paid once per ATT payload.
+ *
+ * The 16-byte key is provisioned per device into NVS ("fcrypt"/"key",
+ * with "key_id"); see docs/FRAME_CRYPTO.md. Without a key, frames stay
+ * plaintext as before and the summary characteristic says so.
+ */
+#ifndef FRAME_CRYPT_ENABLE
+#define FRAME_CRYPT_ENABLE 1
+#endif
+
+#define FRAME_CRYPT_VERSION     1
+#define FRAME_CRYPT_KEY_LEN     16
+#define FRAME_CRYPT_HDR_LEN     12
+#define FRAME_CRYPT_TAG_LEN     8
+#define FRAME_CRYPT_OVERHEAD    (FRAME_CRYPT_HDR_LEN + FRAME_CRYPT_TAG_LEN)
+#define FRAME_CRYPT_MAX_FRAME   244     // ATT notification payload at MTU 247
+#define FRAME_CRYPT_BACKLOG_RECS ((FRAME_CRYPT_MAX_FRAME - FRAME_CRYPT_OVERHEAD) / sizeof(battery_log_t))
+
+typedef enum {
+    FRAME_TYPE_LIVE = 1,
+    FRAME_TYPE_BACKLOG = 2,
+} frame_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  type;          // frame_type_t
+    uint8_t  count;         // records in the frame
+    uint8_t  key_id;
+    uint32_t epoch;
+    uint32_t ctr;
+} frame_crypt_hdr_t;
+
+_Static_assert(sizeof(frame_crypt_hdr_t) == FRAME_CRYPT_HDR_LEN, "header layout");
+
+/** Load the key and advance the boot epoch. Inactive (not an error) without a key. */
+esp_err_t frame_crypt_init(void);
+
+/** Frames are being sealed. */
+bool frame_crypt_active(void);
+uint8_t frame_crypt_key_id(void);
+
+/** Store a device key (factory provisioning, host tests) and use it. */
+esp_err_t frame_crypt_provision(const uint8_t key[FRAME_CRYPT_KEY_LEN], uint8_t key_id);
+
+/**
+ * @brief Seal a frame in place. `frame` holds FRAME_CRYPT_HDR_LEN bytes of
+ *        room, then `body_len` bytes of plaintext, then FRAME_CRYPT_TAG_LEN
+ *        bytes of room.
+ * @return sealed length, or -1 (inactive, counter exhausted, cipher error)
+ */
+int frame_crypt_seal(uint8_t *frame, size_t body_len, frame_type_t type, uint8_t count);
+
+/**
+ * @brief Client side: check and decrypt a sealed frame in place.
+ * @return plaintext length (at frame + FRAME_CRYPT_HDR_LEN), or -1
+ */
+int frame_crypt_open(const uint8_t key[FRAME_CRYPT_KEY_LEN], uint8_t *frame, size_t len,
+                     frame_crypt_hdr_t *hdr_out);
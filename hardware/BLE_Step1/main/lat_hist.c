@@ -0,0 +1,38 @@
+#include "lat_hist.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+static const uint32_t s_bounds_us[LAT_HIST_BUCKETS - 1] = {
+    500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 500000,
+};
+
+static const char *const s_labels[LAT_HIST_BUCKETS] = {
+    "lt0.5ms", "lt1ms", "lt2ms", "lt5ms", "lt10ms", "lt20ms", "lt50ms", "lt100ms", "lt500ms",
+    "ge500ms",
+};
+
+void lat_hist_add(lat_hist_t *h, uint32_t us)
+{
+    int i = 0;
+    while (i < LAT_HIST_BUCKETS - 1 && us >= s_bounds_us[i]) i++;
+    h->bucket[i]++;
+    h->n++;
+    h->sum_us += us;
+    if (us > h->max_us) h->max_us = us;
+}
+
+uint32_t lat_hist_bucket_us(int i)
+{
+    return (i >= 0 && i < LAT_HIST_BUCKETS - 1) ? s_bounds_us[i] : UINT32_MAX;
+}
+
+int lat_hist_format(const lat_hist_t *h, char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "n=%" PRIu32 ",avg_us=%" PRIu32 ",max_us=%" PRIu32,
+                     h->n, h->n ? (uint32_t)(h->sum_us / h->n) : 0, h->max_us);
+    for (int i = 0; i < LAT_HIST_BUCKETS && n >= 0 && (size_t)n < len; i++) {
+        n += snprintf(buf + n, len - (size_t)n, ",%s=%" PRIu32, s_labels[i], h->bucket[i]);
+    }
+    return n;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Latency histogram with fixed buckets from 0.5 ms to 500 ms plus an
+ * overflow bucket. Not locked: the owner serialises lat_hist_add() against
+ * readers (copy it under its own lock before formatting).
+ */
+#define LAT_HIST_BUCKETS 10
+
+typedef struct {
+    uint32_t n;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t bucket[LAT_HIST_BUCKETS];
+} lat_hist_t;
+
+void lat_hist_add(lat_hist_t *h, uint32_t us);
+
+/** Upper bound of bucket `i` in microseconds (UINT32_MAX for the last). */
+uint32_t lat_hist_bucket_us(int i);
+
+/**
+ * @brief Append "n=,avg_us=,max_us=,lt0.5ms=,...,ge500ms=" to a stats line.
+ * @return characters written, as snprintf
+ */
+int lat_hist_format(const lat_hist_t *h, char *buf, size_t len);
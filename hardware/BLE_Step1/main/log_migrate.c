@@ -0,0 +1,455 @@
+#include "log_migrate.h"
+#include "log_store.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "file_pool.h"
+#include "esp_timer.h"
+#include "ble_stats.h"
+
+static const char *TAG = "LOG_MIGRATE";
+
+#define OLD_FILE   LOG_BASE_PATH "/battery.old"
+#define MIG_FILE   LOG_BASE_PATH "/battery.mig"
+
+#define NVS_KEY_MIG_PHASE  "mig_ph"
+#define NVS_KEY_MIG_VER    "mig_ver"
+#define NVS_KEY_MIG_SIZE   "mig_sz"
+#define NVS_KEY_MIG_TOTAL  "mig_tot"
+#define NVS_KEY_MIG_DONE   "mig_done"
+
+#define MIG_PHASE_IDLE     0
+#define MIG_PHASE_CONVERT  1
+#define MIG_PHASE_SWAP     2
+
+#define MIG_OLD_MAX_SIZE   64   // largest old record size a converter accepts
+#define MIG_READ_CHUNK     8    // records per fread on the read path (stack)
+
+/**
+ * One entry per record version a deployed device may still hold. A converter
+ * fills every field of the current record from an old one.
+ */
+typedef struct {
+    uint32_t ver;
+    uint32_t size;
+    void (*convert)(const uint8_t *src, battery_log_t *dst);
+} log_converter_t;
+
+// v3 -> v4: the 3 pad bytes after soc became interval_s and rate.
+static void convert_v3(const uint8_t *src, battery_log_t *dst)
+{
+    memcpy(dst, src, offsetof(battery_log_t, interval_s));
+    dst->interval_s = 0;
+    dst->rate = 0;
+}
+
+static const log_converter_t s_converters[] = {
+    { 3, 56, convert_v3 },
+};
+
+static const log_converter_t *s_conv = NULL;
+static volatile uint32_t s_phase = MIG_PHASE_IDLE;
+static uint32_t s_total = 0;
+static volatile uint32_t s_done = 0;
+static uint32_t s_batches = 0;
+static int64_t s_t0_us = 0;
+static uint32_t s_elapsed_ms = 0;
+
+// Batch buffers, used by the converter task (and by the swap, after it ends).
+static uint8_t s_in[LOG_MIGRATE_BATCH * MIG_OLD_MAX_SIZE];
+static battery_log_t s_out[LOG_MIGRATE_BATCH];
+
+static const log_converter_t *find_converter(uint32_t ver, uint32_t size)
+{
+    for (size_t i = 0; i < sizeof(s_converters) / sizeof(s_converters[0]); i++) {
+        if (s_converters[i].ver == ver && s_converters[i].size == size &&
+            size <= MIG_OLD_MAX_SIZE) {
+            return &s_converters[i];
+        }
+    }
+    return NULL;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static void nvs_clear_state(nvs_handle_t h)
+{
+    nvs_erase_key(h, NVS_KEY_MIG_PHASE);
+    nvs_erase_key(h, NVS_KEY_MIG_VER);
+    nvs_erase_key(h, NVS_KEY_MIG_SIZE);
+    nvs_erase_key(h, NVS_KEY_MIG_TOTAL);
+    nvs_erase_key(h, NVS_KEY_MIG_DONE);
+}
+
+static esp_err_t nvs_set_progress(const char *key, uint32_t v)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(LOG_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_u32(h, key, v);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+void log_migrate_discard(nvs_handle_t h)
+{
+    unlink(OLD_FILE);
+    unlink(MIG_FILE);
+    nvs_clear_state(h);
+    s_conv = NULL;
+    s_phase = MIG_PHASE_IDLE;
+    s_total = 0;
+    s_done = 0;
+}
+
+esp_err_t log_migrate_begin(nvs_handle_t h, uint32_t old_ver, uint32_t old_size)
+{
+    // A migration still pending from an earlier update is abandoned.
+    uint32_t phase = MIG_PHASE_IDLE;
+    if (nvs_get_u32(h, NVS_KEY_MIG_PHASE, &phase) == ESP_OK && phase != MIG_PHASE_IDLE) {
+        ESP_LOGW(TAG, "format changed again during a migration, dropping it");
+        log_migrate_discard(h);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    const log_converter_t *conv = find_converter(old_ver, old_size);
+    if (!conv) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // If a previous attempt renamed the file but lost power before the NVS
+    // commit, battery.old is already the source.
+    if (file_size(LOG_ROW_FILE) >= 0) {
+        unlink(OLD_FILE);
+        if (rename(LOG_ROW_FILE, OLD_FILE) != 0) {
+            ESP_LOGE(TAG, "rename to %s failed errno=%d (%s)", OLD_FILE, errno, strerror(errno));
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    unlink(MIG_FILE);
+
+    long sz = file_size(OLD_FILE);
+    uint32_t total = sz > 0 ? (uint32_t)(sz / (long)old_size) : 0;
+    if (total == 0) {
+        unlink(OLD_FILE);
+        return ESP_OK;
+    }
+
+    // Committed by the caller together with the new log version.
+    nvs_set_u32(h, NVS_KEY_MIG_VER, old_ver);
+    nvs_set_u32(h, NVS_KEY_MIG_SIZE, old_size);
+    nvs_set_u32(h, NVS_KEY_MIG_TOTAL, total);
+    nvs_set_u32(h, NVS_KEY_MIG_DONE, 0);
+    nvs_set_u32(h, NVS_KEY_MIG_PHASE, MIG_PHASE_CONVERT);
+
+    ESP_LOGW(TAG, "migrating %" PRIu32 " record(s) v%" PRIu32 " -> v%u in the background",
+             total, old_ver, (unsigned)LOG_RECORD_VERSION);
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------- swap
+
+static int copy_new_records(FILE *dst)
+{
+    FILE *src = file_pool_open(LOG_ROW_FILE, "rb");
+    if (!src) return errno == ENOENT ? 0 : -1;
+
+    int copied = 0;
+    size_t got;
+    while ((got = fread(s_out, sizeof(battery_log_t), LOG_MIGRATE_BATCH, src)) > 0) {
+        if (fwrite(s_out, sizeof(battery_log_t), got, dst) != got) {
+            file_pool_close(src);
+            return -1;
+        }
+        copied += (int)got;
+    }
+    file_pool_close(src);
+    return copied;
+}
+
+static void finish(void)
+{
+    nvs_handle_t h;
+    unlink(OLD_FILE);
+    if (nvs_open(LOG_NVS_NS, NVS_READWRITE, &h) == ESP_OK) {
+        nvs_clear_state(h);
+        nvs_commit(h);
+        nvs_close(h);
+    }
+
+    s_elapsed_ms = (uint32_t)((esp_timer_get_time() - s_t0_us) / 1000);
+    ESP_LOGI(TAG, "migration done: %" PRIu32 " record(s) in %" PRIu32 " batch(es), %" PRIu32 " ms",
+             s_total, s_batches, s_elapsed_ms);
+    s_conv = NULL;
+    s_phase = MIG_PHASE_IDLE;
+}
+
+/*
+ * battery.mig = converted records + everything written since the update,
+ * then it replaces battery.bin. Repeatable until the rename lands; after it,
+ * battery.mig no longer exists and only the cleanup is left.
+ */
+static esp_err_t swap(void)
+{
+    if (file_size(MIG_FILE) < 0) {
+        finish();
+        return ESP_OK;
+    }
+
+    if (truncate(MIG_FILE, (off_t)s_total * (off_t)sizeof(battery_log_t)) != 0) {
+        ESP_LOGE(TAG, "truncate %s failed errno=%d (%s)", MIG_FILE, errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    FILE *f = file_pool_open(MIG_FILE, "ab");
+    if (!f) return ESP_FAIL;
+    int copied = copy_new_records(f);
+    bool ok = copied >= 0 && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    file_pool_close(f);
+    if (!ok) {
+        ESP_LOGE(TAG, "merge of new records failed errno=%d (%s)", errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    if (rename(MIG_FILE, LOG_ROW_FILE) != 0) {
+        ESP_LOGE(TAG, "rename to %s failed errno=%d (%s)", LOG_ROW_FILE, errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "swapped in converted log (+%d new record(s))", copied);
+    finish();
+    return ESP_OK;
+}
+
+bool log_migrate_swap_due(void)
+{
+    return s_phase == MIG_PHASE_SWAP;
+}
+
+void log_migrate_poll(void)
+{
+    if (s_phase == MIG_PHASE_SWAP) {
+        swap();
+    }
+}
+
+// ---------------------------------------------------------------- convert
+
+int log_migrate_run_batch(void)
+{
+    if (s_phase != MIG_PHASE_CONVERT) return 0;
+
+    uint32_t done = s_done;
+    int k = (int)(s_total - done) < LOG_MIGRATE_BATCH ? (int)(s_total - done) : LOG_MIGRATE_BATCH;
+
+    if (k > 0) {
+        FILE *in = file_pool_open(OLD_FILE, "rb");
+        if (!in) {
+            ESP_LOGE(TAG, "open %s failed errno=%d (%s)", OLD_FILE, errno, strerror(errno));
+            return -1;
+        }
+        bool ok = fseek(in, (long)done * (long)s_conv->size, SEEK_SET) == 0 &&
+                  fread(s_in, s_conv->size, (size_t)k, in) == (size_t)k;
+        file_pool_close(in);
+        if (!ok) return -1;
+
+        for (int i = 0; i < k; i++) {
+            s_conv->convert(s_in + (size_t)i * s_conv->size, &s_out[i]);
+        }
+
+        FILE *out = file_pool_open(MIG_FILE, "ab");
+        if (!out) {
+            ESP_LOGE(TAG, "open %s failed errno=%d (%s)", MIG_FILE, errno, strerror(errno));
+            return -1;
+        }
+        ok = fwrite(s_out, sizeof(battery_log_t), (size_t)k, out) == (size_t)k &&
+             fflush(out) == 0 && fsync(fileno(out)) == 0;
+        file_pool_close(out);
+        if (!ok) {
+            truncate(MIG_FILE, (off_t)done * (off_t)sizeof(battery_log_t));
+            return -1;
+        }
+
+        // The records are on flash before the marker says so.
+        if (nvs_set_progress(NVS_KEY_MIG_DONE, done + (uint32_t)k) != ESP_OK) return -1;
+        s_done = done + (uint32_t)k;
+        s_batches++;
+    }
+
+    if (s_done >= s_total) {
+        if (nvs_set_progress(NVS_KEY_MIG_PHASE, MIG_PHASE_SWAP) != ESP_OK) return -1;
+        s_phase = MIG_PHASE_SWAP;
+        ESP_LOGI(TAG, "conversion complete, swap on next append");
+        return 0;
+    }
+    return (int)(s_total - s_done);
+}
+
+// ---------------------------------------------------------------- read path
+
+int log_migrate_count(void)
+{
+    return s_phase != MIG_PHASE_IDLE ? (int)s_total : 0;
+}
+
+static int read_converted(int start, int n, battery_log_t *out)
+{
+    FILE *f = file_pool_open(OLD_FILE, "rb");
+    if (!f) return -1;
+
+    uint8_t raw[MIG_READ_CHUNK * MIG_OLD_MAX_SIZE];
+    int done = 0;
+    if (fseek(f, (long)start * (long)s_conv->size, SEEK_SET) == 0) {
+        while (done < n) {
+            int want = n - done < MIG_READ_CHUNK ? n - done : MIG_READ_CHUNK;
+            int got = (int)fread(raw, s_conv->size, (size_t)want, f);
+            for (int i = 0; i < got; i++) {
+                s_conv->convert(raw + (size_t)i * s_conv->size, &out[done + i]);
+            }
+            done += got;
+            if (got < want) break;
+        }
+    }
+    file_pool_close(f);
+    return done;
+}
+
+bool log_migrate_read(int index, battery_log_t *out)
+{
+    if (index < 0 || index >= log_migrate_count()) return false;
+    return read_converted(index, 1, out) == 1;
+}
+
+int log_migrate_read_field(log_field_t field, int start, int n, void *out)
+{
+    int total = log_migrate_count();
+    if (start + n > total) n = total - start;
+    if (n <= 0) return 0;
+
+    size_t vsz = log_field_desc(field)->size;
+    uint8_t *dst = (uint8_t *)out;
+    battery_log_t chunk[MIG_READ_CHUNK];
+    int done = 0;
+
+    while (done < n) {
+        int want = n - done < MIG_READ_CHUNK ? n - done : MIG_READ_CHUNK;
+        int got = read_converted(start + done, want, chunk);
+        if (got <= 0) break;
+        log_extract_field(chunk, got, field, dst + (size_t)done * vsz);
+        done += got;
+    }
+    return done;
+}
+
+int log_migrate_find_seq(uint32_t start_seq)
+{
+    int lo = 0, hi = log_migrate_count();
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        battery_log_t rec;
+        if (read_converted(mid, 1, &rec) != 1) return lo;
+        if (rec.seq < start_seq) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// ---------------------------------------------------------------- init / stats
+
+void log_migrate_get_status(log_migrate_status_t *out)
+{
+    out->phase = s_phase;
+    out->from_ver = s_conv ? s_conv->ver : 0;
+    out->done = s_done;
+    out->total = s_total;
+    out->batches = s_batches;
+    out->elapsed_ms = s_phase != MIG_PHASE_IDLE
+                    ? (uint32_t)((esp_timer_get_time() - s_t0_us) / 1000) : s_elapsed_ms;
+}
+
+static int migrate_stats_section(char *buf, size_t len)
+{
+    log_migrate_status_t st;
+    log_migrate_get_status(&st);
+    uint32_t rate = st.elapsed_ms ? (uint32_t)((uint64_t)st.done * 1000u / st.elapsed_ms) : 0;
+
+    return snprintf(buf, len,
+                    "phase=%" PRIu32 ",from=%" PRIu32 ",done=%" PRIu32 ",total=%" PRIu32
+                    ",batches=%" PRIu32 ",ms=%" PRIu32 ",rec_per_s=%" PRIu32,
+                    st.phase, st.from_ver, st.done, st.total, st.batches, st.elapsed_ms, rate);
+}
+
+esp_err_t log_migrate_init(void)
+{
+    static bool registered = false;
+    if (!registered) {
+        ble_stats_register_section("migrate", migrate_stats_section);
+        registered = true;
+    }
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(LOG_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    uint32_t phase = MIG_PHASE_IDLE, ver = 0, size = 0, total = 0, done = 0;
+    nvs_get_u32(h, NVS_KEY_MIG_PHASE, &phase);
+    if (phase == MIG_PHASE_IDLE) {
+        // Leftovers of an attempt that never got its NVS commit.
+        unlink(OLD_FILE);
+        unlink(MIG_FILE);
+        s_phase = MIG_PHASE_IDLE;
+        nvs_close(h);
+        return ESP_OK;
+    }
+
+    nvs_get_u32(h, NVS_KEY_MIG_VER, &ver);
+    nvs_get_u32(h, NVS_KEY_MIG_SIZE, &size);
+    nvs_get_u32(h, NVS_KEY_MIG_TOTAL, &total);
+    nvs_get_u32(h, NVS_KEY_MIG_DONE, &done);
+
+    s_conv = find_converter(ver, size);
+    bool source_ok = phase == MIG_PHASE_SWAP ||
+                     file_size(OLD_FILE) >= (long)total * (long)size;
+    if (!s_conv || !source_ok) {
+        ESP_LOGE(TAG, "migration state unusable (v%" PRIu32 " sz=%" PRIu32 "), dropping old records",
+                 ver, size);
+        log_migrate_discard(h);
+        nvs_commit(h);
+        nvs_close(h);
+        return ESP_FAIL;
+    }
+    nvs_close(h);
+
+    s_total = total;
+    s_done = done;
+    s_batches = 0;
+    s_t0_us = esp_timer_get_time();
+
+    if (phase == MIG_PHASE_CONVERT) {
+        // Drop a batch that was written but not yet marked.
+        long have = file_size(MIG_FILE);
+        uint32_t on_flash = have > 0 ? (uint32_t)(have / (long)sizeof(battery_log_t)) : 0;
+        if (on_flash < done) {
+            ESP_LOGW(TAG, "converted file short (%" PRIu32 " < %" PRIu32 "), restarting there",
+                     on_flash, done);
+            s_done = on_flash;
+        }
+        truncate(MIG_FILE, (off_t)s_done * (off_t)sizeof(battery_log_t));
+        s_phase = MIG_PHASE_CONVERT;
+        ESP_LOGI(TAG, "resuming migration at %" PRIu32 "/%" PRIu32, s_done, s_total);
+        return ESP_OK;
+    }
+
+    // Interrupted swap: finish it before anything is appended.
+    s_phase = MIG_PHASE_SWAP;
+    return swap();
+}
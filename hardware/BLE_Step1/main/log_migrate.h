@@ -0,0 +1,74 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+#include "battery_log.h"
+
+/**
+ * Online migration of battery.bin after a record format change.
+ *
+ * Instead of wiping, the old file is set aside as battery.old and converted
+ * to the current record layout in the background, a batch at a time, into
+ * battery.mig. Until that finishes, the old records are served to readers
+ * by converting them on the fly, in front of the records written since the
+ * update, so indices and seq search behave as one log. When conversion is
+ * done, the records written since are appended to battery.mig and it
+ * replaces battery.bin.
+ *
+ * Progress is committed to NVS after every batch, so a reset resumes where
+ * it stopped. Only the row layout is migrated; other cases still wipe.
+ */
+
+#define LOG_MIGRATE_BATCH  32      // records per batch (2 x 1.75 KB of static buffers)
+
+/**
+ * @brief Called by log_maybe_wipe_on_format_change() on a version/size
+ *        mismatch, with the log NVS namespace open.
+ * @return ESP_OK if a migration was set up (the caller records the new
+ *         version and keeps the seq checkpoint), ESP_ERR_NOT_SUPPORTED if the
+ *         caller should wipe instead.
+ */
+esp_err_t log_migrate_begin(nvs_handle_t h, uint32_t old_ver, uint32_t old_size);
+
+/** Drop any pending migration and its files (the log is being wiped). */
+void log_migrate_discard(nvs_handle_t h);
+
+/**
+ * @brief Boot-time: load migration state, repair a partial batch, finish an
+ *        interrupted swap, start the background task. Registers the
+ *        "migrate" stats section.
+ */
+esp_err_t log_migrate_init(void);
+
+/** Records still in the old format (0 when no migration is pending). */
+int  log_migrate_count(void);
+bool log_migrate_read(int index, battery_log_t *out);
+int  log_migrate_read_field(log_field_t field, int start, int n, void *out);
+int  log_migrate_find_seq(uint32_t start_seq);
+
+/**
+ * @brief Convert one batch.
+ * @return records left to convert (0 = conversion done), -1 on error
+ */
+int log_migrate_run_batch(void);
+
+/** Conversion is done: the next log_migrate_poll() replaces battery.bin. */
+bool log_migrate_swap_due(void);
+
+/**
+ * @brief From the log writer's context: once conversion is done, merge the
+ *        new records into the converted file and swap it in.
+ */
+void log_migrate_poll(void);
+
+typedef struct {
+    uint32_t phase;         // 0 idle, 1 converting, 2 swapping
+    uint32_t from_ver;
+    uint32_t done;
+    uint32_t total;
+    uint32_t batches;
+    uint32_t elapsed_ms;
+} log_migrate_status_t;
+
+void log_migrate_get_status(log_migrate_status_t *out);
@@ -0,0 +1,214 @@
+#include "log_pack.h"
+
+#include <string.h>
+
+// One entry per value, array elements expanded, in record order.
+typedef struct {
+    uint8_t offset;
+    uint8_t code;       // LOG_TCODE_*
+} pack_value_t;
+
+static const pack_value_t s_values[LOG_SCHEMA_VALUES] = {
+#define VAL(t, name, i) { offsetof(battery_log_t, name) + (i) * sizeof(LOG_CTYPE_##t), LOG_TCODE_##t },
+#define FIELD(t, name, n, e, u) LOG_EACH_##n(VAL, t, name)
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+#undef VAL
+};
+
+static inline void put_le(uint8_t *p, uint32_t v, int size)
+{
+    for (int i = 0; i < size; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint32_t get_le(const uint8_t *p, int size)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < size; i++) v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+static int64_t value_get(const battery_log_t *rec, const pack_value_t *v)
+{
+    const uint8_t *p = (const uint8_t *)rec + v->offset;
+    switch (v->code) {
+    case LOG_TCODE_U8:  { uint8_t x;  memcpy(&x, p, 1); return x; }
+    case LOG_TCODE_I8:  { int8_t x;   memcpy(&x, p, 1); return x; }
+    case LOG_TCODE_U16: { uint16_t x; memcpy(&x, p, 2); return x; }
+    case LOG_TCODE_I16: { int16_t x;  memcpy(&x, p, 2); return x; }
+    case LOG_TCODE_U32: { uint32_t x; memcpy(&x, p, 4); return x; }
+    default:            { int32_t x;  memcpy(&x, p, 4); return x; }
+    }
+}
+
+// Truncates to the value's width, so a corrupt batch cannot overflow it.
+static void value_set(battery_log_t *rec, const pack_value_t *v, int64_t val)
+{
+    uint8_t *p = (uint8_t *)rec + v->offset;
+    switch (LOG_TCODE_SIZE(v->code)) {
+    case 1:  { uint8_t x = (uint8_t)val;   memcpy(p, &x, 1); break; }
+    case 2:  { uint16_t x = (uint16_t)val; memcpy(p, &x, 2); break; }
+    default: { uint32_t x = (uint32_t)val; memcpy(p, &x, 4); break; }
+    }
+}
+
+typedef struct {
+    uint8_t *p;
+    size_t len;
+    size_t cap;
+} pack_out_t;
+
+static inline int put_varint(pack_out_t *o, uint64_t v)
+{
+    do {
+        if (o->len >= o->cap) return -1;
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        o->p[o->len++] = v ? (b | 0x80) : b;
+    } while (v);
+    return 0;
+}
+
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static int pack_delta(const battery_log_t *recs, int n, pack_out_t *o)
+{
+    for (int c = 0; c < LOG_SCHEMA_VALUES; c++) {
+        const pack_value_t *v = &s_values[c];
+        int64_t prev = value_get(&recs[0], v);
+        if (put_varint(o, zigzag(prev)) != 0) return -1;
+
+        for (int i = 1; i < n; ) {
+            int64_t cur = value_get(&recs[i], v);
+            if (cur != prev) {
+                if (put_varint(o, zigzag(cur - prev)) != 0) return -1;
+                prev = cur;
+                i++;
+                continue;
+            }
+            int run = 1;
+            while (i + run < n && value_get(&recs[i + run], v) == prev) run++;
+            if (put_varint(o, 0) != 0 || put_varint(o, (uint64_t)(run - 1)) != 0) return -1;
+            i += run;
+        }
+    }
+    return 0;
+}
+
+int log_pack_batch(const battery_log_t *recs, int n, uint32_t from_seq, uint8_t flags,
+                   uint8_t *out, size_t cap)
+{
+    if (!recs || !out || n < 1 || n > LOG_PACK_MAX_RECORDS || cap < LOG_PACK_HDR_LEN) return -1;
+
+    const size_t raw_len = (size_t)n * LOG_RECORD_SIZE_BYTES;
+    pack_out_t o = { out + LOG_PACK_HDR_LEN, 0, cap - LOG_PACK_HDR_LEN };
+    if (o.cap > raw_len - 1) o.cap = raw_len - 1;     // only worth it if smaller
+
+    uint8_t codec = LOG_PACK_DELTA;
+    if (pack_delta(recs, n, &o) != 0) {
+        if (cap - LOG_PACK_HDR_LEN < raw_len) return -1;
+        codec = LOG_PACK_RAW;
+        for (int i = 0; i < n; i++) {
+            log_record_encode(&recs[i], out + LOG_PACK_HDR_LEN + (size_t)i * LOG_RECORD_SIZE_BYTES);
+        }
+        o.len = raw_len;
+    }
+
+    put_le(out, LOG_PACK_MAGIC, 4);
+    out[4] = LOG_PACK_VERSION;
+    out[5] = codec;
+    out[6] = LOG_RECORD_VERSION;
+    out[7] = flags;
+    put_le(out + 8, LOG_RECORD_SIZE_BYTES, 2);
+    put_le(out + 10, (uint32_t)n, 2);
+    put_le(out + 12, from_seq, 4);
+    put_le(out + 16, recs[n - 1].seq, 4);
+    put_le(out + 20, (uint32_t)o.len, 4);
+    return (int)(LOG_PACK_HDR_LEN + o.len);
+}
+
+int log_pack_parse_header(const uint8_t *in, size_t len, log_pack_hdr_t *hdr)
+{
+    if (!in || !hdr || len < LOG_PACK_HDR_LEN) return -1;
+    if (get_le(in, 4) != LOG_PACK_MAGIC || in[4] != LOG_PACK_VERSION) return -1;
+
+    hdr->codec = in[5];
+    hdr->record_version = in[6];
+    hdr->flags = in[7];
+    hdr->record_size = (uint16_t)get_le(in + 8, 2);
+    hdr->count = (uint16_t)get_le(in + 10, 2);
+    hdr->from_seq = get_le(in + 12, 4);
+    hdr->last_seq = get_le(in + 16, 4);
+    hdr->payload_len = get_le(in + 20, 4);
+
+    if (hdr->record_version != LOG_RECORD_VERSION || hdr->record_size != LOG_RECORD_SIZE_BYTES ||
+        hdr->count == 0 || hdr->codec > LOG_PACK_DELTA ||
+        hdr->payload_len > len - LOG_PACK_HDR_LEN) {
+        return -1;
+    }
+    return 0;
+}
+
+static int get_varint(const uint8_t *p, size_t len, size_t *pos, uint64_t *v)
+{
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= len) return -1;
+        uint8_t b = p[(*pos)++];
+        x |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int log_pack_unpack(const uint8_t *in, size_t len, log_pack_hdr_t *hdr,
+                    battery_log_t *recs, int max)
+{
+    if (log_pack_parse_header(in, len, hdr) != 0 || hdr->count > max) return -1;
+
+    const uint8_t *p = in + LOG_PACK_HDR_LEN;
+    const size_t plen = hdr->payload_len;
+    const int n = hdr->count;
+
+    if (hdr->codec == LOG_PACK_RAW) {
+        if (plen != (size_t)n * LOG_RECORD_SIZE_BYTES) return -1;
+        for (int i = 0; i < n; i++) {
+            log_record_decode(p + (size_t)i * LOG_RECORD_SIZE_BYTES, &recs[i]);
+        }
+        return n;
+    }
+
+    size_t pos = 0;
+    for (int c = 0; c < LOG_SCHEMA_VALUES; c++) {
+        const pack_value_t *v = &s_values[c];
+        uint64_t z;
+        if (get_varint(p, plen, &pos, &z) != 0) return -1;
+        int64_t prev = unzigzag(z);
+        value_set(&recs[0], v, prev);
+
+        for (int i = 1; i < n; ) {
+            if (get_varint(p, plen, &pos, &z) != 0) return -1;
+            int64_t d = unzigzag(z);
+            if (d != 0) {
+                prev += d;
+                value_set(&recs[i++], v, prev);
+                continue;
+            }
+            uint64_t more;
+            if (get_varint(p, plen, &pos, &more) != 0 || more >= (uint64_t)(n - i)) return -1;
+            for (int k = 0; k <= (int)more; k++) value_set(&recs[i++], v, prev);
+        }
+    }
+    return pos == plen ? n : -1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "log_schema.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Record batches for the Wi-Fi upload (wifi_offload.c).
+ *
+ * A batch is a header and `count` records, either in their wire form back
+ * to back (RAW) or packed column by column (DELTA): every value of the
+ * record (array elements expanded, LOG_RECORD_FIELDS order) becomes one
+ * column of `count` zigzag varints, the first value as is and then the
+ * difference to the previous record. A zero difference is followed by a
+ * varint of how many more zeros follow, so a column that does not change
+ * over the batch costs three bytes. seq, timestamp and the cell voltages
+ * of consecutive samples move by a few counts, so most values take one
+ * byte or less. DELTA is used when it comes out smaller than RAW.
+ *
+ * Header, little-endian (LOG_PACK_HDR_LEN bytes):
+ *   u32 magic  LOG_PACK_MAGIC ("FSLB")
+ *   u8  format LOG_PACK_VERSION
+ *   u8  codec  LOG_PACK_RAW / LOG_PACK_DELTA
+ *   u8  LOG_RECORD_VERSION
+ *   u8  flags  LOG_PACK_F_*
+ *   u16 record size
+ *   u16 count
+ *   u32 from_seq   the upload offset this batch continues from; its records
+ *                  are the first `count` with seq >= from_seq
+ *   u32 last_seq   seq of the last record
+ *   u32 payload length
+ */
+#define LOG_PACK_MAGIC      0x424C5346u     // "FSLB"
+#define LOG_PACK_VERSION    1
+#define LOG_PACK_HDR_LEN    24
+
+#define LOG_PACK_RAW        0
+#define LOG_PACK_DELTA      1
+
+// from_seq is not the receiver's offset on purpose: the device's log was
+// reset (seqs start again), or the records before it reached the backend
+// another way (a phone relayed them). The receiver takes it as its offset.
+#define LOG_PACK_F_REBASE   0x01
+
+#define LOG_PACK_MAX_RECORDS  0xFFFF
+
+/** Batch buffer that always holds `n` records (RAW is the fallback). */
+#define LOG_PACK_BUF_SIZE(n)  (LOG_PACK_HDR_LEN + (size_t)(n) * LOG_RECORD_SIZE_BYTES)
+
+typedef struct {
+    uint8_t  codec;
+    uint8_t  record_version;
+    uint8_t  flags;
+    uint16_t record_size;
+    uint16_t count;
+    uint32_t from_seq;
+    uint32_t last_seq;
+    uint32_t payload_len;
+} log_pack_hdr_t;
+
+/**
+ * @brief Pack `n` records (1..LOG_PACK_MAX_RECORDS) into `out`: DELTA if it
+ *        fits and is smaller, else RAW.
+ * @return batch length, or -1 if not even RAW fits in `cap`
+ */
+int log_pack_batch(const battery_log_t *recs, int n, uint32_t from_seq, uint8_t flags,
+                   uint8_t *out, size_t cap);
+
+/**
+ * @brief Parse a batch header; `len` is what was received.
+ * @return 0, or -1 if it is not a batch of this record version or is
+ *         truncated
+ */
+int log_pack_parse_header(const uint8_t *in, size_t len, log_pack_hdr_t *hdr);
+
+/**
+ * @brief Unpack a whole batch (host tools and tests; the backend has its own
+ *        decoder, backend/utils/logBatch.js).
+ * @return records written to `recs` (the batch's count), or -1 if the batch
+ *         is malformed or holds more than `max`
+ */
+int log_pack_unpack(const uint8_t *in, size_t len, log_pack_hdr_t *hdr,
+                    battery_log_t *recs, int max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,95 @@
+#include "log_schema.h"
+
+#include <string.h>
+
+// Native <-> little-endian per type; on the ESP32 (and x86 hosts) the
+// compiler turns each into a plain load or store.
+static inline void put_le(uint8_t *p, uint32_t v, int size)
+{
+    for (int i = 0; i < size; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint32_t get_le(const uint8_t *p, int size)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < size; i++) v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+void log_record_encode(const battery_log_t *rec, uint8_t *out)
+{
+    const uint8_t *src = (const uint8_t *)rec;
+#define ENC(t, name, i) {                                                       \
+        const size_t off = offsetof(battery_log_t, name) + (i) * sizeof(LOG_CTYPE_##t); \
+        LOG_CTYPE_##t v;                                                        \
+        memcpy(&v, src + off, sizeof(v));                                       \
+        put_le(out + off, (uint32_t)v, sizeof(v));                              \
+    }
+#define FIELD(t, name, n, e, u) LOG_EACH_##n(ENC, t, name)
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+#undef ENC
+}
+
+void log_record_decode(const uint8_t *in, battery_log_t *rec)
+{
+    uint8_t *dst = (uint8_t *)rec;
+#define DEC(t, name, i) {                                                       \
+        const size_t off = offsetof(battery_log_t, name) + (i) * sizeof(LOG_CTYPE_##t); \
+        LOG_CTYPE_##t v = (LOG_CTYPE_##t)get_le(in + off, sizeof(v));           \
+        memcpy(dst + off, &v, sizeof(v));                                       \
+    }
+#define FIELD(t, name, n, e, u) LOG_EACH_##n(DEC, t, name)
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+#undef DEC
+}
+
+typedef struct {
+    uint8_t code;
+    uint8_t count;
+    uint8_t offset;
+    int8_t exp10;
+    const char *name;
+    const char *unit;
+} schema_field_t;
+
+static const schema_field_t s_schema[LOG_SCHEMA_FIELDS] = {
+#define FIELD(t, name, n, e, u) \
+    { LOG_TCODE_##t, (n), offsetof(battery_log_t, name), (e), #name, u },
+    LOG_RECORD_FIELDS(FIELD)
+#undef FIELD
+};
+
+static int put_str(uint8_t *buf, size_t len, size_t *pos, const char *s)
+{
+    size_t n = strlen(s) + 1;
+    if (*pos + n > len) return -1;
+    memcpy(buf + *pos, s, n);
+    *pos += n;
+    return 0;
+}
+
+int log_schema_table(uint8_t *buf, size_t len)
+{
+    if (!buf || len < 5) return -1;
+
+    buf[0] = LOG_SCHEMA_TABLE_VERSION;
+    buf[1] = LOG_RECORD_VERSION;
+    put_le(buf + 2, LOG_RECORD_SIZE_BYTES, 2);
+    buf[4] = LOG_SCHEMA_FIELDS;
+    size_t pos = 5;
+
+    for (int i = 0; i < LOG_SCHEMA_FIELDS; i++) {
+        const schema_field_t *f = &s_schema[i];
+        if (pos + 4 > len) return -1;
+        buf[pos++] = f->code;
+        buf[pos++] = f->count;
+        buf[pos++] = f->offset;
+        buf[pos++] = (uint8_t)f->exp10;
+        if (put_str(buf, len, &pos, f->name) != 0 || put_str(buf, len, &pos, f->unit) != 0) {
+            return -1;
+        }
+    }
+    return (int)pos;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Battery log record schema: the one definition of battery_log_t.
+ *
+ * LOG_RECORD_FIELDS lists the fields in record order as
+ *   X(type, name, count, exp10, unit)
+ * - type: U8 I8 U16 I16 U32 I32 (little-endian on the wire and on flash)
+ * - count: 1 for a scalar, N for an array (LOG_DIM_N / LOG_EACH_N must exist)
+ * - exp10, unit: value in `unit` = raw * 10^exp10 (mV -> V is -3)
+ *
+ * Everything else is generated from it: the packed struct and its size
+ * checks (here), log_field_t's value table (battery_log.c), the LE
+ * encode/decode and the field table the device advertises (log_schema.c,
+ * "Record Schema" characteristic), the host C++ view and column decoder
+ * (host/lib) and the Python / JS decoders (host/tools/log_schema_gen).
+ *
+ * Adding, removing or resizing a field changes the record: bump
+ * LOG_RECORD_VERSION and handle the old file (log_migrate.c).
+ */
+#define LOG_RECORD_FIELDS(X)                                                    \
+    X(U32, seq,                 1,   0, "")                                     \
+    X(U32, timestamp_s,         1,   0, "s")    /* Unix time */                 \
+    X(U16, cell_mv,             16, -3, "V")    /* per cell */                  \
+    X(U16, pack_total_mv,       1,  -3, "V")                                    \
+    X(U16, pack_ld_mv,          1,  -3, "V")    /* pack load drop */            \
+    X(U16, pack_sum_active_mv,  1,  -3, "V")                                    \
+    X(I16, current_ma,          1,  -3, "A")    /* + charging */                \
+    X(I16, temp_ts1_c_x100,     1,  -2, "C")    /* thermistor 1 */              \
+    X(I16, temp_int_c_x100,     1,  -2, "C")    /* BMS die */                   \
+    X(U8,  soc,                 1,   0, "%")                                    \
+    X(U16, interval_s,          1,   0, "s")    /* since previous, 0 = first */ \
+    X(U8,  rate,                1,   0, "")     /* sampler_rate_t, 0 = fixed */
+
+#define LOG_RECORD_VERSION 4
+
+// Type tags. The code in the field table is the size in the low nibble,
+// bit 7 set for signed types.
+#define LOG_CTYPE_U8    uint8_t
+#define LOG_CTYPE_I8    int8_t
+#define LOG_CTYPE_U16   uint16_t
+#define LOG_CTYPE_I16   int16_t
+#define LOG_CTYPE_U32   uint32_t
+#define LOG_CTYPE_I32   int32_t
+
+#define LOG_TCODE_U8    0x01
+#define LOG_TCODE_I8    0x81
+#define LOG_TCODE_U16   0x02
+#define LOG_TCODE_I16   0x82
+#define LOG_TCODE_U32   0x04
+#define LOG_TCODE_I32   0x84
+
+#define LOG_TCODE_SIZE(code)    ((code) & 0x0F)
+#define LOG_TCODE_SIGNED(code)  (((code) & 0x80) != 0)
+
+// Per count: the array declarator, and F(t, name, i) for every element.
+#define LOG_DIM_1
+#define LOG_DIM_16      [16]
+#define LOG_EACH_1(F, t, name)  F(t, name, 0)
+#define LOG_EACH_16(F, t, name)                                                 \
+    F(t, name, 0)  F(t, name, 1)  F(t, name, 2)  F(t, name, 3)                  \
+    F(t, name, 4)  F(t, name, 5)  F(t, name, 6)  F(t, name, 7)                  \
+    F(t, name, 8)  F(t, name, 9)  F(t, name, 10) F(t, name, 11)                 \
+    F(t, name, 12) F(t, name, 13) F(t, name, 14) F(t, name, 15)
+
+/**
+ * @brief Battery log record - packed struct for binary storage
+ *
+ * Its binary representation is written to and read from flash directly
+ * and sent as is in backlog frames; see LOG_RECORD_FIELDS.
+ */
+typedef struct __attribute__((packed)) {
+#define LOG_X_MEMBER(t, name, n, e, u) LOG_CTYPE_##t name LOG_DIM_##n;
+    LOG_RECORD_FIELDS(LOG_X_MEMBER)
+#undef LOG_X_MEMBER
+} battery_log_t;
+
+#define LOG_X_BYTES(t, name, n, e, u) + (int)sizeof(LOG_CTYPE_##t) * (n)
+#define LOG_X_VALUES(t, name, n, e, u) + (n)
+#define LOG_X_ONE(t, name, n, e, u) + 1
+
+#define LOG_RECORD_SIZE_BYTES   (0 LOG_RECORD_FIELDS(LOG_X_BYTES))     // 56
+#define LOG_SCHEMA_FIELDS       (0 LOG_RECORD_FIELDS(LOG_X_ONE))       // table entries
+#define LOG_SCHEMA_VALUES       (0 LOG_RECORD_FIELDS(LOG_X_VALUES))    // array elements counted
+
+#ifdef __cplusplus
+#define LOG_STATIC_ASSERT static_assert
+#else
+#define LOG_STATIC_ASSERT _Static_assert
+#endif
+
+LOG_STATIC_ASSERT(sizeof(battery_log_t) == LOG_RECORD_SIZE_BYTES,
+                  "battery_log_t size changed! Bump LOG_RECORD_VERSION and migrate/wipe battery.bin");
+LOG_STATIC_ASSERT(LOG_RECORD_SIZE_BYTES <= 255, "field table offsets are one byte");
+#define LOG_X_ASSERT(t, name, n, e, u)                                          \
+    LOG_STATIC_ASSERT(sizeof(((battery_log_t *)0)->name) == sizeof(LOG_CTYPE_##t) * (n), \
+                      "schema type of " #name);
+LOG_RECORD_FIELDS(LOG_X_ASSERT)
+#undef LOG_X_ASSERT
+
+/*
+ * Advertised field table (Record Schema characteristic), little-endian:
+ *   u8 table version (LOG_SCHEMA_TABLE_VERSION), u8 LOG_RECORD_VERSION,
+ *   u16 record size, u8 field count, then per field:
+ *   u8 type code, u8 count, u8 offset, i8 exp10, name\0, unit\0
+ */
+#define LOG_SCHEMA_TABLE_VERSION  1
+#define LOG_SCHEMA_TABLE_MAX      256
+
+/** Write the field table into buf; returns its length, or -1 if len is too small. */
+int log_schema_table(uint8_t *buf, size_t len);
+
+/** battery_log_t to its little-endian wire form (LOG_RECORD_SIZE_BYTES). */
+void log_record_encode(const battery_log_t *rec, uint8_t *out);
+
+/** Wire form back to battery_log_t. */
+void log_record_decode(const uint8_t *in, battery_log_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
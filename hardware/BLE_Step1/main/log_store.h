@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "battery_log.h"
+
+// Overridable so the same code can run against a host directory.
+#ifndef LOG_BASE_PATH
+#define LOG_BASE_PATH "/littlefs"
+#endif
+
+#define LOG_ROW_FILE  LOG_BASE_PATH "/battery.bin"
+#define LOG_NVS_NS    "blog"      // log format metadata and migration progress
+
+/**
+ * On-flash storage behind battery_log.c.
+ *
+ * battery_log.c owns the public API, seq allocation and the RAM stage; a
+ * store only persists whole records and reads them back. Indices are
+ * 0-based over the records on flash (staged records are not included).
+ * A store is only called with battery_log's lock held (battery_log_lock()),
+ * so it keeps cached handles and positions without locking of its own.
+ */
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void);                                 // mount-time recovery
+    int  (*count)(void);
+    int  (*append)(const battery_log_t *recs, int n);        // 0 / -1
+    bool (*read)(int index, battery_log_t *out);
+    int  (*read_field)(log_field_t field, int start, int n, void *out);  // values read / -1
+    int  (*find_seq)(uint32_t start_seq);                    // first index with seq >= start_seq
+    void (*wipe)(void);
+    void (*idle)(void);                                      // optional, may be NULL
+    bool evicts;                                             // append may drop the oldest records
+    uint32_t (*evicted)(void);                               // records dropped since boot; NULL if !evicts
+} log_store_t;
+
+extern const log_store_t log_store_row;
+extern const log_store_t log_store_columnar;
+extern const log_store_t log_store_partition;
+
+#define LOG_PART_LABEL "blog"
+
+/** True if the "blog" data partition exists in this partition table. */
+bool log_store_partition_present(void);
+
+typedef struct {
+    uint8_t offset;     // offsetof(battery_log_t, field)
+    uint8_t size;       // bytes per value
+} log_field_desc_t;
+
+const log_field_desc_t *log_field_desc(log_field_t field);
+
+/** Copy one field out of `n` row-layout records. */
+void log_extract_field(const battery_log_t *recs, int n, log_field_t field, void *out);
+
+/** Select the store (host tools / benchmarks); call before any other log API. */
+void battery_log_use_store(const log_store_t *store);
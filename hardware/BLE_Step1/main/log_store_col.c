@@ -0,0 +1,316 @@
+#include "log_store.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "file_pool.h"
+
+/*
+ * Columnar layout.
+ *
+ * battery.col is a sequence of fixed-size blocks of LOG_COL_BLOCK_RECORDS
+ * records. Inside a block the fields are stored column by column in record
+ * order, so field f of record i sits at
+ *
+ *     block_start + offsetof(f) * B + i * sizeof(f)
+ *
+ * Records go to the row-wise battery.tail until it holds a full block, which
+ * is then transposed and appended to battery.col, and the tail removed. If
+ * power fails between the two steps, init finds the tail's records already
+ * in the last block and drops the tail.
+ */
+
+static const char *TAG = "LOG_COL";
+
+#define COL_FILE     LOG_BASE_PATH "/battery.col"
+#define TAIL_FILE    LOG_BASE_PATH "/battery.tail"
+#define B            LOG_COL_BLOCK_RECORDS
+#define BLOCK_BYTES  ((size_t)B * sizeof(battery_log_t))
+#define TAIL_CHUNK   16
+
+static int s_blocks = 0;
+static int s_tail = 0;
+
+// One block: the read cache for row reads, and the transpose buffer on commit.
+static uint8_t s_blk[BLOCK_BYTES];
+static int s_blk_index = -1;
+
+static size_t col_offset(log_field_t field)
+{
+    return (size_t)log_field_desc(field)->offset * B;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : 0;
+}
+
+static int tail_read(int start, int n, battery_log_t *out)
+{
+    FILE *f = file_pool_open(TAIL_FILE, "rb");
+    if (!f) return -1;
+    int got = -1;
+    if (fseek(f, (long)start * (long)sizeof(battery_log_t), SEEK_SET) == 0) {
+        got = (int)fread(out, sizeof(battery_log_t), (size_t)n, f);
+    }
+    file_pool_close(f);
+    return got;
+}
+
+static bool load_block(int b)
+{
+    if (s_blk_index == b) return true;
+
+    FILE *f = file_pool_open(COL_FILE, "rb");
+    if (!f) return false;
+    bool ok = fseek(f, (long)b * (long)BLOCK_BYTES, SEEK_SET) == 0 &&
+              fread(s_blk, 1, BLOCK_BYTES, f) == BLOCK_BYTES;
+    file_pool_close(f);
+
+    s_blk_index = ok ? b : -1;
+    return ok;
+}
+
+static int commit_block(void)
+{
+    // Rows in, columns out, through the same buffer.
+    s_blk_index = -1;
+    if (tail_read(0, B, (battery_log_t *)s_blk) != B) {
+        ESP_LOGE(TAG, "tail read failed before commit");
+        return -1;
+    }
+
+    FILE *f = file_pool_open(COL_FILE, "ab");
+    if (!f) {
+        ESP_LOGE(TAG, "open %s failed errno=%d (%s)", COL_FILE, errno, strerror(errno));
+        return -1;
+    }
+
+    const battery_log_t *rows = (const battery_log_t *)s_blk;
+    uint8_t col[4 * B];
+    bool ok = true;
+    for (int fld = 0; fld < LOG_FIELD_COUNT && ok; fld++) {
+        log_extract_field(rows, B, (log_field_t)fld, col);
+        size_t len = (size_t)log_field_desc((log_field_t)fld)->size * B;
+        ok = fwrite(col, 1, len, f) == len;
+    }
+    ok = (fflush(f) == 0) && ok;
+    file_pool_close(f);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "block write failed errno=%d (%s)", errno, strerror(errno));
+        truncate(COL_FILE, (off_t)s_blocks * (off_t)BLOCK_BYTES);
+        return -1;
+    }
+
+    unlink(TAIL_FILE);
+    s_blocks++;
+    s_tail = 0;
+    return 0;
+}
+
+static esp_err_t col_init(void)
+{
+    s_blk_index = -1;
+
+    long col_sz = file_size(COL_FILE);
+    s_blocks = (int)(col_sz / (long)BLOCK_BYTES);
+    if (col_sz % (long)BLOCK_BYTES) {
+        ESP_LOGW(TAG, "dropping torn block (%ld bytes)", col_sz % (long)BLOCK_BYTES);
+        truncate(COL_FILE, (off_t)s_blocks * (off_t)BLOCK_BYTES);
+    }
+
+    long tail_sz = file_size(TAIL_FILE);
+    s_tail = (int)(tail_sz / (long)sizeof(battery_log_t));
+    if (tail_sz % (long)sizeof(battery_log_t)) {
+        truncate(TAIL_FILE, (off_t)s_tail * (off_t)sizeof(battery_log_t));
+    }
+
+    if (s_blocks > 0 && s_tail > 0) {
+        uint32_t last_seq = 0;
+        battery_log_t first;
+        FILE *f = file_pool_open(COL_FILE, "rb");
+        bool have_last = f &&
+            fseek(f, (long)(s_blocks - 1) * (long)BLOCK_BYTES +
+                     (long)col_offset(LOG_FIELD_SEQ) + (long)(B - 1) * 4, SEEK_SET) == 0 &&
+            fread(&last_seq, sizeof(last_seq), 1, f) == 1;
+        if (f) file_pool_close(f);
+
+        if (have_last && tail_read(0, 1, &first) == 1 && first.seq <= last_seq) {
+            ESP_LOGW(TAG, "tail already committed (seq %" PRIu32 " <= %" PRIu32 "), removing",
+                     first.seq, last_seq);
+            unlink(TAIL_FILE);
+            s_tail = 0;
+        }
+    }
+
+    if (s_tail >= B && commit_block() != 0) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "columnar log: %d block(s) + %d tail record(s)", s_blocks, s_tail);
+    return ESP_OK;
+}
+
+static int col_count(void)
+{
+    return s_blocks * B + s_tail;
+}
+
+static int col_append(const battery_log_t *recs, int n)
+{
+    while (n > 0) {
+        if (s_tail >= B && commit_block() != 0) return -1;
+
+        int k = (B - s_tail) < n ? (B - s_tail) : n;
+        FILE *f = file_pool_open(TAIL_FILE, "ab");
+        if (!f) {
+            ESP_LOGE(TAG, "open %s failed errno=%d (%s)", TAIL_FILE, errno, strerror(errno));
+            return -1;
+        }
+        size_t wrote = fwrite(recs, sizeof(battery_log_t), (size_t)k, f);
+        fflush(f);
+        file_pool_close(f);
+        if (wrote != (size_t)k) {
+            truncate(TAIL_FILE, (off_t)s_tail * (off_t)sizeof(battery_log_t));
+            return -1;
+        }
+
+        s_tail += k;
+        recs += k;
+        n -= k;
+
+        if (s_tail == B && commit_block() != 0) return -1;
+    }
+    return 0;
+}
+
+static bool col_read(int index, battery_log_t *out)
+{
+    int b = index / B;
+    if (b >= s_blocks) {
+        return tail_read(index - s_blocks * B, 1, out) == 1;
+    }
+    if (!load_block(b)) return false;
+
+    int i = index % B;
+    uint8_t *dst = (uint8_t *)out;
+    for (int fld = 0; fld < LOG_FIELD_COUNT; fld++) {
+        const log_field_desc_t *d = log_field_desc((log_field_t)fld);
+        memcpy(dst + d->offset, s_blk + (size_t)d->offset * B + (size_t)i * d->size, d->size);
+    }
+    return true;
+}
+
+static int col_read_field(log_field_t field, int start, int n, void *out)
+{
+    size_t vsz = log_field_desc(field)->size;
+    size_t coff = col_offset(field);
+    uint8_t *dst = (uint8_t *)out;
+    int total = col_count();
+    if (start + n > total) n = total - start;
+    if (n <= 0) return 0;
+
+    int done = 0;
+    FILE *f = NULL;
+
+    // Whole-block part: one contiguous read per block.
+    while (done < n && (start + done) / B < s_blocks) {
+        int idx = start + done;
+        int b = idx / B, i = idx % B;
+        int cnt = B - i < n - done ? B - i : n - done;
+        size_t len = (size_t)cnt * vsz;
+
+        if (b == s_blk_index) {
+            memcpy(dst + (size_t)done * vsz, s_blk + coff + (size_t)i * vsz, len);
+        } else {
+            if (!f && !(f = file_pool_open(COL_FILE, "rb"))) return done ? done : -1;
+            long off = (long)b * (long)BLOCK_BYTES + (long)coff + (long)i * (long)vsz;
+            if (fseek(f, off, SEEK_SET) != 0 || fread(dst + (size_t)done * vsz, 1, len, f) != len) {
+                file_pool_close(f);
+                return done ? done : -1;
+            }
+        }
+        done += cnt;
+    }
+    if (f) file_pool_close(f);
+
+    // Tail part: rows.
+    battery_log_t chunk[TAIL_CHUNK];
+    while (done < n) {
+        int want = n - done < TAIL_CHUNK ? n - done : TAIL_CHUNK;
+        int got = tail_read(start + done - s_blocks * B, want, chunk);
+        if (got <= 0) break;
+        log_extract_field(chunk, got, field, dst + (size_t)done * vsz);
+        done += got;
+    }
+    return done;
+}
+
+static bool block_seqs(FILE *f, int b, int i, int n, uint32_t *out)
+{
+    long off = (long)b * (long)BLOCK_BYTES + (long)col_offset(LOG_FIELD_SEQ) + (long)i * 4;
+    return fseek(f, off, SEEK_SET) == 0 && fread(out, 4, (size_t)n, f) == (size_t)n;
+}
+
+static int col_find_seq(uint32_t start_seq)
+{
+    uint32_t seqs[B];
+
+    if (s_blocks > 0) {
+        FILE *f = file_pool_open(COL_FILE, "rb");
+        if (!f) return 0;
+
+        // Blocks by their first seq, then within the block before the split.
+        int lo = 0, hi = s_blocks;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            uint32_t first;
+            if (!block_seqs(f, mid, 0, 1, &first)) { file_pool_close(f); return 0; }
+            if (first < start_seq) lo = mid + 1; else hi = mid;
+        }
+
+        if (lo == 0) { file_pool_close(f); return 0; }
+        bool ok = block_seqs(f, lo - 1, 0, B, seqs);
+        file_pool_close(f);
+        if (!ok) return 0;
+
+        for (int i = 0; i < B; i++) {
+            if (seqs[i] >= start_seq) return (lo - 1) * B + i;
+        }
+        if (lo < s_blocks) return lo * B;
+    }
+
+    // Past the last block: the tail.
+    int base = s_blocks * B;
+    int n = col_read_field(LOG_FIELD_SEQ, base, s_tail, seqs);
+    for (int i = 0; i < n; i++) {
+        if (seqs[i] >= start_seq) return base + i;
+    }
+    return col_count();
+}
+
+static void col_wipe(void)
+{
+    unlink(COL_FILE);
+    unlink(TAIL_FILE);
+    s_blocks = 0;
+    s_tail = 0;
+    s_blk_index = -1;
+}
+
+const log_store_t log_store_columnar = {
+    .name = "columnar",
+    .init = col_init,
+    .count = col_count,
+    .append = col_append,
+    .read = col_read,
+    .read_field = col_read_field,
+    .find_seq = col_find_seq,
+    .wipe = col_wipe,
+};
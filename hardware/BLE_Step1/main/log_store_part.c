@@ -0,0 +1,431 @@
+#include "log_store.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "ble_stats.h"
+
+/*
+ * Circular log in a raw data partition.
+ *
+ * The partition is a ring of 4 KB sectors. Each sector starts with a header
+ * slot (sector sequence number, erase count) followed by record slots of
+ * PART_SLOT bytes: the record and its CRC, padded to a whole number of flash
+ * program units so every record is one aligned write. A sector is only ever
+ * erased as a whole, when the ring needs it, and its next sector is erased
+ * ahead of time from battery_log_idle() so an append never waits for an
+ * erase. When the ring is full, preparing a sector drops the oldest one.
+ *
+ * Mount rebuilds the ring from the headers (the newest is the highest
+ * sequence, the oldest is where consecutive sequences stop going back) and
+ * from the slots: an erased slot ends a sector, a slot with a bad CRC (torn
+ * write) closes it. Reads go straight through a memory mapping of the
+ * partition.
+ */
+
+static const char *TAG = "LOG_PART";
+
+#define PART_SECTOR          4096
+#define PART_PROGRAM_UNIT    16     // write granularity with flash encryption
+#define PART_SLOT            64
+#define PART_SLOTS           (PART_SECTOR / PART_SLOT - 1)   // first slot is the header
+#define PART_MAX_SECTORS     256
+#define PART_MAGIC           0x31474C42u   // 'BLG1'
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t sector_seq;        // +1 for every sector opened
+    uint32_t erase_count;       // erases of this sector, carried across erases
+    uint16_t rec_size;
+    uint16_t slot_size;
+    uint32_t crc;               // over the fields above
+    uint8_t  _rsv[PART_SLOT - 20];
+} part_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    battery_log_t rec;
+    uint32_t crc;               // over rec
+    uint8_t  _rsv[PART_SLOT - sizeof(battery_log_t) - 4];
+} part_slot_t;
+
+_Static_assert(sizeof(part_hdr_t) == PART_SLOT, "header must fill one slot");
+_Static_assert(sizeof(part_slot_t) == PART_SLOT, "record must fill one slot");
+_Static_assert(PART_SLOT % PART_PROGRAM_UNIT == 0, "slot must be whole program units");
+
+static const esp_partition_t *s_part = NULL;
+static const uint8_t *s_map = NULL;
+static esp_partition_mmap_handle_t s_map_handle;
+
+static int s_nsec = 0;
+static int s_tail = 0;              // oldest sector in the ring
+static int s_used = 0;              // sectors in the ring, tail first
+static int s_wr = 0;                // sector being appended to
+static uint32_t s_last_seq = 0;     // sector_seq of the newest sector
+static int s_count = 0;
+
+static uint8_t s_fill[PART_MAX_SECTORS];     // valid records per sector
+static bool s_closed[PART_MAX_SECTORS];      // torn slot or write error: no more appends
+
+static uint32_t s_ec_min = 0, s_ec_max = 0;
+static uint32_t s_pre_erase = 0;    // sectors prepared from idle
+static uint32_t s_inline_erase = 0; // ... and on the append path
+static uint32_t s_dropped = 0;      // records overwritten by the ring
+
+// Sequential reads resume the sector walk where the last one ended.
+static int s_walk_sec = -1, s_walk_base = 0;
+
+static int ring_at(int k)      { return (s_tail + k) % s_nsec; }
+static int ring_last(void)     { return ring_at(s_used - 1); }
+
+static const part_hdr_t *hdr_at(int sec)
+{
+    return (const part_hdr_t *)(s_map + (size_t)sec * PART_SECTOR);
+}
+
+static const part_slot_t *slot_at(int sec, int i)
+{
+    return (const part_slot_t *)(s_map + (size_t)sec * PART_SECTOR + (size_t)(i + 1) * PART_SLOT);
+}
+
+static bool hdr_valid(const part_hdr_t *h)
+{
+    return h->magic == PART_MAGIC && h->rec_size == sizeof(battery_log_t) &&
+           h->slot_size == PART_SLOT &&
+           h->crc == esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(part_hdr_t, crc));
+}
+
+static bool slot_erased(const void *slot)
+{
+    const uint32_t *w = (const uint32_t *)slot;    // slots are 64-byte aligned
+    for (size_t i = 0; i < PART_SLOT / 4; i++) {
+        if (w[i] != 0xFFFFFFFFu) return false;
+    }
+    return true;
+}
+
+static uint32_t rec_crc(const battery_log_t *rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, sizeof(*rec));
+}
+
+static bool part_open(void)
+{
+    if (s_map) return true;
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      LOG_PART_LABEL);
+    if (!s_part) return false;
+
+    s_nsec = (int)(s_part->size / PART_SECTOR);
+    if (s_nsec > PART_MAX_SECTORS) s_nsec = PART_MAX_SECTORS;
+    if (s_nsec < 2) {
+        ESP_LOGE(TAG, "partition %s too small (%" PRIu32 " bytes)", LOG_PART_LABEL, s_part->size);
+        s_part = NULL;
+        return false;
+    }
+
+    const void *ptr = NULL;
+    esp_err_t err = esp_partition_mmap(s_part, 0, (size_t)s_nsec * PART_SECTOR,
+                                       ESP_PARTITION_MMAP_DATA, &ptr, &s_map_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mmap failed: %s", esp_err_to_name(err));
+        s_part = NULL;
+        return false;
+    }
+    s_map = (const uint8_t *)ptr;
+    return true;
+}
+
+bool log_store_partition_present(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                    LOG_PART_LABEL) != NULL;
+}
+
+// ---------------------------------------------------------------- ring
+
+/** Erase the sector after the newest one and open it with a fresh header. */
+static esp_err_t prepare_next(void)
+{
+    int sec = s_used ? (ring_last() + 1) % s_nsec : s_tail;
+
+    if (s_used == s_nsec) {
+        // Ring full: the sector to erase is the oldest one.
+        s_count -= s_fill[s_tail];
+        s_dropped += s_fill[s_tail];
+        s_tail = (s_tail + 1) % s_nsec;
+        s_used--;
+    }
+
+    const part_hdr_t *old = hdr_at(sec);
+    uint32_t ec = hdr_valid(old) ? old->erase_count : s_ec_max;
+
+    s_walk_sec = -1;
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)sec * PART_SECTOR, PART_SECTOR);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "erase sector %d failed: %s", sec, esp_err_to_name(err));
+        return err;
+    }
+
+    part_hdr_t h;
+    memset(&h, 0xFF, sizeof(h));
+    h.magic = PART_MAGIC;
+    h.sector_seq = s_used ? s_last_seq + 1 : s_last_seq;
+    h.erase_count = ec + 1;
+    h.rec_size = sizeof(battery_log_t);
+    h.slot_size = PART_SLOT;
+    h.crc = esp_rom_crc32_le(0, (const uint8_t *)&h, offsetof(part_hdr_t, crc));
+
+    err = esp_partition_write(s_part, (size_t)sec * PART_SECTOR, &h, sizeof(h));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "header write sector %d failed: %s", sec, esp_err_to_name(err));
+        return err;
+    }
+
+    if (s_used == 0) s_tail = sec;
+    s_used++;
+    s_last_seq = h.sector_seq;
+    s_fill[sec] = 0;
+    s_closed[sec] = false;
+    if (h.erase_count > s_ec_max) s_ec_max = h.erase_count;
+    if (s_ec_min == 0 || h.erase_count < s_ec_min) s_ec_min = h.erase_count;
+    return ESP_OK;
+}
+
+static int scan_sector(int sec, bool *closed)
+{
+    int n = 0;
+    *closed = false;
+    while (n < PART_SLOTS) {
+        const part_slot_t *s = slot_at(sec, n);
+        if (slot_erased(s)) break;
+        if (s->crc != rec_crc(&s->rec)) {
+            *closed = true;
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+static int part_stats_section(char *buf, size_t len)
+{
+    return snprintf(buf, len,
+                    "sectors=%d,used=%d,records=%d,wr=%d,ec_min=%" PRIu32 ",ec_max=%" PRIu32
+                    ",pre_erase=%" PRIu32 ",inline_erase=%" PRIu32 ",dropped=%" PRIu32,
+                    s_nsec, s_used, s_count, s_wr, s_ec_min, s_ec_max,
+                    s_pre_erase, s_inline_erase, s_dropped);
+}
+
+static esp_err_t part_init(void)
+{
+    static bool registered = false;
+    if (!part_open()) {
+        ESP_LOGW(TAG, "no \"%s\" partition", LOG_PART_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!registered) {
+        ble_stats_register_section("part", part_stats_section);
+        registered = true;
+    }
+
+    // Newest sector, and the erase count range.
+    int newest = -1;
+    s_ec_min = 0;
+    s_ec_max = 0;
+    for (int sec = 0; sec < s_nsec; sec++) {
+        const part_hdr_t *h = hdr_at(sec);
+        if (!hdr_valid(h)) continue;
+        if (newest < 0 || (int32_t)(h->sector_seq - hdr_at(newest)->sector_seq) > 0) newest = sec;
+        if (h->erase_count > s_ec_max) s_ec_max = h->erase_count;
+        if (s_ec_min == 0 || h->erase_count < s_ec_min) s_ec_min = h->erase_count;
+    }
+
+    s_count = 0;
+    s_used = 0;
+    s_walk_sec = -1;
+    memset(s_fill, 0, sizeof(s_fill));
+    memset(s_closed, 0, sizeof(s_closed));
+
+    if (newest < 0) {
+        s_last_seq = 0;
+        s_tail = 0;
+        esp_err_t err = prepare_next();
+        s_wr = s_tail;
+        ESP_LOGI(TAG, "empty ring of %d sectors", s_nsec);
+        return err;
+    }
+
+    // Walk back while the sequence numbers stay consecutive.
+    s_last_seq = hdr_at(newest)->sector_seq;
+    int sec = newest;
+    uint32_t want = s_last_seq;
+    while (s_used < s_nsec && hdr_valid(hdr_at(sec)) && hdr_at(sec)->sector_seq == want) {
+        bool closed;
+        s_fill[sec] = (uint8_t)scan_sector(sec, &closed);
+        s_closed[sec] = closed;
+        s_count += s_fill[sec];
+        s_tail = sec;
+        s_used++;
+        sec = (sec + s_nsec - 1) % s_nsec;
+        want--;
+    }
+    s_wr = newest;
+
+    ESP_LOGI(TAG, "ring: %d/%d sector(s), %d record(s), erase count %" PRIu32 "..%" PRIu32,
+             s_used, s_nsec, s_count, s_ec_min, s_ec_max);
+    return ESP_OK;
+}
+
+static int part_count(void)
+{
+    return s_count;
+}
+
+static int part_append(const battery_log_t *recs, int n)
+{
+    if (!s_map) return -1;
+
+    for (int i = 0; i < n; i++) {
+        if (s_fill[s_wr] >= PART_SLOTS || s_closed[s_wr]) {
+            if (s_wr == ring_last()) {
+                s_inline_erase++;
+                if (prepare_next() != ESP_OK) return -1;
+            }
+            s_wr = (s_wr + 1) % s_nsec;
+        }
+
+        part_slot_t slot;
+        memset(&slot, 0xFF, sizeof(slot));
+        slot.rec = recs[i];
+        slot.crc = rec_crc(&recs[i]);
+
+        size_t off = (size_t)s_wr * PART_SECTOR + (size_t)(s_fill[s_wr] + 1) * PART_SLOT;
+        esp_err_t err = esp_partition_write(s_part, off, &slot, sizeof(slot));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "write at 0x%x failed: %s", (unsigned)off, esp_err_to_name(err));
+            s_closed[s_wr] = true;      // the slot may be half-programmed
+            return -1;
+        }
+        s_fill[s_wr]++;
+        s_count++;
+    }
+    return 0;
+}
+
+static uint32_t part_evicted(void)
+{
+    return s_dropped;
+}
+
+static void part_idle(void)
+{
+    if (s_map && s_wr == ring_last()) {
+        if (prepare_next() == ESP_OK) s_pre_erase++;
+    }
+}
+
+/** Sector holding record `index`; `*slot` is its slot in that sector. */
+static int locate(int index, int *slot)
+{
+    int k = 0, base = 0;
+    if (s_walk_sec >= 0 && index >= s_walk_base) {
+        k = s_walk_sec;
+        base = s_walk_base;
+    }
+    for (; k < s_used; k++) {
+        int fill = s_fill[ring_at(k)];
+        if (index < base + fill) {
+            s_walk_sec = k;
+            s_walk_base = base;
+            *slot = index - base;
+            return ring_at(k);
+        }
+        base += fill;
+    }
+    return -1;
+}
+
+static bool part_read(int index, battery_log_t *out)
+{
+    int slot;
+    if (index < 0 || index >= s_count) return false;
+    int sec = locate(index, &slot);
+    if (sec < 0) return false;
+    memcpy(out, &slot_at(sec, slot)->rec, sizeof(*out));
+    return true;
+}
+
+static int part_read_field(log_field_t field, int start, int n, void *out)
+{
+    if (start < 0) return -1;
+    if (start + n > s_count) n = s_count - start;
+    if (n <= 0) return 0;
+
+    const log_field_desc_t *d = log_field_desc(field);
+    uint8_t *dst = (uint8_t *)out;
+    int slot;
+    int sec = locate(start, &slot);
+    int k = s_walk_sec;
+    int done = 0;
+
+    while (done < n && sec >= 0) {
+        int take = s_fill[sec] - slot;
+        if (take > n - done) take = n - done;
+        const uint8_t *src = (const uint8_t *)&slot_at(sec, slot)->rec + d->offset;
+        for (int i = 0; i < take; i++) {
+            memcpy(dst, src, d->size);
+            dst += d->size;
+            src += PART_SLOT;
+        }
+        done += take;
+        slot = 0;
+        sec = (++k < s_used) ? ring_at(k) : -1;
+    }
+    return done;
+}
+
+static int part_find_seq(uint32_t start_seq)
+{
+    int lo = 0, hi = s_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int slot;
+        int sec = locate(mid, &slot);
+        if (sec < 0) break;
+        if (slot_at(sec, slot)->rec.seq < start_seq) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static void part_wipe(void)
+{
+    if (!part_open()) return;
+
+    for (int sec = 0; sec < s_nsec; sec++) {
+        const part_hdr_t *h = hdr_at(sec);
+        if (hdr_valid(h) || !slot_erased(h)) {
+            esp_partition_erase_range(s_part, (size_t)sec * PART_SECTOR, PART_SECTOR);
+        }
+    }
+    s_used = 0;
+    s_count = 0;
+    s_walk_sec = -1;
+}
+
+const log_store_t log_store_partition = {
+    .name = "partition",
+    .init = part_init,
+    .count = part_count,
+    .append = part_append,
+    .read = part_read,
+    .read_field = part_read_field,
+    .find_seq = part_find_seq,
+    .wipe = part_wipe,
+    .idle = part_idle,
+    .evicts = true,
+    .evicted = part_evicted,
+};
@@ -0,0 +1,237 @@
+#include "log_store.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "file_pool.h"
+
+// Records back to back in battery.bin: the original layout.
+
+static const char *TAG = "BATTERY_LOG";
+static const char *LOG_FILE = LOG_ROW_FILE;
+
+#define ROW_SCAN_CHUNK 16   // records per fread in field scans (896 B of stack)
+
+// One handle stays open for reads and appends: the backlog sender reads
+// records in order, so most reads are a single fread with no open/seek/
+// close, and a flush is a write + fsync on the same stream. It is opened
+// read-only until the first append. Anything that replaces battery.bin
+// (wipe, init before a migration swap) closes it first. The stream buffer
+// comes from file_pool, so neither path touches the heap.
+//
+// The handle and s_rd_pos are shared by every caller, whichever task it
+// runs on: they are only safe because battery_log.c calls the store with
+// its lock held (log_store.h). Nothing here may be called around it.
+static FILE *s_f = NULL;
+static bool s_f_writable = false;
+static off_t s_rd_pos = -1;         // offset of the next fread, -1 if unknown
+
+static void log_close(void)
+{
+    if (s_f) {
+        file_pool_close(s_f);
+        s_f = NULL;
+    }
+    s_f_writable = false;
+    s_rd_pos = -1;
+}
+
+static FILE *log_handle(bool write)
+{
+    if (s_f && (s_f_writable || !write)) {
+        return s_f;
+    }
+    log_close();
+    s_f = file_pool_open(LOG_FILE, write ? "a+b" : "rb");
+    s_f_writable = write && s_f;
+    return s_f;
+}
+
+static esp_err_t row_init(void)
+{
+    log_close();
+    return ESP_OK;
+}
+
+static int row_append(const battery_log_t *recs, int n)
+{
+    FILE *f = log_handle(true);
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s for append: errno=%d (%s)",
+                 LOG_FILE, errno, strerror(errno));
+        return -1;
+    }
+
+    // Append mode writes at the end anyway; the seek is the switch from
+    // reading to writing that stdio requires.
+    s_rd_pos = -1;
+    size_t want = (size_t)n * sizeof(battery_log_t);
+    size_t wrote = fseeko(f, 0, SEEK_END) == 0 ? fwrite(recs, 1, want, f) : 0;
+    if (wrote != want) {
+        ESP_LOGE(TAG, "Partial/failed write: wrote=%u expected=%u errno=%d (%s)",
+                 (unsigned)wrote, (unsigned)want, errno, strerror(errno));
+        log_close();
+        return -1;
+    }
+
+    // ensure data written to LITTLEFS (what fclose() used to do)
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) {
+        ESP_LOGE(TAG, "flush/sync failed errno=%d (%s)", errno, strerror(errno));
+        log_close();
+        return -1;
+    }
+    return 0;
+}
+
+static int row_count(void)
+{
+    struct stat st;
+    int ret = stat(LOG_FILE, &st);
+    if (ret != 0) {
+        // File doesn't exist yet or stat failed - treat as 0 records
+        if (errno == ENOENT) {
+            ESP_LOGD(TAG, "Log file does not exist yet: %s", LOG_FILE);
+            return 0;
+        } else {
+            ESP_LOGW(TAG, "stat(%s) failed: errno=%d (%s)", LOG_FILE, errno, strerror(errno));
+            return 0;
+        }
+    }
+
+    if (st.st_size < (off_t)sizeof(battery_log_t)) {
+        // File present but too small to contain a full record -> treat as 0
+        ESP_LOGW(TAG, "Log file too small: size=%" PRIiMAX, (intmax_t)st.st_size);
+        return 0;
+    }
+
+    int count = (int)(st.st_size / (off_t)sizeof(battery_log_t));
+    ESP_LOGD(TAG, "Log file size: %" PRIiMAX " bytes, record count: %d",
+             (intmax_t)st.st_size, count);
+    return count;
+}
+
+static bool row_read(int index, battery_log_t *out)
+{
+    FILE *f = log_handle(false);
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s for read: errno=%d (%s)",
+                 LOG_FILE, errno, strerror(errno));
+        return false;
+    }
+
+    // compute offset and seek (only when not reading in order)
+    off_t offset = (off_t)index * (off_t)sizeof(battery_log_t);
+    if (offset != s_rd_pos && fseeko(f, offset, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "fseeko failed offset=%" PRIiMAX " errno=%d (%s)",
+                 (intmax_t)offset, errno, strerror(errno));
+        log_close();
+        return false;
+    }
+
+    size_t nr = fread(out, 1, sizeof(battery_log_t), f);
+    if (nr != sizeof(battery_log_t)) {
+        ESP_LOGE(TAG, "fread failed or partial read: got=%u want=%u errno=%d (%s)",
+                 (unsigned)nr, (unsigned)sizeof(battery_log_t), errno, strerror(errno));
+        log_close();
+        return false;
+    }
+
+    s_rd_pos = offset + (off_t)sizeof(battery_log_t);
+    return true;
+}
+
+// Row layout has no shortcut: every record is read whole.
+static int row_read_field(log_field_t field, int start, int n, void *out)
+{
+    FILE *f = log_handle(false);
+    if (!f) return -1;
+
+    s_rd_pos = -1;
+    if (fseeko(f, (off_t)start * (off_t)sizeof(battery_log_t), SEEK_SET) != 0) {
+        log_close();
+        return -1;
+    }
+
+    size_t vsz = log_field_desc(field)->size;
+    uint8_t *dst = (uint8_t *)out;
+    battery_log_t chunk[ROW_SCAN_CHUNK];
+    int done = 0;
+
+    while (done < n) {
+        int want = n - done < ROW_SCAN_CHUNK ? n - done : ROW_SCAN_CHUNK;
+        int got = (int)fread(chunk, sizeof(battery_log_t), (size_t)want, f);
+        if (got <= 0) break;
+        log_extract_field(chunk, got, field, dst + (size_t)done * vsz);
+        done += got;
+        if (got < want) break;
+    }
+    clearerr(f);    // a short scan leaves EOF set; the next read seeks anyway
+    return done;
+}
+
+static int row_find_seq(uint32_t start_seq)
+{
+    int count = row_count();
+    if (count <= 0) return 0;
+
+    FILE *f = log_handle(false);
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s for seq search: errno=%d (%s)",
+                 LOG_FILE, errno, strerror(errno));
+        return 0;
+    }
+    s_rd_pos = -1;
+
+    int lo = 0;
+    int hi = count;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        off_t offset = (off_t)mid * (off_t)sizeof(battery_log_t);
+        if (fseeko(f, offset, SEEK_SET) != 0) {
+            ESP_LOGE(TAG, "fseeko failed mid=%d offset=%" PRIiMAX " errno=%d (%s)",
+                     mid, (intmax_t)offset, errno, strerror(errno));
+            log_close();
+            return 0;
+        }
+
+        battery_log_t rec;
+        size_t nr = fread(&rec, 1, sizeof(rec), f);
+        if (nr != sizeof(rec)) {
+            ESP_LOGE(TAG, "fread failed mid=%d got=%u want=%u errno=%d (%s)",
+                     mid, (unsigned)nr, (unsigned)sizeof(rec), errno, strerror(errno));
+            log_close();
+            return 0;
+        }
+
+        if (rec.seq < start_seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static void row_wipe(void)
+{
+    log_close();
+    unlink(LOG_FILE);
+}
+
+const log_store_t log_store_row = {
+    .name = "row",
+    .init = row_init,
+    .count = row_count,
+    .append = row_append,
+    .read = row_read,
+    .read_field = row_read_field,
+    .find_seq = row_find_seq,
+    .wipe = row_wipe,
+};
@@ -0,0 +1,128 @@
+#include "mem_plan.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "ble_stats.h"
+#include "file_pool.h"
+
+static const char *TAG = "MEM_PLAN";
+
+typedef struct {
+    TaskHandle_t task;
+    uint32_t stack_bytes;
+} watched_task_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static watched_task_t s_tasks[MEM_PLAN_MAX_TASKS];
+static int s_task_count = 0;
+
+static bool s_boot_done = false;
+static uint32_t s_boot_blocks = 0;
+static volatile uint32_t s_alloc_failed = 0;
+static volatile uint32_t s_alloc_failed_after_boot = 0;
+static volatile uint32_t s_last_failed_size = 0;
+
+// Called from the allocator, possibly with interrupts off: count only.
+static void alloc_failed_hook(size_t size, uint32_t caps, const char *function_name)
+{
+    (void)caps;
+    (void)function_name;
+    s_alloc_failed++;
+    if (s_boot_done) s_alloc_failed_after_boot++;
+    s_last_failed_size = (uint32_t)size;
+}
+
+void mem_plan_get_heap(mem_plan_heap_t *out)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+    memset(out, 0, sizeof(*out));
+    out->free_bytes = (uint32_t)info.total_free_bytes;
+    out->min_free_bytes = (uint32_t)info.minimum_free_bytes;
+    out->largest_free = (uint32_t)info.largest_free_block;
+    out->alloc_blocks = (uint32_t)info.allocated_blocks;
+    out->blocks_since_boot = s_boot_done ? (int32_t)(out->alloc_blocks - s_boot_blocks) : 0;
+    out->frag_permille = out->free_bytes
+        ? (uint16_t)(1000u - (uint32_t)((uint64_t)out->largest_free * 1000u / out->free_bytes))
+        : 0;
+    out->alloc_failed = s_alloc_failed;
+}
+
+static int mem_stats_section(char *buf, size_t len)
+{
+    mem_plan_heap_t h;
+    mem_plan_get_heap(&h);
+    file_pool_stats_t fp;
+    file_pool_get_stats(&fp);
+
+    return snprintf(buf, len,
+                    "free=%" PRIu32 ",min_free=%" PRIu32 ",largest=%" PRIu32 ",frag=%u"
+                    ",blocks=%" PRIu32 ",blk_boot=%" PRId32 ",afail=%" PRIu32 "/%" PRIu32
+                    ",afail_sz=%" PRIu32 ",fbuf=%u/%d,fbuf_peak=%u,fbuf_fb=%" PRIu32,
+                    h.free_bytes, h.min_free_bytes, h.largest_free, (unsigned)h.frag_permille,
+                    h.alloc_blocks, h.blocks_since_boot, h.alloc_failed, s_alloc_failed_after_boot,
+                    s_last_failed_size, fp.in_use, FILE_POOL_BUFS, fp.peak, fp.fallback);
+}
+
+// name=peak/size per task, bytes (ESP-IDF stacks are sized in bytes).
+static int stacks_stats_section(char *buf, size_t len)
+{
+    watched_task_t tasks[MEM_PLAN_MAX_TASKS];
+    portENTER_CRITICAL(&s_lock);
+    int count = s_task_count;
+    memcpy(tasks, s_tasks, sizeof(tasks));
+    portEXIT_CRITICAL(&s_lock);
+
+    int n = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < count && (size_t)n < len; i++) {
+        uint32_t hwm = (uint32_t)uxTaskGetStackHighWaterMark(tasks[i].task);
+        uint32_t peak = tasks[i].stack_bytes > hwm ? tasks[i].stack_bytes - hwm : 0;
+        int w = snprintf(buf + n, len - (size_t)n, "%s%s=%" PRIu32 "/%" PRIu32,
+                         i ? "," : "", pcTaskGetName(tasks[i].task), peak, tasks[i].stack_bytes);
+        if (w < 0) break;
+        n += w;
+    }
+    return n;
+}
+
+void mem_plan_init(void)
+{
+    static bool s_registered = false;
+    if (s_registered) return;
+    s_registered = true;
+
+    heap_caps_register_failed_alloc_callback(alloc_failed_hook);
+    ble_stats_register_section("mem", mem_stats_section);
+    ble_stats_register_section("stacks", stacks_stats_section);
+}
+
+void mem_plan_watch_task(TaskHandle_t task, uint32_t stack_bytes)
+{
+    if (!task) return;
+    portENTER_CRITICAL(&s_lock);
+    if (s_task_count < MEM_PLAN_MAX_TASKS) {
+        s_tasks[s_task_count].task = task;
+        s_tasks[s_task_count].stack_bytes = stack_bytes;
+        s_task_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void mem_plan_boot_done(void)
+{
+    if (s_boot_done) return;
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    s_boot_blocks = (uint32_t)info.allocated_blocks;
+    s_boot_done = true;
+
+    ESP_LOGI(TAG, "boot done: heap free=%u largest=%u blocks=%u min_free=%u",
+             (unsigned)info.total_free_bytes, (unsigned)info.largest_free_block,
+             (unsigned)info.allocated_blocks, (unsigned)info.minimum_free_bytes);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Memory plan and the reporting that checks it.
+ *
+ * Steady-state buffers are static: notification frames (notify_pool),
+ * the two 4 KB bulk channel SDUs (ble_coc),
+ * stdio buffers (file_pool), log staging (battery_log), OTA chunks, and
+ * the stacks and TCBs of the long-lived tasks (xTaskCreateStatic). What
+ * still comes from the heap is taken during boot: NimBLE, the LittleFS
+ * mount, the mbedtls context, the console UART driver's rings (serial_dump),
+ * and the LittleFS per-file cache of the few handles that then stay open. The Wi-Fi upload (wifi_offload, when built
+ * in) is the exception: the driver, lwIP and TLS heap is taken for one
+ * upload session and returned when it leaves the network.
+ *
+ * mem_plan_boot_done() snapshots the heap. From then on the "mem" stats
+ * section shows how far it moved: allocated blocks since boot, free / low
+ * water / largest free block, the fragmentation that follows from those,
+ * and failed allocations. "stacks" shows each watched task's peak stack
+ * use against its size.
+ */
+#define MEM_PLAN_MAX_TASKS  8
+
+/** Register the stats sections and the failed-allocation hook. */
+void mem_plan_init(void);
+
+/** Report this task's stack high-water mark; only for tasks that never exit. */
+void mem_plan_watch_task(TaskHandle_t task, uint32_t stack_bytes);
+
+/** Boot is over: heap use from here on is steady-state drift. Only the first call counts. */
+void mem_plan_boot_done(void);
+
+typedef struct {
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;        // low-water mark since reset
+    uint32_t largest_free;
+    uint32_t alloc_blocks;
+    int32_t  blocks_since_boot;     // allocated blocks vs. mem_plan_boot_done()
+    uint16_t frag_permille;         // 1000 - 1000 * largest_free / free_bytes
+    uint32_t alloc_failed;
+} mem_plan_heap_t;
+
+void mem_plan_get_heap(mem_plan_heap_t *out);
@@ -0,0 +1,75 @@
+#include "notify_pool.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "NOTIFY_POOL";
+
+static os_membuf_t s_pool_mem[OS_MEMPOOL_SIZE(NOTIFY_POOL_BLOCK_COUNT, NOTIFY_POOL_BLOCK_SIZE)];
+static struct os_mempool s_mempool;
+static struct os_mbuf_pool s_mbuf_pool;
+static bool s_ready = false;
+
+static volatile uint32_t s_allocs = 0;
+static volatile uint32_t s_exhausted = 0;
+
+int notify_pool_init(void)
+{
+    if (s_ready) return 0;
+
+    int rc = os_mempool_init(&s_mempool, NOTIFY_POOL_BLOCK_COUNT,
+                             NOTIFY_POOL_BLOCK_SIZE, s_pool_mem, "notify_pool");
+    if (rc != 0) {
+        ESP_LOGE(TAG, "os_mempool_init failed rc=%d", rc);
+        return rc;
+    }
+
+    rc = os_mbuf_pool_init(&s_mbuf_pool, &s_mempool,
+                           NOTIFY_POOL_BLOCK_SIZE, NOTIFY_POOL_BLOCK_COUNT);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "os_mbuf_pool_init failed rc=%d", rc);
+        return rc;
+    }
+
+    s_ready = true;
+    ESP_LOGI(TAG, "Notify pool ready: %d x %u bytes",
+             NOTIFY_POOL_BLOCK_COUNT, (unsigned)NOTIFY_POOL_BLOCK_SIZE);
+    return 0;
+}
+
+struct os_mbuf *notify_pool_get(void)
+{
+    if (!s_ready) return NULL;
+
+    struct os_mbuf *om = os_mbuf_get_pkthdr(&s_mbuf_pool, 0);
+    if (!om) {
+        s_exhausted++;
+        return NULL;
+    }
+
+    // Same trick as ble_hs_mbuf_att_pkt(): leave room so the host can
+    // prepend its headers without chaining another buffer.
+    om->om_data += NOTIFY_POOL_LEADING_SPACE;
+    s_allocs++;
+    return om;
+}
+
+void *notify_pool_reserve(struct os_mbuf *om, uint16_t len)
+{
+    if (!om || len > NOTIFY_POOL_FRAME_MAX) return NULL;
+    return os_mbuf_extend(om, len);
+}
+
+void notify_pool_get_stats(notify_pool_stats_t *out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    out->allocs = s_allocs;
+    out->exhausted = s_exhausted;
+    out->blocks = NOTIFY_POOL_BLOCK_COUNT;
+    if (s_ready) {
+        out->free_now = s_mempool.omp_num_free;
+        out->min_free = s_mempool.omp_min_free;
+    }
+}
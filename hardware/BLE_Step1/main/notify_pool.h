@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "os/os_mbuf.h"
+#include "frame_crypt.h"
+
+/**
+ * Dedicated mbuf pool for outgoing notifications.
+ *
+ * Frames used to come from the shared msys pool via ble_hs_mbuf_from_flat(),
+ * competing with ACL RX and GATT procedures; msys exhaustion was the main
+ * cause of backlog stalls. Blocks here are sized for one record frame plus
+ * the ATT/L2CAP/HCI headers NimBLE prepends, so a producer can write the
+ * payload straight into the mbuf data area.
+ */
+#if FRAME_CRYPT_ENABLE
+#define NOTIFY_POOL_FRAME_MAX      FRAME_CRYPT_MAX_FRAME   // sealed backlog batch
+#else
+#define NOTIFY_POOL_FRAME_MAX      72    // largest payload we notify (live_frame_t = 68)
+#endif
+#define NOTIFY_POOL_LEADING_SPACE  16    // HCI ACL(4) + L2CAP(4) + ATT notify(3), rounded up
+#define NOTIFY_POOL_BLOCK_COUNT    16
+
+#define NOTIFY_POOL_BLOCK_SIZE \
+    (sizeof(struct os_mbuf) + sizeof(struct os_mbuf_pkthdr) + \
+     NOTIFY_POOL_LEADING_SPACE + NOTIFY_POOL_FRAME_MAX)
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t exhausted;       // allocation attempts that found the pool empty
+    uint16_t blocks;
+    uint16_t free_now;
+    uint16_t min_free;        // low-water mark since boot
+} notify_pool_stats_t;
+
+int notify_pool_init(void);
+
+/**
+ * @brief Take a packet-header mbuf with ATT leading space reserved.
+ * @return NULL when the pool is exhausted (counted in `exhausted`).
+ */
+struct os_mbuf *notify_pool_get(void);
+
+/**
+ * @brief Grow `om` by `len` bytes and return a pointer to the new payload area
+ *        so the caller can fill it in place. Returns NULL if it does not fit.
+ */
+void *notify_pool_reserve(struct os_mbuf *om, uint16_t len);
+
+void notify_pool_get_stats(notify_pool_stats_t *out);
@@ -0,0 +1,276 @@
+#include "notify_sched.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "host/ble_hs.h"
+#include "ble_link.h"
+#include "ble_stats.h"
+#include "trace_rec.h"
+
+static const char *TAG = "NOTIFY_SCHED";
+
+// Queue depths. Frames from notify_pool hold a pool block while queued, so
+// the total stays within NOTIFY_POOL_BLOCK_COUNT (16) with room to spare.
+#define NS_QUEUE_MAX 8
+static const uint8_t s_depth[NS_CLASS_COUNT] = { 2, 2, NS_QUEUE_MAX, 2 };
+static const char s_tag[NS_CLASS_COUNT] = { 'a', 'l', 'b', 'o' };
+
+typedef struct {
+    struct os_mbuf *om;
+    int64_t t_in;
+    uint32_t epoch;
+    uint16_t conn;
+    uint16_t attr;
+    uint16_t len;
+} ns_entry_t;
+
+typedef struct {
+    ns_entry_t e[NS_QUEUE_MAX];
+    uint8_t head;
+    uint8_t count;
+} ns_queue_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ns_queue_t s_q[NS_CLASS_COUNT];
+static ns_class_stats_t s_st[NS_CLASS_COUNT];
+static uint32_t s_epoch = 0;
+
+// Token bucket in byte-microseconds, so refills do not round away.
+static int64_t s_tokens;
+static int64_t s_last_refill;
+static uint32_t s_budget_bps = NOTIFY_SCHED_BUDGET_BPS;
+static uint32_t s_burst = NOTIFY_SCHED_BURST_BYTES;
+
+static void (*s_wake)(void) = NULL;
+static int64_t (*s_now)(void) = esp_timer_get_time;
+static bool s_stats_registered = false;
+
+static bool is_bulk(ns_class_t cls)
+{
+    return cls == NS_CLASS_BACKLOG || cls == NS_CLASS_OTA;
+}
+
+// Caller holds s_lock.
+static void refill(int64_t now)
+{
+    int64_t dt = now - s_last_refill;
+    s_last_refill = now;
+    if (dt <= 0) return;
+    s_tokens += dt * (int64_t)s_budget_bps;
+    int64_t cap = (int64_t)s_burst * 1000000;
+    if (s_tokens > cap) s_tokens = cap;
+}
+
+static int nsched_stats_section(char *buf, size_t len)
+{
+    ns_class_stats_t st[NS_CLASS_COUNT];
+    portENTER_CRITICAL(&s_lock);
+    memcpy(st, s_st, sizeof(st));
+    int64_t tokens = s_tokens / 1000000;
+    portEXIT_CRITICAL(&s_lock);
+
+    int n = snprintf(buf, len, "budget=%" PRIu32 ",tokens=%" PRId64, s_budget_bps, tokens);
+    for (int c = 0; c < NS_CLASS_COUNT && n >= 0 && (size_t)n < len; c++) {
+        // class=sent/avg_us/max_us/full/failed+stale
+        n += snprintf(buf + n, len - (size_t)n, ",%c=%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32,
+                      s_tag[c], st[c].sent,
+                      st[c].sent ? (uint32_t)(st[c].sum_delay_us / st[c].sent) : 0,
+                      st[c].max_delay_us, st[c].full, st[c].failed + st[c].stale);
+    }
+    return n;
+}
+
+void notify_sched_init(void (*wake)(void))
+{
+    struct os_mbuf *drop[NS_CLASS_COUNT * NS_QUEUE_MAX];
+    int n_drop = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    for (int c = 0; c < NS_CLASS_COUNT; c++) {
+        for (int i = 0; i < s_q[c].count; i++) {
+            drop[n_drop++] = s_q[c].e[(s_q[c].head + i) % NS_QUEUE_MAX].om;
+        }
+    }
+    memset(s_q, 0, sizeof(s_q));
+    memset(s_st, 0, sizeof(s_st));
+    s_wake = wake;
+    s_last_refill = s_now();
+    s_tokens = (int64_t)s_burst * 1000000;
+    portEXIT_CRITICAL(&s_lock);
+
+    for (int i = 0; i < n_drop; i++) {
+        os_mbuf_free_chain(drop[i]);
+    }
+    if (!s_stats_registered) {
+        ble_stats_register_section("nsched", nsched_stats_section);
+        s_stats_registered = true;
+    }
+    ESP_LOGI(TAG, "bulk budget %" PRIu32 " B/s, burst %" PRIu32 " B", s_budget_bps, s_burst);
+}
+
+int notify_sched_submit(ns_class_t cls, uint16_t conn, uint16_t attr,
+                        struct os_mbuf *om, uint16_t payload_len)
+{
+    if ((unsigned)cls >= NS_CLASS_COUNT) {
+        os_mbuf_free_chain(om);
+        return -1;
+    }
+
+    int64_t now = s_now();
+    bool queued = false;
+
+    portENTER_CRITICAL(&s_lock);
+    ns_queue_t *q = &s_q[cls];
+    if (q->count < s_depth[cls]) {
+        ns_entry_t *e = &q->e[(q->head + q->count) % NS_QUEUE_MAX];
+        e->om = om;
+        e->t_in = now;
+        e->epoch = s_epoch;
+        e->conn = conn;
+        e->attr = attr;
+        e->len = payload_len;
+        q->count++;
+        queued = true;
+    } else {
+        s_st[cls].full++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!queued) {
+        os_mbuf_free_chain(om);
+        return -2;
+    }
+    if (s_wake) s_wake();
+    return 0;
+}
+
+bool notify_sched_has_room(ns_class_t cls)
+{
+    if ((unsigned)cls >= NS_CLASS_COUNT) return false;
+    portENTER_CRITICAL(&s_lock);
+    bool room = s_q[cls].count < s_depth[cls];
+    portEXIT_CRITICAL(&s_lock);
+    return room;
+}
+
+// Caller holds s_lock. Takes the next frame that may go now, in class order.
+static bool pop_eligible(int64_t now, ns_class_t *cls_out, ns_entry_t *out, int64_t *wait_us)
+{
+    refill(now);
+    *wait_us = -1;
+
+    for (int c = 0; c < NS_CLASS_COUNT; c++) {
+        ns_queue_t *q = &s_q[c];
+        if (q->count == 0) continue;
+
+        ns_entry_t *e = &q->e[q->head];
+        int64_t cost = (int64_t)e->len * 1000000;
+        if (is_bulk((ns_class_t)c) && e->epoch == s_epoch && s_tokens < cost) {
+            // Lower classes wait too: they would only take the same budget.
+            *wait_us = (cost - s_tokens + s_budget_bps - 1) / (s_budget_bps ? s_budget_bps : 1);
+            return false;
+        }
+
+        *out = *e;
+        *cls_out = (ns_class_t)c;
+        q->head = (uint8_t)((q->head + 1) % NS_QUEUE_MAX);
+        q->count--;
+        if (e->epoch == s_epoch) {
+            // Alerts and live frames always go, but still spend the budget,
+            // so bulk traffic backs off around them.
+            s_tokens -= cost;
+        }
+        return true;
+    }
+    return false;
+}
+
+int64_t notify_sched_run(void)
+{
+    for (;;) {
+        ns_class_t cls;
+        ns_entry_t e;
+        int64_t wait_us;
+        int64_t now = s_now();
+
+        portENTER_CRITICAL(&s_lock);
+        bool got = pop_eligible(now, &cls, &e, &wait_us);
+        bool stale = got && e.epoch != s_epoch;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!got) return wait_us;
+
+        if (stale) {
+            os_mbuf_free_chain(e.om);
+            portENTER_CRITICAL(&s_lock);
+            s_st[cls].stale++;
+            portEXIT_CRITICAL(&s_lock);
+            continue;
+        }
+
+        // Consumes the mbuf whether or not it succeeds.
+        TRACE_BEGIN_ARG(TRACE_SPAN_NOTIFY_TX, cls);
+        int rc = ble_gatts_notify_custom(e.conn, e.attr, e.om);
+        TRACE_END(TRACE_SPAN_NOTIFY_TX);
+        uint32_t delay = (uint32_t)(now - e.t_in);
+
+        portENTER_CRITICAL(&s_lock);
+        ns_class_stats_t *st = &s_st[cls];
+        if (rc == 0) {
+            st->sent++;
+            st->sum_delay_us += delay;
+            if (delay > st->max_delay_us) st->max_delay_us = delay;
+        } else {
+            st->failed++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (rc == 0) {
+            ble_link_note_tx(e.len);
+        } else {
+            ESP_LOGD(TAG, "notify class %d failed rc=%d", (int)cls, rc);   // in the stats
+        }
+    }
+}
+
+void notify_sched_on_disconnect(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_epoch++;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_wake) s_wake();   // let the dispatcher free what was queued
+}
+
+uint32_t notify_sched_epoch(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t epoch = s_epoch;
+    portEXIT_CRITICAL(&s_lock);
+    return epoch;
+}
+
+void notify_sched_set_budget(uint32_t bytes_per_s, uint32_t burst_bytes)
+{
+    portENTER_CRITICAL(&s_lock);
+    refill(s_now());
+    s_budget_bps = bytes_per_s ? bytes_per_s : 1;
+    s_burst = burst_bytes;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void notify_sched_get_stats(ns_class_t cls, ns_class_stats_t *out)
+{
+    if ((unsigned)cls >= NS_CLASS_COUNT) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_st[cls];
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void notify_sched_set_clock(int64_t (*now_us)(void))
+{
+    s_now = now_us ? now_us : esp_timer_get_time;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "os/os_mbuf.h"
+
+/**
+ * Notification scheduler.
+ *
+ * Producers hand finished frames to a per-class queue instead of calling
+ * ble_gatts_notify_custom() themselves; the dispatcher sends them in class
+ * order. Bulk classes (backlog, OTA status) also spend a byte budget
+ * (token bucket) that alerts and live frames draw from first, so a long
+ * backlog cannot fill the host/controller queues ahead of the next live
+ * sample. Each class counts its queueing delay (submit -> handed to the
+ * host) in the "nsched" stats section.
+ */
+typedef enum {
+    NS_CLASS_ALERT = 0,     // highest priority
+    NS_CLASS_LIVE,
+    NS_CLASS_BACKLOG,
+    NS_CLASS_OTA,
+    NS_CLASS_COUNT
+} ns_class_t;
+
+// Bulk budget: bytes/s of payload for the backlog and OTA classes, and the
+// largest burst after an idle period. The old fixed 20 ms gap between
+// backlog records was ~2.8 KB/s.
+#ifndef NOTIFY_SCHED_BUDGET_BPS
+#define NOTIFY_SCHED_BUDGET_BPS   8192
+#endif
+#ifndef NOTIFY_SCHED_BURST_BYTES
+#define NOTIFY_SCHED_BURST_BYTES  512
+#endif
+
+typedef struct {
+    uint32_t sent;
+    uint32_t full;          // submits rejected, queue full
+    uint32_t failed;        // ble_gatts_notify_custom() errors
+    uint32_t stale;         // dropped, queued for a connection that is gone
+    uint32_t max_delay_us;
+    uint64_t sum_delay_us;
+} ns_class_stats_t;
+
+/**
+ * @brief Reset the queues. `wake` is called after every submit so the
+ *        dispatcher task can run notify_sched_run() (may be NULL).
+ */
+void notify_sched_init(void (*wake)(void));
+
+/**
+ * @brief Queue a notification. Consumes `om` in every case, like
+ *        ble_gatts_notify_custom().
+ * @return 0 queued, -2 class queue full (try again later)
+ */
+int notify_sched_submit(ns_class_t cls, uint16_t conn, uint16_t attr,
+                        struct os_mbuf *om, uint16_t payload_len);
+
+/** True if `cls` can take another frame now. */
+bool notify_sched_has_room(ns_class_t cls);
+
+/**
+ * @brief Send everything that is eligible now (dispatcher task).
+ * @return microseconds until the budget allows the next queued bulk frame,
+ *         0 to run again at once, -1 if every queue is empty
+ */
+int64_t notify_sched_run(void);
+
+/** Frames queued before this for the old connection are dropped. */
+void notify_sched_on_disconnect(void);
+
+/** Bumped by every disconnect: frames queued under an older value are dropped. */
+uint32_t notify_sched_epoch(void);
+
+void notify_sched_set_budget(uint32_t bytes_per_s, uint32_t burst_bytes);
+void notify_sched_get_stats(ns_class_t cls, ns_class_stats_t *out);
+
+/** Replace the time source (host simulation). */
+void notify_sched_set_clock(int64_t (*now_us)(void));
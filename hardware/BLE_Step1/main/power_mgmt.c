@@ -0,0 +1,123 @@
+#include "power_mgmt.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#if APP_LOW_POWER_MODE && defined(CONFIG_PM_ENABLE)
+#include "esp_pm.h"
+#endif
+
+#include "battery_log.h"
+#include "ble_stats.h"
+
+static const char *TAG = "POWER";
+
+#define LP_MIN_FREQ_MHZ 40
+#define DEFAULT_ADV_ITVL_MS 40   // NimBLE uses 30-60 ms when itvl_min/max are 0
+
+typedef struct {
+    uint64_t active_us;          // sampler work (acquire, notify, append)
+    uint32_t samples;
+    pwr_radio_state_t radio;
+    int64_t  radio_since_us;
+    uint64_t adv_us;
+    uint64_t conn_us;
+} power_acct_t;
+
+static power_acct_t s_acct = {
+    .radio = PWR_RADIO_OFF,
+};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void close_radio_interval(int64_t now)
+{
+    uint64_t dt = (uint64_t)(now - s_acct.radio_since_us);
+    if (s_acct.radio == PWR_RADIO_ADV) {
+        s_acct.adv_us += dt;
+    } else if (s_acct.radio == PWR_RADIO_CONN) {
+        s_acct.conn_us += dt;
+    }
+    s_acct.radio_since_us = now;
+}
+
+static int power_stats_section(char *buf, size_t len)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t flushes = 0, flush_bytes = 0;
+    battery_log_get_io_stats(&flushes, &flush_bytes);
+
+    portENTER_CRITICAL(&s_lock);
+    close_radio_interval(now);
+    power_acct_t a = s_acct;
+    portEXIT_CRITICAL(&s_lock);
+
+    return snprintf(buf, len,
+                    "lp=%d,up_ms=%" PRIu64 ",active_ms=%" PRIu64 ",samples=%" PRIu32
+                    ",adv_ms=%" PRIu64 ",conn_ms=%" PRIu64 ",adv_itvl_ms=%d"
+                    ",flushes=%" PRIu32 ",flush_b=%" PRIu32,
+                    power_mgmt_low_power() ? 1 : 0,
+                    (uint64_t)(now / 1000), a.active_us / 1000, a.samples,
+                    a.adv_us / 1000, a.conn_us / 1000,
+                    power_mgmt_low_power() ? LP_ADV_ITVL_MIN_MS : DEFAULT_ADV_ITVL_MS,
+                    flushes, flush_bytes);
+}
+
+bool power_mgmt_low_power(void)
+{
+    return APP_LOW_POWER_MODE != 0;
+}
+
+void power_mgmt_init(void)
+{
+    ble_stats_register_section("power", power_stats_section);
+
+#if APP_LOW_POWER_MODE
+#if defined(CONFIG_PM_ENABLE)
+    esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = LP_MIN_FREQ_MHZ,
+#if defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "PM: %d-%d MHz, light sleep %s", LP_MIN_FREQ_MHZ,
+                 CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, pm.light_sleep_enable ? "on" : "off");
+    }
+#else
+    ESP_LOGW(TAG, "Low-power mode without CONFIG_PM_ENABLE: batching only");
+#endif
+    battery_log_set_flush_batch(LP_LOG_FLUSH_BATCH);
+#endif
+}
+
+void power_mgmt_note_active(uint32_t us)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_acct.active_us += us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void power_mgmt_note_sample(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_acct.samples++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void power_mgmt_note_radio(pwr_radio_state_t state)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    close_radio_interval(now);
+    s_acct.radio = state;
+    portEXIT_CRITICAL(&s_lock);
+}
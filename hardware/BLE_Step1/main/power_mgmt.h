@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Low-power mode: DFS + automatic light sleep with tickless idle between
+ * samples, batched log writes and slow advertising. Enabled when the build
+ * has CONFIG_PM_ENABLE (see sdkconfig.defaults.lowpower), or force it with
+ * -DAPP_LOW_POWER_MODE=0/1.
+ */
+#ifndef APP_LOW_POWER_MODE
+#ifdef CONFIG_PM_ENABLE
+#define APP_LOW_POWER_MODE 1
+#else
+#define APP_LOW_POWER_MODE 0
+#endif
+#endif
+
+#define LP_LOG_FLUSH_BATCH     12     // one flash write per minute at 5 s sampling
+#define LP_ADV_ITVL_MIN_MS     1000
+#define LP_ADV_ITVL_MAX_MS     1200
+
+typedef enum {
+    PWR_RADIO_OFF = 0,
+    PWR_RADIO_ADV,
+    PWR_RADIO_CONN,
+} pwr_radio_state_t;
+
+void power_mgmt_init(void);
+bool power_mgmt_low_power(void);
+
+/** Instrumentation for the host energy model (tools/energy_model). */
+void power_mgmt_note_active(uint32_t us);
+void power_mgmt_note_radio(pwr_radio_state_t state);
+void power_mgmt_note_sample(void);
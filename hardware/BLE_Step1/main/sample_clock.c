@@ -0,0 +1,130 @@
+#include "sample_clock.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "ble_stats.h"
+#include "sampler.h"
+
+static const char *TAG = "SAMPLE_CLOCK";
+
+typedef struct {
+    bool started;
+    int64_t slot_us;            // slot of the last sample
+    int64_t due_us;             // next slot
+    sample_clock_stats_t st;
+} sample_clock_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static sample_clock_t s_clk = { .st.period_ms = SAMPLER_PERIOD_NORMAL_MS };
+static esp_timer_handle_t s_timer;
+static TaskHandle_t s_waiter;
+
+// esp_timer task: wake the sampling task.
+static void on_slot(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_waiter);
+}
+
+static int clock_stats_section(char *buf, size_t len)
+{
+    sample_clock_stats_t st;
+    sample_clock_get_stats(&st);
+
+    int n = snprintf(buf, len, "period_ms=%" PRIu32 ",samples=%" PRIu32 ",missed=%" PRIu32 ",",
+                     st.period_ms, st.samples, st.missed);
+    if (n < 0 || (size_t)n >= len) return n;
+    return n + lat_hist_format(&st.late, buf + n, len - (size_t)n);
+}
+
+void sample_clock_init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = on_slot,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sample_clock",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&args, &s_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "timer create failed: %s", esp_err_to_name(err));
+    }
+    ble_stats_register_section("clock", clock_stats_section);
+}
+
+int64_t sample_clock_next_due(int64_t now_us)
+{
+    portENTER_CRITICAL(&s_lock);
+    int64_t due = s_clk.started ? s_clk.due_us : now_us;
+    portEXIT_CRITICAL(&s_lock);
+    return due;
+}
+
+int64_t sample_clock_take(int64_t now_us)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (!s_clk.started) {
+        s_clk.started = true;
+        s_clk.due_us = now_us;
+    }
+
+    int64_t slot = s_clk.due_us;
+    int64_t late = now_us > slot ? now_us - slot : 0;
+    const int64_t period_us = (int64_t)s_clk.st.period_ms * 1000;
+    if (late >= period_us) {
+        // Whole periods lost (a stall): take the latest slot, keep the grid.
+        int64_t skip = late / period_us;
+        slot += skip * period_us;
+        late -= skip * period_us;
+        s_clk.st.missed += (uint32_t)skip;
+    }
+
+    lat_hist_add(&s_clk.st.late, (uint32_t)late);
+    s_clk.st.samples++;
+    s_clk.slot_us = slot;
+    s_clk.due_us = slot + period_us;
+    portEXIT_CRITICAL(&s_lock);
+    return slot;
+}
+
+void sample_clock_set_period(uint32_t period_ms)
+{
+    if (period_ms == 0) return;
+    portENTER_CRITICAL(&s_lock);
+    s_clk.st.period_ms = period_ms;
+    if (s_clk.started) s_clk.due_us = s_clk.slot_us + (int64_t)period_ms * 1000;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int64_t sample_clock_wait(void)
+{
+    s_waiter = xTaskGetCurrentTaskHandle();
+
+    int64_t now = esp_timer_get_time();
+    int64_t due = sample_clock_next_due(now);
+    while (now < due) {
+        // The notification can only come from this timer, but a wake-up a
+        // few microseconds early just arms it again.
+        if (!s_timer || esp_timer_start_once(s_timer, (uint64_t)(due - now)) != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS((due - now) / 1000) + 1);
+        } else {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        now = esp_timer_get_time();
+    }
+    sample_clock_take(now);
+    return now;
+}
+
+void sample_clock_get_stats(sample_clock_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_clk.st;
+    portEXIT_CRITICAL(&s_lock);
+}
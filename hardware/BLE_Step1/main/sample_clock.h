@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include "lat_hist.h"
+
+/**
+ * Sampling clock.
+ *
+ * Samples fall on a fixed grid: each slot is the previous slot plus the
+ * sampler's period, not the previous wake-up plus the period, so the work
+ * done around a sample (notify, append, a checkpoint fsync) never shifts
+ * the ones after it. The wake-up comes from a one-shot esp_timer armed at
+ * the slot's absolute time, not from the 10 ms FreeRTOS tick.
+ *
+ * Every sample records its lateness against its slot in a histogram (the
+ * "clock" stats section). A sample more than a whole period late skips the
+ * slots it missed (counted) and stays on the grid. The period is
+ * SAMPLER_PERIOD_NORMAL_MS until the first sample_clock_set_period().
+ */
+typedef struct {
+    uint32_t samples;
+    uint32_t missed;            // slots skipped: the sample came a period or more late
+    uint32_t period_ms;
+    lat_hist_t late;            // wake-up time - slot time
+} sample_clock_stats_t;
+
+/** Create the timer and register the "clock" stats section. */
+void sample_clock_init(void);
+
+/**
+ * @brief Block the calling task (the only one that samples) until the next
+ *        slot, then take it.
+ * @return esp_timer time of the wake-up, in microseconds
+ */
+int64_t sample_clock_wait(void);
+
+/**
+ * @brief Take the slot `now_us` falls in: what sample_clock_wait() does once
+ *        it wakes (host benches call it directly). The first call starts
+ *        the grid.
+ * @return the slot's time, in microseconds
+ */
+int64_t sample_clock_take(int64_t now_us);
+
+/** Next slot: the one just taken plus `period_ms` (the sampler's rate). */
+void sample_clock_set_period(uint32_t period_ms);
+
+/** Time of the next slot; `now_us` before the first sample. */
+int64_t sample_clock_next_due(int64_t now_us);
+
+void sample_clock_get_stats(sample_clock_stats_t *out);
@@ -0,0 +1,135 @@
+#include "sampler.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "esp_log.h"
+
+#include "ble_stats.h"
+
+static const char *TAG = "SAMPLER";
+
+// Rates are per minute so integer math keeps enough resolution at 60 s.
+#define FAST_DI_MA_PER_MIN     12000   // 200 mA/s
+#define FAST_DV_MV_PER_MIN     240     // 4 mV/s on any cell
+#define CALM_DI_MA_PER_MIN     300     // 5 mA/s
+#define CALM_DV_MV_PER_MIN     15      // 0.25 mV/s
+#define REST_MAX_ABS_MA        150     // |I| above this is never "rest"
+
+#define FAST_HOLD_SAMPLES      10      // non-FAST samples before FAST -> NORMAL
+#define REST_HOLD_SAMPLES      12      // calm samples before NORMAL -> REST
+
+typedef struct {
+    bool have_prev;
+    int64_t prev_us;
+    int16_t prev_current_ma;
+    uint16_t prev_cell_mv[16];
+
+    sampler_rate_t rate;
+    uint16_t calm_run;
+    uint32_t rate_changes;
+    uint32_t samples_at[4];        // indexed by sampler_rate_t
+} sampler_state_t;
+
+static sampler_state_t s_smp;
+
+static uint32_t rate_period_ms(sampler_rate_t r)
+{
+    switch (r) {
+        case SAMPLER_RATE_FAST: return SAMPLER_PERIOD_FAST_MS;
+        case SAMPLER_RATE_REST: return SAMPLER_PERIOD_REST_MS;
+        default:                return SAMPLER_PERIOD_NORMAL_MS;
+    }
+}
+
+static const char *rate_name(sampler_rate_t r)
+{
+    switch (r) {
+        case SAMPLER_RATE_FAST:   return "FAST";
+        case SAMPLER_RATE_NORMAL: return "NORMAL";
+        case SAMPLER_RATE_REST:   return "REST";
+        default:                  return "FIXED";
+    }
+}
+
+static void set_rate(sampler_rate_t r, uint32_t di, uint32_t dv)
+{
+    if (r == s_smp.rate) return;
+
+    ESP_LOGI(TAG, "rate %s -> %s (dI=%" PRIu32 " mA/min dV=%" PRIu32 " mV/min)",
+             rate_name(s_smp.rate), rate_name(r), di, dv);
+    s_smp.rate = r;
+    s_smp.calm_run = 0;
+    s_smp.rate_changes++;
+}
+
+static int sampler_stats_section(char *buf, size_t len)
+{
+    return snprintf(buf, len,
+                    "rate=%s,period_ms=%" PRIu32 ",changes=%" PRIu32
+                    ",n_fast=%" PRIu32 ",n_normal=%" PRIu32 ",n_rest=%" PRIu32,
+                    rate_name(s_smp.rate), rate_period_ms(s_smp.rate), s_smp.rate_changes,
+                    s_smp.samples_at[SAMPLER_RATE_FAST],
+                    s_smp.samples_at[SAMPLER_RATE_NORMAL],
+                    s_smp.samples_at[SAMPLER_RATE_REST]);
+}
+
+void sampler_init(void)
+{
+    s_smp.have_prev = false;
+    s_smp.rate = SAMPLER_RATE_NORMAL;
+    s_smp.calm_run = 0;
+    ble_stats_register_section("sampler", sampler_stats_section);
+}
+
+uint32_t sampler_on_sample(battery_log_t *rec, int64_t now_us)
+{
+    // The record describes how it was taken: the gap to the previous sample
+    // and the rate in force, so consumers can rebuild the time base.
+    rec->rate = (uint8_t)s_smp.rate;
+    rec->interval_s = 0;
+    s_smp.samples_at[s_smp.rate]++;
+
+    if (s_smp.have_prev) {
+        int64_t dt_ms = (now_us - s_smp.prev_us) / 1000;
+        if (dt_ms < 1) dt_ms = 1;
+        rec->interval_s = (uint16_t)((dt_ms + 500) / 1000);
+
+        uint32_t di = (uint32_t)((int64_t)abs(rec->current_ma - s_smp.prev_current_ma) * 60000 / dt_ms);
+        uint32_t dv_max = 0;
+        for (int i = 0; i < 16; i++) {
+            uint32_t d = (uint32_t)abs((int)rec->cell_mv[i] - (int)s_smp.prev_cell_mv[i]);
+            if (d > dv_max) dv_max = d;
+        }
+        uint32_t dv = (uint32_t)((int64_t)dv_max * 60000 / dt_ms);
+
+        bool fast = (di >= FAST_DI_MA_PER_MIN) || (dv >= FAST_DV_MV_PER_MIN);
+        bool calm = (di <= CALM_DI_MA_PER_MIN) && (dv <= CALM_DV_MV_PER_MIN) &&
+                    (abs(rec->current_ma) <= REST_MAX_ABS_MA);
+
+        if (fast) {
+            s_smp.calm_run = 0;
+            set_rate(SAMPLER_RATE_FAST, di, dv);
+        } else if (s_smp.rate == SAMPLER_RATE_FAST) {
+            if (++s_smp.calm_run >= FAST_HOLD_SAMPLES) set_rate(SAMPLER_RATE_NORMAL, di, dv);
+        } else if (calm) {
+            if (++s_smp.calm_run >= REST_HOLD_SAMPLES) set_rate(SAMPLER_RATE_REST, di, dv);
+        } else {
+            s_smp.calm_run = 0;
+            set_rate(SAMPLER_RATE_NORMAL, di, dv);
+        }
+    }
+
+    s_smp.have_prev = true;
+    s_smp.prev_us = now_us;
+    s_smp.prev_current_ma = rec->current_ma;
+    for (int i = 0; i < 16; i++) s_smp.prev_cell_mv[i] = rec->cell_mv[i];
+
+    return rate_period_ms(s_smp.rate);
+}
+
+sampler_rate_t sampler_current_rate(void)
+{
+    return s_smp.rate;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include "battery_log.h"
+
+/**
+ * Adaptive sample-rate controller.
+ *
+ * Looks at the current and per-cell voltage rate of change between
+ * consecutive samples and picks the next sampling period: FAST under
+ * dynamic load, NORMAL for steady load, REST when the pack sits idle.
+ * Steps up immediately, steps down only after a run of calm samples.
+ */
+typedef enum {
+    SAMPLER_RATE_FIXED  = 0,   // legacy records (pre-v4): fixed 5 s
+    SAMPLER_RATE_FAST   = 1,
+    SAMPLER_RATE_NORMAL = 2,
+    SAMPLER_RATE_REST   = 3,
+} sampler_rate_t;
+
+#define SAMPLER_PERIOD_FAST_MS     1000
+#define SAMPLER_PERIOD_NORMAL_MS   5000
+#define SAMPLER_PERIOD_REST_MS     60000
+
+void sampler_init(void);
+
+/**
+ * @brief Stamp `rec` with the interval since the previous sample and the
+ *        rate it was taken at, then update the controller from it.
+ * @return period in ms until the next sample should be taken
+ */
+uint32_t sampler_on_sample(battery_log_t *rec, int64_t now_us);
+
+sampler_rate_t sampler_current_rate(void);
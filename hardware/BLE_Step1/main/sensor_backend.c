@@ -0,0 +1,97 @@
+#include "sensor_backend.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ble_stats.h"
+#include "trace_rec.h"
+
+static const char *TAG = "SENSOR";
+
+static const sensor_backend_t *s_backend = NULL;
+static sensor_latency_t s_lat;
+static uint64_t s_lat_total_us = 0;
+
+static const sensor_backend_t *default_backend(void)
+{
+#if SENSOR_BACKEND == SENSOR_BACKEND_BQ76952
+    return &sensor_backend_bq76952;
+#elif SENSOR_BACKEND == SENSOR_BACKEND_REPLAY
+    return &sensor_backend_replay;
+#else
+    return &sensor_backend_mock;
+#endif
+}
+
+static int sensor_stats_section(char *buf, size_t len)
+{
+    sensor_health_t h;
+    sensor_get_health(&h);
+
+    return snprintf(buf, len,
+                    "backend=%s,ok=%d,reads=%" PRIu32 ",errors=%" PRIu32 ",last_err=0x%x"
+                    ",lat_last_us=%" PRIu32 ",lat_min_us=%" PRIu32 ",lat_avg_us=%" PRIu32
+                    ",lat_max_us=%" PRIu32,
+                    s_backend ? s_backend->name : "none", h.ok ? 1 : 0,
+                    h.reads, h.errors, (unsigned)h.last_err,
+                    s_lat.last_us, s_lat.min_us, s_lat.avg_us, s_lat.max_us);
+}
+
+esp_err_t sensor_init(const sensor_backend_t *backend)
+{
+    s_backend = backend ? backend : default_backend();
+    memset(&s_lat, 0, sizeof(s_lat));
+    s_lat_total_us = 0;
+
+    ble_stats_register_section("sensor", sensor_stats_section);
+
+    esp_err_t err = s_backend->init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s init failed: %s", s_backend->name, esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Sensor backend: %s", s_backend->name);
+    return ESP_OK;
+}
+
+esp_err_t sensor_read(battery_log_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_backend) return ESP_ERR_INVALID_STATE;
+
+    int64_t t0 = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_SPAN_SENSOR_READ);
+    esp_err_t err = s_backend->read(out);
+    TRACE_END(TRACE_SPAN_SENSOR_READ);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+    s_lat.last_us = dt;
+    if (s_lat.samples == 0 || dt < s_lat.min_us) s_lat.min_us = dt;
+    if (dt > s_lat.max_us) s_lat.max_us = dt;
+    s_lat.samples++;
+    s_lat_total_us += dt;
+    s_lat.avg_us = (uint32_t)(s_lat_total_us / s_lat.samples);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s read failed: %s", s_backend->name, esp_err_to_name(err));
+    }
+    return err;
+}
+
+void sensor_get_health(sensor_health_t *out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (s_backend && s_backend->health) {
+        s_backend->health(out);
+    }
+}
+
+void sensor_get_latency(sensor_latency_t *out)
+{
+    if (out) *out = s_lat;
+}
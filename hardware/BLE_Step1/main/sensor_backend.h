@@ -0,0 +1,71 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "battery_log.h"
+
+/**
+ * Sensor acquisition backends.
+ *
+ * A backend fills the measurement fields of a battery_log_t snapshot
+ * (timestamp, cells, pack voltages, current, temperatures). seq,
+ * interval_s and rate belong to the logger/sampler and soc to soc_est; a
+ * backend may fill soc (replay) but the estimator overwrites it.
+ */
+typedef struct {
+    bool     ok;                  // last read succeeded
+    uint32_t reads;
+    uint32_t errors;
+    uint32_t consecutive_errors;
+    esp_err_t last_err;
+} sensor_health_t;
+
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void);
+    esp_err_t (*read)(battery_log_t *out);
+    void (*health)(sensor_health_t *out);
+} sensor_backend_t;
+
+#define SENSOR_BACKEND_MOCK     0
+#define SENSOR_BACKEND_BQ76952  1
+#define SENSOR_BACKEND_REPLAY   2
+
+#ifndef SENSOR_BACKEND
+#define SENSOR_BACKEND SENSOR_BACKEND_MOCK
+#endif
+
+extern const sensor_backend_t sensor_backend_mock;
+extern const sensor_backend_t sensor_backend_bq76952;
+extern const sensor_backend_t sensor_backend_replay;
+
+/**
+ * @brief Initialise the backend selected by SENSOR_BACKEND (or `backend` if
+ *        non-NULL) and register the "sensor" stats section.
+ */
+esp_err_t sensor_init(const sensor_backend_t *backend);
+
+/**
+ * @brief Take one snapshot from the active backend, timing it.
+ */
+esp_err_t sensor_read(battery_log_t *out);
+
+void sensor_get_health(sensor_health_t *out);
+
+/** Acquisition latency per snapshot, microseconds. */
+typedef struct {
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint32_t samples;
+} sensor_latency_t;
+
+void sensor_get_latency(sensor_latency_t *out);
+
+/**
+ * @brief Point the replay backend at a capture (CSV with a header row, or raw
+ *        battery_log_t records if the name ends in ".bin"). `loop` restarts
+ *        at end of file. Call before sensor_init().
+ */
+void sensor_replay_set_source(const char *path, bool loop);
@@ -0,0 +1,178 @@
+#include "sensor_backend.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/i2c_master.h"
+
+/*
+ * TI BQ76952 (BQ769x2 family) analog front end over I2C.
+ *
+ * Direct-command registers are contiguous, so one snapshot is two
+ * transactions: a 40-byte block read of 0x14..0x3B (16 cells, stack, PACK,
+ * LD, CC2 current) and a 10-byte read of 0x68..0x71 (internal and TS1
+ * temperatures). Device is assumed in default comm mode (no I2C CRC).
+ */
+
+static const char *TAG = "BQ76952";
+
+#ifndef BQ_I2C_PORT
+#define BQ_I2C_PORT        I2C_NUM_0
+#endif
+#ifndef BQ_I2C_SDA_GPIO
+#define BQ_I2C_SDA_GPIO    21
+#endif
+#ifndef BQ_I2C_SCL_GPIO
+#define BQ_I2C_SCL_GPIO    22
+#endif
+#ifndef BQ_I2C_HZ
+#define BQ_I2C_HZ          400000
+#endif
+#define BQ_I2C_ADDR        0x08     // 7-bit (0x10 write / 0x11 read)
+#define BQ_I2C_TIMEOUT_MS  20
+
+// Direct commands
+#define BQ_CMD_CELL1_V     0x14     // Cell1..Cell16 at 0x14..0x32, mV
+#define BQ_CMD_STACK_V     0x34     // userV
+#define BQ_CMD_PACK_V      0x36     // userV
+#define BQ_CMD_LD_V        0x38     // userV
+#define BQ_CMD_CC2_I       0x3A     // userA
+#define BQ_CMD_INT_TEMP    0x68     // 0.1 K
+#define BQ_CMD_TS1_TEMP    0x70     // 0.1 K
+
+#define BQ_BLOCK_V_LEN     (BQ_CMD_CC2_I + 2 - BQ_CMD_CELL1_V)     // 40
+#define BQ_BLOCK_T_LEN     (BQ_CMD_TS1_TEMP + 2 - BQ_CMD_INT_TEMP)  // 10
+
+// Default DA Configuration: userV = 10 mV, userA = 1 mA.
+#ifndef BQ_USER_V_MV
+#define BQ_USER_V_MV       10
+#endif
+
+#define BQ_CELL_MAX_MV     5500     // anything above is a bad read
+#define BQ_RESET_AFTER_ERRORS 3
+
+static i2c_master_bus_handle_t s_bus = NULL;
+static i2c_master_dev_handle_t s_dev = NULL;
+static sensor_health_t s_health;
+
+static uint16_t rd_u16(const uint8_t *b, uint8_t reg, uint8_t base)
+{
+    const uint8_t *p = b + (reg - base);
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static int16_t kelvin_x10_to_c_x100(uint16_t k10)
+{
+    return (int16_t)((int32_t)k10 * 10 - 27315);
+}
+
+static esp_err_t bq_read_block(uint8_t reg, uint8_t *buf, size_t len)
+{
+    return i2c_master_transmit_receive(s_dev, &reg, 1, buf, len, BQ_I2C_TIMEOUT_MS);
+}
+
+static esp_err_t bq_init(void)
+{
+    memset(&s_health, 0, sizeof(s_health));
+
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = BQ_I2C_PORT,
+        .sda_io_num = BQ_I2C_SDA_GPIO,
+        .scl_io_num = BQ_I2C_SCL_GPIO,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &s_bus);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "i2c_new_master_bus failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = BQ_I2C_ADDR,
+        .scl_speed_hz = BQ_I2C_HZ,
+    };
+    err = i2c_master_bus_add_device(s_bus, &dev_cfg, &s_dev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "add device failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = i2c_master_probe(s_bus, BQ_I2C_ADDR, BQ_I2C_TIMEOUT_MS);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "no ACK at 0x%02x: %s", BQ_I2C_ADDR, esp_err_to_name(err));
+    }
+    s_health.ok = (err == ESP_OK);
+    s_health.last_err = err;
+    return ESP_OK;  // keep running; reads report failures through health
+}
+
+static esp_err_t bq_read_snapshot(battery_log_t *r)
+{
+    uint8_t v[BQ_BLOCK_V_LEN];
+    uint8_t t[BQ_BLOCK_T_LEN];
+
+    esp_err_t err = bq_read_block(BQ_CMD_CELL1_V, v, sizeof(v));
+    if (err == ESP_OK) {
+        err = bq_read_block(BQ_CMD_INT_TEMP, t, sizeof(t));
+    }
+    if (err != ESP_OK) return err;
+
+    memset(r, 0, sizeof(*r));
+    r->timestamp_s = (uint32_t)(esp_timer_get_time() / 1000000ULL);
+
+    uint32_t sum = 0;
+    for (int i = 0; i < 16; i++) {
+        uint16_t mv = rd_u16(v, (uint8_t)(BQ_CMD_CELL1_V + 2 * i), BQ_CMD_CELL1_V);
+        if (mv > BQ_CELL_MAX_MV) return ESP_ERR_INVALID_RESPONSE;
+        r->cell_mv[i] = mv;
+        sum += mv;
+    }
+
+    r->pack_total_mv = (uint16_t)(rd_u16(v, BQ_CMD_STACK_V, BQ_CMD_CELL1_V) * BQ_USER_V_MV);
+    r->pack_ld_mv = (uint16_t)(rd_u16(v, BQ_CMD_LD_V, BQ_CMD_CELL1_V) * BQ_USER_V_MV);
+    r->pack_sum_active_mv = (uint16_t)sum;
+    r->current_ma = (int16_t)rd_u16(v, BQ_CMD_CC2_I, BQ_CMD_CELL1_V);
+
+    r->temp_int_c_x100 = kelvin_x10_to_c_x100(rd_u16(t, BQ_CMD_INT_TEMP, BQ_CMD_INT_TEMP));
+    r->temp_ts1_c_x100 = kelvin_x10_to_c_x100(rd_u16(t, BQ_CMD_TS1_TEMP, BQ_CMD_INT_TEMP));
+
+    // The AFE has no gas gauge; soc is filled in by soc_est.
+    return ESP_OK;
+}
+
+static esp_err_t bq_read(battery_log_t *r)
+{
+    if (!s_dev) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = bq_read_snapshot(r);
+
+    s_health.reads++;
+    s_health.last_err = err;
+    s_health.ok = (err == ESP_OK);
+    if (err == ESP_OK) {
+        s_health.consecutive_errors = 0;
+        return ESP_OK;
+    }
+
+    s_health.errors++;
+    if (++s_health.consecutive_errors == BQ_RESET_AFTER_ERRORS) {
+        ESP_LOGW(TAG, "%u consecutive errors, resetting bus", BQ_RESET_AFTER_ERRORS);
+        i2c_master_bus_reset(s_bus);
+    }
+    return err;
+}
+
+static void bq_health(sensor_health_t *out)
+{
+    *out = s_health;
+}
+
+const sensor_backend_t sensor_backend_bq76952 = {
+    .name = "bq76952",
+    .init = bq_init,
+    .read = bq_read,
+    .health = bq_health,
+};
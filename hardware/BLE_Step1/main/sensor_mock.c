@@ -0,0 +1,122 @@
+#include "sensor_backend.h"
+
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_random.h"
+
+// Synthetic pack used when no AFE is fitted.
+
+static uint16_t rand_u16(uint16_t min, uint16_t max)
+{
+    if (max <= min) return min;
+    return (uint16_t)(min + (esp_random() % (max - min + 1)));
+}
+
+static int16_t rand_i16(int16_t min, int16_t max)
+{
+    if (max <= min) return min;
+    return (int16_t)(min + (int32_t)(esp_random() % (uint32_t)(max - min + 1)));
+}
+
+// The mock alternates rest and load phases so the adaptive sampler sees
+// realistic activity: near-zero current with flat cells at rest, a noisy
+// load current with IR sag on the cells under load.
+typedef struct {
+    bool init;
+    bool load;
+    int remaining;              // samples left in the current phase
+    int16_t load_ma;            // phase target current
+    uint16_t base_mv;
+    int16_t cell_offset_mv[16];
+} mock_state_t;
+
+static mock_state_t s_mock;
+static uint32_t s_mock_reads;
+
+static void mock_next_phase(void)
+{
+    if (!s_mock.init) {
+        s_mock.init = true;
+        s_mock.base_mv = rand_u16(3600, 4100);
+        for (int i = 0; i < 16; i++) {
+            s_mock.cell_offset_mv[i] = rand_i16(-15, 15);  // small cell-to-cell variation
+        }
+    }
+
+    s_mock.load = !s_mock.load;
+    s_mock.remaining = rand_u16(20, 120);
+    s_mock.load_ma = s_mock.load ? rand_i16(-5000, 3000) : 0;
+}
+
+static esp_err_t mock_read(battery_log_t *r)
+{
+    memset(r, 0, sizeof(*r));
+
+    r->timestamp_s = (uint32_t)(esp_timer_get_time() / 1000000ULL);
+
+    if (!s_mock.init || s_mock.remaining-- <= 0) {
+        mock_next_phase();
+    }
+
+    // Current -5000 to +5000 mA under load, a few mA of offset at rest
+    int32_t cur = s_mock.load ? s_mock.load_ma + rand_i16(-300, 300) : rand_i16(-20, 20);
+    if (cur < -5000) cur = -5000;
+    if (cur > 5000) cur = 5000;
+    r->current_ma = (int16_t)cur;
+
+    if (s_mock.load && s_mock.load_ma < 0 && s_mock.base_mv > 3400 && rand_u16(0, 9) == 0) {
+        s_mock.base_mv--;   // slow discharge
+    }
+
+    // ~10 mOhm per cell of IR drop/rise
+    int16_t ir_mv = (int16_t)(cur / 100);
+
+    uint32_t sum = 0;
+    for (int i = 0; i < 16; i++) {
+        int32_t v = (int32_t)s_mock.base_mv + s_mock.cell_offset_mv[i] + ir_mv + rand_i16(-1, 1);
+
+        // clamp
+        if (v < 3300) v = 3300;
+        if (v > 4200) v = 4200;
+
+        r->cell_mv[i] = (uint16_t)v;
+        sum += (uint32_t)v;
+    }
+
+    r->pack_total_mv = (uint16_t)sum;
+
+    // Load drop 20–150 mV (just a mock)
+    uint16_t drop = rand_u16(20, 150);
+    r->pack_ld_mv = (r->pack_total_mv > drop) ? (r->pack_total_mv - drop) : r->pack_total_mv;
+
+    r->pack_sum_active_mv = r->pack_total_mv;
+
+    // Temps: 20.00°C–45.00°C
+    r->temp_ts1_c_x100 = (int16_t)rand_u16(2000, 4500);
+    r->temp_int_c_x100 = (int16_t)rand_u16(2000, 4500);
+
+    // soc is left to the estimator (soc_est), as with the AFE.
+
+    s_mock_reads++;
+    return ESP_OK;
+}
+
+static esp_err_t mock_init(void)
+{
+    memset(&s_mock, 0, sizeof(s_mock));
+    s_mock_reads = 0;
+    return ESP_OK;
+}
+
+static void mock_health(sensor_health_t *out)
+{
+    out->ok = true;
+    out->reads = s_mock_reads;
+}
+
+const sensor_backend_t sensor_backend_mock = {
+    .name = "mock",
+    .init = mock_init,
+    .read = mock_read,
+    .health = mock_health,
+};
@@ -0,0 +1,213 @@
+#include "sensor_backend.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "file_pool.h"
+
+/*
+ * Replays a recorded capture as if it came from the AFE.
+ *
+ * ".bin" files are raw battery_log_t records (battery.bin layout). Anything
+ * else is CSV with a header row; columns are matched by name, unknown ones
+ * are ignored and missing ones read as 0. Column names follow the record
+ * fields, cells as cell1_mv..cell16_mv.
+ */
+
+static const char *TAG = "REPLAY";
+
+#ifndef LOG_BASE_PATH
+#define LOG_BASE_PATH "/littlefs"
+#endif
+#ifndef SENSOR_REPLAY_PATH
+#define SENSOR_REPLAY_PATH LOG_BASE_PATH "/replay.csv"
+#endif
+
+#define REPLAY_LINE_MAX  512
+#define REPLAY_MAX_COLS  40
+
+typedef enum {
+    COL_SKIP = 0,
+    COL_SEQ,
+    COL_TIMESTAMP,
+    COL_CELL,           // + cell index in col_cell[]
+    COL_PACK_TOTAL,
+    COL_PACK_LD,
+    COL_PACK_SUM,
+    COL_CURRENT,
+    COL_TEMP_TS1,
+    COL_TEMP_INT,
+    COL_SOC,
+} replay_col_t;
+
+static char s_path[128] = SENSOR_REPLAY_PATH;
+static bool s_loop = true;
+static FILE *s_f = NULL;
+static bool s_bin = false;
+static uint8_t s_cols[REPLAY_MAX_COLS];
+static uint8_t s_col_cell[REPLAY_MAX_COLS];
+static int s_ncols = 0;
+static sensor_health_t s_health;
+
+void sensor_replay_set_source(const char *path, bool loop)
+{
+    if (path) {
+        strncpy(s_path, path, sizeof(s_path) - 1);
+        s_path[sizeof(s_path) - 1] = '\0';
+    }
+    s_loop = loop;
+}
+
+static bool ends_with(const char *s, const char *suffix)
+{
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static replay_col_t col_from_name(const char *name, uint8_t *cell)
+{
+    int idx;
+    if (sscanf(name, "cell%d_mv", &idx) == 1 && idx >= 1 && idx <= 16) {
+        *cell = (uint8_t)(idx - 1);
+        return COL_CELL;
+    }
+    if (strcmp(name, "seq") == 0)                return COL_SEQ;
+    if (strcmp(name, "timestamp_s") == 0)        return COL_TIMESTAMP;
+    if (strcmp(name, "pack_total_mv") == 0)      return COL_PACK_TOTAL;
+    if (strcmp(name, "pack_ld_mv") == 0)         return COL_PACK_LD;
+    if (strcmp(name, "pack_sum_active_mv") == 0) return COL_PACK_SUM;
+    if (strcmp(name, "current_ma") == 0)         return COL_CURRENT;
+    if (strcmp(name, "temp_ts1_c_x100") == 0)    return COL_TEMP_TS1;
+    if (strcmp(name, "temp_int_c_x100") == 0)    return COL_TEMP_INT;
+    if (strcmp(name, "soc") == 0)                return COL_SOC;
+    return COL_SKIP;
+}
+
+static esp_err_t parse_header(void)
+{
+    char line[REPLAY_LINE_MAX];
+    if (!fgets(line, sizeof(line), s_f)) return ESP_ERR_INVALID_SIZE;
+
+    s_ncols = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(line, ",\r\n", &save);
+         tok && s_ncols < REPLAY_MAX_COLS;
+         tok = strtok_r(NULL, ",\r\n", &save)) {
+        while (*tok == ' ') tok++;
+        s_cols[s_ncols] = (uint8_t)col_from_name(tok, &s_col_cell[s_ncols]);
+        s_ncols++;
+    }
+    return s_ncols > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t replay_open(void)
+{
+    s_f = file_pool_open(s_path, "rb");
+    if (!s_f) {
+        ESP_LOGE(TAG, "cannot open %s", s_path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_bin = ends_with(s_path, ".bin");
+    return s_bin ? ESP_OK : parse_header();
+}
+
+static esp_err_t replay_init(void)
+{
+    memset(&s_health, 0, sizeof(s_health));
+    if (s_f) {
+        file_pool_close(s_f);
+        s_f = NULL;
+    }
+
+    esp_err_t err = replay_open();
+    if (err != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "replaying %s (%s%s)", s_path, s_bin ? "bin" : "csv", s_loop ? ", loop" : "");
+    s_health.ok = true;
+    return ESP_OK;
+}
+
+static bool parse_row(char *line, battery_log_t *r)
+{
+    memset(r, 0, sizeof(*r));
+
+    int col = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(line, ",\r\n", &save);
+         tok && col < s_ncols;
+         tok = strtok_r(NULL, ",\r\n", &save), col++) {
+        long v = strtol(tok, NULL, 10);
+        switch ((replay_col_t)s_cols[col]) {
+            case COL_SEQ:        r->seq = (uint32_t)v; break;
+            case COL_TIMESTAMP:  r->timestamp_s = (uint32_t)v; break;
+            case COL_CELL:       r->cell_mv[s_col_cell[col]] = (uint16_t)v; break;
+            case COL_PACK_TOTAL: r->pack_total_mv = (uint16_t)v; break;
+            case COL_PACK_LD:    r->pack_ld_mv = (uint16_t)v; break;
+            case COL_PACK_SUM:   r->pack_sum_active_mv = (uint16_t)v; break;
+            case COL_CURRENT:    r->current_ma = (int16_t)v; break;
+            case COL_TEMP_TS1:   r->temp_ts1_c_x100 = (int16_t)v; break;
+            case COL_TEMP_INT:   r->temp_int_c_x100 = (int16_t)v; break;
+            case COL_SOC:        r->soc = (uint8_t)v; break;
+            default: break;
+        }
+    }
+    return col > 0;
+}
+
+static bool next_record(battery_log_t *r)
+{
+    if (s_bin) {
+        return fread(r, sizeof(*r), 1, s_f) == 1;
+    }
+
+    char line[REPLAY_LINE_MAX];
+    while (fgets(line, sizeof(line), s_f)) {
+        if (parse_row(line, r)) return true;   // skip blank lines
+    }
+    return false;
+}
+
+static esp_err_t replay_read(battery_log_t *r)
+{
+    if (!s_f) return ESP_ERR_INVALID_STATE;
+
+    bool got = next_record(r);
+    if (!got && s_loop) {
+        file_pool_close(s_f);
+        s_f = NULL;
+        if (replay_open() == ESP_OK) {
+            got = next_record(r);
+        }
+    }
+
+    s_health.reads++;
+    s_health.ok = got;
+    if (!got) {
+        s_health.errors++;
+        s_health.consecutive_errors++;
+        s_health.last_err = ESP_ERR_NOT_FOUND;
+        return ESP_ERR_NOT_FOUND;   // end of capture
+    }
+
+    // The logger owns these; the capture's values are history.
+    r->seq = 0;
+    r->interval_s = 0;
+    r->rate = 0;
+
+    s_health.consecutive_errors = 0;
+    s_health.last_err = ESP_OK;
+    return ESP_OK;
+}
+
+static void replay_health(sensor_health_t *out)
+{
+    *out = s_health;
+}
+
+const sensor_backend_t sensor_backend_replay = {
+    .name = "replay",
+    .init = replay_init,
+    .read = replay_read,
+    .health = replay_health,
+};
@@ -0,0 +1,324 @@
+#include "serial_dump.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "battery_log.h"
+#include "ble_stats.h"
+#include "mem_plan.h"
+
+static const char *TAG = "SERIAL_DUMP";
+
+#define SERIAL_DUMP_STACK   3072
+#define SERIAL_DUMP_PRIO    2
+#define RX_RING_LEN         256         // requests are a few bytes
+#define TX_RING_LEN         4096        // four DATA frames behind the FIFO
+#define BAUD_MIN            9600
+
+typedef struct {
+    bool     active;
+    uint8_t  tag;
+    uint16_t frames;
+    uint32_t next;          // seq of the next record to send
+    uint32_t left;          // records before END LIMIT
+    uint32_t sent;
+    int      idx;           // log index of `next` if it follows on; -1 to look it up
+} stream_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static serial_dump_stats_t s_stats;
+
+// Only the dump task touches these.
+static dump_parser_t s_rx;
+static uint8_t s_frame[DUMP_FRAME_MAX];
+static battery_log_t s_recs[SERIAL_DUMP_RECS_PER_FRAME];
+static stream_t s_st;
+static bool s_session = false;
+
+static uint32_t s_baud = SERIAL_DUMP_CONSOLE_BAUD;
+
+// ---------------------------------------------------------------- UART
+
+// What is there, or (wait > 0) block for the first byte: uart_read_bytes()
+// itself waits until all `len` have come.
+static int uart_recv(uint8_t *buf, size_t len, TickType_t wait)
+{
+    size_t avail = 0;
+    if (uart_get_buffered_data_len(SERIAL_DUMP_UART, &avail) != ESP_OK) return -1;
+    if (avail == 0) {
+        if (wait == 0) return 0;
+        int n = uart_read_bytes(SERIAL_DUMP_UART, buf, 1, wait);
+        if (n <= 0) return n;
+        if (uart_get_buffered_data_len(SERIAL_DUMP_UART, &avail) != ESP_OK) return -1;
+        if (avail > len - 1) avail = len - 1;
+        int m = avail ? uart_read_bytes(SERIAL_DUMP_UART, buf + 1, avail, 0) : 0;
+        return m < 0 ? -1 : 1 + m;
+    }
+    if (avail > len) avail = len;
+    return uart_read_bytes(SERIAL_DUMP_UART, buf, avail, 0);
+}
+
+// Blocks while the TX ring is full: the UART paces the stream.
+static void send_frame(uint8_t type, size_t payload_len)
+{
+    size_t len = dump_frame_seal(s_frame, type, payload_len);
+    if (uart_write_bytes(SERIAL_DUMP_UART, s_frame, len) < 0) return;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += len;
+    if (type == DUMP_T_DATA) s_stats.frames++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void set_baud(uint32_t baud)
+{
+    if (baud == s_baud) return;
+    // The frame before (INFO) goes out at the old rate.
+    uart_wait_tx_done(SERIAL_DUMP_UART, pdMS_TO_TICKS(100));
+    uart_set_baudrate(SERIAL_DUMP_UART, baud);
+    s_baud = baud;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.baud = baud;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// ---------------------------------------------------------------- stream
+
+static void send_info(uint32_t baud)
+{
+    battery_log_summary_t sum = { 0 };
+    battery_log_get_summary(&sum);
+
+    uint8_t *p = s_frame + DUMP_FRAME_HDR_LEN;
+    p[0] = DUMP_PROTO_VERSION;
+    p[1] = LOG_RECORD_VERSION;
+    dump_put_u16(&p[2], LOG_RECORD_SIZE_BYTES);
+    dump_put_u32(&p[4], sum.count);
+    dump_put_u32(&p[8], sum.first_seq);
+    dump_put_u32(&p[12], sum.last_seq);
+    dump_put_u32(&p[16], baud);
+    int table = log_schema_table(p + DUMP_INFO_HDR_LEN, DUMP_FRAME_PAYLOAD_MAX - DUMP_INFO_HDR_LEN);
+    send_frame(DUMP_T_INFO, DUMP_INFO_HDR_LEN + (table > 0 ? table : 0));
+}
+
+static void end_stream(uint8_t status)
+{
+    uint8_t *p = s_frame + DUMP_FRAME_HDR_LEN;
+    p[0] = s_st.tag;
+    p[1] = status;
+    dump_put_u16(&p[2], s_st.frames);
+    dump_put_u32(&p[4], s_st.sent);
+    dump_put_u32(&p[8], s_st.next);
+    send_frame(DUMP_T_END, DUMP_END_LEN);
+    s_st.active = false;
+}
+
+// The next frame's records from s_st.next on: 0 when caught up, -1 if the
+// log could not be read. The writer's appends and the partition store's
+// evictions can move the index between frames; a record that does not
+// follow on (or a gap in the seqs) means it is looked up again, and a
+// record out of order ends the frame, like wifi_offload's batches.
+static int read_frame_records(uint32_t want)
+{
+    int count = battery_log_count();
+    int idx = s_st.idx;
+    battery_log_t *r = &s_recs[0];
+
+    if (idx < 0 || idx >= count || !battery_log_read(idx, r) || r->seq != s_st.next) {
+        idx = battery_log_find_start_index_by_seq(s_st.next);
+        if (idx < 0 || idx >= count) return 0;
+        if (!battery_log_read(idx, r)) return -1;
+        if (r->seq < s_st.next) return 0;
+    }
+
+    uint32_t n = 1;
+    while (n < want && idx + (int)n < count) {
+        if (!battery_log_read(idx + (int)n, &s_recs[n]) || s_recs[n].seq <= s_recs[n - 1].seq) break;
+        n++;
+    }
+    s_st.idx = idx + (int)n;
+    return (int)n;
+}
+
+// Holds the log for the frame: find, count and reads see one log.
+static int read_records(uint32_t want)
+{
+    battery_log_lock();
+    int n = read_frame_records(want);
+    battery_log_unlock();
+    return n;
+}
+
+static void stream_step(void)
+{
+    if (s_st.left == 0) {
+        end_stream(DUMP_END_LIMIT);
+        return;
+    }
+    uint32_t want = s_st.left < SERIAL_DUMP_RECS_PER_FRAME ? s_st.left : SERIAL_DUMP_RECS_PER_FRAME;
+    int n = read_records(want);
+    if (n <= 0) {
+        end_stream(n < 0 ? DUMP_END_READ_ERR : DUMP_END_DONE);
+        return;
+    }
+
+    uint8_t *p = s_frame + DUMP_FRAME_HDR_LEN;
+    p[0] = s_st.tag;
+    p[1] = (uint8_t)n;
+    dump_put_u16(&p[2], s_st.frames);
+    for (int i = 0; i < n; i++) {
+        log_record_encode(&s_recs[i], p + DUMP_DATA_HDR_LEN + i * LOG_RECORD_SIZE_BYTES);
+    }
+    send_frame(DUMP_T_DATA, DUMP_DATA_HDR_LEN + (size_t)n * LOG_RECORD_SIZE_BYTES);
+
+    s_st.frames++;
+    s_st.next = s_recs[n - 1].seq + 1;
+    s_st.left -= (uint32_t)n;
+    s_st.sent += (uint32_t)n;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.records += (uint32_t)n;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// ---------------------------------------------------------------- requests
+
+static void end_session(void)
+{
+    s_st.active = false;
+    s_session = false;
+    set_baud(SERIAL_DUMP_CONSOLE_BAUD);
+}
+
+static void handle_frame(void)
+{
+    const uint8_t *p = s_rx.payload;
+    switch (s_rx.type) {
+    case DUMP_T_HELLO: {
+        if (s_rx.len != DUMP_HELLO_LEN) break;
+        uint32_t baud = dump_get_u32(p);
+        if (baud < BAUD_MIN) baud = s_baud;
+        if (baud > SERIAL_DUMP_BAUD_MAX) baud = SERIAL_DUMP_BAUD_MAX;
+        s_st.active = false;
+        s_session = true;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.sessions++;
+        portEXIT_CRITICAL(&s_lock);
+        send_info(baud);
+        set_baud(baud);
+        return;
+    }
+    case DUMP_T_READ: {
+        if (s_rx.len != DUMP_READ_LEN) break;
+        uint32_t max = dump_get_u32(&p[4]);
+        s_st = (stream_t){
+            .active = true,
+            .tag = p[8],
+            .next = dump_get_u32(&p[0]),
+            .left = max ? max : UINT32_MAX,
+            .idx = -1,
+        };
+        s_session = true;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.reads++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    case DUMP_T_ABORT:
+        end_stream(DUMP_END_ABORTED);
+        return;
+    case DUMP_T_BYE:
+        end_session();
+        return;
+    default:
+        return;             // a newer host's request: ignored
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bad_frames++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void serial_dump_run(void)
+{
+    uint8_t rx[64];
+    for (;;) {
+        // Streaming: only look for a request between frames. In a session:
+        // wait for the next one, but not forever at the session's baud.
+        TickType_t wait = s_st.active ? 0
+                        : s_session   ? pdMS_TO_TICKS(SERIAL_DUMP_IDLE_MS)
+                                      : portMAX_DELAY;
+        int n = uart_recv(rx, sizeof(rx), wait);
+        if (n < 0) return;
+        if (n == 0 && wait != 0) {
+            ESP_LOGW(TAG, "host silent for %d ms: session over", SERIAL_DUMP_IDLE_MS);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.idle_timeouts++;
+            portEXIT_CRITICAL(&s_lock);
+            end_session();
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            dump_parse_t r = dump_parser_push(&s_rx, rx[i]);
+            if (r == DUMP_PARSE_FRAME) {
+                handle_frame();
+            } else if (r == DUMP_PARSE_BAD) {
+                portENTER_CRITICAL(&s_lock);
+                s_stats.bad_frames++;
+                portEXIT_CRITICAL(&s_lock);
+            }
+        }
+        if (s_st.active) stream_step();
+    }
+}
+
+static void serial_dump_task(void *arg)
+{
+    serial_dump_run();
+    ESP_LOGE(TAG, "UART%d failed: dump off", SERIAL_DUMP_UART);
+    vTaskDelete(NULL);
+}
+
+static int dump_stats_section(char *buf, size_t len)
+{
+    serial_dump_stats_t st;
+    serial_dump_get_stats(&st);
+    return snprintf(buf, len,
+                    "sessions=%" PRIu32 ",reads=%" PRIu32 ",records=%" PRIu32 ",frames=%" PRIu32
+                    ",bytes=%" PRIu32 ",bad=%" PRIu32 ",idle=%" PRIu32 ",baud=%" PRIu32,
+                    st.sessions, st.reads, st.records, st.frames, st.bytes, st.bad_frames,
+                    st.idle_timeouts, st.baud);
+}
+
+void serial_dump_init(void)
+{
+    if (!SERIAL_DUMP_ENABLE) return;
+
+    esp_err_t err = uart_driver_install(SERIAL_DUMP_UART, RX_RING_LEN, TX_RING_LEN, 0, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "UART%d driver: %s", SERIAL_DUMP_UART, esp_err_to_name(err));
+        return;
+    }
+    // Console output through the driver as well: a log line is queued whole
+    // between two frames instead of going to the FIFO in the middle of one.
+    uart_vfs_dev_use_driver(SERIAL_DUMP_UART);
+    s_stats.baud = s_baud;
+    ble_stats_register_section("dump", dump_stats_section);
+
+    static StackType_t s_stack[SERIAL_DUMP_STACK];
+    static StaticTask_t s_tcb;
+    TaskHandle_t task = xTaskCreateStatic(serial_dump_task, "serial_dump", SERIAL_DUMP_STACK, NULL,
+                                          SERIAL_DUMP_PRIO, s_stack, &s_tcb);
+    mem_plan_watch_task(task, SERIAL_DUMP_STACK);
+    ESP_LOGI(TAG, "log dump on UART%d, up to %d baud", SERIAL_DUMP_UART, SERIAL_DUMP_BAUD_MAX);
+}
+
+void serial_dump_get_stats(serial_dump_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
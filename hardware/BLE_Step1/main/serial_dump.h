@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "dump_frame.h"
+#include "log_schema.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wired log dump over the console UART.
+ *
+ * A technician's PC pulls the log through the board's USB-serial bridge
+ * (host/tools/dumprecv): it says HELLO at the console baud, both ends
+ * switch to SERIAL_DUMP_BAUD, and the log streams as CRC'd DATA frames of
+ * SERIAL_DUMP_RECS_PER_FRAME records (dump_frame.h) as fast as the UART
+ * sends them. The receiver keeps the seq after the last record it got
+ * intact and resumes from there (a new READ) after a bad or lost frame, or
+ * in a later session. The session ends with BYE, or after
+ * SERIAL_DUMP_IDLE_MS without a frame from the host; the UART goes back to
+ * the console baud either way.
+ *
+ * The classic ESP32 has no USB device, so "USB" is the bridge chip on UART0;
+ * CP2102 boards top out at 921600, CH34x ones run 2000000. Console output
+ * keeps going during a session through the same driver, so it lands between
+ * frames, never inside one, and the receiver skips it.
+ * See docs/SERIAL_DUMP.md.
+ */
+#ifndef SERIAL_DUMP_ENABLE
+#define SERIAL_DUMP_ENABLE 1
+#endif
+
+#ifndef SERIAL_DUMP_UART
+#define SERIAL_DUMP_UART        0           // console UART, behind the USB bridge
+#endif
+#ifndef SERIAL_DUMP_BAUD
+#define SERIAL_DUMP_BAUD        921600      // what dumprecv asks for by default
+#endif
+#ifndef SERIAL_DUMP_BAUD_MAX
+#define SERIAL_DUMP_BAUD_MAX    2000000     // a HELLO above this gets this
+#endif
+#ifdef CONFIG_ESP_CONSOLE_UART_BAUDRATE
+#define SERIAL_DUMP_CONSOLE_BAUD CONFIG_ESP_CONSOLE_UART_BAUDRATE
+#else
+#define SERIAL_DUMP_CONSOLE_BAUD 115200
+#endif
+#define SERIAL_DUMP_IDLE_MS     3000
+#define SERIAL_DUMP_RECS_PER_FRAME \
+    ((DUMP_FRAME_PAYLOAD_MAX - DUMP_DATA_HDR_LEN) / LOG_RECORD_SIZE_BYTES)    // 18
+
+typedef struct {
+    uint32_t sessions;          // HELLOs
+    uint32_t reads;             // READs; after the first of a session, resumes
+    uint32_t records;
+    uint32_t frames;            // DATA
+    uint32_t bytes;             // sent, framing included
+    uint32_t bad_frames;        // from the host: CRC / length
+    uint32_t idle_timeouts;     // sessions ended without BYE
+    uint32_t baud;              // current
+} serial_dump_stats_t;
+
+/** Install the UART driver and start the dump task (after battery_log_init). */
+void serial_dump_init(void);
+
+/**
+ * @brief The dump task's loop: serve sessions on SERIAL_DUMP_UART. Returns
+ *        only if the UART fails (host benches run it on a thread, over a
+ *        pty, and return by closing it).
+ */
+void serial_dump_run(void);
+
+void serial_dump_get_stats(serial_dump_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
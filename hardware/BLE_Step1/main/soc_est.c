@@ -0,0 +1,302 @@
+#include "soc_est.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "ble_stats.h"
+
+static const char *TAG = "SOC_EST";
+
+#define NVS_NS_SOC          "soc"
+#define NVS_KEY_STATE       "state"
+#define SOC_CKPT_VERSION    1
+
+#define UAS_PER_MAH         3600000000LL    // mA*us in one mAh
+#define UAS_PER_MAS         1000000LL
+#define CAP_MIN_MAH         (SOC_EST_CAPACITY_MAH / 2)
+#define CAP_MAX_MAH         (SOC_EST_CAPACITY_MAH + SOC_EST_CAPACITY_MAH / 10)
+#define CAP_SPAN_MIN_BP     3000            // OCV points this far apart re-estimate capacity
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  has_anchor;
+    uint16_t cap_mah;
+    int32_t  charge_mas;
+    int32_t  anchor_net_mas;
+    uint16_t anchor_soc_bp;
+    uint16_t _pad;
+} soc_ckpt_t;
+
+_Static_assert(sizeof(soc_ckpt_t) == 16, "checkpoint layout");
+_Static_assert(CAP_MAX_MAH <= UINT16_MAX, "capacity is kept in 16 bits");
+
+// Resting open-circuit voltage per cell at 0, 10, ... 100 % (NMC).
+static const uint16_t s_ocv_mv[11] = {
+    3300, 3550, 3640, 3690, 3730, 3770, 3830, 3910, 3990, 4080, 4190,
+};
+
+// Share of the capacity usable at temperature (°C x100), permille.
+#define TEMP_POINTS 5
+static const int16_t s_temp_c_x100[TEMP_POINTS] = { -2000, -1000, 0, 1000, 2500 };
+static const uint16_t s_temp_avail[TEMP_POINTS] = { 600, 700, 800, 900, 1000 };
+
+typedef struct {
+    bool     seeded;
+    bool     has_prev;
+    bool     has_anchor;
+    bool     fixed_this_rest;
+    int16_t  prev_ma;
+    int64_t  prev_us;
+    int64_t  q_uas;             // charge held, mA*us
+    int64_t  anchor_net_uas;    // counted since the last OCV point
+    uint16_t anchor_soc_bp;
+    uint16_t cap_mah;
+    int64_t  rest_us;
+    uint16_t soc_bp;
+    uint16_t soc_raw_bp;
+    uint32_t ocv_fixes;
+    uint32_t cap_updates;
+} soc_state_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static soc_state_t s;
+static uint16_t s_saved_bp = 0;
+static bool s_force_save = false;
+static bool s_stats_registered = false;
+
+uint16_t soc_est_ocv_to_bp(uint16_t cell_mv)
+{
+    if (cell_mv <= s_ocv_mv[0]) return 0;
+    if (cell_mv >= s_ocv_mv[10]) return 10000;
+    int i = 0;
+    while (cell_mv >= s_ocv_mv[i + 1]) i++;
+    uint32_t span = (uint32_t)(s_ocv_mv[i + 1] - s_ocv_mv[i]);
+    return (uint16_t)(i * 1000 + (uint32_t)(cell_mv - s_ocv_mv[i]) * 1000u / span);
+}
+
+static uint32_t temp_avail_permille(int16_t c_x100)
+{
+    if (c_x100 <= s_temp_c_x100[0]) return s_temp_avail[0];
+    if (c_x100 >= s_temp_c_x100[TEMP_POINTS - 1]) return s_temp_avail[TEMP_POINTS - 1];
+    int i = 0;
+    while (c_x100 >= s_temp_c_x100[i + 1]) i++;
+    int32_t span = s_temp_c_x100[i + 1] - s_temp_c_x100[i];
+    int32_t d = s_temp_avail[i + 1] - s_temp_avail[i];
+    return (uint32_t)(s_temp_avail[i] + d * (c_x100 - s_temp_c_x100[i]) / span);
+}
+
+static int64_t cap_uas(void)
+{
+    return (int64_t)s.cap_mah * UAS_PER_MAH;
+}
+
+static uint16_t clamp_bp(int64_t bp)
+{
+    return (uint16_t)(bp < 0 ? 0 : bp > 10000 ? 10000 : bp);
+}
+
+static uint16_t mean_cell_mv(const battery_log_t *rec)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < 16; i++) sum += rec->cell_mv[i];
+    return (uint16_t)((sum + 8) / 16);
+}
+
+// Caller holds s_lock. The pack has rested: correct the count from OCV.
+static void ocv_correct(uint16_t ocv_bp)
+{
+    if (s.has_anchor) {
+        int32_t dsoc = (int32_t)ocv_bp - (int32_t)s.anchor_soc_bp;
+        int64_t net = s.anchor_net_uas;
+        bool agree = (dsoc > 0 && net > 0) || (dsoc < 0 && net < 0);
+        if (agree && (dsoc >= CAP_SPAN_MIN_BP || dsoc <= -CAP_SPAN_MIN_BP)) {
+            int64_t est = (net < 0 ? -net : net) * 10000 / (dsoc < 0 ? -dsoc : dsoc) / UAS_PER_MAH;
+            if (est < CAP_MIN_MAH) est = CAP_MIN_MAH;
+            if (est > CAP_MAX_MAH) est = CAP_MAX_MAH;
+            s.cap_mah = (uint16_t)(s.cap_mah + (est - s.cap_mah) / 4);
+            s.cap_updates++;
+        }
+    }
+
+    int64_t q_ocv = cap_uas() * ocv_bp / 10000;
+    s.q_uas += (q_ocv - s.q_uas) / 2;
+    s.has_anchor = true;
+    s.anchor_soc_bp = ocv_bp;
+    s.anchor_net_uas = 0;
+    s.ocv_fixes++;
+    s_force_save = true;
+}
+
+uint8_t soc_est_update(battery_log_t *rec, int64_t now_us)
+{
+    int16_t ma = rec->current_ma;
+    uint16_t ocv_bp = soc_est_ocv_to_bp(mean_cell_mv(rec));
+
+    portENTER_CRITICAL(&s_lock);
+    if (!s.seeded) {
+        s.q_uas = cap_uas() * ocv_bp / 10000;
+        s.seeded = true;
+        s_force_save = true;
+    }
+
+    int64_t dt = s.has_prev ? now_us - s.prev_us : -1;
+    if (dt > 0 && dt <= (int64_t)SOC_EST_MAX_GAP_S * 1000000) {
+        int64_t dq = ((int64_t)s.prev_ma + ma) * dt / 2;
+        s.q_uas += dq;
+        s.anchor_net_uas += dq;
+
+        bool rest = ma < SOC_EST_REST_MA && ma > -SOC_EST_REST_MA &&
+                    s.prev_ma < SOC_EST_REST_MA && s.prev_ma > -SOC_EST_REST_MA;
+        s.rest_us = rest ? s.rest_us + dt : 0;
+    } else {
+        s.rest_us = 0;      // unknown interval: start the rest period over
+    }
+    if (s.rest_us == 0) s.fixed_this_rest = false;
+    s.prev_ma = ma;
+    s.prev_us = now_us;
+    s.has_prev = true;
+
+    if (s.rest_us >= (int64_t)SOC_EST_REST_S * 1000000 && !s.fixed_this_rest) {
+        ocv_correct(ocv_bp);
+        s.fixed_this_rest = true;
+    }
+
+    int64_t cap = cap_uas();
+    if (s.q_uas < 0) s.q_uas = 0;
+    if (s.q_uas > cap) s.q_uas = cap;
+
+    // Cold: the bottom (1000 - avail) permille of the charge can't be drawn.
+    int64_t avail = temp_avail_permille(rec->temp_ts1_c_x100);
+    int64_t usable = cap * avail / 1000;
+    s.soc_raw_bp = clamp_bp(s.q_uas * 10000 / cap);
+    s.soc_bp = clamp_bp((s.q_uas - (cap - usable)) * 10000 / usable);
+    uint16_t soc_bp = s.soc_bp;
+    portEXIT_CRITICAL(&s_lock);
+
+    rec->soc = (uint8_t)((soc_bp + 50) / 100);
+    return rec->soc;
+}
+
+static void save(void)
+{
+    soc_ckpt_t c;
+    memset(&c, 0, sizeof(c));
+
+    portENTER_CRITICAL(&s_lock);
+    c.version = SOC_CKPT_VERSION;
+    c.has_anchor = s.has_anchor;
+    c.cap_mah = s.cap_mah;
+    c.charge_mas = (int32_t)(s.q_uas / UAS_PER_MAS);
+    c.anchor_net_mas = (int32_t)(s.anchor_net_uas / UAS_PER_MAS);
+    c.anchor_soc_bp = s.anchor_soc_bp;
+    uint16_t bp = s.soc_raw_bp;
+    s_force_save = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NS_SOC, NVS_READWRITE, &h) != ESP_OK) return;
+    esp_err_t err = nvs_set_blob(h, NVS_KEY_STATE, &c, sizeof(c));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err == ESP_OK) {
+        s_saved_bp = bp;
+    } else {
+        ESP_LOGW(TAG, "checkpoint write failed: %s", esp_err_to_name(err));
+    }
+}
+
+void soc_est_persist(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool due = s.seeded &&
+               (s_force_save || s.soc_raw_bp >= s_saved_bp + 100 || s.soc_raw_bp + 100 <= s_saved_bp);
+    portEXIT_CRITICAL(&s_lock);
+    if (due) save();
+}
+
+static int soc_stats_section(char *buf, size_t len)
+{
+    soc_est_state_t st;
+    soc_est_get(&st);
+    return snprintf(buf, len,
+                    "soc_bp=%u,raw_bp=%u,soh=%u,cap_mah=%u,q_mah=%" PRId32 ",rest_s=%" PRIu32
+                    ",ocv_fixes=%" PRIu32 ",cap_updates=%" PRIu32,
+                    st.soc_bp, st.soc_raw_bp, st.soh_permille, st.cap_mah, st.charge_mah,
+                    st.rest_s, st.ocv_fixes, st.cap_updates);
+}
+
+void soc_est_init(void)
+{
+    soc_ckpt_t c;
+    size_t len = sizeof(c);
+    nvs_handle_t h;
+    bool ok = nvs_open(NVS_NS_SOC, NVS_READONLY, &h) == ESP_OK;
+    if (ok) {
+        ok = nvs_get_blob(h, NVS_KEY_STATE, &c, &len) == ESP_OK &&
+             len == sizeof(c) && c.version == SOC_CKPT_VERSION &&
+             c.cap_mah >= CAP_MIN_MAH && c.cap_mah <= CAP_MAX_MAH;
+        nvs_close(h);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    memset(&s, 0, sizeof(s));
+    s.cap_mah = SOC_EST_CAPACITY_MAH;
+    if (ok) {
+        s.seeded = true;
+        s.cap_mah = c.cap_mah;
+        s.q_uas = (int64_t)c.charge_mas * UAS_PER_MAS;
+        s.has_anchor = c.has_anchor != 0;
+        s.anchor_net_uas = (int64_t)c.anchor_net_mas * UAS_PER_MAS;
+        s.anchor_soc_bp = c.anchor_soc_bp;
+        s.soc_raw_bp = clamp_bp(s.q_uas * 10000 / cap_uas());
+        s.soc_bp = s.soc_raw_bp;
+        s_saved_bp = s.soc_raw_bp;
+    }
+    s_force_save = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!s_stats_registered) {
+        ble_stats_register_section("soc", soc_stats_section);
+        s_stats_registered = true;
+    }
+    if (ok) {
+        ESP_LOGI(TAG, "checkpoint: charge %" PRId32 " mAs, capacity %u mAh",
+                 c.charge_mas, c.cap_mah);
+    } else {
+        ESP_LOGI(TAG, "no checkpoint, seeding from OCV");
+    }
+}
+
+void soc_est_get(soc_est_state_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    out->soc_bp = s.soc_bp;
+    out->soc_raw_bp = s.soc_raw_bp;
+    out->cap_mah = s.cap_mah;
+    out->soh_permille = (uint16_t)((uint32_t)s.cap_mah * 1000u / SOC_EST_CAPACITY_MAH);
+    out->charge_mah = (int32_t)(s.q_uas / UAS_PER_MAH);
+    out->rest_s = (uint32_t)(s.rest_us / 1000000);
+    out->ocv_fixes = s.ocv_fixes;
+    out->cap_updates = s.cap_updates;
+    out->seeded = s.seeded;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void soc_est_reset(void)
+{
+    nvs_handle_t h;
+    if (nvs_open(NVS_NS_SOC, NVS_READWRITE, &h) == ESP_OK) {
+        nvs_erase_key(h, NVS_KEY_STATE);
+        nvs_commit(h);
+        nvs_close(h);
+    }
+    portENTER_CRITICAL(&s_lock);
+    memset(&s, 0, sizeof(s));
+    s.cap_mah = SOC_EST_CAPACITY_MAH;
+    s_saved_bp = 0;
+    s_force_save = false;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "battery_log.h"
+
+/**
+ * State of charge / state of health estimator.
+ *
+ * Coulomb counting on integers: current_ma is integrated (trapezoid) over
+ * the esp_timer interval between samples, in mA*us. After the pack has
+ * rested for SOC_EST_REST_S the mean cell voltage is read against an OCV
+ * table and pulls the count halfway towards it; two such rest points far
+ * enough apart also re-estimate the usable capacity (SOH). The reported
+ * SOC holds back the part of the capacity that is unavailable at low
+ * temperature. O(1) per sample, no floating point.
+ *
+ * The charge and capacity survive reboots as a 16-byte NVS checkpoint
+ * (soc_est_persist). Without one, the first sample seeds the count from OCV.
+ */
+
+// Nominal pack capacity and sign convention: positive current_ma charges.
+#ifndef SOC_EST_CAPACITY_MAH
+#define SOC_EST_CAPACITY_MAH  20000
+#endif
+#define SOC_EST_REST_MA       50        // |current| below this counts as rest
+#define SOC_EST_REST_S        900       // rest time before OCV is trusted
+#define SOC_EST_MAX_GAP_S     600       // longer gaps (reset, stalls) are not integrated
+
+typedef struct {
+    uint16_t soc_bp;            // reported SOC, 0.01 %, temperature-compensated
+    uint16_t soc_raw_bp;        // charge / usable capacity, 0.01 %
+    uint16_t soh_permille;      // usable capacity / nominal
+    uint16_t cap_mah;           // usable capacity estimate
+    int32_t  charge_mah;        // charge held
+    uint32_t rest_s;            // current rest period
+    uint32_t ocv_fixes;         // OCV corrections applied since boot
+    uint32_t cap_updates;       // capacity re-estimates since boot
+    bool     seeded;            // false until a checkpoint or first sample
+} soc_est_state_t;
+
+/** Load the checkpoint and register the "soc" stats section. */
+void soc_est_init(void);
+
+/**
+ * @brief Feed one snapshot taken at `now_us` (esp_timer) and set rec->soc.
+ * @return the reported SOC in percent
+ */
+uint8_t soc_est_update(battery_log_t *rec, int64_t now_us);
+
+/** Write the checkpoint if the SOC moved by 1 % or the capacity changed. */
+void soc_est_persist(void);
+
+void soc_est_get(soc_est_state_t *out);
+
+/** Forget everything, including the checkpoint (host harness, pack swap). */
+void soc_est_reset(void);
+
+/** OCV table lookup: mean cell voltage -> SOC in 0.01 %. */
+uint16_t soc_est_ocv_to_bp(uint16_t cell_mv);
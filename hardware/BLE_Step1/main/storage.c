@@ -8,16 +8,16 @@
 
 static const char *TAG = "storage";
 
-void storage_init(void)
-{
-    esp_vfs_littlefs_conf_t conf = {
-        .base_path = "/littlefs",
-        .partition_label = "littlefs",
-        /* don't automatically format - handle corruption explicitly */
-        .format_if_mount_failed = false,
-        .dont_mount = false
-    };
+static const esp_vfs_littlefs_conf_t conf = {
+    .base_path = "/littlefs",
+    .partition_label = "littlefs",
+    /* don't automatically format - handle corruption explicitly */
+    .format_if_mount_failed = false,
+    .dont_mount = false
+};
 
+esp_err_t storage_mount(void)
+{
     esp_err_t ret = esp_vfs_littlefs_register(&conf);
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "Mount failed (%s), formatting partition...",
@@ -27,7 +27,7 @@ void storage_init(void)
         ret = esp_vfs_littlefs_register(&conf);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "LittleFS register error after format (%s)", esp_err_to_name(ret));
-            return;
+            return ret;
         }
     }
 
@@ -37,6 +37,12 @@ void storage_init(void)
         ESP_LOGI(TAG, "LittleFS mounted at %s", conf.base_path);
         ESP_LOGI(TAG, "Partition size: total=%d, used=%d", (int)total, (int)used);
     }
+    return ESP_OK;
+}
+
+void storage_boot_diag(bool remount)
+{
+    esp_err_t ret;
 
     // Simple write test: append a single line.  This is sufficient to
     // verify the file grows across resets.  The "used" value reported by
@@ -57,17 +63,26 @@ void storage_init(void)
         fclose(f);
 
         // remount just to refresh the used measurement (optional)
-        esp_vfs_littlefs_unregister(conf.partition_label);
-        ret = esp_vfs_littlefs_register(&conf);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "re-mount failed (%s)", esp_err_to_name(ret));
+        if (remount) {
+            esp_vfs_littlefs_unregister(conf.partition_label);
+            ret = esp_vfs_littlefs_register(&conf);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "re-mount failed (%s)", esp_err_to_name(ret));
+            }
         }
         size_t total_after = 0, used_after = 0;
         if (esp_littlefs_info(conf.partition_label, &total_after, &used_after) == ESP_OK) {
-            ESP_LOGI(TAG, "After write (remount): total=%d, used=%d", (int)total_after, (int)used_after);
+            ESP_LOGI(TAG, "After write%s: total=%d, used=%d", remount ? " (remount)" : "",
+                     (int)total_after, (int)used_after);
         }
     } else {
         ESP_LOGW(TAG, "Could not open /littlefs/boot_log.txt for append");
     }
+}
 
+void storage_init(void)
+{
+    if (storage_mount() == ESP_OK) {
+        storage_boot_diag(true);
+    }
 }
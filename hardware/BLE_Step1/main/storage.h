@@ -1,9 +1,22 @@
 #pragma once
+#include <stdbool.h>
+#include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Mount LittleFS at /littlefs, formatting it if the mount fails. */
+esp_err_t storage_mount(void);
+
+/**
+ * @brief Append to boot_log.txt and log the partition usage. With `remount`
+ *        the filesystem is unmounted and mounted again to refresh the usage
+ *        numbers, which is only safe while nothing else has a file open.
+ */
+void storage_boot_diag(bool remount);
+
+/** storage_mount() then storage_boot_diag(true): the original boot sequence. */
 void storage_init(void);
 
 #ifdef __cplusplus
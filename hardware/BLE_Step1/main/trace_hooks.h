@@ -0,0 +1,28 @@
+#pragma once
+/*
+ * FreeRTOS trace hooks for trace_rec, force-included into every component
+ * by the project CMakeLists.txt when built with -D TRACE_TASK_HOOKS=1
+ * (FreeRTOS.h only defines the hook macros that are still undefined, so
+ * ours have to be seen first). Nothing else may be included from here.
+ *
+ * The switch hook expands inside tasks.c, right after the scheduler picked
+ * the next task, so it can read pxCurrentTCBs like ESP-IDF's own SystemView
+ * port does. It runs with interrupts off on every context switch:
+ * trace_rec_task_in() is in IRAM, takes no lock, returns at once while the
+ * recorder is disarmed and otherwise finds the task's slot by its TCB.
+ */
+#ifndef __ASSEMBLER__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void trace_rec_task_in(void *tcb);
+void trace_rec_task_deleted(void *tcb);
+#ifdef __cplusplus
+}
+#endif
+
+#define traceTASK_SWITCHED_IN()  trace_rec_task_in((void *)pxCurrentTCBs[xPortGetCoreID()])
+#define traceTASK_DELETE(pxTCB)  trace_rec_task_deleted((void *)(pxTCB))
+
+#endif
@@ -0,0 +1,268 @@
+#include "trace_rec.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ble_stats.h"
+
+#define RING_MASK       (TRACE_REC_EVENTS - 1)
+#define TASK_OTHER      0xFF    // task table full
+#define DUMP_LINE_BYTES 32
+#define MAP_SIZE        (2 * TRACE_REC_TASKS)   // power of two, half full at most
+#define MAP_MASK        (MAP_SIZE - 1)
+#define MAP_DELETED     ((void *)1)
+#define MAP_BUSY        ((void *)2)             // being filled in
+
+_Static_assert((TRACE_REC_EVENTS & RING_MASK) == 0, "TRACE_REC_EVENTS must be a power of two");
+_Static_assert(sizeof(trace_event_t) == 8, "trace event layout");
+_Static_assert(sizeof(trace_dump_hdr_t) == 24, "trace dump header layout");
+_Static_assert(TRACE_REC_TASKS < TASK_OTHER, "task slots");
+_Static_assert((MAP_SIZE & MAP_MASK) == 0, "TRACE_REC_TASKS must be a power of two");
+
+static const char *const k_span_names[TRACE_SPAN_COUNT] = {
+    [TRACE_SPAN_LOG_APPEND]     = "log_append",
+    [TRACE_SPAN_LOG_FLUSH]      = "log_flush",
+    [TRACE_SPAN_LOG_READ]       = "log_read",
+    [TRACE_SPAN_LOG_FIND]       = "log_find",
+    [TRACE_SPAN_LOG_IDLE]       = "log_idle",
+    [TRACE_SPAN_SENSOR_READ]    = "sensor_read",
+    [TRACE_SPAN_NOTIFY_TX]      = "notify_tx",
+    [TRACE_SPAN_OTA_BEGIN]      = "ota_begin",
+    [TRACE_SPAN_OTA_WRITE]      = "ota_write",
+    [TRACE_SPAN_OTA_END]        = "ota_end",
+    [TRACE_SPAN_BLE_CONNECT]    = "ble_connect",
+    [TRACE_SPAN_BLE_DISCONNECT] = "ble_disconnect",
+};
+
+// Writers on both cores and in the scheduler hook: slots are claimed with
+// an atomic increment instead of a lock. Two writers only collide if the
+// ring wraps while one of them is still filling its slot. Nothing is
+// recorded until the recorder is armed.
+static trace_event_t s_ring[TRACE_REC_EVENTS];
+static uint32_t s_head = 0;             // events ever recorded
+static volatile bool s_armed = TRACE_REC_ARM_AT_BOOT;
+static volatile bool s_frozen = false;
+static uint32_t s_dropped = 0;
+
+// Task slots. The name is copied on first sight so a dump still names
+// tasks that have since exited.
+static char s_task_name[TRACE_REC_TASKS][TRACE_NAME_LEN];
+static uint32_t s_task_count = 0;
+
+// TCB -> slot, open addressing on the TCB pointer: the switch hook does a
+// probe or two and never reads the name. A deleted task's entry becomes
+// MAP_DELETED, so a new task reusing its TCB gets a new slot. Entries are
+// claimed with a compare-and-swap; only different tasks race for them.
+static void *s_map_tcb[MAP_SIZE];
+static uint8_t s_map_slot[MAP_SIZE];
+
+static trace_dump_hdr_t s_dump;         // valid while frozen
+static uint32_t s_dump_first;
+
+static inline IRAM_ATTR void put(uint8_t type, uint8_t id, uint16_t arg)
+{
+    if (s_frozen) {
+        __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    uint32_t i = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    trace_event_t *e = &s_ring[i & RING_MASK];
+    e->ts_us = (uint32_t)esp_timer_get_time();
+    e->type = (uint8_t)(type | (xPortGetCoreID() << 7));
+    e->id = id;
+    e->arg = arg;
+}
+
+static inline IRAM_ATTR uint32_t map_hash(void *tcb)
+{
+    uintptr_t p = (uintptr_t)tcb;
+    return (uint32_t)(p ^ (p >> 7)) >> 2;   // TCBs are word aligned
+}
+
+static IRAM_ATTR uint8_t task_slot(void *tcb)
+{
+    uint32_t h = map_hash(tcb);
+    for (uint32_t k = 0; k < MAP_SIZE; k++) {
+        uint32_t i = (h + k) & MAP_MASK;
+        void *cur = __atomic_load_n(&s_map_tcb[i], __ATOMIC_ACQUIRE);
+        if (cur == tcb) return s_map_slot[i];
+        if (cur != NULL) continue;
+
+        // First sight: claim the entry, name a slot (TASK_OTHER once they
+        // run out), then publish the TCB. Only this task inserts itself,
+        // so a lost claim means another task took the entry: probe on.
+        void *expect = NULL;
+        if (!__atomic_compare_exchange_n(&s_map_tcb[i], &expect, MAP_BUSY, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        uint32_t slot = __atomic_fetch_add(&s_task_count, 1, __ATOMIC_ACQ_REL);
+        if (slot < TRACE_REC_TASKS) {
+            strncpy(s_task_name[slot], pcTaskGetName((TaskHandle_t)tcb), TRACE_NAME_LEN);
+        } else {
+            slot = TASK_OTHER;
+        }
+        s_map_slot[i] = (uint8_t)slot;
+        __atomic_store_n(&s_map_tcb[i], tcb, __ATOMIC_RELEASE);
+        return (uint8_t)slot;
+    }
+    return TASK_OTHER;      // map full of deleted tasks
+}
+
+IRAM_ATTR void trace_rec_task_in(void *tcb)
+{
+    if (!s_armed || s_frozen || !tcb) return;
+    put(TRACE_EV_TASK_IN, task_slot(tcb), 0);
+}
+
+IRAM_ATTR void trace_rec_task_deleted(void *tcb)
+{
+    uint32_t h = map_hash(tcb);
+    for (uint32_t k = 0; k < MAP_SIZE; k++) {
+        uint32_t i = (h + k) & MAP_MASK;
+        void *cur = __atomic_load_n(&s_map_tcb[i], __ATOMIC_ACQUIRE);
+        if (cur == NULL) return;
+        if (cur == tcb) {
+            __atomic_store_n(&s_map_tcb[i], MAP_DELETED, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+void trace_rec_event(trace_ev_type_t type, uint8_t id, uint16_t arg)
+{
+    if (!s_armed) return;
+    put((uint8_t)type, id, arg);
+}
+
+void trace_rec_arm(bool on)
+{
+    s_armed = on;
+}
+
+bool trace_rec_armed(void)
+{
+    return s_armed;
+}
+
+void trace_rec_freeze(bool on)
+{
+    if (!on) {
+        s_frozen = false;
+        return;
+    }
+    if (s_frozen) return;
+    s_frozen = true;
+
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t n = head < TRACE_REC_EVENTS ? head : TRACE_REC_EVENTS;
+    uint32_t tasks = __atomic_load_n(&s_task_count, __ATOMIC_ACQUIRE);
+
+    s_dump_first = head - n;
+    s_dump = (trace_dump_hdr_t) {
+        .magic = TRACE_DUMP_MAGIC,
+        .version = TRACE_DUMP_VERSION,
+        .n_tasks = (uint8_t)(tasks < TRACE_REC_TASKS ? tasks : TRACE_REC_TASKS),
+        .n_spans = TRACE_SPAN_COUNT,
+        .name_len = TRACE_NAME_LEN,
+        .n_events = n,
+        .lost = head - n,
+        .dropped = s_dropped,
+        .t_dump_us = (uint32_t)esp_timer_get_time(),
+    };
+}
+
+bool trace_rec_frozen(void)
+{
+    return s_frozen;
+}
+
+static size_t names_len(void)
+{
+    return (size_t)(s_dump.n_tasks + s_dump.n_spans) * TRACE_NAME_LEN;
+}
+
+size_t trace_rec_dump_size(void)
+{
+    if (!s_frozen) return 0;
+    return sizeof(s_dump) + names_len() + (size_t)s_dump.n_events * sizeof(trace_event_t);
+}
+
+size_t trace_rec_dump_read(uint32_t off, uint8_t *dst, size_t len)
+{
+    if (!s_frozen || !dst) return 0;
+
+    size_t done = 0;
+    while (done < len) {
+        size_t o = off + done;
+        const uint8_t *src;
+        size_t avail;
+        char name[TRACE_NAME_LEN];
+
+        if (o < sizeof(s_dump)) {
+            src = (const uint8_t *)&s_dump + o;
+            avail = sizeof(s_dump) - o;
+        } else if ((o -= sizeof(s_dump)) < names_len()) {
+            size_t k = o / TRACE_NAME_LEN;
+            memset(name, 0, sizeof(name));
+            if (k < s_dump.n_tasks) {
+                memcpy(name, s_task_name[k], TRACE_NAME_LEN);
+            } else {
+                strncpy(name, k_span_names[k - s_dump.n_tasks], TRACE_NAME_LEN - 1);
+            }
+            src = (const uint8_t *)name + o % TRACE_NAME_LEN;
+            avail = TRACE_NAME_LEN - o % TRACE_NAME_LEN;
+        } else if ((o -= names_len()) < (size_t)s_dump.n_events * sizeof(trace_event_t)) {
+            size_t i = o / sizeof(trace_event_t);
+            src = (const uint8_t *)&s_ring[(s_dump_first + i) & RING_MASK] + o % sizeof(trace_event_t);
+            avail = sizeof(trace_event_t) - o % sizeof(trace_event_t);
+        } else {
+            break;
+        }
+
+        size_t n = avail < len - done ? avail : len - done;
+        memcpy(dst + done, src, n);
+        done += n;
+    }
+    return done;
+}
+
+void trace_rec_dump_serial(void)
+{
+    bool was_frozen = s_frozen;
+    trace_rec_freeze(true);
+
+    size_t size = trace_rec_dump_size();
+    printf("TRACE begin size=%u events=%u lost=%u\n",
+           (unsigned)size, (unsigned)s_dump.n_events, (unsigned)s_dump.lost);
+    for (uint32_t off = 0; off < size; off += DUMP_LINE_BYTES) {
+        uint8_t b[DUMP_LINE_BYTES];
+        size_t n = trace_rec_dump_read(off, b, sizeof(b));
+        char hex[2 * DUMP_LINE_BYTES + 1];
+        for (size_t i = 0; i < n; i++) {
+            snprintf(hex + 2 * i, 3, "%02x", b[i]);
+        }
+        hex[2 * n] = '\0';
+        printf("TRACE %06x %s\n", (unsigned)off, hex);
+    }
+    printf("TRACE end\n");
+
+    if (!was_frozen) trace_rec_freeze(false);
+}
+
+static int trace_stats_section(char *buf, size_t len)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    uint32_t tasks = __atomic_load_n(&s_task_count, __ATOMIC_RELAXED);
+    return snprintf(buf, len, "armed=%d,ev=%u,cap=%d,tasks=%u,frozen=%d,fdrop=%u",
+                    (int)s_armed, (unsigned)head, TRACE_REC_EVENTS, (unsigned)tasks,
+                    (int)s_frozen, (unsigned)s_dropped);
+}
+
+void trace_rec_init(void)
+{
+    ble_stats_register_section("trace", trace_stats_section);
+}
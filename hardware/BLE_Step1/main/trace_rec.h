@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Execution trace recorder.
+ *
+ * A RAM ring of 8-byte events: which task each core switched to (the
+ * FreeRTOS traceTASK_SWITCHED_IN hook, see trace_hooks.h) and begin/end
+ * of the spans below around the log, sensor, notify and OTA paths. The
+ * ring is a flight recorder: it keeps the last TRACE_REC_EVENTS events
+ * until a client freezes it and reads the dump (stats service, "trace"
+ * characteristic) or asks for it on the serial console.
+ * host/tools/trace2json turns a dump into Chrome / Perfetto trace JSON.
+ *
+ * Nothing is recorded until the recorder is armed (trace_rec_arm(), the
+ * trace characteristic); disarmed, the hook and the spans return at once.
+ * -DTRACE_REC_ARM_AT_BOOT=1 arms it from boot. -DTRACE_REC_ENABLE=0
+ * compiles the spans out. The scheduler hook is only built in with
+ * -D TRACE_TASK_HOOKS=1 on the idf.py command line.
+ */
+#ifndef TRACE_REC_ENABLE
+#define TRACE_REC_ENABLE 1
+#endif
+
+#ifndef TRACE_REC_ARM_AT_BOOT
+#define TRACE_REC_ARM_AT_BOOT 0
+#endif
+
+#define TRACE_REC_EVENTS    1024    // power of two; 8 KB of DRAM
+#define TRACE_REC_TASKS     16      // distinct tasks named in a dump; power of two
+#define TRACE_NAME_LEN      16      // configMAX_TASK_NAME_LEN
+
+typedef enum {
+    TRACE_EV_TASK_IN = 1,       // id = task slot
+    TRACE_EV_BEGIN,             // id = span
+    TRACE_EV_END,
+    TRACE_EV_MARK,              // instant; arg is span specific
+} trace_ev_type_t;
+
+typedef enum {
+    TRACE_SPAN_LOG_APPEND = 0,
+    TRACE_SPAN_LOG_FLUSH,
+    TRACE_SPAN_LOG_READ,
+    TRACE_SPAN_LOG_FIND,
+    TRACE_SPAN_LOG_IDLE,        // store housekeeping, e.g. sector pre-erase
+    TRACE_SPAN_SENSOR_READ,
+    TRACE_SPAN_NOTIFY_TX,       // ble_gatts_notify_custom, arg = class
+    TRACE_SPAN_OTA_BEGIN,       // esp_ota_begin: erases the slot
+    TRACE_SPAN_OTA_WRITE,       // arg = bytes
+    TRACE_SPAN_OTA_END,
+    TRACE_SPAN_BLE_CONNECT,     // mark
+    TRACE_SPAN_BLE_DISCONNECT,  // mark, arg = reason
+    TRACE_SPAN_COUNT
+} trace_span_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t ts_us;     // esp_timer, low 32 bits
+    uint8_t type;       // trace_ev_type_t | core << 7
+    uint8_t id;
+    uint16_t arg;
+} trace_event_t;
+
+/*
+ * Dump: header, n_tasks + n_spans names of TRACE_NAME_LEN bytes (NUL
+ * padded, task slot order then span order), then n_events events, oldest
+ * first. Little-endian.
+ */
+#define TRACE_DUMP_MAGIC    0x31435254u     // 'TRC1'
+#define TRACE_DUMP_VERSION  1
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t n_tasks;
+    uint8_t n_spans;
+    uint8_t name_len;
+    uint32_t n_events;
+    uint32_t lost;          // overwritten before the freeze
+    uint32_t dropped;       // not recorded while frozen
+    uint32_t t_dump_us;     // esp_timer at the freeze, low 32 bits
+} trace_dump_hdr_t;
+
+/** Register the "trace" stats section. */
+void trace_rec_init(void);
+
+/** Scheduler hook: `tcb` is now running on this core. ISR context. */
+void trace_rec_task_in(void *tcb);
+
+/** Scheduler hook: `tcb` is being deleted; a task reusing it gets a new slot. */
+void trace_rec_task_deleted(void *tcb);
+
+void trace_rec_event(trace_ev_type_t type, uint8_t id, uint16_t arg);
+
+/** Start (true) or stop recording. The ring keeps what it has. */
+void trace_rec_arm(bool on);
+bool trace_rec_armed(void);
+
+/**
+ * Stop recording and snapshot the ring for trace_rec_dump_read(), or
+ * (false) resume. Events while frozen are counted, not recorded.
+ */
+void trace_rec_freeze(bool on);
+bool trace_rec_frozen(void);
+
+/** Dump size in bytes; 0 unless frozen. */
+size_t trace_rec_dump_size(void);
+
+/** Copy dump bytes [off, off + len) into dst; returns the count (0 at the end). */
+size_t trace_rec_dump_read(uint32_t off, uint8_t *dst, size_t len);
+
+/**
+ * Freeze, print the dump on the console as "TRACE <off> <hex>" lines
+ * between "TRACE begin" / "TRACE end", and resume. Blocks for the
+ * console: run it from a low-priority task.
+ */
+void trace_rec_dump_serial(void);
+
+#if TRACE_REC_ENABLE
+#define TRACE_BEGIN(span)          trace_rec_event(TRACE_EV_BEGIN, (span), 0)
+#define TRACE_BEGIN_ARG(span, arg) trace_rec_event(TRACE_EV_BEGIN, (span), (uint16_t)(arg))
+#define TRACE_END(span)            trace_rec_event(TRACE_EV_END, (span), 0)
+#define TRACE_MARK(span, arg)      trace_rec_event(TRACE_EV_MARK, (span), (uint16_t)(arg))
+#else
+#define TRACE_BEGIN(span)          ((void)0)
+#define TRACE_BEGIN_ARG(span, arg) ((void)0)
+#define TRACE_END(span)            ((void)0)
+#define TRACE_MARK(span, arg)      ((void)0)
+#endif
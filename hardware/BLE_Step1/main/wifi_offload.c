@@ -0,0 +1,403 @@
+#include "wifi_offload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+#include "esp_http_client.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+#include "battery_log.h"
+#include "ble_stats.h"
+#include "ble_sync.h"
+#include "log_pack.h"
+#include "mem_plan.h"
+
+static const char *TAG = "WIFI_OFFLOAD";
+
+#define NVS_NS_OFFLOAD      "offload"
+#define WIFI_OFFLOAD_STACK  6144        // HTTP client; TLS runs in it for https URLs
+
+#define EV_GOT_IP       BIT0
+#define EV_DISCONNECTED BIT1
+
+typedef struct {
+    char ssid[33];
+    char pass[65];
+    char url[128];      // base: <url>/<dev>/offset, <url>/<dev>/batches
+    char dev[33];
+    char key[65];
+} offload_cfg_t;
+
+static const uint8_t *const s_sync_id = (const uint8_t *)WIFI_OFFLOAD_SYNC_ID;
+#define SYNC_ID_LEN (sizeof(WIFI_OFFLOAD_SYNC_ID) - 1)
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static offload_cfg_t s_cfg;
+static wifi_offload_stats_t s_stats;
+static EventGroupHandle_t s_events;
+static bool s_netif_ready = false;
+
+// One batch in RAM at a time: the records as read, and the body built from them.
+static battery_log_t s_recs[WIFI_OFFLOAD_ENABLE ? WIFI_OFFLOAD_BATCH : 1];
+static uint8_t s_body[WIFI_OFFLOAD_ENABLE ? LOG_PACK_BUF_SIZE(WIFI_OFFLOAD_BATCH) : 1];
+static char s_url[sizeof(s_cfg.url) + sizeof(s_cfg.dev) + 16];
+static char s_resp[160];
+
+static void cfg_str(nvs_handle_t h, bool open, const char *key, char *out, size_t len,
+                    const char *def)
+{
+    size_t n = len;
+    if (!open || nvs_get_str(h, key, out, &n) != ESP_OK) {
+        snprintf(out, len, "%s", def);
+    }
+}
+
+static bool load_config(void)
+{
+    nvs_handle_t h;
+    bool open = nvs_open(NVS_NS_OFFLOAD, NVS_READONLY, &h) == ESP_OK;
+    cfg_str(h, open, "ssid", s_cfg.ssid, sizeof(s_cfg.ssid), WIFI_OFFLOAD_SSID);
+    cfg_str(h, open, "pass", s_cfg.pass, sizeof(s_cfg.pass), WIFI_OFFLOAD_PASS);
+    cfg_str(h, open, "url", s_cfg.url, sizeof(s_cfg.url), WIFI_OFFLOAD_URL);
+    cfg_str(h, open, "dev", s_cfg.dev, sizeof(s_cfg.dev), WIFI_OFFLOAD_DEV);
+    cfg_str(h, open, "key", s_cfg.key, sizeof(s_cfg.key), WIFI_OFFLOAD_KEY);
+    if (open) nvs_close(h);
+
+    if (!s_cfg.dev[0]) {
+        uint8_t mac[6] = {0};
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(s_cfg.dev, sizeof(s_cfg.dev), "esp32-%02x%02x%02x", mac[3], mac[4], mac[5]);
+    }
+    size_t url_len = strlen(s_cfg.url);
+    if (url_len && s_cfg.url[url_len - 1] == '/') s_cfg.url[url_len - 1] = '\0';
+    return s_cfg.ssid[0] && s_cfg.url[0];
+}
+
+// ---------------------------------------------------------------- Wi-Fi
+
+static void wifi_event(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    (void)arg;
+    (void)data;
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        xEventGroupSetBits(s_events, EV_DISCONNECTED);
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        xEventGroupSetBits(s_events, EV_GOT_IP);
+    }
+}
+
+// netif and the default loop outlive a session; the driver does not.
+static esp_err_t netif_once(void)
+{
+    if (s_netif_ready) return ESP_OK;
+
+    esp_err_t err = esp_netif_init();
+    if (err == ESP_OK) {
+        err = esp_event_loop_create_default();
+        if (err == ESP_ERR_INVALID_STATE) err = ESP_OK;     // someone else made it
+    }
+    if (err == ESP_OK && !esp_netif_create_default_wifi_sta()) err = ESP_FAIL;
+    if (err == ESP_OK) err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, wifi_event, NULL);
+    if (err == ESP_OK) err = esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event, NULL);
+    s_netif_ready = err == ESP_OK;
+    return err;
+}
+
+static bool wifi_join(void)
+{
+    esp_err_t err = netif_once();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "netif setup failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    xEventGroupClearBits(s_events, EV_GOT_IP | EV_DISCONNECTED);
+
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t wc = {0};
+    memcpy(wc.sta.ssid, s_cfg.ssid, strlen(s_cfg.ssid));
+    memcpy(wc.sta.password, s_cfg.pass, strlen(s_cfg.pass));
+    wc.sta.threshold.authmode = s_cfg.pass[0] ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+
+    err = esp_wifi_init(&init);
+    if (err == ESP_OK) err = esp_wifi_set_storage(WIFI_STORAGE_RAM);    // config is in "offload"
+    if (err == ESP_OK) err = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (err == ESP_OK) err = esp_wifi_set_config(WIFI_IF_STA, &wc);
+    if (err == ESP_OK) err = esp_wifi_start();
+    if (err == ESP_OK) err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "wifi start failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(s_events, EV_GOT_IP | EV_DISCONNECTED, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(WIFI_OFFLOAD_CONNECT_MS));
+    if (!(bits & EV_GOT_IP)) {
+        ESP_LOGW(TAG, "could not join \"%s\" (%s)", s_cfg.ssid,
+                 (bits & EV_DISCONNECTED) ? "refused" : "timeout");
+        return false;
+    }
+    return true;
+}
+
+// Also after a failed join: gives the driver's heap back.
+static void wifi_leave(void)
+{
+    esp_wifi_disconnect();
+    esp_wifi_stop();
+    esp_wifi_deinit();
+}
+
+// ---------------------------------------------------------------- HTTP
+
+// One request on its own connection; the body of the reply lands in s_resp.
+// Returns the HTTP status, or -1 if the exchange failed.
+static int http_exchange(esp_http_client_handle_t c, esp_http_client_method_t method,
+                         const char *path, const uint8_t *body, int len)
+{
+    snprintf(s_url, sizeof(s_url), "%s/%s/%s", s_cfg.url, s_cfg.dev, path);
+    esp_http_client_set_url(c, s_url);
+    esp_http_client_set_method(c, method);
+
+    int status = -1;
+    s_resp[0] = '\0';
+    if (esp_http_client_open(c, len) == ESP_OK) {
+        if ((len == 0 || esp_http_client_write(c, (const char *)body, len) == len) &&
+            esp_http_client_fetch_headers(c) >= 0) {
+            int n = esp_http_client_read_response(c, s_resp, sizeof(s_resp) - 1);
+            s_resp[n > 0 ? n : 0] = '\0';
+            status = esp_http_client_get_status_code(c);
+        }
+        esp_http_client_close(c);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.last_status = status;
+    if (status != 200 && status != 409) s_stats.http_errors++;
+    portEXIT_CRITICAL(&s_lock);
+    return status;
+}
+
+// The backend answers {"success":..,"data":{"nextSeq":N,..}}; only N is needed.
+static bool resp_next_seq(uint32_t *next)
+{
+    const char *p = strstr(s_resp, "\"nextSeq\":");
+    if (!p) return false;
+    char *end;
+    unsigned long v = strtoul(p + 10, &end, 10);
+    if (end == p + 10) return false;
+    *next = (uint32_t)v;
+    return true;
+}
+
+// ---------------------------------------------------------------- upload
+
+// Up to WIFI_OFFLOAD_BATCH records with seq >= from. The log is held from
+// the seq lookup to the last read, so the writer task's appends (and the
+// partition store's evictions) cannot move the indices in between; the seq
+// checks only guard against a log that is out of order on flash.
+static int read_batch(uint32_t from)
+{
+    battery_log_lock();
+    int idx = battery_log_find_start_index_by_seq(from);
+    int count = battery_log_count();
+    int n = 0;
+
+    while (idx >= 0 && idx + n < count && n < WIFI_OFFLOAD_BATCH) {
+        battery_log_t *r = &s_recs[n];
+        if (!battery_log_read(idx + n, r)) break;
+        if (r->seq < from || (n > 0 && r->seq <= s_recs[n - 1].seq)) break;
+        n++;
+    }
+    battery_log_unlock();
+    return n;
+}
+
+static int upload(esp_http_client_handle_t c, uint32_t next)
+{
+    int accepted = 0;
+    bool skip_phone = true;
+    for (int b = 0; b < WIFI_OFFLOAD_MAX_BATCHES; b++) {
+        uint32_t from = next;
+        uint8_t flags = 0;
+
+        // The backend is ahead of the log: it was wiped and seqs started over.
+        if (from > battery_log_peek_next_seq()) {
+            from = 0;
+            flags = LOG_PACK_F_REBASE;
+        }
+        // A phone holds these and relays them itself. The backend takes that
+        // only once the relay has stored them; until then it answers 409 and
+        // this session uploads them too.
+        uint32_t phone;
+        if (skip_phone && ble_sync_newest_watermark(s_sync_id, SYNC_ID_LEN, &phone) &&
+            phone >= from && !(flags & LOG_PACK_F_REBASE)) {
+            from = phone + 1;
+            flags = LOG_PACK_F_REBASE;
+        }
+
+        int n = read_batch(from);
+        if (n == 0) break;      // caught up
+
+        int len = log_pack_batch(s_recs, n, from, flags, s_body, sizeof(s_body));
+        if (len < 0) break;
+        int status = http_exchange(c, HTTP_METHOD_POST, "batches", s_body, len);
+
+        uint32_t srv_next;
+        if ((status != 200 && status != 409) || !resp_next_seq(&srv_next)) {
+            ESP_LOGW(TAG, "batch from seq %" PRIu32 " failed: status %d", from, status);
+            break;
+        }
+        if (status == 409) {
+            // The backend's offset moved (another upload, its data restored):
+            // continue from where it is.
+            ESP_LOGW(TAG, "offset conflict: sent from %" PRIu32 ", backend at %" PRIu32,
+                     from, srv_next);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.conflicts++;
+            portEXIT_CRITICAL(&s_lock);
+            if (flags & LOG_PACK_F_REBASE) skip_phone = false;
+            next = srv_next;
+            continue;
+        }
+
+        if (srv_next > 0) ble_sync_ack_named(s_sync_id, SYNC_ID_LEN, srv_next - 1);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.batches++;
+        s_stats.records += n;
+        s_stats.bytes_raw += (uint32_t)n * LOG_RECORD_SIZE_BYTES;
+        s_stats.bytes_sent += len;
+        if (flags & LOG_PACK_F_REBASE) s_stats.rebased++;
+        s_stats.next_seq = srv_next;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "batch %d: %d records, %d bytes, offset %" PRIu32, b, n, len, srv_next);
+        accepted += n;
+        next = srv_next;
+    }
+    return accepted;
+}
+
+static uint32_t pending_records(void)
+{
+    battery_log_summary_t sum;
+    if (!battery_log_get_summary(&sum) || sum.count == 0) return 0;
+
+    uint32_t wm;
+    if (!wifi_offload_get_watermark(&wm) || wm < sum.first_seq) return sum.count;
+    return sum.last_seq > wm ? sum.last_seq - wm : 0;
+}
+
+int wifi_offload_run_session(void)
+{
+    if (!s_events) return -1;   // not configured
+    uint32_t pending = pending_records();
+    if (pending < WIFI_OFFLOAD_MIN_RECORDS) return 0;
+
+    ESP_LOGI(TAG, "session: about %" PRIu32 " records to upload", pending);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.sessions++;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!wifi_join()) {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.join_failed++;
+        portEXIT_CRITICAL(&s_lock);
+        wifi_leave();
+        return -1;
+    }
+
+    esp_http_client_config_t hc = {
+        .url = s_cfg.url,
+        .timeout_ms = WIFI_OFFLOAD_HTTP_MS,
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+    };
+    int accepted = -1;
+    esp_http_client_handle_t c = esp_http_client_init(&hc);
+    if (c) {
+        char auth[sizeof(s_cfg.key) + 8];
+        snprintf(auth, sizeof(auth), "Bearer %s", s_cfg.key);
+        esp_http_client_set_header(c, "Authorization", auth);
+        esp_http_client_set_header(c, "Content-Type", "application/octet-stream");
+
+        uint32_t next;
+        int status = http_exchange(c, HTTP_METHOD_GET, "offset", NULL, 0);
+        if (status == 200 && resp_next_seq(&next)) {
+            accepted = upload(c, next);
+        } else {
+            ESP_LOGW(TAG, "offset request failed: status %d", status);
+        }
+        esp_http_client_cleanup(c);
+    }
+    wifi_leave();
+    return accepted;
+}
+
+static void offload_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(WIFI_OFFLOAD_PERIOD_S * 1000));
+        wifi_offload_run_session();
+    }
+}
+
+static int offload_stats_section(char *buf, size_t len)
+{
+    wifi_offload_stats_t st;
+    wifi_offload_get_stats(&st);
+    return snprintf(buf, len,
+                    "cfg=%d,sessions=%" PRIu32 ",join_fail=%" PRIu32 ",batches=%" PRIu32
+                    ",records=%" PRIu32 ",raw=%" PRIu32 ",sent=%" PRIu32 ",rebased=%" PRIu32
+                    ",conflicts=%" PRIu32 ",http_err=%" PRIu32 ",status=%d,next=%" PRIu32,
+                    (int)st.configured, st.sessions, st.join_failed, st.batches, st.records,
+                    st.bytes_raw, st.bytes_sent, st.rebased, st.conflicts, st.http_errors,
+                    st.last_status, st.next_seq);
+}
+
+void wifi_offload_init(void)
+{
+    if (!WIFI_OFFLOAD_ENABLE) return;
+
+    bool configured = load_config();
+    portENTER_CRITICAL(&s_lock);
+    s_stats.configured = configured;
+    portEXIT_CRITICAL(&s_lock);
+    ble_stats_register_section("wifi", offload_stats_section);
+    if (!configured) {
+        ESP_LOGI(TAG, "no network configured (NVS \"%s\"): upload off", NVS_NS_OFFLOAD);
+        return;
+    }
+
+    s_events = xEventGroupCreate();
+    static StackType_t s_stack[WIFI_OFFLOAD_STACK];
+    static StaticTask_t s_tcb;
+    TaskHandle_t task = xTaskCreateStatic(offload_task, "wifi_offload", WIFI_OFFLOAD_STACK, NULL, 2,
+                                          s_stack, &s_tcb);
+    mem_plan_watch_task(task, WIFI_OFFLOAD_STACK);
+    ESP_LOGI(TAG, "uploading to %s as %s every %d s", s_cfg.url, s_cfg.dev, WIFI_OFFLOAD_PERIOD_S);
+}
+
+bool wifi_offload_get_watermark(uint32_t *seq)
+{
+    return ble_sync_get_named_watermark(s_sync_id, SYNC_ID_LEN, seq);
+}
+
+void wifi_offload_get_stats(wifi_offload_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
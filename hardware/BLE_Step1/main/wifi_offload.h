@@ -0,0 +1,94 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Wi-Fi bulk upload of the log to the backend.
+ *
+ * Opt-in twice: built only with WIFI_OFFLOAD_ENABLE (idf.py -D
+ * WIFI_OFFLOAD=1 build), and idle until a network and backend are
+ * configured (NVS namespace "offload", or the WIFI_OFFLOAD_* defaults
+ * below). Then every WIFI_OFFLOAD_PERIOD_S, if at least
+ * WIFI_OFFLOAD_MIN_RECORDS are not on the backend yet, it joins the
+ * network, asks the backend for its upload offset, POSTs what follows in
+ * log_pack batches of up to WIFI_OFFLOAD_BATCH records, and leaves the
+ * network again. Each accepted batch moves the offset, so an upload cut off
+ * by the network resumes where the backend stopped.
+ *
+ * The backend's offset is kept as a ble_sync watermark under the client id
+ * WIFI_OFFLOAD_SYNC_ID: it counts for reclaiming, a phone's SYNC (CMD 0x05)
+ * starts after it, and it is in the Log Summary, so the phone does not relay
+ * what the backend already has. The upload likewise starts after the
+ * newest phone watermark, since the phone relays those records itself.
+ * See docs/WIFI_OFFLOAD.md.
+ */
+#ifndef WIFI_OFFLOAD_ENABLE
+#define WIFI_OFFLOAD_ENABLE 0
+#endif
+
+#ifndef WIFI_OFFLOAD_PERIOD_S
+#define WIFI_OFFLOAD_PERIOD_S       900
+#endif
+#ifndef WIFI_OFFLOAD_MIN_RECORDS
+#define WIFI_OFFLOAD_MIN_RECORDS    128
+#endif
+#ifndef WIFI_OFFLOAD_BATCH
+#define WIFI_OFFLOAD_BATCH          128     // records per POST
+#endif
+#define WIFI_OFFLOAD_MAX_BATCHES    64      // per session, then wait for the next period
+#define WIFI_OFFLOAD_CONNECT_MS     15000
+#define WIFI_OFFLOAD_HTTP_MS        10000
+
+// Build-time defaults; the NVS "offload" keys (ssid, pass, url, dev, key) win.
+#ifndef WIFI_OFFLOAD_SSID
+#define WIFI_OFFLOAD_SSID   ""
+#endif
+#ifndef WIFI_OFFLOAD_PASS
+#define WIFI_OFFLOAD_PASS   ""
+#endif
+#ifndef WIFI_OFFLOAD_URL
+#define WIFI_OFFLOAD_URL    ""      // e.g. "http://192.168.1.20:3000/api/device-logs"
+#endif
+#ifndef WIFI_OFFLOAD_DEV
+#define WIFI_OFFLOAD_DEV    ""      // device id the backend knows; default from the MAC
+#endif
+#ifndef WIFI_OFFLOAD_KEY
+#define WIFI_OFFLOAD_KEY    ""      // bearer key for that device id
+#endif
+
+#define WIFI_OFFLOAD_SYNC_ID     "wifi-upload"
+
+typedef struct {
+    uint32_t sessions;
+    uint32_t join_failed;
+    uint32_t batches;           // accepted
+    uint32_t records;
+    uint32_t bytes_raw;         // records * LOG_RECORD_SIZE_BYTES
+    uint32_t bytes_sent;        // batch bodies
+    uint32_t rebased;           // offset moved past the backend's (log reset, phone relayed)
+    uint32_t conflicts;         // 409: backend had another offset
+    uint32_t http_errors;
+    int      last_status;       // HTTP status, -1 transport error
+    uint32_t next_seq;          // backend's offset after the last session
+    bool     configured;
+} wifi_offload_stats_t;
+
+/** Load the configuration and start the upload task (after ble_sync_init). */
+void wifi_offload_init(void);
+
+/**
+ * @brief One upload session on the caller's task: what the upload task runs
+ *        every period (host benches call it directly).
+ * @return records the backend accepted, 0 if fewer than
+ *         WIFI_OFFLOAD_MIN_RECORDS were pending, -1 if not configured or the
+ *         network or backend could not be reached
+ */
+int wifi_offload_run_session(void);
+
+/**
+ * @brief Highest seq the backend is known to hold (its offset - 1), from
+ *        the ble_sync table; false before the first accepted batch.
+ */
+bool wifi_offload_get_watermark(uint32_t *seq);
+
+void wifi_offload_get_stats(wifi_offload_stats_t *out);